@@ -0,0 +1,50 @@
+#!/bin/sh
+set -e
+
+# Run the Catch2 benchmark targets and compare them with the baselines in
+# benchmarks/. Exits non-zero when a gated benchmark (Log::write, config
+# parsing, layout pipeline) is significantly slower than its baseline.
+#
+#   scripts/bench_baseline.sh [--update] [--build-dir DIR] [--samples N] [-- bench_compare options]
+#
+# --update records a new baseline instead of comparing; commit the result
+# together with the change that explains it. Baselines are only comparable
+# on the machine that recorded them.
+
+BUILD_DIR="build-bench"
+SAMPLES=30
+UPDATE=0
+BENCH_TARGETS="bench_core"
+
+while [ $# -gt 0 ]; do
+    case "$1" in
+        --update) UPDATE=1 ;;
+        --build-dir) shift; BUILD_DIR="$1" ;;
+        --samples) shift; SAMPLES="$1" ;;
+        --) shift; break ;;
+        *) echo "usage: $0 [--update] [--build-dir DIR] [--samples N] [-- bench_compare options]" >&2; exit 2 ;;
+    esac
+    shift
+done
+
+cmake -S . -B "$BUILD_DIR" -DCMAKE_BUILD_TYPE=Release >/dev/null
+cmake --build "$BUILD_DIR" --target $BENCH_TARGETS bench_compare -j"$(nproc)" >/dev/null
+
+status=0
+for target in $BENCH_TARGETS; do
+    result="$BUILD_DIR/$target.json"
+    baseline="benchmarks/$target.json"
+    echo "Running $target ($SAMPLES samples)..."
+    "$BUILD_DIR/$target" --reporter "benchjson::out=$result" --benchmark-samples "$SAMPLES" >/dev/null
+
+    if [ "$UPDATE" = 1 ]; then
+        cp "$result" "$baseline"
+        echo "Updated $baseline"
+    elif [ ! -f "$baseline" ]; then
+        echo "No baseline for $target; run $0 --update first" >&2
+        status=2
+    else
+        "$BUILD_DIR/bench_compare" "$baseline" "$result" --thresholds benchmarks/thresholds.conf "$@" || status=$?
+    fi
+done
+exit $status
@@ -82,7 +82,7 @@ if %ERRORLEVEL%==0 (
     tests\test_tray_icon.cpp tests\test_tray_icon_integration.cpp tests\test_tray_icon_update.cpp ^
     tests\test_hotkey_registry.cpp tests\test_unknown_option.cpp tests\test_config_watcher_posix.cpp tests\stubs.cpp ^
     source\configuration.cpp source\log.cpp source\config_parser.cpp source\tray_icon.cpp ^
-    source\hotkey_registry.cpp source\hotkey_cli.cpp source\config_watcher.cpp source\config_watcher_posix.cpp source\cli_utils.cpp ^
+    source\hotkey_registry.cpp source\hotkey_cli.cpp source\config_watcher.cpp source\cli_utils.cpp ^
     source\app_state.cpp ^
     -o tests\run_tests -pthread
   if %ERRORLEVEL% NEQ 0 (
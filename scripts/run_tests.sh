@@ -60,12 +60,12 @@ if echo '#include <catch2/catch_test_macros.hpp>' | g++ -std=c++17 -x c++ - -fsy
     g++ -std=c++17 -DUNIT_TEST -I tests -I resources \
         tests/test_configuration.cpp tests/test_log.cpp tests/test_utils.cpp tests/test_timer_guard.cpp \
         tests/test_tray_icon.cpp tests/test_tray_icon_integration.cpp tests/test_tray_icon_update.cpp \
-        tests/test_hotkey_registry.cpp tests/test_unknown_option.cpp tests/test_config_watcher_posix.cpp tests/stubs.cpp \
-        source/configuration.cpp source/log.cpp source/config_parser.cpp source/tray_icon.cpp \
-        source/hotkey_registry.cpp source/hotkey_cli.cpp source/config_watcher.cpp source/config_watcher_posix.cpp source/cli_utils.cpp \
-        source/app_state.cpp \
+        tests/test_hotkey_registry.cpp tests/test_unknown_option.cpp tests/test_config_watcher_posix.cpp tests/test_file_watch_service.cpp tests/test_shared_state.cpp tests/test_config_image.cpp tests/test_layout_events.cpp tests/test_latency_stats.cpp tests/test_layout_trace.cpp tests/test_startup_profile.cpp tests/test_startup_scheduler.cpp tests/stubs.cpp tests/memory_registry.cpp \
+        source/configuration.cpp source/log.cpp source/config_parser.cpp source/config_schema.cpp source/tray_icon.cpp \
+        source/hotkey_registry.cpp source/hotkey_cli.cpp source/config_watcher.cpp source/file_watch_service.cpp source/file_watch_service_posix.cpp source/file_watch_service_win.cpp source/cli_utils.cpp \
+        source/app_state.cpp source/shared_memory.cpp source/shared_state.cpp source/config_image.cpp source/config_cache.cpp source/layout_event_ring.cpp source/layout_event_consumer.cpp source/layout_pipeline.cpp source/latency_stats.cpp source/layout_trace.cpp source/startup_profile.cpp source/startup_scheduler.cpp \
         -o tests/run_tests \
-        -lCatch2Main -lCatch2 -pthread
+        -lCatch2Main -lCatch2 -pthread -lrt
 else
     # Use the downloaded single-header and catch_main.cpp
     g++ -std=c++17 -DUNIT_TEST -I tests -I resources -I "$VENDOR_DIR" \
@@ -73,11 +73,11 @@ else
         tests/vendor/catch2/catch_amalgamated.cpp \
         tests/test_configuration.cpp tests/test_log.cpp tests/test_utils.cpp tests/test_timer_guard.cpp \
         tests/test_tray_icon.cpp tests/test_tray_icon_integration.cpp tests/test_tray_icon_update.cpp \
-        tests/test_hotkey_registry.cpp tests/test_unknown_option.cpp tests/test_config_watcher_posix.cpp tests/stubs.cpp \
-        source/configuration.cpp source/log.cpp source/config_parser.cpp source/tray_icon.cpp \
-        source/hotkey_registry.cpp source/hotkey_cli.cpp source/config_watcher.cpp source/config_watcher_posix.cpp source/cli_utils.cpp \
-        source/app_state.cpp \
-        -o tests/run_tests -pthread
+        tests/test_hotkey_registry.cpp tests/test_unknown_option.cpp tests/test_config_watcher_posix.cpp tests/test_file_watch_service.cpp tests/test_shared_state.cpp tests/test_config_image.cpp tests/test_layout_events.cpp tests/test_latency_stats.cpp tests/test_layout_trace.cpp tests/test_startup_profile.cpp tests/test_startup_scheduler.cpp tests/stubs.cpp tests/memory_registry.cpp \
+        source/configuration.cpp source/log.cpp source/config_parser.cpp source/config_schema.cpp source/tray_icon.cpp \
+        source/hotkey_registry.cpp source/hotkey_cli.cpp source/config_watcher.cpp source/file_watch_service.cpp source/file_watch_service_posix.cpp source/file_watch_service_win.cpp source/cli_utils.cpp \
+        source/app_state.cpp source/shared_memory.cpp source/shared_state.cpp source/config_image.cpp source/config_cache.cpp source/layout_event_ring.cpp source/layout_event_consumer.cpp source/layout_pipeline.cpp source/latency_stats.cpp source/layout_trace.cpp source/startup_profile.cpp source/startup_scheduler.cpp \
+        -o tests/run_tests -pthread -lrt
 fi
 
 ./tests/run_tests "$@"
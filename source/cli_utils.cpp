@@ -33,6 +33,7 @@ std::wstring GetUsageString() {
         L"  --disable-layout-hotkey    Disable the Windows \"Layout\" hotkey\n"
         L"  --version    Print the application version and exit\n"
         L"  --status     Print startup and hotkey states and exit\n"
+        L"  --startup-report           Print how long each startup phase took\n"
         L"  --help       Show this help message and exit";
 }
 
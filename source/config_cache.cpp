@@ -0,0 +1,167 @@
+#include "config_cache.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <cwchar>
+#include <cwctype>
+#include <filesystem>
+#include <fstream>
+#include <system_error>
+
+#include "config_image.h"
+#include "config_parser.h"
+#include "config_schema.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+namespace {
+constexpr size_t kAlignment = 8;
+
+size_t Padded(size_t size) {
+    return (size + kAlignment - 1) & ~(kAlignment - 1);
+}
+
+bool SameKey(const ConfigCacheKey& a, const ConfigCacheKey& b) {
+    return a.sourceHash == b.sourceHash && a.sourceSize == b.sourceSize && a.environmentHash == b.environmentHash &&
+           a.schemaHash == b.schemaHash;
+}
+
+std::wstring DiagnosticKey(size_t index) {
+    std::wstring key = std::to_wstring(index);
+    key.insert(0, key.size() < 8 ? 8 - key.size() : 0, L'0');
+    return key;
+}
+
+void Append(std::wstring& out, std::wstring_view text) {
+    out.append(text);
+    out.push_back(L'\0');
+}
+} // namespace
+
+uint64_t ConfigSchemaHash() {
+    static const uint64_t hash = [] {
+        std::wstring text;
+        for (const ConfigKeyInfo& info : kConfigKeys) {
+            Append(text, info.name);
+            Append(text, info.defaultValue);
+            text += std::to_wstring(static_cast<unsigned>(info.type)) + L',' + std::to_wstring(info.minValue) + L',' +
+                    std::to_wstring(info.maxValue);
+            for (size_t i = 0; i < info.choiceCount; ++i)
+                Append(text, info.choices[i]);
+            text.push_back(L'\0');
+        }
+        return HashConfigBytes(text.data(), text.size() * sizeof(wchar_t));
+    }();
+    return hash;
+}
+
+std::wstring ConfigCacheDirectory() {
+    namespace fs = std::filesystem;
+#ifdef _WIN32
+    wchar_t localAppData[MAX_PATH];
+    DWORD length = GetEnvironmentVariableW(L"LOCALAPPDATA", localAppData, MAX_PATH);
+    if (length == 0 || length >= MAX_PATH)
+        return std::wstring();
+    return (fs::path(localAppData) / L"kbdlayoutmon" / L"cache").wstring();
+#else
+    if (const char* cacheHome = std::getenv("XDG_CACHE_HOME"); cacheHome && *cacheHome)
+        return (fs::path(cacheHome) / "kbdlayoutmon").wstring();
+    if (const char* home = std::getenv("HOME"); home && *home)
+        return (fs::path(home) / ".cache" / "kbdlayoutmon").wstring();
+    return std::wstring();
+#endif
+}
+
+std::wstring ConfigCachePath(const std::wstring& configPath) {
+    std::wstring directory = ConfigCacheDirectory();
+    if (directory.empty())
+        return std::wstring();
+    // The file name keeps caches of same-named files in different places apart
+    std::wstring source = std::filesystem::path(configPath).lexically_normal().wstring();
+#ifdef _WIN32
+    for (wchar_t& c : source)
+        c = towlower(c);
+#endif
+    wchar_t hash[17];
+    swprintf(hash, 17, L"%016llx",
+             static_cast<unsigned long long>(HashConfigBytes(source.data(), source.size() * sizeof(wchar_t))));
+    std::wstring name = std::filesystem::path(configPath).filename().wstring() + L"." + hash + L".cache";
+    return (std::filesystem::path(directory) / name).wstring();
+}
+
+bool WriteConfigCache(const std::wstring& path, const ConfigCacheKey& key, const ConfigMap& settings,
+                      const std::vector<std::wstring>& diagnostics) {
+    ConfigMap numbered;
+    for (size_t i = 0; i < diagnostics.size(); ++i)
+        numbered.emplace(DiagnosticKey(i), diagnostics[i]);
+    std::vector<unsigned char> settingsImage = SerializeConfigImage(settings, 0);
+    std::vector<unsigned char> diagnosticsImage = SerializeConfigImage(numbered, 0);
+
+    ConfigCacheHeader header{};
+    header.magic = kConfigCacheMagic;
+    header.version = kConfigCacheVersion;
+    header.key = key;
+    header.settingsBytes = static_cast<uint32_t>(Padded(settingsImage.size()));
+    header.diagnosticsBytes = static_cast<uint32_t>(diagnosticsImage.size());
+
+    std::vector<unsigned char> file(sizeof(header) + header.settingsBytes + header.diagnosticsBytes);
+    unsigned char* payload = file.data() + sizeof(header);
+    std::memcpy(payload, settingsImage.data(), settingsImage.size());
+    std::memcpy(payload + header.settingsBytes, diagnosticsImage.data(), diagnosticsImage.size());
+    header.payloadHash = HashConfigBytes(payload, file.size() - sizeof(header));
+    std::memcpy(file.data(), &header, sizeof(header));
+
+    namespace fs = std::filesystem;
+    if (path.empty())
+        return false;
+    fs::path target(path);
+    fs::path temp(path + L".tmp");
+    std::error_code ec;
+    fs::create_directories(target.parent_path(), ec);
+    {
+        std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+        if (!out.is_open())
+            return false;
+        out.write(reinterpret_cast<const char*>(file.data()), static_cast<std::streamsize>(file.size()));
+        if (!out.flush())
+            return false;
+    }
+    fs::rename(temp, target, ec);
+    if (ec) {
+        fs::remove(temp, ec);
+        return false;
+    }
+    return true;
+}
+
+bool ReadConfigCache(const std::wstring& path, const ConfigCacheKey& key, ConfigMap& settings,
+                     std::vector<std::wstring>& diagnostics) {
+    std::string bytes;
+    if (!ReadConfigBytes(path, bytes) || bytes.size() < sizeof(ConfigCacheHeader))
+        return false;
+    ConfigCacheHeader header;
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    size_t payloadSize = bytes.size() - sizeof(header);
+    if (header.magic != kConfigCacheMagic || header.version != kConfigCacheVersion || !SameKey(header.key, key) ||
+        header.settingsBytes % kAlignment != 0 ||
+        static_cast<uint64_t>(header.settingsBytes) + header.diagnosticsBytes != payloadSize)
+        return false;
+    // The images are attached in place; std::string storage is suitably
+    // aligned and both images start on an 8-byte boundary
+    const char* payload = bytes.data() + sizeof(header);
+    if (HashConfigBytes(payload, payloadSize) != header.payloadHash)
+        return false;
+
+    ConfigImageView settingsView;
+    ConfigImageView diagnosticsView;
+    if (!settingsView.attach(payload, header.settingsBytes) ||
+        !diagnosticsView.attach(payload + header.settingsBytes, header.diagnosticsBytes))
+        return false;
+    settings = settingsView.toMap();
+    diagnostics.clear();
+    for (auto& [index, text] : diagnosticsView.toMap())
+        diagnostics.push_back(std::move(text));
+    return true;
+}
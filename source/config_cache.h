@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "config_map.h"
+
+/**
+ * @brief What a cached parse was produced from.
+ *
+ * A cache file is only used when every field matches, so an edited file,
+ * a different environment (which variable expansion depends on) or a
+ * program with a different key registry parses the text again.
+ */
+struct ConfigCacheKey {
+    uint64_t sourceHash = 0;      ///< HashConfigBytes of the configuration file
+    uint64_t sourceSize = 0;
+    uint64_t environmentHash = 0; ///< EnvironmentSnapshot::hash() used for expansion
+    uint64_t schemaHash = 0;      ///< ConfigSchemaHash() of the writer
+};
+
+/**
+ * @brief Start of a cache file.
+ *
+ * A settings image and a diagnostics image (see config_image.h) follow,
+ * each starting on an 8-byte boundary. Diagnostics are keyed by their
+ * zero-padded index so the image keeps them in order.
+ */
+struct ConfigCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    ConfigCacheKey key;
+    uint64_t payloadHash;      ///< HashConfigBytes of everything after the header
+    uint32_t settingsBytes;    ///< Settings image including padding
+    uint32_t diagnosticsBytes;
+};
+
+inline constexpr uint32_t kConfigCacheMagic = 0x4B4C4343; // "KLCC"
+inline constexpr uint32_t kConfigCacheVersion = 1;
+
+/// Fingerprint of the key registry; normalized values depend on it.
+uint64_t ConfigSchemaHash();
+
+/// Per-user cache directory: %LOCALAPPDATA%\kbdlayoutmon\cache, or
+/// $XDG_CACHE_HOME/kbdlayoutmon on POSIX; empty when it cannot be found.
+std::wstring ConfigCacheDirectory();
+
+/**
+ * @brief Cache file for the configuration file @p configPath.
+ *
+ * Caches live in ConfigCacheDirectory() rather than beside the file, whose
+ * directory may be shared with other users. Empty when there is no such
+ * directory, in which case nothing is cached.
+ */
+std::wstring ConfigCachePath(const std::wstring& configPath);
+
+/**
+ * @brief Store the result of parsing a configuration file.
+ *
+ * The cache is written under a temporary name and renamed over the old
+ * one, so a reader sees either the previous file or the complete new one.
+ *
+ * @return @c false when the file could not be written; the next load then
+ *         simply parses the text again.
+ */
+bool WriteConfigCache(const std::wstring& path, const ConfigCacheKey& key, const ConfigMap& settings,
+                      const std::vector<std::wstring>& diagnostics);
+
+/**
+ * @brief Load a parse result stored for @p key.
+ * @return @c false when the cache is missing, was written for another key,
+ *         or is truncated or corrupt.
+ */
+bool ReadConfigCache(const std::wstring& path, const ConfigCacheKey& key, ConfigMap& settings,
+                     std::vector<std::wstring>& diagnostics);
@@ -0,0 +1,181 @@
+#include "config_image.h"
+
+#include <algorithm>
+#include <cstring>
+
+std::vector<unsigned char> SerializeConfigImage(const ConfigMap& settings,
+                                                uint32_t generation) {
+    std::vector<ConfigImageEntry> entries;
+    entries.reserve(settings.size());
+    std::wstring pool;
+    // std::map iterates in key order, which is what the reader's binary
+    // search relies on.
+    for (const auto& [key, value] : settings) {
+        ConfigImageEntry e{};
+        e.keyOffset = static_cast<uint32_t>(pool.size());
+        e.keyLength = static_cast<uint32_t>(key.size());
+        pool += key;
+        e.valueOffset = static_cast<uint32_t>(pool.size());
+        e.valueLength = static_cast<uint32_t>(value.size());
+        pool += value;
+        entries.push_back(e);
+    }
+
+    ConfigImageHeader header{};
+    header.magic = ConfigImageView::kMagic;
+    header.version = ConfigImageView::kVersion;
+    header.generation = generation;
+    header.entryCount = static_cast<uint32_t>(entries.size());
+    header.poolLength = static_cast<uint32_t>(pool.size());
+    header.charSize = sizeof(wchar_t);
+
+    size_t entryBytes = entries.size() * sizeof(ConfigImageEntry);
+    size_t poolBytes = pool.size() * sizeof(wchar_t);
+    std::vector<unsigned char> image(sizeof(header) + entryBytes + poolBytes);
+    std::memcpy(image.data(), &header, sizeof(header));
+    if (entryBytes)
+        std::memcpy(image.data() + sizeof(header), entries.data(), entryBytes);
+    if (poolBytes)
+        std::memcpy(image.data() + sizeof(header) + entryBytes, pool.data(), poolBytes);
+    return image;
+}
+
+bool ConfigImageView::attach(const void* data, size_t size) {
+    m_header = nullptr;
+    m_entries = nullptr;
+    m_pool = nullptr;
+    m_entryCount = 0;
+    m_poolLength = 0;
+    if (!data || size < sizeof(ConfigImageHeader))
+        return false;
+
+    const auto* bytes = static_cast<const unsigned char*>(data);
+    const auto* header = reinterpret_cast<const ConfigImageHeader*>(bytes);
+    if (header->magic != kMagic || header->version != kVersion || header->charSize != sizeof(wchar_t))
+        return false;
+
+    uint32_t entryCount = header->entryCount;
+    uint32_t poolLength = header->poolLength;
+    size_t entryBytes = static_cast<size_t>(entryCount) * sizeof(ConfigImageEntry);
+    size_t poolBytes = static_cast<size_t>(poolLength) * sizeof(wchar_t);
+    if (entryBytes > size - sizeof(ConfigImageHeader) ||
+        poolBytes > size - sizeof(ConfigImageHeader) - entryBytes)
+        return false;
+
+    m_header = header;
+    m_entries = reinterpret_cast<const ConfigImageEntry*>(bytes + sizeof(ConfigImageHeader));
+    m_pool = reinterpret_cast<const wchar_t*>(bytes + sizeof(ConfigImageHeader) + entryBytes);
+    // Counts are captured once so that a concurrent rewrite of shared memory
+    // can only yield stale text, never an out-of-bounds read.
+    m_entryCount = entryCount;
+    m_poolLength = poolLength;
+    return true;
+}
+
+bool ConfigImageView::inBounds(uint32_t offset, uint32_t length) const {
+    return offset <= m_poolLength && length <= m_poolLength - offset;
+}
+
+std::optional<std::wstring_view> ConfigImageView::get(std::wstring_view key) const {
+    size_t lo = 0;
+    size_t hi = m_entryCount;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        ConfigImageEntry e = m_entries[mid];
+        if (!inBounds(e.keyOffset, e.keyLength) || !inBounds(e.valueOffset, e.valueLength))
+            return std::nullopt;
+        int cmp = text(e.keyOffset, e.keyLength).compare(key);
+        if (cmp == 0)
+            return text(e.valueOffset, e.valueLength);
+        if (cmp < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return std::nullopt;
+}
+
+ConfigMap ConfigImageView::toMap() const {
+    ConfigMap result;
+    for (size_t i = 0; i < m_entryCount; ++i) {
+        ConfigImageEntry e = m_entries[i];
+        if (!inBounds(e.keyOffset, e.keyLength) || !inBounds(e.valueOffset, e.valueLength))
+            break;
+        result.emplace(text(e.keyOffset, e.keyLength), text(e.valueOffset, e.valueLength));
+    }
+    return result;
+}
+
+bool SharedConfigImage::openForPublish(const std::wstring& name) {
+    close();
+    if (!m_memory.open(name, kRegionSize))
+        return false;
+    auto* control = static_cast<ConfigImageControl*>(m_memory.data());
+    uint32_t expected = 0;
+    if (!control->magic.compare_exchange_strong(expected, ConfigImageView::kMagic) &&
+        expected != ConfigImageView::kMagic) {
+        m_memory.close();
+        return false;
+    }
+    m_control = control;
+    m_writable = true;
+    return true;
+}
+
+bool SharedConfigImage::openForRead(const std::wstring& name) {
+    close();
+    if (!m_memory.open(name, kRegionSize, SharedMemory::Access::ReadOnly))
+        return false;
+    auto* control = static_cast<ConfigImageControl*>(m_memory.data());
+    if (control->magic.load(std::memory_order_acquire) != ConfigImageView::kMagic) {
+        m_memory.close();
+        return false;
+    }
+    m_control = control;
+    m_writable = false;
+    return true;
+}
+
+void SharedConfigImage::close() noexcept {
+    m_control = nullptr;
+    m_writable = false;
+    m_memory.close();
+}
+
+unsigned char* SharedConfigImage::slot(uint32_t index) const {
+    return static_cast<unsigned char*>(m_memory.data()) + 4096 + (index & 1u) * kSlotSize;
+}
+
+uint32_t SharedConfigImage::publish(const ConfigMap& settings) {
+    if (!m_control || !m_writable)
+        return 0;
+    uint32_t generation = m_control->generation.load(std::memory_order_relaxed) + 1;
+    if (generation == 0)
+        generation = 1;
+    std::vector<unsigned char> image = SerializeConfigImage(settings, generation);
+    if (image.size() > kSlotSize)
+        return 0;
+
+    // Readers only follow activeSlot, so the other slot can be rewritten
+    // without disturbing a lookup in progress.
+    uint32_t target = m_control->activeSlot.load(std::memory_order_relaxed) ^ 1u;
+    std::memcpy(slot(target), image.data(), image.size());
+    m_control->slotBytes[target].store(static_cast<uint32_t>(image.size()), std::memory_order_relaxed);
+    m_control->activeSlot.store(target, std::memory_order_release);
+    m_control->generation.store(generation, std::memory_order_release);
+    return generation;
+}
+
+uint32_t SharedConfigImage::generation() const {
+    return m_control ? m_control->generation.load(std::memory_order_acquire) : 0;
+}
+
+ConfigImageView SharedConfigImage::current() const {
+    ConfigImageView view;
+    if (!m_control || generation() == 0)
+        return view;
+    uint32_t active = m_control->activeSlot.load(std::memory_order_acquire) & 1u;
+    size_t bytes = std::min<size_t>(m_control->slotBytes[active].load(std::memory_order_acquire), kSlotSize);
+    view.attach(slot(active), bytes);
+    return view;
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "config_map.h"
+#include "shared_memory.h"
+
+/**
+ * @brief Compact, position-independent serialization of parsed settings.
+ *
+ * Layout: a fixed header, an entry table sorted by key and a pool of
+ * UTF-16/UTF-32 code units (native @c wchar_t) holding keys and values.
+ * Offsets are relative to the pool, so the image can be read in place from
+ * shared memory or a mapped file.
+ */
+struct ConfigImageHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t generation;
+    uint32_t entryCount;
+    uint32_t poolLength;  ///< Pool size in wchar_t units.
+    uint32_t charSize;    ///< sizeof(wchar_t) of the writer.
+};
+
+/// One key/value pair; offsets and lengths are in wchar_t units.
+struct ConfigImageEntry {
+    uint32_t keyOffset;
+    uint32_t keyLength;
+    uint32_t valueOffset;
+    uint32_t valueLength;
+};
+
+/**
+ * @brief Serialize @p settings into an image buffer.
+ * @param settings   Lower-cased keys and their values.
+ * @param generation Generation number stored in the header.
+ * @return Bytes of the image.
+ */
+std::vector<unsigned char> SerializeConfigImage(const ConfigMap& settings,
+                                                uint32_t generation);
+
+/**
+ * @brief Read-only, zero-copy view over a serialized image.
+ *
+ * Returned string views point into the underlying buffer and stay valid only
+ * as long as that buffer does.
+ */
+class ConfigImageView {
+public:
+    static constexpr uint32_t kMagic = 0x4B4C4349; // "KLCI"
+    static constexpr uint32_t kVersion = 1;
+
+    /**
+     * @brief Validate and attach to an image.
+     * @return @c false when the buffer is truncated or malformed.
+     */
+    bool attach(const void* data, size_t size);
+    /// True when attached to a valid image.
+    bool valid() const noexcept { return m_header != nullptr; }
+    /// Generation stored by the writer.
+    uint32_t generation() const noexcept { return m_header ? m_header->generation : 0; }
+    /// Number of stored settings.
+    size_t size() const noexcept { return m_entryCount; }
+
+    /// Look up @p key without copying; keys are lower case.
+    std::optional<std::wstring_view> get(std::wstring_view key) const;
+    /// Copy every entry into a map.
+    ConfigMap toMap() const;
+
+private:
+    std::wstring_view text(uint32_t offset, uint32_t length) const {
+        return std::wstring_view(m_pool + offset, length);
+    }
+    bool inBounds(uint32_t offset, uint32_t length) const;
+
+    const ConfigImageHeader* m_header = nullptr;
+    const ConfigImageEntry* m_entries = nullptr;
+    const wchar_t* m_pool = nullptr;
+    uint32_t m_entryCount = 0;
+    uint32_t m_poolLength = 0;
+};
+
+/**
+ * @brief Control block at the start of the shared configuration region.
+ *
+ * Two image slots follow it. The host writes the inactive slot, then flips
+ * @c activeSlot and publishes the new @c generation.
+ */
+struct ConfigImageControl {
+    std::atomic<uint32_t> magic;
+    std::atomic<uint32_t> generation;
+    std::atomic<uint32_t> activeSlot;
+    std::atomic<uint32_t> slotBytes[2];
+};
+
+/**
+ * @brief Shared-memory region through which the host hands the effective
+ *        configuration to every process hosting the hook.
+ *
+ * The publisher maps the region read-write; readers map it read-only and
+ * look values up in place. A view obtained from @c current() remains intact
+ * until the publisher has written twice more, so readers compare
+ * @c generation() before and after use when they hold a view across calls.
+ */
+class SharedConfigImage {
+public:
+    /// Name of the region used by the application.
+    static constexpr const wchar_t* kDefaultName = L"kbdlayoutmon_config";
+    /// Capacity of one image slot.
+    static constexpr size_t kSlotSize = 64 * 1024;
+    /// Total region size.
+    static constexpr size_t kRegionSize = 4096 + 2 * kSlotSize;
+
+    /// Map the region for publishing, creating it when needed.
+    bool openForPublish(const std::wstring& name = kDefaultName);
+    /// Attach read-only to a region created by the publisher.
+    bool openForRead(const std::wstring& name = kDefaultName);
+    /// Unmap the region.
+    void close() noexcept;
+    /// True when mapped.
+    bool isOpen() const noexcept { return m_control != nullptr; }
+
+    /**
+     * @brief Serialize and publish @p settings.
+     * @return New generation, or 0 if the image does not fit or the region
+     *         is not writable.
+     */
+    uint32_t publish(const ConfigMap& settings);
+
+    /// Generation of the active image; 0 when nothing was published.
+    uint32_t generation() const;
+    /// View of the active image; invalid when nothing was published.
+    ConfigImageView current() const;
+
+private:
+    unsigned char* slot(uint32_t index) const;
+
+    SharedMemory m_memory;
+    ConfigImageControl* m_control = nullptr;
+    bool m_writable = false;
+};
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <functional>
+#include <map>
+#include <string>
+
+/**
+ * @brief Parsed settings keyed by lower-cased name.
+ *
+ * The transparent comparator lets callers look keys up with a
+ * @c std::wstring_view or literal without building a temporary string.
+ */
+using ConfigMap = std::map<std::wstring, std::wstring, std::less<>>;
@@ -1,41 +1,319 @@
 #include "config_parser.h"
+#include "config_schema.h"
 #include <algorithm>
-#include <cwctype>
-#include <stdexcept>
+#include <cstdint>
 #include <cstdlib>
+#include <cstring>
+#include <cwchar>
+#include <cwctype>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
 
 #ifdef _WIN32
 #include <windows.h>
+#else
+extern char** environ;
 #endif
 
+std::wstring ParseBoolOrDefault(const std::wstring& value, bool def) {
+    return ParseConfigBool(value).value_or(def) ? L"1" : L"0";
+}
+
 namespace {
-std::wstring ParseUnsignedOrDefault(const std::wstring& value, unsigned long def) {
-    try {
-        if (!value.empty() && value[0] == L'-') {
-            throw std::invalid_argument("negative");
+constexpr std::wstring_view kSpace = L" \t\r\n";
+
+std::wstring_view Trim(std::wstring_view text) {
+    size_t start = text.find_first_not_of(kSpace);
+    if (start == std::wstring_view::npos)
+        return {};
+    size_t end = text.find_last_not_of(kSpace);
+    return text.substr(start, end - start + 1);
+}
+
+// Parse one line into @p result. @p key is scratch space reused across
+// lines so only new map entries allocate.
+void ParseLine(std::wstring_view line, size_t lineNumber, ConfigMap& result, std::wstring& key,
+               std::vector<std::wstring>* diagnostics, const EnvironmentSnapshot* environment) {
+    line = Trim(line);
+    if (line.empty() || line[0] == L'#' || line[0] == L';')
+        return;
+
+    size_t eqPos = line.find(L'=');
+    if (eqPos == std::wstring_view::npos)
+        return;
+    std::wstring_view rawKey = line.substr(0, eqPos);
+    std::wstring_view value = line.substr(eqPos + 1);
+
+    // Strip inline comments while respecting quoted sections
+    wchar_t quoteChar = 0;
+    for (size_t i = 0; i < value.size(); ++i) {
+        wchar_t c = value[i];
+        if (quoteChar) {
+            if (c == quoteChar)
+                quoteChar = 0;
+        } else if (c == L'"' || c == L'\'') {
+            quoteChar = c;
+        } else if (c == L'#' || c == L';') {
+            value = value.substr(0, i);
+            break;
+        }
+    }
+
+    rawKey = Trim(rawKey);
+    value = Trim(value);
+
+    // Remove surrounding quotes if present
+    if (value.size() >= 2 && (value.front() == L'"' || value.front() == L'\'') && value.back() == value.front())
+        value = value.substr(1, value.size() - 2);
+
+    key.assign(rawKey);
+    for (wchar_t& c : key)
+        c = static_cast<wchar_t>(std::towlower(c));
+
+    // Expand environment variables such as %VAR% or $VAR
+    std::wstring expanded;
+    if (value.find_first_of(L"%$") != std::wstring_view::npos) {
+        expanded = ExpandEnvVars(std::wstring(value), environment);
+        value = expanded;
+    }
+
+    auto it = result.lower_bound(key);
+    if (it == result.end() || it->first != key)
+        it = result.emplace_hint(it, key, std::wstring());
+
+    const ConfigKeyInfo* info = FindConfigKey(key);
+    if (!info) {
+        if (diagnostics)
+            diagnostics->push_back(L"line " + std::to_wstring(lineNumber) + L": unknown key '" + key + L"'");
+        it->second.assign(value);
+        return;
+    }
+    if (!NormalizeConfigValue(*info, value, it->second) && diagnostics) {
+        diagnostics->push_back(L"line " + std::to_wstring(lineNumber) + L": invalid value '" + std::wstring(value) +
+                               L"' for " + key + L", using '" + it->second + L"'");
+    }
+}
+
+void AppendCodePoint(std::wstring& out, uint32_t cp) {
+    if constexpr (sizeof(wchar_t) == 2) {
+        if (cp >= 0x10000) {
+            cp -= 0x10000;
+            out.push_back(static_cast<wchar_t>(0xD800 + (cp >> 10)));
+            out.push_back(static_cast<wchar_t>(0xDC00 + (cp & 0x3FF)));
+            return;
+        }
+    }
+    out.push_back(static_cast<wchar_t>(cp));
+}
+
+// Bytes that do not form valid UTF-8 are taken as Latin-1 so legacy ANSI
+// files keep their ASCII content readable.
+void DecodeUtf8(const unsigned char* p, size_t size, std::wstring& out) {
+    out.reserve(out.size() + size);
+    for (size_t i = 0; i < size;) {
+        unsigned char b = p[i];
+        if (b < 0x80) {
+            out.push_back(static_cast<wchar_t>(b));
+            ++i;
+            continue;
+        }
+        size_t len = b >= 0xF0 && b < 0xF5 ? 4 : b >= 0xE0 ? 3 : b >= 0xC2 && b < 0xE0 ? 2 : 0;
+        uint32_t cp = len == 4 ? b & 0x07u : len == 3 ? b & 0x0Fu : b & 0x1Fu;
+        bool valid = len != 0 && i + len <= size;
+        for (size_t k = 1; valid && k < len; ++k) {
+            if ((p[i + k] & 0xC0) != 0x80)
+                valid = false;
+            else
+                cp = (cp << 6) | (p[i + k] & 0x3Fu);
+        }
+        // Reject overlong forms, surrogates and values past U+10FFFF
+        if (valid && ((len == 3 && cp < 0x800) || (len == 4 && (cp < 0x10000 || cp > 0x10FFFF)) ||
+                      (cp >= 0xD800 && cp <= 0xDFFF)))
+            valid = false;
+        if (!valid) {
+            out.push_back(static_cast<wchar_t>(b));
+            ++i;
+            continue;
+        }
+        AppendCodePoint(out, cp);
+        i += len;
+    }
+}
+
+void DecodeUtf16(const unsigned char* p, size_t size, bool bigEndian, std::wstring& out) {
+    out.reserve(out.size() + size / 2);
+    auto unit = [&](size_t i) -> uint32_t {
+        return bigEndian ? (uint32_t(p[i]) << 8) | p[i + 1] : (uint32_t(p[i + 1]) << 8) | p[i];
+    };
+    for (size_t i = 0; i + 1 < size; i += 2) {
+        uint32_t u = unit(i);
+        if (u >= 0xD800 && u < 0xDC00 && i + 3 < size) {
+            uint32_t low = unit(i + 2);
+            if (low >= 0xDC00 && low < 0xE000) {
+                AppendCodePoint(out, 0x10000 + ((u - 0xD800) << 10) + (low - 0xDC00));
+                i += 2;
+                continue;
+            }
         }
-        unsigned long parsed = std::stoul(value);
-        return std::to_wstring(parsed);
-    } catch (...) {
-        return std::to_wstring(def);
+        // Unpaired surrogates are passed through unchanged
+        out.push_back(static_cast<wchar_t>(u));
     }
 }
+} // namespace
+
+std::wstring Utf8ToWide(std::string_view text) {
+    std::wstring out;
+    DecodeUtf8(reinterpret_cast<const unsigned char*>(text.data()), text.size(), out);
+    return out;
+}
 
-std::wstring ExpandEnvVars(const std::wstring& input) {
+std::string WideToUtf8(std::wstring_view text) {
+    std::string out;
+    out.reserve(text.size());
+    for (size_t i = 0; i < text.size(); ++i) {
+        uint32_t cp = static_cast<uint32_t>(text[i]);
+        if constexpr (sizeof(wchar_t) == 2) {
+            if (cp >= 0xD800 && cp < 0xDC00 && i + 1 < text.size()) {
+                uint32_t low = static_cast<uint32_t>(text[i + 1]);
+                if (low >= 0xDC00 && low < 0xE000) {
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                    ++i;
+                }
+            }
+        }
+        if ((cp >= 0xD800 && cp <= 0xDFFF) || cp > 0x10FFFF)
+            cp = 0xFFFD;
+        if (cp < 0x80) {
+            out.push_back(static_cast<char>(cp));
+        } else if (cp < 0x800) {
+            out.push_back(static_cast<char>(0xC0 | (cp >> 6)));
+            out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+        } else if (cp < 0x10000) {
+            out.push_back(static_cast<char>(0xE0 | (cp >> 12)));
+            out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+        } else {
+            out.push_back(static_cast<char>(0xF0 | (cp >> 18)));
+            out.push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+        }
+    }
+    return out;
+}
+
+namespace {
 #ifdef _WIN32
-    // Use the Windows API to expand %VAR% style references.
-    DWORD needed = ExpandEnvironmentStringsW(input.c_str(), nullptr, 0);
-    if (needed == 0)
-        return input;
-    std::wstring buffer(needed, L'\0');
-    DWORD written = ExpandEnvironmentStringsW(input.c_str(), buffer.data(), needed);
-    if (written == 0)
-        return input;
-    if (!buffer.empty() && buffer.back() == L'\0')
-        buffer.pop_back();
-    return buffer;
+std::wstring UpperCase(std::wstring_view name) {
+    std::wstring upper(name);
+    for (wchar_t& c : upper)
+        c = static_cast<wchar_t>(std::towupper(c));
+    return upper;
+}
+#endif
+
+// Variables referenced by one value; a name used several times is looked
+// up once. Values come from the snapshot when there is one (always on
+// Windows, which otherwise expands through the API).
+class VariableResolver {
+public:
+    explicit VariableResolver(const EnvironmentSnapshot* environment) : m_environment(environment) {}
+
+    const std::wstring* find(std::wstring_view name) {
+        if (m_environment)
+            return m_environment->find(name);
+        for (const Entry& entry : m_entries) {
+            if (entry.name == name)
+                return entry.found ? &entry.value : nullptr;
+        }
+        Entry entry{name, false, std::wstring()};
+#ifndef _WIN32
+        if (const char* value = std::getenv(WideToUtf8(name).c_str())) {
+            entry.found = true;
+            entry.value = Utf8ToWide(value);
+        }
+#endif
+        m_entries.push_back(std::move(entry));
+        return m_entries.back().found ? &m_entries.back().value : nullptr;
+    }
+
+private:
+    struct Entry {
+        std::wstring_view name;
+        bool found;
+        std::wstring value;
+    };
+
+    const EnvironmentSnapshot* m_environment;
+    std::vector<Entry> m_entries;
+};
+} // namespace
+
+EnvironmentSnapshot::EnvironmentSnapshot(Variables variables) {
+#ifdef _WIN32
+    for (auto& [name, value] : variables)
+        m_variables.insert_or_assign(UpperCase(name), std::move(value));
 #else
-    // Manual expansion supporting $VAR and ${VAR} as well as %VAR%.
+    m_variables = std::move(variables);
+#endif
+    std::wstring text;
+    for (const auto& [name, value] : m_variables) {
+        text.append(name).push_back(L'=');
+        text.append(value).push_back(L'\0');
+    }
+    m_hash = HashConfigBytes(text.data(), text.size() * sizeof(wchar_t));
+}
+
+std::shared_ptr<const EnvironmentSnapshot> EnvironmentSnapshot::Capture() {
+    Variables variables;
+#ifdef _WIN32
+    wchar_t* block = GetEnvironmentStringsW();
+    if (block) {
+        // Entries such as "=C:=C:\dir" track per-drive directories, not variables
+        for (const wchar_t* entry = block; *entry; entry += wcslen(entry) + 1) {
+            const wchar_t* eq = wcschr(entry + 1, L'=');
+            if (entry[0] != L'=' && eq)
+                variables.emplace(std::wstring(entry, eq), std::wstring(eq + 1));
+        }
+        FreeEnvironmentStringsW(block);
+    }
+#else
+    for (char** entry = environ; entry && *entry; ++entry) {
+        const char* eq = std::strchr(*entry, '=');
+        if (eq && eq != *entry)
+            variables.emplace(Utf8ToWide(std::string_view(*entry, eq - *entry)), Utf8ToWide(eq + 1));
+    }
+#endif
+    return std::make_shared<const EnvironmentSnapshot>(std::move(variables));
+}
+
+const std::wstring* EnvironmentSnapshot::find(std::wstring_view name) const {
+#ifdef _WIN32
+    auto it = m_variables.find(UpperCase(name));
+#else
+    auto it = m_variables.find(name);
+#endif
+    return it != m_variables.end() ? &it->second : nullptr;
+}
+
+std::wstring ExpandEnvVars(const std::wstring& input, const EnvironmentSnapshot* environment) {
+#ifdef _WIN32
+    // Without a snapshot the Windows API expands %VAR% references in one call
+    if (!environment) {
+        DWORD needed = ExpandEnvironmentStringsW(input.c_str(), nullptr, 0);
+        if (needed == 0)
+            return input;
+        std::wstring buffer(needed, L'\0');
+        DWORD written = ExpandEnvironmentStringsW(input.c_str(), buffer.data(), needed);
+        if (written == 0)
+            return input;
+        if (!buffer.empty() && buffer.back() == L'\0')
+            buffer.pop_back();
+        return buffer;
+    }
+#endif
+    VariableResolver resolver(environment);
     std::wstring result;
     result.reserve(input.size());
     for (size_t i = 0; i < input.size(); ++i) {
@@ -43,165 +321,208 @@ std::wstring ExpandEnvVars(const std::wstring& input) {
         if (c == L'%') {
             size_t end = input.find(L'%', i + 1);
             if (end != std::wstring::npos) {
-                std::wstring name = input.substr(i + 1, end - i - 1);
-                std::string narrow(name.begin(), name.end());
-                const char* val = std::getenv(narrow.c_str());
-                if (val) {
-                    std::string sval(val);
-                    result.append(sval.begin(), sval.end());
+                std::wstring_view name(input.data() + i + 1, end - i - 1);
+                if (const std::wstring* value = resolver.find(name)) {
+                    result.append(*value);
+                    i = end;
+                    continue;
                 }
+#ifdef _WIN32
+                // Like ExpandEnvironmentStrings: keep the text and let the
+                // closing '%' open the next reference
+                result.push_back(c);
+                result.append(name);
+                i = end - 1;
+#else
                 i = end;
+#endif
                 continue;
             }
-        } else if (c == L'$') {
+        }
+#ifndef _WIN32
+        else if (c == L'$') {
             size_t start = i + 1;
             size_t end = start;
             bool brace = false;
             if (start < input.size() && input[start] == L'{') {
                 brace = true;
                 start++;
-                end = start;
-                while (end < input.size() && input[end] != L'}')
-                    ++end;
-                if (end == input.size()) {
+                end = input.find(L'}', start);
+                if (end == std::wstring::npos) {
                     // Unmatched '{', treat literally
                     result.push_back(c);
                     continue;
                 }
             } else {
-                while (end < input.size() &&
-                       (std::iswalnum(input[end]) || input[end] == L'_'))
+                while (end < input.size() && (std::iswalnum(input[end]) || input[end] == L'_'))
                     ++end;
             }
 
             if (end > start) {
-                std::wstring name = input.substr(start, end - start);
-                std::string narrow(name.begin(), name.end());
-                const char* val = std::getenv(narrow.c_str());
-                if (val) {
-                    std::string sval(val);
-                    result.append(sval.begin(), sval.end());
-                }
+                if (const std::wstring* value = resolver.find(std::wstring_view(input.data() + start, end - start)))
+                    result.append(*value);
                 i = brace ? end : end - 1;
                 continue;
             }
         }
+#endif
         result.push_back(c);
     }
     return result;
+}
+
+void DecodeConfigBytes(const void* data, size_t size, std::wstring& text) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    text.clear();
+    if (size >= 3 && p[0] == 0xEF && p[1] == 0xBB && p[2] == 0xBF)
+        DecodeUtf8(p + 3, size - 3, text);
+    else if (size >= 2 && p[0] == 0xFF && p[1] == 0xFE)
+        DecodeUtf16(p + 2, size - 2, false, text);
+    else if (size >= 2 && p[0] == 0xFE && p[1] == 0xFF)
+        DecodeUtf16(p + 2, size - 2, true, text);
+    else
+        DecodeUtf8(p, size, text);
+}
+
+bool ReadConfigBytes(const std::wstring& path, std::string& bytes) {
+#ifdef _WIN32
+    std::ifstream file(path.c_str(), std::ios::binary);
+#else
+    std::ifstream file(std::filesystem::path(path), std::ios::binary);
 #endif
+    if (!file.is_open())
+        return false;
+    // One read of the whole file; fall back to streaming when the size is unknown
+    file.seekg(0, std::ios::end);
+    std::streamoff size = file.tellg();
+    file.seekg(0, std::ios::beg);
+    if (size < 0 || !file) {
+        file.clear();
+        bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        return !file.bad();
+    }
+    bytes.resize(static_cast<size_t>(size));
+    file.read(bytes.data(), size);
+    bytes.resize(static_cast<size_t>(file.gcount()));
+    return !file.bad();
 }
-} // namespace
 
-std::wstring ParseBoolOrDefault(const std::wstring& value, bool def) {
-    std::wstring lower = value;
-    std::transform(lower.begin(), lower.end(), lower.begin(), [](wchar_t c) {
-        return std::towlower(c);
-    });
-    if (lower == L"1" || lower == L"true" || lower == L"yes" || lower == L"on")
-        return L"1";
-    if (lower == L"0" || lower == L"false" || lower == L"no" || lower == L"off")
-        return L"0";
-    return def ? L"1" : L"0";
-}
-
-std::map<std::wstring, std::wstring> ParseConfigLines(const std::vector<std::wstring>& lines) {
-    std::map<std::wstring, std::wstring> result;
-    for (const std::wstring& line : lines) {
-        std::wstring currentLine = line;
-        size_t start = currentLine.find_first_not_of(L" \t\r\n");
-        if (start == std::wstring::npos)
-            continue;
-        size_t end = currentLine.find_last_not_of(L" \t\r\n");
-        currentLine = currentLine.substr(start, end - start + 1);
-        if (currentLine.empty())
-            continue;
+bool ReadConfigFile(const std::wstring& path, std::wstring& text) {
+    std::string bytes;
+    if (!ReadConfigBytes(path, bytes))
+        return false;
+    DecodeConfigBytes(bytes.data(), bytes.size(), text);
+    return true;
+}
 
-        if (currentLine[0] == L'#' || currentLine[0] == L';')
-            continue;
+namespace {
+constexpr uint64_t kPrime64_1 = 0x9E3779B185EBCA87ull;
+constexpr uint64_t kPrime64_2 = 0xC2B2AE3D27D4EB4Full;
+constexpr uint64_t kPrime64_3 = 0x165667B19E3779F9ull;
+constexpr uint64_t kPrime64_4 = 0x85EBCA77C2B2AE63ull;
+constexpr uint64_t kPrime64_5 = 0x27D4EB2F165667C5ull;
 
-        size_t eqPos = currentLine.find(L'=');
-        if (eqPos == std::wstring::npos)
-            continue;
+uint64_t RotateLeft(uint64_t value, int bits) { return (value << bits) | (value >> (64 - bits)); }
 
-        std::wstring key = currentLine.substr(0, eqPos);
-        std::wstring value = currentLine.substr(eqPos + 1);
-
-        // Strip inline comments while respecting quoted sections
-        bool inQuotes = false;
-        wchar_t quoteChar = 0;
-        size_t commentPos = std::wstring::npos;
-        for (size_t i = 0; i < value.size(); ++i) {
-            wchar_t c = value[i];
-            if (inQuotes) {
-                if (c == quoteChar)
-                    inQuotes = false;
-            } else {
-                if (c == L'"' || c == L'\'') {
-                    inQuotes = true;
-                    quoteChar = c;
-                } else if (c == L'#' || c == L';') {
-                    commentPos = i;
-                    break;
-                }
-            }
-        }
-        if (commentPos != std::wstring::npos)
-            value = value.substr(0, commentPos);
-
-        auto trim = [](std::wstring& s) {
-            size_t start = s.find_first_not_of(L" \t\r\n");
-            size_t end = s.find_last_not_of(L" \t\r\n");
-            if (start == std::wstring::npos) {
-                s.clear();
-            } else {
-                s = s.substr(start, end - start + 1);
-            }
-        };
+// Little-endian loads regardless of alignment
+uint64_t Load64(const unsigned char* p) {
+    uint64_t value = 0;
+    for (int i = 7; i >= 0; --i)
+        value = (value << 8) | p[i];
+    return value;
+}
 
-        trim(key);
-        trim(value);
+uint32_t Load32(const unsigned char* p) {
+    return static_cast<uint32_t>(p[0]) | static_cast<uint32_t>(p[1]) << 8 | static_cast<uint32_t>(p[2]) << 16 |
+           static_cast<uint32_t>(p[3]) << 24;
+}
 
-        // Remove surrounding quotes if present
-        if (value.size() >= 2 &&
-            ((value.front() == L'"' && value.back() == L'"') ||
-             (value.front() == L'\'' && value.back() == L'\''))) {
-            value = value.substr(1, value.size() - 2);
-        }
+uint64_t HashRound(uint64_t acc, uint64_t input) {
+    acc += input * kPrime64_2;
+    return RotateLeft(acc, 31) * kPrime64_1;
+}
 
-        // Expand environment variables such as %VAR% or $VAR
-        value = ExpandEnvVars(value);
-
-        std::transform(key.begin(), key.end(), key.begin(), [](wchar_t c) {
-            return std::towlower(c);
-        });
-
-        if (key == L"temp_hotkey_timeout") {
-            result[key] = ParseUnsignedOrDefault(value, 10000);
-        } else if (key == L"max_log_size_mb") {
-            result[key] = ParseUnsignedOrDefault(value, 10);
-        } else if (key == L"max_log_backups") {
-            result[key] = ParseUnsignedOrDefault(value, 5);
-        } else if (key == L"max_queue_size") {
-            result[key] = ParseUnsignedOrDefault(value, 1000);
-        } else if (key == L"startup" || key == L"language_hotkey" || key == L"layout_hotkey") {
-            result[key] = ParseBoolOrDefault(value, false);
-        } else if (key == L"icon_path" || key == L"tray_tooltip") {
-            // String values used by the tray icon subsystem
-            result[key] = value;
-        } else {
-            result[key] = value;
+uint64_t HashMerge(uint64_t acc, uint64_t value) {
+    acc ^= HashRound(0, value);
+    return acc * kPrime64_1 + kPrime64_4;
+}
+} // namespace
+
+uint64_t HashConfigBytes(const void* data, size_t size) {
+    const auto* p = static_cast<const unsigned char*>(data);
+    const unsigned char* end = p + size;
+    uint64_t hash;
+    if (size >= 32) {
+        uint64_t v1 = kPrime64_1 + kPrime64_2;
+        uint64_t v2 = kPrime64_2;
+        uint64_t v3 = 0;
+        uint64_t v4 = 0 - kPrime64_1;
+        for (; end - p >= 32; p += 32) {
+            v1 = HashRound(v1, Load64(p));
+            v2 = HashRound(v2, Load64(p + 8));
+            v3 = HashRound(v3, Load64(p + 16));
+            v4 = HashRound(v4, Load64(p + 24));
         }
+        hash = RotateLeft(v1, 1) + RotateLeft(v2, 7) + RotateLeft(v3, 12) + RotateLeft(v4, 18);
+        hash = HashMerge(hash, v1);
+        hash = HashMerge(hash, v2);
+        hash = HashMerge(hash, v3);
+        hash = HashMerge(hash, v4);
+    } else {
+        hash = kPrime64_5;
     }
-    return result;
+    hash += static_cast<uint64_t>(size);
+
+    for (; end - p >= 8; p += 8) {
+        hash ^= HashRound(0, Load64(p));
+        hash = RotateLeft(hash, 27) * kPrime64_1 + kPrime64_4;
+    }
+    if (end - p >= 4) {
+        hash ^= static_cast<uint64_t>(Load32(p)) * kPrime64_1;
+        hash = RotateLeft(hash, 23) * kPrime64_2 + kPrime64_3;
+        p += 4;
+    }
+    for (; p < end; ++p) {
+        hash ^= *p * kPrime64_5;
+        hash = RotateLeft(hash, 11) * kPrime64_1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= kPrime64_2;
+    hash ^= hash >> 29;
+    hash *= kPrime64_3;
+    hash ^= hash >> 32;
+    return hash;
 }
 
-std::map<std::wstring, std::wstring> ParseConfigStream(std::wistream& stream) {
-    std::vector<std::wstring> lines;
-    std::wstring line;
-    while (std::getline(stream, line)) {
-        lines.push_back(line);
+ConfigMap ParseConfigText(std::wstring_view text, std::vector<std::wstring>* diagnostics,
+                          const EnvironmentSnapshot* environment) {
+    ConfigMap result;
+    std::wstring key;
+    size_t lineNumber = 0;
+    while (!text.empty()) {
+        size_t end = text.find(L'\n');
+        std::wstring_view line = text.substr(0, end);
+        ParseLine(line, ++lineNumber, result, key, diagnostics, environment);
+        if (end == std::wstring_view::npos)
+            break;
+        text.remove_prefix(end + 1);
     }
-    return ParseConfigLines(lines);
+    return result;
 }
 
+ConfigMap ParseConfigLines(const std::vector<std::wstring>& lines, std::vector<std::wstring>* diagnostics,
+                           const EnvironmentSnapshot* environment) {
+    ConfigMap result;
+    std::wstring key;
+    size_t lineNumber = 0;
+    for (const std::wstring& line : lines)
+        ParseLine(line, ++lineNumber, result, key, diagnostics, environment);
+    return result;
+}
+
+ConfigMap ParseConfigStream(std::wistream& stream, std::vector<std::wstring>* diagnostics,
+                            const EnvironmentSnapshot* environment) {
+    std::wstring text((std::istreambuf_iterator<wchar_t>(stream)), std::istreambuf_iterator<wchar_t>());
+    return ParseConfigText(text, diagnostics, environment);
+}
@@ -1,7 +1,12 @@
 #pragma once
 
+#include "config_map.h"
+#include <cstddef>
+#include <cstdint>
 #include <map>
+#include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <istream>
 
@@ -9,6 +14,60 @@
 // Accepts common representations such as "1", "true", "yes" and "on".
 std::wstring ParseBoolOrDefault(const std::wstring& value, bool def);
 
-std::map<std::wstring, std::wstring> ParseConfigLines(const std::vector<std::wstring>& lines);
-std::map<std::wstring, std::wstring> ParseConfigStream(std::wistream& stream);
+// Convert between UTF-8 and wide strings. Bytes that are not valid UTF-8
+// are taken as Latin-1; unpaired surrogates are encoded as U+FFFD.
+std::wstring Utf8ToWide(std::string_view text);
+std::string WideToUtf8(std::wstring_view text);
+
+// Copy of the process environment taken once, so expansions during later
+// reloads are deterministic and need no libc or Win32 lookups. Names are
+// matched case-insensitively on Windows, exactly elsewhere.
+class EnvironmentSnapshot {
+public:
+    using Variables = std::map<std::wstring, std::wstring, std::less<>>;
+
+    // Snapshot of the current process environment.
+    static std::shared_ptr<const EnvironmentSnapshot> Capture();
+
+    explicit EnvironmentSnapshot(Variables variables);
+
+    // Value of @p name, or nullptr when it is not set.
+    const std::wstring* find(std::wstring_view name) const;
+
+    // Hash of every name and value; equal snapshots expand alike.
+    uint64_t hash() const noexcept { return m_hash; }
+
+private:
+    Variables m_variables; // Names upper-cased on Windows
+    uint64_t m_hash = 0;
+};
+
+// Expand %VAR% references (and $VAR / ${VAR} on POSIX) in a configuration
+// value. Variables come from @p environment when given, otherwise from the
+// live process environment, each distinct name looked up once per call.
+std::wstring ExpandEnvVars(const std::wstring& input, const EnvironmentSnapshot* environment = nullptr);
+
+// Decode a configuration file's bytes. A UTF-8 or UTF-16 (LE/BE) byte order
+// mark selects the encoding; files without one are read as UTF-8.
+void DecodeConfigBytes(const void* data, size_t size, std::wstring& text);
+
+// Read a whole configuration file without decoding it; false when it cannot be read.
+bool ReadConfigBytes(const std::wstring& path, std::string& bytes);
+
+// Read and decode a whole configuration file; false when it cannot be read.
+bool ReadConfigFile(const std::wstring& path, std::wstring& text);
+
+// XXH64 of a configuration file's bytes, used to detect unchanged reloads.
+uint64_t HashConfigBytes(const void* data, size_t size);
+
+// Parse key=value lines. Known keys (see config_schema.h) are validated and
+// normalized; invalid values are replaced by the key's default. Unknown keys
+// and rejected values are described in @p diagnostics when provided.
+// Variable references are expanded from @p environment, see ExpandEnvVars().
+ConfigMap ParseConfigText(std::wstring_view text, std::vector<std::wstring>* diagnostics = nullptr,
+                          const EnvironmentSnapshot* environment = nullptr);
+ConfigMap ParseConfigLines(const std::vector<std::wstring>& lines, std::vector<std::wstring>* diagnostics = nullptr,
+                           const EnvironmentSnapshot* environment = nullptr);
+ConfigMap ParseConfigStream(std::wistream& stream, std::vector<std::wstring>* diagnostics = nullptr,
+                            const EnvironmentSnapshot* environment = nullptr);
 
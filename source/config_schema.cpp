@@ -0,0 +1,117 @@
+#include "config_schema.h"
+
+#include <cwctype>
+
+namespace {
+bool EqualsIgnoreCase(std::wstring_view a, std::wstring_view b) {
+    if (a.size() != b.size())
+        return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (std::towlower(a[i]) != std::towlower(b[i]))
+            return false;
+    }
+    return true;
+}
+
+std::optional<uint32_t> ParseConfigUInt(std::wstring_view value) {
+    if (value.empty() || value.size() > 10)
+        return std::nullopt;
+    uint64_t result = 0;
+    for (wchar_t c : value) {
+        if (c < L'0' || c > L'9')
+            return std::nullopt;
+        result = result * 10 + static_cast<uint64_t>(c - L'0');
+    }
+    if (result > UINT32_MAX)
+        return std::nullopt;
+    return static_cast<uint32_t>(result);
+}
+
+uint32_t ToUInt(const std::wstring& normalized) {
+    return ParseConfigUInt(normalized).value_or(0);
+}
+} // namespace
+
+std::optional<bool> ParseConfigBool(std::wstring_view value) {
+    for (std::wstring_view word : {L"1", L"true", L"yes", L"on"}) {
+        if (EqualsIgnoreCase(value, word))
+            return true;
+    }
+    for (std::wstring_view word : {L"0", L"false", L"no", L"off"}) {
+        if (EqualsIgnoreCase(value, word))
+            return false;
+    }
+    return std::nullopt;
+}
+
+bool NormalizeConfigValue(const ConfigKeyInfo& info, std::wstring_view raw, std::wstring& normalized) {
+    switch (info.type) {
+    case ConfigType::Bool:
+        if (auto value = ParseConfigBool(raw)) {
+            normalized = *value ? L"1" : L"0";
+            return true;
+        }
+        break;
+    case ConfigType::UInt:
+        if (auto value = ParseConfigUInt(raw)) {
+            if (*value >= info.minValue && *value <= info.maxValue) {
+                normalized = std::to_wstring(*value);
+                return true;
+            }
+        }
+        break;
+    case ConfigType::Enum:
+        for (size_t i = 0; i < info.choiceCount; ++i) {
+            if (EqualsIgnoreCase(raw, info.choices[i])) {
+                normalized = info.choices[i];
+                return true;
+            }
+        }
+        break;
+    case ConfigType::Path:
+    case ConfigType::String:
+        normalized = raw;
+        return true;
+    }
+    normalized = info.defaultValue;
+    return false;
+}
+
+ConfigSettings BuildConfigSettings(const ConfigMap& values) {
+    ConfigSettings settings;
+    std::wstring value;
+    for (const ConfigKeyInfo& info : kConfigKeys) {
+        auto it = values.find(info.name);
+        if (it != values.end()) {
+            settings.present |= 1u << static_cast<unsigned>(info.key);
+            NormalizeConfigValue(info, it->second, value);
+        } else {
+            value = info.defaultValue;
+        }
+
+        switch (info.key) {
+        case ConfigKey::Debug: settings.debug = value == L"1"; break;
+        case ConfigKey::TrayIcon: settings.trayIcon = value == L"1"; break;
+        case ConfigKey::Startup: settings.startup = value == L"1"; break;
+        case ConfigKey::LanguageHotkey: settings.languageHotkey = value == L"1"; break;
+        case ConfigKey::LayoutHotkey: settings.layoutHotkey = value == L"1"; break;
+        case ConfigKey::TempHotkeyTimeout: settings.tempHotkeyTimeout = ToUInt(value); break;
+        case ConfigKey::LogPath: settings.logPath = value; break;
+        case ConfigKey::LogLevel:
+            settings.logLevel = value == L"warn"    ? LogLevel::Warn
+                                : value == L"error" ? LogLevel::Error
+                                                    : LogLevel::Info;
+            break;
+        case ConfigKey::MaxLogSizeMb: settings.maxLogSizeMb = ToUInt(value); break;
+        case ConfigKey::MaxLogBackups: settings.maxLogBackups = ToUInt(value); break;
+        case ConfigKey::MaxQueueSize: settings.maxQueueSize = ToUInt(value); break;
+        case ConfigKey::IconPath: settings.iconPath = value; break;
+        case ConfigKey::TrayTooltip: settings.trayTooltip = value; break;
+        case ConfigKey::HookMode: settings.hookMode = value == L"light" ? HookMode::Light : HookMode::Full; break;
+        case ConfigKey::LayoutTrace: settings.layoutTrace = value; break;
+        case ConfigKey::ReloadDebounceMs: settings.reloadDebounceMs = ToUInt(value); break;
+        case ConfigKey::Count: break;
+        }
+    }
+    return settings;
+}
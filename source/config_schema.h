@@ -0,0 +1,229 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <optional>
+#include <string>
+#include <string_view>
+#include "config_map.h"
+#include "log_level.h"
+
+/**
+ * @brief Known configuration keys, in registry order.
+ *
+ * The value doubles as the index into kConfigKeys and the bit in
+ * ConfigSettings::present.
+ */
+enum class ConfigKey : uint8_t {
+    Debug,
+    TrayIcon,
+    Startup,
+    LanguageHotkey,
+    LayoutHotkey,
+    TempHotkeyTimeout,
+    LogPath,
+    LogLevel,
+    MaxLogSizeMb,
+    MaxLogBackups,
+    MaxQueueSize,
+    IconPath,
+    TrayTooltip,
+    HookMode,
+    LayoutTrace,
+    ReloadDebounceMs,
+    Count
+};
+
+/// How a value is validated and normalized.
+enum class ConfigType : uint8_t {
+    Bool,   ///< 1/true/yes/on or 0/false/no/off, stored as "1" or "0"
+    UInt,   ///< Decimal integer within [minValue, maxValue]
+    Enum,   ///< One of @c choices, case-insensitive, stored in lower case
+    Path,   ///< File path, environment variables already expanded
+    String  ///< Free text
+};
+
+/// When a changed value takes effect.
+enum class ConfigReload : uint8_t {
+    Live,   ///< Applied by the next reload
+    Restart ///< Read once at startup
+};
+
+/// Registry entry describing one known key.
+struct ConfigKeyInfo {
+    ConfigKey key;
+    std::wstring_view name;          ///< Lower-case key as written in the file
+    ConfigType type;
+    std::wstring_view defaultValue;  ///< Normalized default
+    uint32_t minValue = 0;           ///< UInt only
+    uint32_t maxValue = UINT32_MAX;  ///< UInt only
+    const std::wstring_view* choices = nullptr; ///< Enum only; first is the default
+    size_t choiceCount = 0;
+    ConfigReload reload = ConfigReload::Live;
+};
+
+/// Hook behaviour selected by the @c hook_mode key.
+enum class HookMode : uint8_t {
+    Full, ///< Hooked processes resolve and persist layouts themselves
+    Light ///< Hooked processes only queue events for the executable
+};
+
+inline constexpr std::wstring_view kLogLevelChoices[] = {L"info", L"warn", L"error"};
+inline constexpr std::wstring_view kHookModeChoices[] = {L"full", L"light"};
+
+/// Every known key; indexed by ConfigKey.
+inline constexpr ConfigKeyInfo kConfigKeys[] = {
+    {ConfigKey::Debug, L"debug", ConfigType::Bool, L"0"},
+    {ConfigKey::TrayIcon, L"tray_icon", ConfigType::Bool, L"1"},
+    {ConfigKey::Startup, L"startup", ConfigType::Bool, L"0"},
+    {ConfigKey::LanguageHotkey, L"language_hotkey", ConfigType::Bool, L"0"},
+    {ConfigKey::LayoutHotkey, L"layout_hotkey", ConfigType::Bool, L"0"},
+    {ConfigKey::TempHotkeyTimeout, L"temp_hotkey_timeout", ConfigType::UInt, L"10000", 0, 86400000},
+    {ConfigKey::LogPath, L"log_path", ConfigType::Path, L""},
+    {ConfigKey::LogLevel, L"log_level", ConfigType::Enum, L"info", 0, 0, kLogLevelChoices, 3},
+    {ConfigKey::MaxLogSizeMb, L"max_log_size_mb", ConfigType::UInt, L"10", 0, 65536},
+    {ConfigKey::MaxLogBackups, L"max_log_backups", ConfigType::UInt, L"5", 0, 1000},
+    {ConfigKey::MaxQueueSize, L"max_queue_size", ConfigType::UInt, L"1000", 0, 10000000, nullptr, 0,
+     ConfigReload::Restart},
+    {ConfigKey::IconPath, L"icon_path", ConfigType::Path, L""},
+    {ConfigKey::TrayTooltip, L"tray_tooltip", ConfigType::String, L""},
+    {ConfigKey::HookMode, L"hook_mode", ConfigType::Enum, L"full", 0, 0, kHookModeChoices, 2},
+    {ConfigKey::LayoutTrace, L"layout_trace", ConfigType::Path, L""},
+    {ConfigKey::ReloadDebounceMs, L"reload_debounce_ms", ConfigType::UInt, L"100", 0, 10000},
+};
+
+constexpr bool ConfigKeysInOrder() {
+    for (size_t i = 0; i < std::size(kConfigKeys); ++i) {
+        if (static_cast<size_t>(kConfigKeys[i].key) != i)
+            return false;
+    }
+    return true;
+}
+static_assert(std::size(kConfigKeys) == static_cast<size_t>(ConfigKey::Count),
+              "every ConfigKey needs a registry entry");
+static_assert(ConfigKeysInOrder(), "kConfigKeys must be ordered by ConfigKey");
+
+/// Registry entry for @p key.
+constexpr const ConfigKeyInfo& GetConfigKeyInfo(ConfigKey key) {
+    return kConfigKeys[static_cast<size_t>(key)];
+}
+
+inline constexpr size_t kConfigKeyCount = static_cast<size_t>(ConfigKey::Count);
+
+/**
+ * @brief Seeded FNV-1a over the UTF-16/32 code units of @p name.
+ *
+ * Also used by ConfigSnapshot to place keys outside the registry.
+ */
+constexpr uint32_t HashConfigKey(std::wstring_view name, uint32_t seed = 0) {
+    uint32_t hash = 2166136261u ^ (seed * 0x9E3779B9u);
+    for (wchar_t c : name) {
+        hash ^= static_cast<uint32_t>(c);
+        hash *= 16777619u;
+    }
+    // FNV leaves the low bits weakly mixed; fold the high half in
+    return hash ^ (hash >> 15);
+}
+
+/// Slots in the perfect hash table; a power of two well above the key count.
+inline constexpr size_t kConfigKeySlots = 64;
+static_assert(kConfigKeySlots >= 2 * kConfigKeyCount, "grow kConfigKeySlots with the registry");
+
+/// True when @p seed sends every registry name to its own slot.
+constexpr bool IsPerfectConfigKeySeed(uint32_t seed) {
+    bool used[kConfigKeySlots] = {};
+    for (const ConfigKeyInfo& info : kConfigKeys) {
+        size_t slot = HashConfigKey(info.name, seed) & (kConfigKeySlots - 1);
+        if (used[slot])
+            return false;
+        used[slot] = true;
+    }
+    return true;
+}
+
+/// First seed without collisions, found at compile time; 0 if none is.
+constexpr uint32_t FindConfigKeySeed() {
+    for (uint32_t seed = 1; seed < 4096; ++seed) {
+        if (IsPerfectConfigKeySeed(seed))
+            return seed;
+    }
+    return 0;
+}
+
+inline constexpr uint32_t kConfigKeySeed = FindConfigKeySeed();
+static_assert(kConfigKeySeed != 0, "no collision-free seed for the key registry");
+
+/// Slot to ConfigKey index; @c ConfigKey::Count marks an empty slot.
+struct ConfigKeyTable {
+    uint8_t slots[kConfigKeySlots];
+};
+
+constexpr ConfigKeyTable BuildConfigKeyTable() {
+    ConfigKeyTable table{};
+    for (uint8_t& slot : table.slots)
+        slot = static_cast<uint8_t>(ConfigKey::Count);
+    for (const ConfigKeyInfo& info : kConfigKeys)
+        table.slots[HashConfigKey(info.name, kConfigKeySeed) & (kConfigKeySlots - 1)] = static_cast<uint8_t>(info.key);
+    return table;
+}
+
+inline constexpr ConfigKeyTable kConfigKeyTable = BuildConfigKeyTable();
+
+/**
+ * @brief Registry entry named @p name (lower case), or @c nullptr for unknown keys.
+ *
+ * One hash, one table load and one comparison; with a literal argument the
+ * whole lookup folds to a constant.
+ */
+constexpr const ConfigKeyInfo* FindConfigKey(std::wstring_view name) {
+    uint8_t index = kConfigKeyTable.slots[HashConfigKey(name, kConfigKeySeed) & (kConfigKeySlots - 1)];
+    if (index == static_cast<uint8_t>(ConfigKey::Count) || kConfigKeys[index].name != name)
+        return nullptr;
+    return &kConfigKeys[index];
+}
+
+/// Parse a textual boolean ("1", "true", "yes", "on" and their opposites).
+std::optional<bool> ParseConfigBool(std::wstring_view value);
+
+/**
+ * @brief Validate @p raw for @p info and store the normalized form.
+ * @param[out] normalized Canonical value, or the key's default when
+ *             @p raw is invalid.
+ * @return @c false when @p raw was rejected.
+ */
+bool NormalizeConfigValue(const ConfigKeyInfo& info, std::wstring_view raw, std::wstring& normalized);
+
+/**
+ * @brief Known settings parsed into native types.
+ *
+ * Built once per published snapshot; every field holds the registry default
+ * unless the key was present with a valid value.
+ */
+struct ConfigSettings {
+    bool debug = false;
+    bool trayIcon = true;
+    bool startup = false;
+    bool languageHotkey = false;
+    bool layoutHotkey = false;
+    uint32_t tempHotkeyTimeout = 10000;
+    std::wstring logPath;
+    LogLevel logLevel = LogLevel::Info;
+    uint32_t maxLogSizeMb = 10;
+    uint32_t maxLogBackups = 5;
+    uint32_t maxQueueSize = 1000;
+    std::wstring iconPath;
+    std::wstring trayTooltip;
+    HookMode hookMode = HookMode::Full;
+    std::wstring layoutTrace;
+    uint32_t reloadDebounceMs = 100;
+
+    /// Bit per ConfigKey that was present in the source settings.
+    uint32_t present = 0;
+
+    /// True when @p key was set explicitly (valid or not).
+    bool has(ConfigKey key) const noexcept { return (present >> static_cast<unsigned>(key)) & 1u; }
+};
+
+/// Interpret the known keys of @p values; invalid values fall back to defaults.
+ConfigSettings BuildConfigSettings(const ConfigMap& values);
@@ -1,152 +1,85 @@
-#ifdef _WIN32
 #include "config_watcher.h"
 
+#include <chrono>
+#include <filesystem>
 #include <string>
-#include <shlwapi.h>
 #include <system_error>
-#include <chrono>
-#include <thread>
+#include <vector>
+#ifdef _WIN32
+#include <shlwapi.h>
+#endif
 
 #include "configuration.h"
+#include "file_watch_service.h"
 #include "log.h"
 
-#ifdef UNIT_TEST
+#if defined(_WIN32) && defined(UNIT_TEST)
 // Use the test-controlled Win32 stubs when running unit tests
 #include "../tests/windows_stub.h"
 #endif
 
+#include "constants.h"
+
+#ifdef _WIN32
 // g_hInst is defined in kbdlayoutmon.cpp
 extern HINSTANCE g_hInst;
-// ApplyConfig is implemented in kbdlayoutmon.cpp
-void ApplyConfig(HWND hwnd);
-
-
-ConfigWatcher::ConfigWatcher(HWND hwnd) : m_hwnd(hwnd) {
-    m_stopEvent.reset(CreateEventW(NULL, TRUE, FALSE, NULL));
-    try {
-        m_thread = std::thread(&ConfigWatcher::threadProc, this);
-    } catch (const std::system_error&) {
-        WriteLog(LogLevel::Error, L"Failed to create watcher thread.");
-        throw;
-    }
-}
+#endif
 
-ConfigWatcher::~ConfigWatcher() {
-    if (m_stopEvent) {
-        SetEvent(m_stopEvent.get());
-    }
-    if (m_thread.joinable()) {
-        m_thread.join();
-    }
-    m_stopEvent.reset();
-}
+// Optional hook for tests to observe configuration reloads.
+void (*g_testApplyConfig)(HWND) = nullptr;
 
-void ConfigWatcher::threadProc(ConfigWatcher* self) {
-    wchar_t dirPath[MAX_PATH];
+// The user file that was loaded, or where it is created next to the program
+static std::wstring UserConfigPath() {
     std::wstring cfgPath = g_config.getLastPath();
-    if (cfgPath.empty()) {
-        GetModuleFileNameW(g_hInst, dirPath, MAX_PATH);
-    } else {
-        wcsncpy(dirPath, cfgPath.c_str(), MAX_PATH);
-        dirPath[MAX_PATH - 1] = L'\0';
-    }
-    PathRemoveFileSpecW(dirPath);
-
-    const DWORD kMaxBackoff = 1000;
-    DWORD backoff = 50;
-    // Continuously attempt to monitor the directory until the stop event is signalled.
-    for (;;) {
-        HandleGuard hDir(CreateFileW(
-            dirPath, FILE_LIST_DIRECTORY,
-            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
-            NULL, OPEN_EXISTING,
-            FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, NULL));
-
-        if (!hDir) {
-            WriteLog(LogLevel::Error, L"CreateFileW failed for configuration directory.");
-            if (WaitForSingleObject(self->m_stopEvent.get(), 0) == WAIT_OBJECT_0)
-                break;
-            std::wstring delayMsg = L"Retrying directory watch in " + std::to_wstring(backoff) + L" ms.";
-            WriteLog(LogLevel::Warn, delayMsg);
-#ifdef UNIT_TEST
-            Sleep(backoff);
+    if (!cfgPath.empty())
+        return cfgPath;
+#ifdef _WIN32
+    wchar_t modulePath[MAX_PATH];
+    GetModuleFileNameW(g_hInst, modulePath, MAX_PATH);
+    PathRemoveFileSpecW(modulePath);
+    PathCombineW(modulePath, modulePath, configFile);
+    return modulePath;
 #else
-            std::this_thread::sleep_for(std::chrono::milliseconds(backoff));
+    return configFile;
 #endif
-            if (backoff < kMaxBackoff) {
-                backoff *= 2;
-                if (backoff > kMaxBackoff)
-                    backoff = kMaxBackoff;
-            }
-            continue;
-        }
-
-        backoff = 50;
-
-        BYTE buffer[1024];
-        OVERLAPPED ov{};
-        HandleGuard hEvent(CreateEventW(NULL, FALSE, FALSE, NULL));
-        if (!hEvent) {
-            WriteLog(LogLevel::Error, L"Failed to create directory watch event.");
-            break;
-        }
-        ov.hEvent = hEvent.get();
-
-        HANDLE handles[2] = { hEvent.get(), self->m_stopEvent.get() };
-        bool restart = false;
-        while (!restart) {
-            DWORD bytesReturned = 0;
-            BOOL ok = ReadDirectoryChangesW(
-                hDir.get(), buffer, sizeof(buffer), FALSE,
-                FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE,
-                &bytesReturned, &ov, NULL);
-
-            if (!ok) {
-                WriteLog(LogLevel::Error, L"ReadDirectoryChangesW failed.");
-                restart = true;
-                break;
-            }
-
-            DWORD wait = WaitForMultipleObjects(2, handles, FALSE, INFINITE);
-            if (wait == WAIT_OBJECT_0 + 1) {
-                CancelIoEx(hDir.get(), &ov);
-                WaitForSingleObject(hEvent.get(), INFINITE);
-                return;
-            }
-            if (wait != WAIT_OBJECT_0) {
-                WriteLog(LogLevel::Error, L"WaitForMultipleObjects failed.");
-                restart = true;
-                break;
-            }
-
-            bytesReturned = 0;
-            if (!GetOverlappedResult(hDir.get(), &ov, &bytesReturned, FALSE)) {
-                WriteLog(LogLevel::Error, L"GetOverlappedResult failed.");
-                restart = true;
-                break;
-            }
-
-            bool renamed = false;
-            BYTE* ptr = buffer;
-            while (bytesReturned > 0) {
-                auto* info = reinterpret_cast<FILE_NOTIFY_INFORMATION*>(ptr);
-                if (info->Action == FILE_ACTION_RENAMED_OLD_NAME ||
-                    info->Action == FILE_ACTION_RENAMED_NEW_NAME) {
-                    renamed = true;
-                }
-                if (info->NextEntryOffset == 0)
-                    break;
-                bytesReturned -= info->NextEntryOffset;
-                ptr += info->NextEntryOffset;
-            }
+}
 
-            g_config.load();
-            ApplyConfig(self->m_hwnd);
+ConfigWatcher::ConfigWatcher(HWND hwnd) : m_hwnd(hwnd) {
+    FileWatchService& service = GetFileWatchService();
+    // Editors save in several steps; the service waits for the burst to settle
+    auto debounce = std::chrono::milliseconds(g_config.snapshot()->settings().reloadDebounceMs);
+    // Each file reloads only its own layer
+    auto watchLayer = [&](ConfigLayer layer, const std::wstring& path) {
+        uint64_t id = service.watch(path, [hwnd, layer](const std::wstring&) {
+            // Subscribers react to whatever the reload changed. After an
+            // overflow this is a resync: unchanged content is not applied again.
+            g_config.loadLayer(layer);
+            if (g_testApplyConfig)
+                g_testApplyConfig(hwnd);
             WriteLog(LogLevel::Info, L"Configuration reloaded.");
+        }, debounce);
+        if (id)
+            m_watches.push_back(id);
+        else
+            WriteLog(LogLevel::Error, L"Failed to watch configuration file: " + path);
+    };
+    // The machine-wide file is optional, and a normal install has not even
+    // its directory; one created later is read by the next start's resync
+    std::wstring machinePath = g_config.getLayerPath(ConfigLayer::Machine);
+    std::error_code ec;
+    if (!machinePath.empty() && std::filesystem::is_directory(std::filesystem::path(machinePath).parent_path(), ec))
+        watchLayer(ConfigLayer::Machine, machinePath);
+    watchLayer(ConfigLayer::User, UserConfigPath());
+
+    m_subscription = g_config.subscribe(L"reload_debounce_ms", [watches = m_watches](const ConfigDiff& diff) {
+        auto ms = std::chrono::milliseconds(diff.after()->settings().reloadDebounceMs);
+        for (uint64_t id : watches)
+            GetFileWatchService().setDebounce(id, ms);
+    });
+}
 
-            if (renamed)
-                restart = true;
-        }
-    }
+ConfigWatcher::~ConfigWatcher() {
+    g_config.unsubscribe(m_subscription);
+    for (uint64_t id : m_watches)
+        GetFileWatchService().unwatch(id);
 }
-#endif
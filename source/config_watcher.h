@@ -1,33 +1,35 @@
 #pragma once
 
+#include <cstdint>
+#include <vector>
+
 #ifdef _WIN32
 #include <windows.h>
-#include <thread>
-#include "handle_guard.h"
+#else
+// Dummy HWND type for non-Windows builds
+using HWND = void*;
+#endif
 
 /**
  * @brief RAII helper that watches the configuration file for changes.
  *
- * The watcher starts monitoring in the constructor and terminates the
- * background thread when destroyed.
+ * The user file, and the machine-wide file when its directory exists, are
+ * watched through the shared FileWatchService from construction until
+ * destruction; each change reloads only that file's layer.
+ * reload_debounce_ms is applied to the watches whenever it changes.
  */
 class ConfigWatcher {
 public:
     /// Begin watching for configuration changes affecting @p hwnd.
     explicit ConfigWatcher(HWND hwnd);
-    /// Stop the watcher thread and clean up resources.
+    /// Stop watching; no reload runs once this returns.
     ~ConfigWatcher();
 
     ConfigWatcher(const ConfigWatcher&) = delete;
     ConfigWatcher& operator=(const ConfigWatcher&) = delete;
 
 private:
-    static void threadProc(ConfigWatcher* self);
-
-    HWND m_hwnd;            ///< Window receiving update notifications.
-    std::thread m_thread;   ///< Background thread.
-    HandleGuard m_stopEvent; ///< Event used to signal thread shutdown.
+    HWND m_hwnd;                     ///< Window receiving update notifications.
+    std::vector<uint64_t> m_watches; ///< FileWatchService subscription per layer file.
+    uint64_t m_subscription{0};      ///< reload_debounce_ms listener.
 };
-#else
-#include "config_watcher_posix.h"
-#endif
@@ -9,23 +9,179 @@
 #endif
 #include "constants.h"
 #include "log.h"
+#include "config_cache.h"
 #include "config_parser.h"
-#include <fstream>
+#include "startup_profile.h"
+#include <algorithm>
+#include <chrono>
 
 #ifndef _WIN32
 using HINSTANCE = void*;
 #endif
 extern HINSTANCE g_hInst; // Provided by the executable
 
+namespace {
+/// Source of snapshot generations; shared by every instance so a cached
+/// generation identifies exactly one snapshot.
+std::atomic<uint64_t> g_nextGeneration{1};
+
+struct CachedSnapshot {
+    uint64_t generation = 0;
+    ConfigSnapshotPtr snapshot;
+};
+
+// A few slots so threads alternating between instances (tests, tools) do
+// not keep evicting each other.
+constexpr size_t kCachedSnapshots = 4;
+thread_local CachedSnapshot t_snapshots[kCachedSnapshots];
+thread_local size_t t_nextSnapshot = 0;
+} // namespace
+
 /// Global configuration instance shared across modules.
 Configuration g_config;
 
+void ConfigSnapshot::buildIndex() {
+    size_t unknown = 0;
+    for (const auto& entry : m_values) {
+        if (const ConfigKeyInfo* info = FindConfigKey(entry.first))
+            m_known[static_cast<size_t>(info->key)] = &entry.second;
+        else
+            ++unknown;
+    }
+    if (unknown == 0)
+        return;
+
+    size_t capacity = 4;
+    while (capacity < 2 * unknown)
+        capacity *= 2;
+    m_unknown.assign(capacity, nullptr);
+    for (const auto& entry : m_values) {
+        if (FindConfigKey(entry.first))
+            continue;
+        size_t slot = HashConfigKey(entry.first) & (capacity - 1);
+        while (m_unknown[slot])
+            slot = (slot + 1) & (capacity - 1);
+        m_unknown[slot] = &entry;
+    }
+}
+
+const std::wstring* ConfigSnapshot::find(std::wstring_view key) const {
+    if (const ConfigKeyInfo* info = FindConfigKey(key))
+        return find(info->key);
+    if (m_unknown.empty())
+        return nullptr;
+    size_t mask = m_unknown.size() - 1;
+    // At most half full, so an empty slot always ends the probe
+    for (size_t slot = HashConfigKey(key) & mask;; slot = (slot + 1) & mask) {
+        const ConfigMap::value_type* entry = m_unknown[slot];
+        if (!entry)
+            return nullptr;
+        if (entry->first == key)
+            return &entry->second;
+    }
+}
+
+std::optional<std::wstring_view> ConfigSnapshot::get(std::wstring_view key) const {
+    if (const std::wstring* value = find(key))
+        return std::wstring_view(*value);
+    return std::nullopt;
+}
+
+ConfigDiff::ConfigDiff(ConfigSnapshotPtr before, ConfigSnapshotPtr after)
+    : m_before(std::move(before)), m_after(std::move(after)) {
+    // Both maps are sorted by key, so one merge walk finds every change
+    const ConfigMap& oldValues = m_before->values();
+    const ConfigMap& newValues = m_after->values();
+    auto oldIt = oldValues.begin();
+    auto newIt = newValues.begin();
+    while (oldIt != oldValues.end() || newIt != newValues.end()) {
+        if (newIt == newValues.end() || (oldIt != oldValues.end() && oldIt->first < newIt->first)) {
+            m_changes.push_back({oldIt->first, &oldIt->second, nullptr});
+            ++oldIt;
+        } else if (oldIt == oldValues.end() || newIt->first < oldIt->first) {
+            m_changes.push_back({newIt->first, nullptr, &newIt->second});
+            ++newIt;
+        } else {
+            if (oldIt->second != newIt->second)
+                m_changes.push_back({newIt->first, &oldIt->second, &newIt->second});
+            ++oldIt;
+            ++newIt;
+        }
+    }
+}
+
+ConfigDiff::ConfigDiff(ConfigSnapshotPtr before, ConfigSnapshotPtr after, std::vector<ConfigChange> changes)
+    : m_before(std::move(before)), m_after(std::move(after)), m_changes(std::move(changes)) {}
+
+bool ConfigDiff::contains(std::wstring_view key) const {
+    auto it = std::lower_bound(m_changes.begin(), m_changes.end(), key,
+                               [](const ConfigChange& change, std::wstring_view k) { return change.key < k; });
+    return it != m_changes.end() && it->key == key;
+}
+
+ConfigDiff ConfigDiff::select(std::wstring_view key, bool prefix) const {
+    auto less = [](const ConfigChange& change, std::wstring_view k) { return change.key < k; };
+    auto first = std::lower_bound(m_changes.begin(), m_changes.end(), key, less);
+    auto last = first;
+    if (prefix) {
+        while (last != m_changes.end() && last->key.substr(0, key.size()) == key)
+            ++last;
+    } else if (last != m_changes.end() && last->key == key) {
+        ++last;
+    }
+    return ConfigDiff(m_before, m_after, std::vector<ConfigChange>(first, last));
+}
+
+Configuration::Configuration() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    publishLocked({});
+}
+
+std::wstring MachineConfigPath() {
+#ifdef _WIN32
+    wchar_t programData[MAX_PATH];
+    DWORD length = GetEnvironmentVariableW(L"ProgramData", programData, MAX_PATH);
+    if (length == 0 || length >= MAX_PATH)
+        return std::wstring();
+    return (std::filesystem::path(programData) / L"kbdlayoutmon" / configFile).wstring();
+#else
+    return (std::filesystem::path("/etc/kbdlayoutmon") / configFile).wstring();
+#endif
+}
+
 void Configuration::load(std::optional<std::wstring> path) {
+    loadLayer(ConfigLayer::User, std::move(path));
+}
+
+void Configuration::loadLayer(ConfigLayer which, std::optional<std::wstring> path) {
+    std::shared_ptr<const EnvironmentSnapshot> captured;
+    loadLayer(which, std::move(path), captured);
+}
+
+void Configuration::loadLayers(std::initializer_list<ConfigLayer> layers) {
+    std::shared_ptr<const EnvironmentSnapshot> captured;
+    for (ConfigLayer layer : layers) {
+        if (!getLayerPath(layer).empty())
+            loadLayer(layer, std::nullopt, captured);
+    }
+}
+
+void Configuration::loadLayer(ConfigLayer which, std::optional<std::wstring> path,
+                              std::shared_ptr<const EnvironmentSnapshot>& captured) {
+    if (which != ConfigLayer::Machine && which != ConfigLayer::User) {
+        WriteLog(LogLevel::Error, L"Only the machine and user configuration layers are loaded from files.");
+        return;
+    }
+    const size_t index = static_cast<size_t>(which);
+    ScopedStartupPhase phase(which == ConfigLayer::Machine ? L"load machine configuration"
+                                                           : L"load user configuration");
     std::wstring fullPath;
     if (path && !path->empty()) {
         fullPath = *path;
-    } else if (!m_lastPath.empty()) {
-        fullPath = m_lastPath;
+    } else if (std::wstring last = getLayerPath(which); !last.empty()) {
+        fullPath = last;
+    } else if (which == ConfigLayer::Machine) {
+        fullPath = MachineConfigPath();
     } else {
 #ifdef _WIN32
         // Prefer current working directory (tests expect this behavior).
@@ -54,45 +210,275 @@ void Configuration::load(std::optional<std::wstring> path) {
 #endif
     }
 
-#ifdef _WIN32
-    std::wifstream file(fullPath.c_str());
-#else
-    std::wifstream file{std::filesystem::path(fullPath)};
-#endif
-    if (!file.is_open()) {
+    namespace fs = std::filesystem;
+    FileStamp stamp;
+    std::error_code ec;
+    fs::path file(fullPath);
+    stamp.size = fs::file_size(file, ec);
+    fs::file_time_type mtime = ec ? fs::file_time_type() : fs::last_write_time(file, ec);
+    if (!ec) {
+        stamp.mtime = mtime.time_since_epoch().count();
+        // A write in the same timestamp tick as the one we are about to
+        // read could keep both size and time; only trust them once the file
+        // has been left alone for longer than any filesystem's resolution.
+        stamp.settled = fs::file_time_type::clock::now() - mtime > std::chrono::seconds(2);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const Layer& layer = m_layers[index];
+        if (layer.stamp.valid && layer.stamp.settled && fullPath == layer.path && layer.stamp.size == stamp.size &&
+            layer.stamp.mtime == stamp.mtime)
+            return;
+    }
+
+    std::string bytes;
+    if (!ReadConfigBytes(fullPath, bytes)) {
+        if (which == ConfigLayer::Machine) {
+            // The machine-wide file is optional; without it the layer is
+            // empty, but keeps its path so the file is picked up once created
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                Layer& layer = m_layers[index];
+                layer.path = fullPath;
+                layer.values.clear();
+                layer.stamp = FileStamp();
+                layer.reported.clear();
+                mergeLocked();
+            }
+            notify();
+            return;
+        }
         std::wstring msg = L"Failed to open configuration file: " + fullPath;
         WriteLog(LogLevel::Error, msg.c_str());
         return;
     }
+    stamp.valid = true;
+    stamp.size = bytes.size();
+    stamp.hash = HashConfigBytes(bytes.data(), bytes.size());
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Layer& layer = m_layers[index];
+        if (layer.stamp.valid && fullPath == layer.path && layer.stamp.size == stamp.size &&
+            layer.stamp.hash == stamp.hash) {
+            layer.stamp = stamp;
+            return;
+        }
+    }
 
-    auto newSettings = ParseConfigStream(file);
+    std::shared_ptr<const EnvironmentSnapshot> environment;
+    bool binaryCache;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        environment = m_environment;
+        // Anyone may write a cache, so only files they could edit use one
+        binaryCache = m_binaryCache && which != ConfigLayer::Machine;
+    }
+    std::wstring cachePath = binaryCache ? ConfigCachePath(fullPath) : std::wstring();
+    binaryCache = !cachePath.empty();
+    ConfigMap newSettings;
+    std::vector<std::wstring> diagnostics;
+    ConfigCacheKey cacheKey;
+    bool cached = false;
+    if (binaryCache) {
+        // The cache must match the variables the text is expanded with
+        if (!environment) {
+            if (!captured)
+                captured = EnvironmentSnapshot::Capture();
+            environment = captured;
+        }
+        cacheKey = {stamp.hash, stamp.size, environment->hash(), ConfigSchemaHash()};
+        ScopedStartupPhase cachePhase(L"read binary cache");
+        cached = ReadConfigCache(cachePath, cacheKey, newSettings, diagnostics);
+    }
+    if (!cached) {
+        ScopedStartupPhase parsePhase(L"parse text");
+        std::wstring text;
+        DecodeConfigBytes(bytes.data(), bytes.size(), text);
+        newSettings = ParseConfigText(text, &diagnostics, environment.get());
+        if (binaryCache)
+            WriteConfigCache(cachePath, cacheKey, newSettings, diagnostics);
+    }
 
+    std::vector<std::wstring> fresh;
     {
         std::lock_guard<std::mutex> lock(m_mutex);
-        m_lastPath = fullPath;
-        settings = std::move(newSettings);
+        Layer& layer = m_layers[index];
+        bool reload = !layer.path.empty();
+        layer.path = fullPath;
+        layer.stamp = stamp;
+        if (newSettings != layer.values) {
+            layer.values = std::move(newSettings);
+            ConfigSnapshotPtr before = m_current;
+            mergeLocked();
+            // Compare normalized text; a missing key counts as its default.
+            for (const ConfigKeyInfo& info : kConfigKeys) {
+                if (info.reload != ConfigReload::Restart || !reload)
+                    continue;
+                const std::wstring* oldValue = before->find(info.name);
+                const std::wstring* newValue = m_current->find(info.name);
+                if ((oldValue ? std::wstring_view(*oldValue) : info.defaultValue) !=
+                    (newValue ? std::wstring_view(*newValue) : info.defaultValue))
+                    diagnostics.push_back(std::wstring(info.name) + L" changed; restart to apply it");
+            }
+        }
+
+        for (const auto& message : diagnostics) {
+            if (std::find(layer.reported.begin(), layer.reported.end(), message) == layer.reported.end())
+                fresh.push_back(message);
+        }
+        layer.reported = std::move(diagnostics);
     }
+    // Logged outside the lock: the log writer reads the configuration
+    for (const auto& message : fresh)
+        WriteLog(LogLevel::Warn, fullPath + L": " + message);
+    notify();
 }
 
 std::wstring Configuration::getLastPath() const {
+    return getLayerPath(ConfigLayer::User);
+}
+
+std::wstring Configuration::getLayerPath(ConfigLayer layer) const {
     std::lock_guard<std::mutex> lock(m_mutex);
-    return m_lastPath;
+    return m_layers[static_cast<size_t>(layer)].path;
 }
 
-std::optional<std::wstring> Configuration::get(const std::wstring& key) const {
+ConfigMap Configuration::layerValues(ConfigLayer layer) const {
     std::lock_guard<std::mutex> lock(m_mutex);
-    auto it = settings.find(key);
-    if (it != settings.end())
-        return it->second;
+    return m_layers[static_cast<size_t>(layer)].values;
+}
+
+std::optional<std::wstring> Configuration::get(std::wstring_view key) const {
+    if (const std::wstring* value = current()->find(key))
+        return *value;
     return std::nullopt;
 }
 
-void Configuration::set(const std::wstring& key, const std::wstring& value) {
+std::optional<std::wstring> Configuration::get(ConfigKey key) const {
+    if (const std::wstring* value = current()->find(key))
+        return *value;
+    return std::nullopt;
+}
+
+void Configuration::set(const std::wstring& key, const std::wstring& value, ConfigLayer which) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Layer& layer = m_layers[static_cast<size_t>(which)];
+        auto [it, inserted] = layer.values.try_emplace(key, value);
+        if (!inserted) {
+            if (it->second == value)
+                return;
+            it->second = value;
+        }
+        layer.stamp.valid = false;
+        mergeLocked();
+    }
+    notify();
+}
+
+void Configuration::clearLayer(ConfigLayer which) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Layer& layer = m_layers[static_cast<size_t>(which)];
+        if (layer.values.empty())
+            return;
+        layer.values.clear();
+        layer.stamp.valid = false;
+        mergeLocked();
+    }
+    notify();
+}
+
+void Configuration::setEnvironment(std::shared_ptr<const EnvironmentSnapshot> environment) {
     std::lock_guard<std::mutex> lock(m_mutex);
-    settings[key] = value;
+    m_environment = std::move(environment);
+    // Unchanged files must still be expanded against the new variables
+    for (Layer& layer : m_layers)
+        layer.stamp.valid = false;
 }
 
-std::map<std::wstring, std::wstring> Configuration::snapshot() const {
+void Configuration::setBinaryCache(bool enabled) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_binaryCache = enabled;
+}
+
+ConfigSnapshotPtr Configuration::snapshot() const {
+    return current();
+}
+
+uint64_t Configuration::subscribe(std::wstring key, ConfigListener listener) {
+    return addSubscription(std::move(key), false, std::move(listener));
+}
+
+uint64_t Configuration::subscribePrefix(std::wstring prefix, ConfigListener listener) {
+    return addSubscription(std::move(prefix), true, std::move(listener));
+}
+
+void Configuration::unsubscribe(uint64_t id) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_subscriptions.erase(std::remove_if(m_subscriptions.begin(), m_subscriptions.end(),
+                                         [id](const auto& s) { return s->id == id; }),
+                          m_subscriptions.end());
+}
+
+uint64_t Configuration::addSubscription(std::wstring key, bool prefix, ConfigListener listener) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    uint64_t id = m_nextSubscription++;
+    m_subscriptions.push_back(
+        std::make_shared<const Subscription>(Subscription{id, std::move(key), prefix, std::move(listener)}));
+    return id;
+}
+
+void Configuration::mergeLocked() {
+    // Lower layers first so each key ends up with its highest layer's value
+    ConfigMap merged = m_layers[0].values;
+    for (size_t i = 1; i < kConfigLayerCount; ++i) {
+        for (const auto& [key, value] : m_layers[i].values)
+            merged.insert_or_assign(key, value);
+    }
+    if (merged != m_current->values())
+        publishLocked(std::move(merged));
+}
+
+void Configuration::publishLocked(ConfigMap values) {
+    ConfigSnapshotPtr previous = std::move(m_current);
+    m_current = std::make_shared<const ConfigSnapshot>(std::move(values));
+    m_generation.store(g_nextGeneration.fetch_add(1, std::memory_order_relaxed), std::memory_order_release);
+    if (!m_subscriptions.empty() && previous)
+        m_pending.emplace_back(std::move(previous), m_current);
+}
+
+void Configuration::notify() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    // A thread already delivering picks up whatever was queued meanwhile,
+    // which keeps listeners serialized and in publish order.
+    if (m_notifying)
+        return;
+    m_notifying = true;
+    while (!m_pending.empty()) {
+        auto [before, after] = std::move(m_pending.front());
+        m_pending.pop_front();
+        auto subscriptions = m_subscriptions;
+        lock.unlock();
+
+        ConfigDiff diff(std::move(before), std::move(after));
+        for (const auto& subscription : subscriptions) {
+            ConfigDiff selected = diff.select(subscription->key, subscription->prefix);
+            if (!selected.empty())
+                subscription->listener(selected);
+        }
+        lock.lock();
+    }
+    m_notifying = false;
+}
+
+const ConfigSnapshotPtr& Configuration::current() const {
+    uint64_t generation = m_generation.load(std::memory_order_acquire);
+    for (const CachedSnapshot& cached : t_snapshots) {
+        if (cached.generation == generation)
+            return cached.snapshot;
+    }
+    CachedSnapshot& slot = t_snapshots[t_nextSnapshot++ % kCachedSnapshots];
     std::lock_guard<std::mutex> lock(m_mutex);
-    return settings;
+    slot.generation = m_generation.load(std::memory_order_relaxed);
+    slot.snapshot = m_current;
+    return slot.snapshot;
 }
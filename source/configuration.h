@@ -1,25 +1,170 @@
 #pragma once
 
-#include <map>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <initializer_list>
+#include <memory>
 #include <string>
+#include <string_view>
 #include <optional>
 #include <mutex>
+#include <vector>
+#include "config_map.h"
+#include "config_schema.h"
 
 /**
- * @brief Manages configuration settings loaded from a file.
+ * @brief Immutable set of settings published by Configuration.
+ *
+ * A snapshot never changes after construction, so it can be read from any
+ * thread without locking. Views and pointers returned by the lookups stay
+ * valid for as long as the snapshot is alive. Known keys are additionally
+ * parsed once into settings() so hot paths read native fields.
+ *
+ * Lookups do not search the map: known keys are indexed by ConfigKey and
+ * everything else sits in a small open-addressing table, both pointing
+ * into the map and built once with the snapshot.
+ */
+class ConfigSnapshot {
+public:
+    ConfigSnapshot() : m_settings(BuildConfigSettings(m_values)) {}
+    explicit ConfigSnapshot(ConfigMap values)
+        : m_values(std::move(values)), m_settings(BuildConfigSettings(m_values)) {
+        buildIndex();
+    }
+    // The index points into this instance's map
+    ConfigSnapshot(const ConfigSnapshot&) = delete;
+    ConfigSnapshot& operator=(const ConfigSnapshot&) = delete;
+
+    /// Stored value for @p key, or @c nullptr when the key is absent.
+    const std::wstring* find(std::wstring_view key) const;
+    /// Stored value for a known key; a single array load.
+    const std::wstring* find(ConfigKey key) const noexcept { return m_known[static_cast<size_t>(key)]; }
+    /// Value for @p key without copying.
+    std::optional<std::wstring_view> get(std::wstring_view key) const;
+    std::optional<std::wstring_view> get(ConfigKey key) const {
+        if (const std::wstring* value = find(key))
+            return std::wstring_view(*value);
+        return std::nullopt;
+    }
+    /// Every setting in key order.
+    const ConfigMap& values() const noexcept { return m_values; }
+    /// True when no settings are present.
+    bool empty() const noexcept { return m_values.empty(); }
+    /// Known keys as typed values.
+    const ConfigSettings& settings() const noexcept { return m_settings; }
+
+private:
+    void buildIndex();
+
+    const ConfigMap m_values;
+    const ConfigSettings m_settings;
+    /// Value of each known key, or @c nullptr when absent.
+    std::array<const std::wstring*, kConfigKeyCount> m_known{};
+    /// Keys outside the registry, linear probing by HashConfigKey(); the
+    /// size is a power of two at least twice the count, empty if none.
+    std::vector<const ConfigMap::value_type*> m_unknown;
+};
+
+/// Shared handle to a published snapshot; copying it is one atomic increment.
+using ConfigSnapshotPtr = std::shared_ptr<const ConfigSnapshot>;
+
+/// One key whose value differs between two snapshots.
+struct ConfigChange {
+    std::wstring_view key;
+    const std::wstring* before = nullptr; ///< Old value, or @c nullptr when the key was added
+    const std::wstring* after = nullptr;  ///< New value, or @c nullptr when the key was removed
+};
+
+/**
+ * @brief Keys that differ between two snapshots, in key order.
+ *
+ * The diff keeps both snapshots alive, so the keys and values its changes
+ * point to stay valid for as long as the diff does.
+ */
+class ConfigDiff {
+public:
+    ConfigDiff(ConfigSnapshotPtr before, ConfigSnapshotPtr after);
+
+    const ConfigSnapshotPtr& before() const noexcept { return m_before; }
+    const ConfigSnapshotPtr& after() const noexcept { return m_after; }
+    const std::vector<ConfigChange>& changes() const noexcept { return m_changes; }
+    /// True when both snapshots hold the same settings.
+    bool empty() const noexcept { return m_changes.empty(); }
+    /// True when @p key was added, removed or changed.
+    bool contains(std::wstring_view key) const;
+    bool contains(ConfigKey key) const { return contains(GetConfigKeyInfo(key).name); }
+
+    /**
+     * @brief Restrict the diff to the changes a subscriber asked for.
+     * @param key Exact key, or key prefix when @p prefix is set.
+     */
+    ConfigDiff select(std::wstring_view key, bool prefix) const;
+
+private:
+    ConfigDiff(ConfigSnapshotPtr before, ConfigSnapshotPtr after, std::vector<ConfigChange> changes);
+
+    ConfigSnapshotPtr m_before;
+    ConfigSnapshotPtr m_after;
+    std::vector<ConfigChange> m_changes;
+};
+
+/// Callback receiving the changes a subscription matched.
+using ConfigListener = std::function<void(const ConfigDiff&)>;
+
+class EnvironmentSnapshot;
+
+/// Sources of settings, lowest precedence first.
+/// Keys no layer sets fall back to their schema defaults.
+enum class ConfigLayer : uint8_t {
+    Machine,     ///< Machine-wide file, see MachineConfigPath()
+    User,        ///< The user's file, normally next to the executable
+    CommandLine, ///< Overrides given on the command line
+};
+
+inline constexpr size_t kConfigLayerCount = 3;
+
+/// Location of the optional machine-wide configuration file.
+std::wstring MachineConfigPath();
+
+/**
+ * @brief Manages configuration settings loaded from files and overrides.
  *
  * Keys are stored in lower case to simplify lookups.  Values are kept
  * verbatim after trimming whitespace.
+ *
+ * Settings come from the layers in ConfigLayer, each stored on its own, so
+ * reloading the user file neither re-reads the machine file nor drops
+ * command-line overrides. When a layer changes, the layers are merged into
+ * a new ConfigSnapshot, the higher layer winning for each key, and
+ * published under a generation number. Readers keep the snapshots they have seen in a small
+ * thread-local cache keyed by that number, so lookups only take the lock
+ * once per thread after each change.
+ *
+ * A load that leaves every value unchanged publishes nothing. Otherwise the
+ * difference to the previous snapshot is handed to the subscribers whose
+ * key or prefix it touches.
  */
 class Configuration {
 public:
+    Configuration();
+
     /**
-     * @brief Load configuration from a file.
+     * @brief Load the user layer from a file.
      *
      * If @p path is empty or @c std::nullopt, the previously loaded
      * path is reused. When no file has been loaded yet, the default
      * configuration file next to the executable is used.
      *
+     * Unknown keys, invalid values and changes to keys that only apply
+     * at startup are logged as warnings; each distinct message once until
+     * a later load no longer produces it.
+     *
+     * Reloading the same file is skipped when its size and modification
+     * time are unchanged, and parsing is skipped when its content hash is.
+     *
      * @param path Optional path to a configuration file.
      * @return void
      * @sideeffects Updates internal settings and remembers the last path.
@@ -27,39 +172,180 @@ public:
     void load(std::optional<std::wstring> path = std::nullopt);
 
     /**
-     * @brief Retrieve the path of the last loaded configuration file.
+     * @brief Load the machine or user layer from a file.
+     *
+     * Behaves like load(); for the machine layer the default path is
+     * MachineConfigPath(), and a missing file empties the layer instead of
+     * being reported; the layer keeps the path so a later reload finds it.
+     */
+    void loadLayer(ConfigLayer layer, std::optional<std::wstring> path = std::nullopt);
+
+    /**
+     * @brief Reload several layers from the files they were last loaded
+     *        from; layers never loaded are skipped.
+     *
+     * Without a fixed environment (see setEnvironment()), the variables are
+     * captured once for the whole batch rather than once per file.
+     */
+    void loadLayers(std::initializer_list<ConfigLayer> layers);
+
+    /**
+     * @brief Retrieve the path of the last loaded user configuration file.
      * @return Absolute path of the last successfully loaded file.
      */
     std::wstring getLastPath() const;
 
+    /// Path the machine or user layer was last loaded from; empty if none.
+    std::wstring getLayerPath(ConfigLayer layer) const;
+
+    /// Settings held by @p layer alone.
+    ConfigMap layerValues(ConfigLayer layer) const;
+
     /**
      * @brief Retrieve the value associated with @p key.
      * @param key Lower-cased configuration key to look up.
      * @return Optional containing the value if the key exists.
      */
-    std::optional<std::wstring> get(const std::wstring& key) const;
+    std::optional<std::wstring> get(std::wstring_view key) const;
+    std::optional<std::wstring> get(ConfigKey key) const;
 
     /**
-     * @brief Set the value for @p key.
+     * @brief Set the value for @p key in one layer.
+     *
+     * A value set in a file layer lasts until that file is next reloaded.
+     *
      * @param key Lower-cased configuration key.
      * @param value Value to store.
+     * @param layer Layer receiving the value.
+     */
+    void set(const std::wstring& key, const std::wstring& value, ConfigLayer layer = ConfigLayer::User);
+
+    /// Remove every setting from @p layer.
+    void clearLayer(ConfigLayer layer);
+
+    /**
+     * @brief Expand variables in loaded files from a fixed environment.
+     *
+     * With a snapshot, reloads expand references the same way however the
+     * process environment changes; @c nullptr restores live lookups. The
+     * file layers are parsed again on their next load.
+     */
+    void setEnvironment(std::shared_ptr<const EnvironmentSnapshot> environment);
+
+    /**
+     * @brief Keep a binary copy of each parsed user file.
+     *
+     * Copies go to the per-user ConfigCachePath(). The machine-wide file is
+     * never cached: a copy any user can write must not stand in for a file
+     * only administrators can change.
+     *
+     * When enabled (the default), a load whose file content, environment
+     * and key registry match the cache (see config_cache.h) takes the
+     * settings and diagnostics from it instead of decoding and parsing the
+     * text; otherwise the text is parsed and the cache rewritten. A cache
+     * that cannot be written is ignored.
      */
-    void set(const std::wstring& key, const std::wstring& value);
+    void setBinaryCache(bool enabled);
 
     /**
-     * @brief Obtain a snapshot of all configuration settings.
-     * @return Copy of the internal settings map.
+     * @brief Obtain the current settings.
+     *
+     * Use one snapshot for several lookups that belong together; later
+     * changes publish a new snapshot and leave this one untouched.
+     */
+    ConfigSnapshotPtr snapshot() const;
+
+    /**
+     * @brief Call @p listener whenever @p key changes.
+     *
+     * Listeners run on the thread that published the change, outside the
+     * configuration lock and one at a time in publish order; they may read
+     * or modify the configuration. A change published while listeners run
+     * is delivered once they return.
+     *
+     * @param key Lower-cased configuration key.
+     * @return Identifier for unsubscribe().
+     */
+    uint64_t subscribe(std::wstring key, ConfigListener listener);
+
+    /// Like subscribe() for every key starting with @p prefix; an empty
+    /// prefix matches all keys.
+    uint64_t subscribePrefix(std::wstring prefix, ConfigListener listener);
+
+    /**
+     * @brief Remove a subscription.
+     *
+     * A notification already being delivered may still reach it.
      */
-    std::map<std::wstring, std::wstring> snapshot() const;
+    void unsubscribe(uint64_t id);
 
 private:
-    /// Map containing lower-cased keys from the configuration file.
-    std::map<std::wstring, std::wstring> settings;
+    struct Subscription {
+        uint64_t id;
+        std::wstring key;
+        bool prefix;
+        ConfigListener listener;
+    };
+
+    uint64_t addSubscription(std::wstring key, bool prefix, ConfigListener listener);
+    /// loadLayer() sharing @p captured, the environment taken for the
+    /// current batch, filled on first use when there is no fixed one.
+    void loadLayer(ConfigLayer which, std::optional<std::wstring> path,
+                   std::shared_ptr<const EnvironmentSnapshot>& captured);
+    /// Replace the current snapshot and queue the change for subscribers.
+    /// Caller holds #m_mutex.
+    void publishLocked(ConfigMap values);
+    /// Merge the layers and publish the result if it differs from the
+    /// current snapshot. Caller holds #m_mutex.
+    void mergeLocked();
+    /// Deliver queued changes unless another thread is already doing so.
+    void notify();
+    /// Current snapshot from the calling thread's cache.
+    const ConfigSnapshotPtr& current() const;
+
+    /// Most recently published settings.
+    ConfigSnapshotPtr m_current;
+
+    /// Variables for expansion; @c nullptr for the live environment.
+    std::shared_ptr<const EnvironmentSnapshot> m_environment;
+    bool m_binaryCache = true;
+
+    /// Process-unique number of #m_current; readers compare it against
+    /// their cached snapshot without locking.
+    std::atomic<uint64_t> m_generation{0};
+
+    /// What a layer's file looked like when the layer was parsed from it.
+    struct FileStamp {
+        bool valid = false;     ///< Cleared by set(), which diverges from the file
+        bool settled = false;   ///< Modified well before it was read, so the
+                                ///< size and time alone identify the content
+        uint64_t size = 0;
+        int64_t mtime = 0;      ///< file_time_type ticks
+        uint64_t hash = 0;      ///< HashConfigBytes of the content
+    };
+
+    struct Layer {
+        ConfigMap values;
+        std::wstring path;  ///< File the layer was last loaded from
+        FileStamp stamp;
+        /// Warnings logged by the previous load, used to avoid repeating them.
+        std::vector<std::wstring> reported;
+    };
+
+    /// Indexed by ConfigLayer.
+    Layer m_layers[kConfigLayerCount];
+
+    /// Registered listeners; copied before each delivery so they can
+    /// (un)subscribe from a callback.
+    std::vector<std::shared_ptr<const Subscription>> m_subscriptions;
+    uint64_t m_nextSubscription = 1;
 
-    /// Stores the path of the most recently loaded configuration file.
-    std::wstring m_lastPath;
+    /// Published (before, after) pairs not yet delivered.
+    std::deque<std::pair<ConfigSnapshotPtr, ConfigSnapshotPtr>> m_pending;
+    /// Set while a thread delivers #m_pending.
+    bool m_notifying = false;
 
-    /// Mutex guarding access to #settings and #m_lastPath.
+    /// Mutex guarding #m_current, #m_layers and the subscription state.
     mutable std::mutex m_mutex;
 };
 
@@ -0,0 +1,172 @@
+#include "file_watch_service.h"
+
+#include <algorithm>
+#include <cwctype>
+#include <filesystem>
+#include <system_error>
+
+#include "log.h"
+
+namespace {
+// Split @p path into its absolute directory and file name
+void SplitWatchPath(const std::wstring& path, std::wstring& directory, std::wstring& name) {
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    fs::path full = fs::absolute(fs::path(path), ec);
+    if (ec)
+        full = fs::path(path);
+    full = full.lexically_normal();
+    name = full.filename().wstring();
+    directory = full.parent_path().wstring();
+    if (directory.empty())
+        directory = L".";
+}
+} // namespace
+
+FileWatchService::FileWatchService(std::unique_ptr<FileWatchBackend> backend)
+    : m_backend(std::move(backend)) {}
+
+FileWatchService::~FileWatchService() {
+    if (m_backend)
+        m_backend->stop();
+    if (m_thread.joinable())
+        m_thread.join();
+}
+
+uint64_t FileWatchService::watch(const std::wstring& path, Callback callback, std::chrono::milliseconds debounce) {
+    if (!m_backend) {
+        WriteLog(LogLevel::Error, L"File watching is unavailable: " + path);
+        return 0;
+    }
+    auto subscription = std::make_shared<Subscription>();
+    subscription->path = path;
+    subscription->callback = std::move(callback);
+    subscription->debounce = debounce;
+    SplitWatchPath(path, subscription->directory, subscription->name);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    size_t& watchers = m_directories[subscription->directory];
+    if (watchers == 0 && !m_backend->addDirectory(subscription->directory)) {
+        m_directories.erase(subscription->directory);
+        WriteLog(LogLevel::Error, L"Failed to watch directory: " + subscription->directory);
+        return 0;
+    }
+    ++watchers;
+    subscription->id = m_nextId++;
+    m_subscriptions.emplace(subscription->id, subscription);
+
+    if (!m_thread.joinable()) {
+        try {
+            m_thread = std::thread(&FileWatchService::threadProc, this);
+            m_threadId = m_thread.get_id();
+        } catch (const std::system_error&) {
+            WriteLog(LogLevel::Error, L"Failed to create file watch thread.");
+        }
+    }
+    return subscription->id;
+}
+
+void FileWatchService::setDebounce(uint64_t id, std::chrono::milliseconds debounce) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_subscriptions.find(id);
+    if (it != m_subscriptions.end())
+        it->second->debounce = debounce;
+}
+
+void FileWatchService::unwatch(uint64_t id) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    auto it = m_subscriptions.find(id);
+    if (it == m_subscriptions.end())
+        return;
+    std::wstring directory = it->second->directory;
+    m_subscriptions.erase(it);
+    auto dir = m_directories.find(directory);
+    if (dir != m_directories.end() && --dir->second == 0) {
+        m_directories.erase(dir);
+        m_backend->removeDirectory(directory);
+    }
+    // Once this returns the caller may destroy whatever the callback uses
+    if (std::this_thread::get_id() != m_threadId)
+        m_callbackDone.wait(lock, [&] { return m_running != id; });
+}
+
+size_t FileWatchService::directoryCount() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_directories.size();
+}
+
+bool FileWatchService::sameName(const std::wstring& a, const std::wstring& b) const {
+    if (!m_backend->caseInsensitive())
+        return a == b;
+    return a.size() == b.size() &&
+           std::equal(a.begin(), a.end(), b.begin(),
+                      [](wchar_t x, wchar_t y) { return std::towlower(x) == std::towlower(y); });
+}
+
+void FileWatchService::threadProc() {
+    std::vector<FileWatchChange> changes;
+    std::vector<std::shared_ptr<Subscription>> due;
+    for (;;) {
+        // Sleep until a change arrives or the earliest debounce expires
+        long long timeout = -1;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto now = ReloadDebouncer::Clock::now();
+            for (const auto& [id, subscription] : m_subscriptions) {
+                long long remaining = subscription->debouncer.timeoutMs(now);
+                if (remaining >= 0 && (timeout < 0 || remaining < timeout))
+                    timeout = remaining;
+            }
+        }
+
+        changes.clear();
+        FileWatchBackend::WaitResult result = m_backend->wait(timeout, changes);
+        if (result == FileWatchBackend::WaitResult::Stopped)
+            return;
+        if (result == FileWatchBackend::WaitResult::Failed) {
+            WriteLog(LogLevel::Error, L"File watch failed; changes are no longer picked up.");
+            return;
+        }
+
+        due.clear();
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto now = ReloadDebouncer::Clock::now();
+            for (const auto& [id, subscription] : m_subscriptions) {
+                for (const FileWatchChange& change : changes) {
+                    bool ours = change.overflow
+                                    ? change.directory.empty() || change.directory == subscription->directory
+                                    : change.directory == subscription->directory &&
+                                          sameName(change.name, subscription->name);
+                    if (ours) {
+                        subscription->debouncer.touch(now, subscription->debounce);
+                        break;
+                    }
+                }
+                if (subscription->debouncer.take(now))
+                    due.push_back(subscription);
+            }
+        }
+
+        // Callbacks run unlocked so they may watch, unwatch or reconfigure
+        for (const auto& subscription : due) {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (!m_subscriptions.count(subscription->id))
+                    continue;
+                m_running = subscription->id;
+            }
+            subscription->callback(subscription->path);
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_running = 0;
+            }
+            m_callbackDone.notify_all();
+        }
+    }
+}
+
+FileWatchService& GetFileWatchService() {
+    static FileWatchService service;
+    return service;
+}
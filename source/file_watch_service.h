@@ -0,0 +1,133 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "reload_debouncer.h"
+
+/// One change reported by a FileWatchBackend.
+struct FileWatchChange {
+    std::wstring directory; ///< Watched directory, as passed to addDirectory()
+    std::wstring name;      ///< File name within it; empty for an overflow
+    bool overflow = false;  ///< Events were lost; every file in @c directory
+                            ///< (every directory when it is empty) may have changed
+};
+
+/**
+ * @brief Platform directory notification mechanism behind FileWatchService.
+ *
+ * One instance watches any number of directories: inotify on Linux,
+ * overlapped ReadDirectoryChangesW on Windows.
+ */
+class FileWatchBackend {
+public:
+    enum class WaitResult { Changes, Timeout, Stopped, Failed };
+
+    virtual ~FileWatchBackend() = default;
+
+    /// Start reporting changes in @p directory. May be called from any thread.
+    virtual bool addDirectory(const std::wstring& directory) = 0;
+    /// Stop reporting changes in @p directory. May be called from any thread.
+    virtual void removeDirectory(const std::wstring& directory) = 0;
+
+    /**
+     * @brief Block until changes arrive, @p timeoutMs passes or stop() is called.
+     * @param timeoutMs Milliseconds to wait; -1 waits indefinitely.
+     * @param[out] changes Appended with what changed.
+     */
+    virtual WaitResult wait(long long timeoutMs, std::vector<FileWatchChange>& changes) = 0;
+
+    /// Make the current and every later wait() return Stopped.
+    virtual void stop() = 0;
+
+    /// True when file names compare case-insensitively (Windows).
+    virtual bool caseInsensitive() const = 0;
+};
+
+/// Backend for the current platform, or @c nullptr when it cannot be created.
+std::unique_ptr<FileWatchBackend> CreateFileWatchBackend();
+
+/// ReadDirectoryChangesW backend used on Windows; unit tests build it
+/// against the Win32 stubs on every platform.
+std::unique_ptr<FileWatchBackend> CreateDirectoryChangesBackend();
+
+/**
+ * @brief Single thread that watches any number of files.
+ *
+ * Files are watched through their directories; subscriptions sharing a
+ * directory share one backend watch. Each subscription has its own debounce
+ * window (see ReloadDebouncer) and its callback runs on the service thread
+ * once a burst of changes has settled. Callbacks run one at a time and may
+ * call back into the service.
+ */
+class FileWatchService {
+public:
+    /// Called with the watched path after it changed.
+    using Callback = std::function<void(const std::wstring& path)>;
+
+    /// Watch through @p backend; the thread starts with the first watch().
+    explicit FileWatchService(std::unique_ptr<FileWatchBackend> backend = CreateFileWatchBackend());
+    /// Stop and join the service thread.
+    ~FileWatchService();
+
+    FileWatchService(const FileWatchService&) = delete;
+    FileWatchService& operator=(const FileWatchService&) = delete;
+
+    /**
+     * @brief Call @p callback whenever the file at @p path is written,
+     *        created, renamed or removed.
+     * @param debounce Quiet period required before the callback runs.
+     * @return Subscription id, or 0 when the directory cannot be watched.
+     */
+    uint64_t watch(const std::wstring& path, Callback callback,
+                   std::chrono::milliseconds debounce = std::chrono::milliseconds(0));
+
+    /// Change the debounce window of subscription @p id.
+    void setDebounce(uint64_t id, std::chrono::milliseconds debounce);
+
+    /**
+     * @brief Remove subscription @p id.
+     *
+     * When its callback is running on the service thread, waits for it to
+     * return unless called from that callback.
+     */
+    void unwatch(uint64_t id);
+
+    /// Number of directories currently watched.
+    size_t directoryCount() const;
+
+private:
+    struct Subscription {
+        uint64_t id;
+        std::wstring path;
+        std::wstring directory;
+        std::wstring name;
+        Callback callback;
+        std::chrono::milliseconds debounce;
+        ReloadDebouncer debouncer;
+    };
+
+    void threadProc();
+    bool sameName(const std::wstring& a, const std::wstring& b) const;
+
+    std::unique_ptr<FileWatchBackend> m_backend;
+    std::thread m_thread;
+    std::thread::id m_threadId;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_callbackDone;
+    std::map<uint64_t, std::shared_ptr<Subscription>> m_subscriptions;
+    std::map<std::wstring, size_t> m_directories; ///< Subscriptions per directory
+    uint64_t m_nextId = 1;
+    uint64_t m_running = 0; ///< Subscription whose callback is executing
+};
+
+/// Process-wide service shared by every watcher.
+FileWatchService& GetFileWatchService();
@@ -0,0 +1,137 @@
+#ifndef _WIN32
+#include "file_watch_service.h"
+
+#include <cerrno>
+#include <climits>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include "log.h"
+
+namespace {
+constexpr uint32_t kWatchMask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM;
+
+/**
+ * @brief One inotify instance for every watched directory.
+ *
+ * wait() sleeps in epoll_wait() on the inotify descriptor and an eventfd
+ * used as the stop signal, so the service thread uses no CPU while idle.
+ */
+class InotifyBackend : public FileWatchBackend {
+public:
+    InotifyBackend(int fd, int stopFd, int epollFd) : m_fd(fd), m_stopFd(stopFd), m_epollFd(epollFd) {}
+
+    ~InotifyBackend() override {
+        for (int fd : {m_epollFd, m_stopFd, m_fd})
+            close(fd);
+    }
+
+    bool addDirectory(const std::wstring& directory) override {
+        std::string path = std::filesystem::path(directory).string();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        int wd = inotify_add_watch(m_fd, path.c_str(), kWatchMask);
+        if (wd < 0)
+            return false;
+        m_directories[wd] = directory;
+        return true;
+    }
+
+    void removeDirectory(const std::wstring& directory) override {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto it = m_directories.begin(); it != m_directories.end(); ++it) {
+            if (it->second == directory) {
+                inotify_rm_watch(m_fd, it->first);
+                m_directories.erase(it);
+                return;
+            }
+        }
+    }
+
+    WaitResult wait(long long timeoutMs, std::vector<FileWatchChange>& changes) override {
+        epoll_event events[2];
+        int timeout = timeoutMs > INT_MAX ? INT_MAX : static_cast<int>(timeoutMs);
+        int ready = epoll_wait(m_epollFd, events, 2, timeout);
+        if (ready < 0)
+            return errno == EINTR ? WaitResult::Timeout : WaitResult::Failed;
+        if (ready == 0)
+            return WaitResult::Timeout;
+        // The stop counter is left set so every later wait returns at once
+        for (int i = 0; i < ready; ++i) {
+            if (events[i].data.fd == m_stopFd)
+                return WaitResult::Stopped;
+        }
+        drain(changes);
+        return WaitResult::Changes;
+    }
+
+    void stop() override {
+        uint64_t one = 1;
+        while (write(m_stopFd, &one, sizeof(one)) < 0 && errno == EINTR) {
+        }
+    }
+
+    bool caseInsensitive() const override { return false; }
+
+private:
+    // Read every queued event. Events for a watch removed meanwhile
+    // (including its IN_IGNORED) have no directory and are dropped.
+    void drain(std::vector<FileWatchChange>& changes) {
+        alignas(inotify_event) char buffer[16 * (sizeof(inotify_event) + NAME_MAX + 1)];
+        for (;;) {
+            ssize_t len = read(m_fd, buffer, sizeof(buffer));
+            if (len < 0 && errno == EINTR)
+                continue;
+            if (len <= 0)
+                return; // EAGAIN: queue empty
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (char* ptr = buffer; ptr < buffer + len;) {
+                auto* ev = reinterpret_cast<inotify_event*>(ptr);
+                ptr += sizeof(inotify_event) + ev->len;
+                if (ev->mask & IN_Q_OVERFLOW) {
+                    changes.push_back({std::wstring(), std::wstring(), true});
+                    continue;
+                }
+                auto dir = m_directories.find(ev->wd);
+                if (dir == m_directories.end() || !(ev->mask & kWatchMask) || ev->len == 0)
+                    continue;
+                changes.push_back({dir->second, std::filesystem::path(ev->name).wstring(), false});
+            }
+        }
+    }
+
+    int m_fd;      ///< inotify instance
+    int m_stopFd;  ///< eventfd signalled by stop()
+    int m_epollFd;
+    std::mutex m_mutex;
+    std::map<int, std::wstring> m_directories; ///< Watch descriptor to directory
+};
+} // namespace
+
+std::unique_ptr<FileWatchBackend> CreateFileWatchBackend() {
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    int stopFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    int epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (fd < 0 || stopFd < 0 || epollFd < 0) {
+        WriteLog(LogLevel::Error, L"Failed to create file watch descriptors.");
+        for (int d : {epollFd, stopFd, fd}) {
+            if (d >= 0)
+                close(d);
+        }
+        return nullptr;
+    }
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev);
+    ev.data.fd = stopFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, stopFd, &ev);
+    return std::make_unique<InotifyBackend>(fd, stopFd, epollFd);
+}
+
+#endif // !_WIN32
@@ -0,0 +1,282 @@
+#if defined(_WIN32) || defined(UNIT_TEST)
+#include "file_watch_service.h"
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#ifdef UNIT_TEST
+// Use the test-controlled Win32 stubs when running unit tests
+#include "../tests/windows_stub.h"
+#else
+#include <windows.h>
+#endif
+
+#include "handle_guard.h"
+#include "log.h"
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+constexpr DWORD kNotifyFilter = FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE;
+// Only a real storm of changes overflows this; network directories are
+// limited to 64 KiB per read anyway
+constexpr DWORD kBufferSize = 64 * 1024;
+// Wait slots left for directories after the stop and wake events
+constexpr size_t kMaxDirectories = 62;
+constexpr std::chrono::milliseconds kMinBackoff(50);
+constexpr std::chrono::milliseconds kMaxBackoff(1000);
+
+/**
+ * @brief One directory with its own overlapped ReadDirectoryChangesW.
+ *
+ * Reads alternate between two buffers: when one completes, the next read
+ * is posted into the other before the finished batch is parsed, so the
+ * directory always has a read outstanding.
+ */
+struct WatchedDirectory {
+    std::wstring path;
+    HandleGuard handle; ///< Null while waiting to be (re)opened
+    HandleGuard event;  ///< Auto-reset; kept across reopens
+    OVERLAPPED ov{};
+    bool reading = false;
+    bool lost = false; ///< Changes may have been missed while unwatched
+    int current = 0; ///< Buffer the outstanding read fills
+    Clock::time_point retryAt;
+    std::chrono::milliseconds backoff = kMinBackoff;
+    alignas(DWORD) BYTE buffers[2][kBufferSize];
+};
+
+/**
+ * @brief Overlapped ReadDirectoryChangesW on every watched directory.
+ *
+ * Reads are issued, cancelled and completed only on the thread calling
+ * wait(), which picks up additions and removals after the wake event.
+ * A directory that cannot be opened or read is retried with backoff. Once
+ * it is watched again, and whenever its notifications overflow, an
+ * overflow change asks its subscribers to resynchronize from disk.
+ */
+class DirectoryChangesBackend : public FileWatchBackend {
+public:
+    DirectoryChangesBackend(HANDLE stopEvent, HANDLE wakeEvent) : m_stopEvent(stopEvent), m_wakeEvent(wakeEvent) {}
+
+    ~DirectoryChangesBackend() override {
+        for (auto& dir : m_directories)
+            close(*dir);
+    }
+
+    bool addDirectory(const std::wstring& directory) override {
+        auto dir = std::make_unique<WatchedDirectory>();
+        dir->path = directory;
+        dir->event.reset(CreateEventW(NULL, FALSE, FALSE, NULL));
+        if (!dir->event)
+            return false;
+        dir->ov.hEvent = dir->event.get();
+        dir->retryAt = Clock::now();
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_count == kMaxDirectories)
+                return false;
+            ++m_count;
+            m_operations.push_back({std::move(dir), directory});
+        }
+        SetEvent(m_wakeEvent.get());
+        return true;
+    }
+
+    void removeDirectory(const std::wstring& directory) override {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            --m_count;
+            m_operations.push_back({nullptr, directory});
+        }
+        SetEvent(m_wakeEvent.get());
+    }
+
+    WaitResult wait(long long timeoutMs, std::vector<FileWatchChange>& changes) override {
+        applyOperations();
+
+        // Open directories that are due; whatever happened while one was
+        // lost is picked up by a resync
+        bool resync = false;
+        auto now = Clock::now();
+        for (auto& dir : m_directories) {
+            if (!dir->handle && now >= dir->retryAt && open(*dir) && post(*dir) && dir->lost) {
+                WriteLog(LogLevel::Info, L"Watching directory again: " + dir->path);
+                dir->lost = false;
+                changes.push_back({dir->path, std::wstring(), true});
+                resync = true;
+            }
+        }
+        if (resync)
+            return WaitResult::Changes;
+
+        HANDLE handles[2 + kMaxDirectories] = {m_stopEvent.get(), m_wakeEvent.get()};
+        DWORD count = 2;
+        for (auto& dir : m_directories) {
+            if (dir->reading) {
+                handles[count++] = dir->event.get();
+            } else if (!dir->handle) {
+                long long retry = std::max<long long>(
+                    0, std::chrono::ceil<std::chrono::milliseconds>(dir->retryAt - now).count());
+                timeoutMs = timeoutMs < 0 ? retry : std::min(timeoutMs, retry);
+            }
+        }
+
+        DWORD wait = WaitForMultipleObjects(count, handles, FALSE,
+                                            timeoutMs < 0 ? INFINITE : static_cast<DWORD>(timeoutMs));
+        if (wait == WAIT_TIMEOUT)
+            return WaitResult::Timeout;
+        if (wait == WAIT_OBJECT_0)
+            return WaitResult::Stopped;
+        if (wait == WAIT_OBJECT_0 + 1)
+            return WaitResult::Changes; // Directory set changed; rearm
+        if (wait >= WAIT_OBJECT_0 + count)
+            return WaitResult::Failed;
+
+        HANDLE signalled = handles[wait - WAIT_OBJECT_0];
+        for (auto& dir : m_directories) {
+            if (dir->reading && dir->event.get() == signalled) {
+                complete(*dir, changes);
+                break;
+            }
+        }
+        return WaitResult::Changes;
+    }
+
+    void stop() override { SetEvent(m_stopEvent.get()); }
+
+    bool caseInsensitive() const override { return true; }
+
+private:
+    struct Operation {
+        std::unique_ptr<WatchedDirectory> added; ///< Null for a removal
+        std::wstring path;
+    };
+
+    // Apply queued additions and removals in the order they were made
+    void applyOperations() {
+        std::vector<Operation> operations;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            operations.swap(m_operations);
+        }
+        for (auto& op : operations) {
+            if (op.added) {
+                m_directories.push_back(std::move(op.added));
+                continue;
+            }
+            for (auto it = m_directories.begin(); it != m_directories.end(); ++it) {
+                if ((*it)->path == op.path) {
+                    close(**it);
+                    m_directories.erase(it);
+                    break;
+                }
+            }
+        }
+    }
+
+    static bool open(WatchedDirectory& dir) {
+        dir.handle.reset(CreateFileW(dir.path.c_str(), FILE_LIST_DIRECTORY,
+                                     FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING,
+                                     FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, NULL));
+        if (dir.handle)
+            return true;
+        dir.handle.release(); // INVALID_HANDLE_VALUE is not ours to close
+        retryLater(dir, L"Failed to open watched directory: ");
+        return false;
+    }
+
+    // Post the next read into the buffer not holding the last batch
+    static bool post(WatchedDirectory& dir) {
+        DWORD ignored = 0;
+        if (!ReadDirectoryChangesW(dir.handle.get(), dir.buffers[dir.current], kBufferSize, FALSE, kNotifyFilter,
+                                   &ignored, &dir.ov, NULL)) {
+            dir.handle.reset();
+            retryLater(dir, L"ReadDirectoryChangesW failed for ");
+            return false;
+        }
+        dir.reading = true;
+        dir.backoff = kMinBackoff;
+        return true;
+    }
+
+    // Only the first failure is logged; retries stay quiet until one works
+    static void retryLater(WatchedDirectory& dir, const wchar_t* what) {
+        if (!dir.lost)
+            WriteLog(LogLevel::Error, what + dir.path + L"; retrying in the background.");
+        dir.lost = true;
+        dir.retryAt = Clock::now() + dir.backoff;
+        dir.backoff = std::min(dir.backoff * 2, kMaxBackoff);
+    }
+
+    // The outstanding read must finish before its buffer goes away
+    static void close(WatchedDirectory& dir) {
+        if (dir.reading) {
+            CancelIoEx(dir.handle.get(), &dir.ov);
+            WaitForSingleObject(dir.event.get(), INFINITE);
+            dir.reading = false;
+        }
+        dir.handle.reset();
+    }
+
+    static void complete(WatchedDirectory& dir, std::vector<FileWatchChange>& changes) {
+        dir.reading = false;
+        DWORD bytes = 0;
+        if (!GetOverlappedResult(dir.handle.get(), &dir.ov, &bytes, FALSE)) {
+            if (GetLastError() != ERROR_NOTIFY_ENUM_DIR) {
+                // The directory went away or became unreadable
+                dir.handle.reset();
+                retryLater(dir, L"GetOverlappedResult failed for ");
+                return;
+            }
+            bytes = 0;
+        }
+
+        const BYTE* batch = dir.buffers[dir.current];
+        dir.current ^= 1;
+        // No records means the buffer overflowed and any file may have
+        // changed; a failed repost is resynchronized after the reopen
+        if (!post(dir) || bytes == 0) {
+            if (bytes == 0)
+                changes.push_back({dir.path, std::wstring(), true});
+            return;
+        }
+        for (DWORD offset = 0;;) {
+            auto* info = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(batch + offset);
+            changes.push_back({dir.path, std::wstring(info->FileName, info->FileNameLength / sizeof(WCHAR)), false});
+            if (info->NextEntryOffset == 0 || offset + info->NextEntryOffset >= bytes)
+                break;
+            offset += info->NextEntryOffset;
+        }
+    }
+
+    HandleGuard m_stopEvent; ///< Manual-reset; stays signalled after stop()
+    HandleGuard m_wakeEvent; ///< Auto-reset; signalled when directories change
+    std::mutex m_mutex;
+    std::vector<Operation> m_operations;
+    size_t m_count = 0; ///< Directories once every queued operation is applied
+    std::vector<std::unique_ptr<WatchedDirectory>> m_directories; ///< Owned by the waiting thread
+};
+} // namespace
+
+std::unique_ptr<FileWatchBackend> CreateDirectoryChangesBackend() {
+    HandleGuard stopEvent(CreateEventW(NULL, TRUE, FALSE, NULL));
+    HandleGuard wakeEvent(CreateEventW(NULL, FALSE, FALSE, NULL));
+    if (!stopEvent || !wakeEvent) {
+        WriteLog(LogLevel::Error, L"Failed to create file watch events.");
+        return nullptr;
+    }
+    return std::make_unique<DirectoryChangesBackend>(stopEvent.release(), wakeEvent.release());
+}
+
+#ifdef _WIN32
+std::unique_ptr<FileWatchBackend> CreateFileWatchBackend() {
+    return CreateDirectoryChangesBackend();
+}
+#endif
+
+#endif // _WIN32 || UNIT_TEST
@@ -11,6 +11,7 @@
 #include <vector>
 #include <memory>
 #include "configuration.h"
+#include "config_parser.h"
 #include "constants.h"
 #include "log.h"
 #include "winreg_handle.h"
@@ -22,9 +23,19 @@
 #include "hotkey_cli.h"
 #include "cli_utils.h"
 #include "app_state.h"
+#include "shared_state.h"
+#include "config_image.h"
+#include "layout_event_consumer.h"
+#include "layout_pipeline.h"
+#include "latency_stats.h"
+#include "layout_trace.h"
+#include "startup_profile.h"
+#include "startup_scheduler.h"
 
 // Forward declarations
 void ApplyConfig(HWND hwnd);
+void PublishSharedState();
+void PublishConfigImage();
 
 
 HINSTANCE g_hInst = NULL;
@@ -36,17 +47,13 @@ typedef void(*SetLanguageHotKeyEnabledFunc)(bool);
 typedef void(*SetLayoutHotKeyEnabledFunc)(bool);
 typedef bool(*GetLanguageHotKeyEnabledFunc)();
 typedef bool(*GetLayoutHotKeyEnabledFunc)();
-typedef void(*SetDebugLoggingEnabledFunc)(bool);
 typedef BOOL(*InitHookModuleFunc)();
 typedef void(*CleanupHookModuleFunc)();
 
 InstallGlobalHookFunc InstallGlobalHook = NULL;
 UninstallGlobalHookFunc UninstallGlobalHook = NULL;
-SetLanguageHotKeyEnabledFunc SetLanguageHotKeyEnabled = NULL;
-SetLayoutHotKeyEnabledFunc SetLayoutHotKeyEnabled = NULL;
 GetLanguageHotKeyEnabledFunc GetLanguageHotKeyEnabled = NULL;
 GetLayoutHotKeyEnabledFunc GetLayoutHotKeyEnabled = NULL;
-SetDebugLoggingEnabledFunc SetDebugLoggingEnabledPtr = NULL;
 InitHookModuleFunc InitHookModule = NULL;
 CleanupHookModuleFunc CleanupHookModule = NULL;
 
@@ -54,8 +61,126 @@ CleanupHookModuleFunc CleanupHookModule = NULL;
 bool g_cliMode = false;                     // Suppress GUI/tray behavior
 HWND g_hwnd = NULL;                // Handle to our message window
 std::unique_ptr<TrayIcon> g_trayIcon;
-std::wstring g_cliIconPath;       // Command-line override for tray icon
-std::wstring g_cliTrayTooltip;    // Command-line override for tray tooltip
+SharedStatePage g_sharedState;    // State page read by every hooked process
+SharedConfigImage g_configImage;  // Parsed settings read by every hooked process
+LayoutEventConsumer g_layoutEvents; // Changes published by lightweight hooks
+LatencyStats g_latency;           // Layout-switch latency, recorded by hooks and host
+LayoutTraceWriter g_layoutTrace;  // Optional record of handled layout events (LAYOUT_TRACE)
+std::unique_ptr<StartupScheduler> g_startup;    // Startup work, critical and deferred
+std::unique_ptr<ConfigWatcher> g_configWatcher; // Started once startup is done
+bool g_startupReport = false;     // --startup-report: print the phases too
+
+// Threads for critical startup: enough for the independent tasks
+constexpr size_t kStartupThreads = 3;
+// Posted once the message loop runs to start non-critical work
+constexpr UINT WM_STARTUP_DEFERRED = WM_USER + 3;
+// Posted by configuration subscribers, which run on whichever thread
+// reloaded; wParam is the ConfigApply mask to re-apply on the window thread
+constexpr UINT WM_APPLY_CONFIG = WM_USER + 5;
+
+enum ConfigApply : WPARAM {
+    ApplyLog = 1 << 0,
+    ApplyTray = 1 << 1,
+    ApplyHotkeys = 1 << 2,
+    ApplyStartup = 1 << 3,
+    ApplyTrace = 1 << 4,
+};
+
+// The executable is the only writer of the shared state page, so the
+// hotkey flags are published here rather than through the hook DLL
+void PublishLanguageHotKeyEnabled(bool enabled) {
+    g_sharedState.setLanguageHotKeyEnabled(enabled);
+}
+
+void PublishLayoutHotKeyEnabled(bool enabled) {
+    g_sharedState.setLayoutHotKeyEnabled(enabled);
+}
+
+SetLanguageHotKeyEnabledFunc SetLanguageHotKeyEnabled = PublishLanguageHotKeyEnabled;
+SetLayoutHotKeyEnabledFunc SetLayoutHotKeyEnabled = PublishLayoutHotKeyEnabled;
+
+// Mirror runtime settings hooked processes need into the shared state page
+void PublishSharedState() {
+    auto& state = GetAppState();
+    g_sharedState.update([&](SharedStateSnapshot& s) {
+        s.debugEnabled = state.debugEnabled.load();
+        s.logLevel = g_logLevel.load();
+    });
+}
+
+// Publish the effective configuration so hooked processes need no file I/O
+void PublishConfigImage() {
+    if (!g_configImage.isOpen())
+        return;
+    uint32_t generation = g_configImage.publish(g_config.snapshot()->values());
+    if (generation == 0) {
+        WriteLog(LogLevel::Error, L"Configuration too large for the shared image.");
+        return;
+    }
+    g_sharedState.update([&](SharedStateSnapshot& s) { s.configGeneration = generation; });
+}
+
+// Resolve and persist a change reported by a hook running in light mode
+void HandleLayoutEvent(const LayoutEvent& event) {
+    LayoutNames names = GetLayoutNames(event.hkl);
+    std::wstring localeID = names.localeID;
+    std::wstring klid = names.klid;
+    LayoutTimeline timeline{&g_latency, event.timestampNs};
+    timeline.mark(LatencyStage::Dequeued);
+    std::wstringstream ss;
+    ss << L"Keyboard layout changed. Locale ID: " << localeID << L", KLID: " << klid
+       << L" (event " << event.sequence << L", pid " << event.pid << L")";
+    // Timed entry: LogPersisted is recorded once the line reaches the file
+    g_log.write(LogLevel::Info, ss.str(), event.timestampNs);
+
+    LayoutTraceRecord record;
+    record.timestampNs = event.timestampNs;
+    record.hkl = event.hkl;
+    record.pid = event.pid;
+    record.sequence = event.sequence;
+    record.klid = static_cast<uint32_t>(std::wcstoul(names.klid, nullptr, 16));
+    record.langId = static_cast<uint16_t>(std::wcstoul(names.localeID, nullptr, 16));
+
+    SharedStateSnapshot state = g_sharedState.read();
+    if (!state.languageHotKeyEnabled && !state.layoutHotKeyEnabled) {
+        WriteLog(LogLevel::Warn, L"HotKeys are disabled. Skipping registry update.");
+        record.flags = LayoutTraceRecord::kSkipped;
+    } else {
+        record.writes = static_cast<uint8_t>(SetDefaultInputMethodInRegistry(
+            localeID, klid, [](LogLevel level, const std::wstring& message) { WriteLog(level, message); },
+            timeline));
+    }
+    if (g_layoutTrace.isOpen())
+        g_layoutTrace.append(record);
+}
+
+// Write the layout-switch latency percentiles to the log
+void LogLatencyReport() {
+    if (!g_latency.isOpen()) {
+        WriteLog(LogLevel::Warn, L"Latency statistics are not available.");
+        return;
+    }
+    WriteLog(LogLevel::Info, L"Layout switch latency:\n" + g_latency.report());
+}
+
+// Log how long each startup phase took; with --startup-report also print
+// the table to the console
+void ReportStartupProfile(bool toConsole) {
+    StartupProfile& profile = GetStartupProfile();
+    profile.finish();
+    std::wstring report = profile.report();
+    WriteLog(LogLevel::Info, L"Startup phases:\n" + report);
+    if (toConsole && (g_cliMode || AttachConsole(ATTACH_PARENT_PROCESS))) {
+        FILE* fp = _wfopen(L"CONOUT$", L"w");
+        if (fp) {
+            fwprintf(fp, L"%s", report.c_str());
+            fclose(fp);
+        }
+        if (!g_cliMode)
+            FreeConsole();
+    }
+}
+
 // Retrieve version information from the executable's version resource
 std::wstring GetVersionString() {
     wchar_t path[MAX_PATH] = {0};
@@ -85,35 +210,22 @@ std::wstring GetVersionString() {
     return ver;
 }
 
-// Apply configuration values to runtime settings
-void ApplyConfig(HWND hwnd) {
-    auto levelVal = g_config.get(L"log_level");
-    if (levelVal) {
-        std::wstring lvl = *levelVal;
-        std::transform(lvl.begin(), lvl.end(), lvl.begin(), ::towlower);
-        if (lvl == L"warn")
-            g_logLevel.store(LogLevel::Warn);
-        else if (lvl == L"error")
-            g_logLevel.store(LogLevel::Error);
-        else
-            g_logLevel.store(LogLevel::Info);
-    } else {
-        g_logLevel.store(LogLevel::Info);
-    }
+// Level and debug output for this process's own log
+void ConfigureLog(const ConfigSettings& settings) {
+    g_logLevel.store(settings.logLevel);
+    GetAppState().debugEnabled.store(settings.debug);
+}
 
-    auto debugVal = g_config.get(L"debug");
-    auto& state = GetAppState();
-    bool newDebug = (debugVal && *debugVal == L"1");
-if (newDebug != state.debugEnabled.load()) {
-        state.debugEnabled.store(newDebug);
-        if (SetDebugLoggingEnabledPtr)
-            SetDebugLoggingEnabledPtr(state.debugEnabled.load());
-    }
+// Logging settings, mirrored to hooked processes
+void ApplyLogSettings(const ConfigSettings& settings) {
+    ConfigureLog(settings);
+    PublishSharedState();
+}
 
-    bool tray = true;
-    auto trayVal = g_config.get(L"tray_icon");
-    if (trayVal)
-        tray = *trayVal != L"0";
+// Create, remove or refresh the tray icon
+void ApplyTraySettings(HWND hwnd, const ConfigSettings& settings) {
+    auto& state = GetAppState();
+    bool tray = settings.trayIcon;
     if (tray != state.trayIconEnabled.load()) {
         state.trayIconEnabled.store(tray);
         if (tray) {
@@ -127,10 +239,8 @@ if (newDebug != state.debugEnabled.load()) {
     }
 
     // Update tray icon resources if icon path or tooltip changed
-    auto iconVal = g_config.get(L"icon_path");
-    auto tipVal = g_config.get(L"tray_tooltip");
-    std::wstring newIcon = iconVal ? *iconVal : L"";
-    std::wstring newTip = tipVal ? *tipVal : L"";
+    const std::wstring& newIcon = settings.iconPath;
+    const std::wstring& newTip = settings.trayTooltip;
     static std::wstring lastIcon;
     static std::wstring lastTip;
     if (newIcon != lastIcon || newTip != lastTip) {
@@ -140,15 +250,12 @@ if (newDebug != state.debugEnabled.load()) {
         lastIcon = newIcon;
         lastTip = newTip;
     }
+}
 
-    auto timeoutVal = g_config.get(L"temp_hotkey_timeout");
-    if (timeoutVal) {
-        GetAppState().tempHotKeyTimeout.store(
-            std::wcstoul(timeoutVal->c_str(), nullptr, 10));
-    }
-
-    if (auto startupVal = g_config.get(L"startup")) {
-        bool desired = *startupVal != L"0";
+// Registry-backed startup entry
+void ApplyStartupSetting(const ConfigSettings& settings) {
+    if (settings.has(ConfigKey::Startup)) {
+        bool desired = settings.startup;
         if (desired != GetAppState().startupEnabled.load()) {
             if (desired)
                 AddToStartup();
@@ -156,20 +263,87 @@ if (newDebug != state.debugEnabled.load()) {
                 RemoveFromStartup();
         }
     }
+}
 
-    if (auto langVal = g_config.get(L"language_hotkey")) {
-        bool desired = *langVal != L"0";
+// Language and layout switching hotkeys
+void ApplyHotkeySettings(HWND hwnd, const ConfigSettings& settings) {
+    if (settings.has(ConfigKey::TempHotkeyTimeout))
+        GetAppState().tempHotKeyTimeout.store(settings.tempHotkeyTimeout);
+
+    if (settings.has(ConfigKey::LanguageHotkey)) {
+        bool desired = settings.languageHotkey;
         if (desired != GetAppState().languageHotKeyEnabled.load())
             ToggleLanguageHotKey(hwnd, true, desired);
     }
 
-    if (auto layoutVal = g_config.get(L"layout_hotkey")) {
-        bool desired = *layoutVal != L"0";
+    if (settings.has(ConfigKey::LayoutHotkey)) {
+        bool desired = settings.layoutHotkey;
         if (desired != GetAppState().layoutHotKeyEnabled.load())
             ToggleLayoutHotKey(hwnd, true, desired);
     }
 }
 
+// Start, switch or stop recording handled layout events
+void ApplyLayoutTrace(const ConfigSettings& settings) {
+    const std::wstring& tracePath = settings.layoutTrace;
+    if (tracePath != g_layoutTrace.path()) {
+        g_layoutTrace.close();
+        if (!tracePath.empty() && !g_layoutTrace.open(tracePath))
+            WriteLog(LogLevel::Error, L"Failed to open layout trace: " + tracePath);
+    }
+}
+
+// Apply every configuration value to runtime settings
+void ApplyConfig(HWND hwnd) {
+    ConfigSnapshotPtr config = g_config.snapshot();
+    const ConfigSettings& settings = config->settings();
+    ApplyLogSettings(settings);
+    ApplyTraySettings(hwnd, settings);
+    ApplyHotkeySettings(hwnd, settings);
+    ApplyStartupSetting(settings);
+    ApplyLayoutTrace(settings);
+    PublishConfigImage();
+}
+
+// Re-apply the groups in a ConfigApply mask from the current settings.
+// Runs on the window thread, which owns the tray and the hotkey state.
+void ApplyConfigChanges(HWND hwnd, WPARAM what) {
+    ConfigSnapshotPtr config = g_config.snapshot();
+    const ConfigSettings& settings = config->settings();
+    if (what & ApplyLog)
+        ApplyLogSettings(settings);
+    if (what & ApplyTray)
+        ApplyTraySettings(hwnd, settings);
+    if (what & ApplyHotkeys)
+        ApplyHotkeySettings(hwnd, settings);
+    if (what & ApplyStartup)
+        ApplyStartupSetting(settings);
+    if (what & ApplyTrace)
+        ApplyLayoutTrace(settings);
+}
+
+// Re-apply only the settings a reload changed. Returns the subscription ids.
+// Reloads run on the file watch and startup threads, so everything but the
+// shared image is handed to the window thread.
+std::vector<uint64_t> SubscribeConfigHandlers(HWND hwnd) {
+    auto name = [](ConfigKey key) { return std::wstring(GetConfigKeyInfo(key).name); };
+    auto post = [hwnd](ConfigApply what) {
+        return [hwnd, what](const ConfigDiff&) { PostMessage(hwnd, WM_APPLY_CONFIG, what, 0); };
+    };
+    std::vector<uint64_t> ids;
+    for (ConfigKey key : {ConfigKey::LogLevel, ConfigKey::Debug})
+        ids.push_back(g_config.subscribe(name(key), post(ApplyLog)));
+    for (ConfigKey key : {ConfigKey::TrayIcon, ConfigKey::IconPath, ConfigKey::TrayTooltip})
+        ids.push_back(g_config.subscribe(name(key), post(ApplyTray)));
+    for (ConfigKey key : {ConfigKey::TempHotkeyTimeout, ConfigKey::LanguageHotkey, ConfigKey::LayoutHotkey})
+        ids.push_back(g_config.subscribe(name(key), post(ApplyHotkeys)));
+    ids.push_back(g_config.subscribe(name(ConfigKey::Startup), post(ApplyStartup)));
+    ids.push_back(g_config.subscribe(name(ConfigKey::LayoutTrace), post(ApplyTrace)));
+    // Hooked processes read every key from the shared image
+    ids.push_back(g_config.subscribePrefix(L"", [](const ConfigDiff&) { PublishConfigImage(); }));
+    return ids;
+}
+
 LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam) {
     switch (uMsg) {
         case WM_TRAYICON:
@@ -186,6 +360,21 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
         case WM_UPDATE_TRAY_MENU:
             ShowTrayMenu(hwnd);
             break;
+        case WM_TRAY_ICON_CHANGED:
+            if (g_trayIcon)
+                g_trayIcon->ReloadIcon();
+            break;
+        case WM_APPLY_CONFIG:
+            ApplyConfigChanges(hwnd, wParam);
+            break;
+        case WM_STARTUP_DEFERRED: {
+            // Reloads may touch the tray, so it exists before the watcher
+            ScopedStartupPhase trayPhase(L"create tray icon");
+            ApplyTraySettings(hwnd, g_config.snapshot()->settings());
+            trayPhase.end();
+            g_startup->runDeferred(1, [] { ReportStartupProfile(g_startupReport); });
+            break;
+        }
         case WM_DESTROY:
             PostQuitMessage(0);
             return 0;
@@ -200,10 +389,13 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
  */
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int nCmdShow) {
     g_hInst = hInstance;
+    GetStartupProfile(); // Phases are timed from here
 
+    ScopedStartupPhase argumentsPhase(L"parse arguments");
     int argc = 0;
     LPWSTR* argv = CommandLineToArgvW(GetCommandLineW(), &argc);
     std::wstring customConfigPath;
+    bool oneShot = false; // Prints something and exits: no hook needed
     if (argv) {
         for (int i = 1; i < argc; ++i) {
             if (wcscmp(argv[i], L"--config") == 0 && i + 1 < argc) {
@@ -211,11 +403,18 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
                 ++i;
             } else if (wcscmp(argv[i], L"--cli") == 0 || wcscmp(argv[i], L"--cli-mode") == 0) {
                 g_cliMode = true;
+            } else if (wcscmp(argv[i], L"--startup-report") == 0) {
+                g_startupReport = true;
+            } else if (wcscmp(argv[i], L"--version") == 0 || wcscmp(argv[i], L"--status") == 0 ||
+                       wcscmp(argv[i], L"--help") == 0) {
+                oneShot = true;
             }
         }
     }
+    argumentsPhase.end();
 
     // Create a named mutex to ensure a single instance
+    ScopedStartupPhase mutexPhase(L"single instance check");
     g_hInstanceMutex.reset(CreateMutex(NULL, TRUE, L"InputMethodMonitorSingleton"));
     if (g_hInstanceMutex && GetLastError() == ERROR_ALREADY_EXISTS) {
         WriteLog(LogLevel::Error, L"Another instance is already running.");
@@ -234,12 +433,88 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
         g_hInstanceMutex.reset();
         return 0;
     }
+    mutexPhase.end();
+
+    // Independent initialization runs concurrently. The hook DLL maps the
+    // shared sections while loading, and applying the configuration
+    // publishes the image it reads, so both wait for the mapping.
+    // Mapping failures are logged once the configuration has set up the log.
+    g_startup = std::make_unique<StartupScheduler>();
+    std::vector<const wchar_t*> mappingFailures;
+    auto sharedMemory = g_startup->add(L"map shared memory", [&mappingFailures] {
+        if (!g_sharedState.openForPublish())
+            mappingFailures.push_back(L"Failed to map shared state page.");
+        if (!g_configImage.openForPublish())
+            mappingFailures.push_back(L"Failed to map shared configuration image.");
+        if (!g_layoutEvents.start(HandleLayoutEvent))
+            mappingFailures.push_back(L"Failed to map layout event ring.");
+        if (g_latency.open())
+            g_log.setPersistedCallback([](uint64_t originNs) {
+                g_latency.recordSince(LatencyStage::LogPersisted, originNs);
+            });
+        else
+            mappingFailures.push_back(L"Failed to map latency statistics.");
+    });
+
+    // Reloads expand variables as the process saw them at startup
+    auto configuration = g_startup->add(L"load configuration", [&customConfigPath] {
+        g_config.setEnvironment(EnvironmentSnapshot::Capture());
+        g_config.loadLayer(ConfigLayer::Machine);
+        g_config.load(customConfigPath);
+    });
+
+    // Level and debug flag first so the registry queries below are logged;
+    // hooked processes get them when the configuration is applied
+    auto logging = g_startup->add(L"configure log", [] {
+        ConfigureLog(g_config.snapshot()->settings());
+    }, {configuration});
+
+    // Startup entry and hotkey state, needed by the hook and the settings
+    auto registry = g_startup->add(L"query registry", [] {
+        GetAppState().startupEnabled.store(IsStartupEnabled());
+        GetAppState().languageHotKeyEnabled.store(IsLanguageHotKeyEnabled());
+        GetAppState().layoutHotKeyEnabled.store(IsLayoutHotKeyEnabled());
+    }, {logging});
+
+    // Failures are logged once the configuration has set up the log
+    const wchar_t* hookFailure = nullptr;
+    DWORD hookError = ERROR_SUCCESS;
+    auto hookLibrary = g_startup->add(L"load hook DLL", [&] {
+        if (oneShot)
+            return;
+        g_hDll = LoadLibrary(L"kbdlayoutmonhook.dll");
+        if (g_hDll == NULL) {
+            hookError = GetLastError();
+            hookFailure = L"Failed to load kbdlayoutmonhook.dll.";
+            return;
+        }
 
-    // Load configuration before any logging occurs
-    g_config.load(customConfigPath);
-    ApplyConfig(NULL);
+        InstallGlobalHook = (InstallGlobalHookFunc)GetProcAddress(g_hDll, "InstallGlobalHook");
+        UninstallGlobalHook = (UninstallGlobalHookFunc)GetProcAddress(g_hDll, "UninstallGlobalHook");
+        GetLanguageHotKeyEnabled = (GetLanguageHotKeyEnabledFunc)GetProcAddress(g_hDll, "GetLanguageHotKeyEnabled");
+        GetLayoutHotKeyEnabled = (GetLayoutHotKeyEnabledFunc)GetProcAddress(g_hDll, "GetLayoutHotKeyEnabled");
+        InitHookModule = (InitHookModuleFunc)GetProcAddress(g_hDll, "InitHookModule");
+        CleanupHookModule = (CleanupHookModuleFunc)GetProcAddress(g_hDll, "CleanupHookModule");
 
-    // Parse command line options after the config file so they override
+        if (!InstallGlobalHook || !UninstallGlobalHook || !GetLanguageHotKeyEnabled || !GetLayoutHotKeyEnabled ||
+            !InitHookModule || !CleanupHookModule) {
+            hookError = GetLastError();
+            hookFailure = L"Failed to get function addresses from kbdlayoutmonhook.dll.";
+            FreeLibrary(g_hDll);
+            g_hDll = NULL;
+        }
+    }, {sharedMemory});
+
+    // Needs every input above; this also configures the log
+    g_startup->add(L"apply configuration", [] { ApplyConfig(NULL); },
+                   {configuration, registry, hookLibrary});
+    g_startup->run(kStartupThreads);
+    for (const wchar_t* failure : mappingFailures)
+        WriteLog(LogLevel::Error, failure);
+
+    // Command line options go to their own layer, above both files, so
+    // they survive reloads
+    ScopedStartupPhase optionsPhase(L"apply command line options");
     if (argv) {
         for (int i = 1; i < argc; ++i) {
             if (wcscmp(argv[i], L"--config") == 0 && i + 1 < argc) {
@@ -247,32 +522,30 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
             } else if (wcscmp(argv[i], L"--no-tray") == 0) {
                 GetAppState().trayIconEnabled.store(false);
             } else if (wcscmp(argv[i], L"--tray-icon") == 0 && i + 1 < argc) {
-                g_config.set(L"tray_icon", argv[i + 1]);
+                g_config.set(L"tray_icon", argv[i + 1], ConfigLayer::CommandLine);
                 GetAppState().trayIconEnabled.store(wcscmp(argv[i + 1], L"0") != 0);
                 ++i;
             } else if (wcscmp(argv[i], L"--temp-hotkey-timeout") == 0 && i + 1 < argc) {
-                g_config.set(L"temp_hotkey_timeout", argv[i + 1]);
+                g_config.set(L"temp_hotkey_timeout", argv[i + 1], ConfigLayer::CommandLine);
                 GetAppState().tempHotKeyTimeout.store(std::wcstoul(argv[i + 1], nullptr, 10));
                 ++i;
             } else if (wcscmp(argv[i], L"--log-path") == 0 && i + 1 < argc) {
-                g_config.set(L"log_path", argv[i + 1]);
+                g_config.set(L"log_path", argv[i + 1], ConfigLayer::CommandLine);
                 ++i;
             } else if (wcscmp(argv[i], L"--log-level") == 0 && i + 1 < argc) {
-                g_config.set(L"log_level", argv[i + 1]);
+                g_config.set(L"log_level", argv[i + 1], ConfigLayer::CommandLine);
                 ++i;
             } else if (wcscmp(argv[i], L"--icon-path") == 0 && i + 1 < argc) {
-                g_config.set(L"icon_path", argv[i + 1]);
-                g_cliIconPath = argv[i + 1];
+                g_config.set(L"icon_path", argv[i + 1], ConfigLayer::CommandLine);
                 ++i;
             } else if (wcscmp(argv[i], L"--tray-tooltip") == 0 && i + 1 < argc) {
-                g_config.set(L"tray_tooltip", argv[i + 1]);
-                g_cliTrayTooltip = argv[i + 1];
+                g_config.set(L"tray_tooltip", argv[i + 1], ConfigLayer::CommandLine);
                 ++i;
             } else if (wcscmp(argv[i], L"--max-log-size-mb") == 0 && i + 1 < argc) {
-                g_config.set(L"max_log_size_mb", argv[i + 1]);
+                g_config.set(L"max_log_size_mb", argv[i + 1], ConfigLayer::CommandLine);
                 ++i;
             } else if (wcscmp(argv[i], L"--max-queue-size") == 0 && i + 1 < argc) {
-                g_config.set(L"max_queue_size", argv[i + 1]);
+                g_config.set(L"max_queue_size", argv[i + 1], ConfigLayer::CommandLine);
                 ++i;
             } else if (wcscmp(argv[i], L"--enable-startup") == 0) {
                 AddToStartup();
@@ -283,6 +556,8 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
             } else if (wcscmp(argv[i], L"--cli") == 0 || wcscmp(argv[i], L"--cli-mode") == 0) {
                 g_cliMode = true;
                 GetAppState().trayIconEnabled.store(false);
+            } else if (wcscmp(argv[i], L"--startup-report") == 0) {
+                // Handled in the first pass
             } else if (wcscmp(argv[i], L"--verbose") == 0) {
                 g_verboseLogging = true;
                 if (!GetAppState().debugEnabled.load()) {
@@ -364,6 +639,8 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
             } else {
                 WarnUnrecognizedOption(argv[i]);
                 LocalFree(argv);
+                if (g_hDll)
+                    FreeLibrary(g_hDll);
                 if (g_hInstanceMutex) {
                     ReleaseMutex(g_hInstanceMutex.get());
                     g_hInstanceMutex.reset();
@@ -372,27 +649,62 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
             }
         }
         ApplyConfig(NULL);
-        if (auto qval = g_config.get(L"max_queue_size")) {
-            try {
-                g_log.setMaxQueueSize(std::stoul(*qval));
-            } catch (...) {
-            }
-        }
+        ConfigSnapshotPtr config = g_config.snapshot();
+        if (config->settings().has(ConfigKey::MaxQueueSize))
+            g_log.setMaxQueueSize(config->settings().maxQueueSize);
         LocalFree(argv);
     }
+    optionsPhase.end();
 
     WriteLog(LogLevel::Info, L"Executable started.");
 
-    // Check if the app is set to launch at startup
-    GetAppState().startupEnabled.store(IsStartupEnabled());
+    // The hook goes in before the window and tray: nothing it does needs them
+    if (g_hDll == NULL) {
+        std::wstringstream ss;
+        ss << hookFailure << L" Error code: 0x" << std::hex << hookError;
+        WriteLog(LogLevel::Error, ss.str());
+        if (g_hInstanceMutex) {
+            ReleaseMutex(g_hInstanceMutex.get());
+            g_hInstanceMutex.reset();
+        }
+        return 1;
+    }
+
+    // Initialize the hook module now that it's loaded
+    ScopedStartupPhase initPhase(L"initialize hook module");
+    if (!InitHookModule()) {
+        WriteLog(LogLevel::Error, L"Failed to initialize hook module.");
+        CleanupHookModule();
+        FreeLibrary(g_hDll);
+        if (g_hInstanceMutex) {
+            ReleaseMutex(g_hInstanceMutex.get());
+            g_hInstanceMutex.reset();
+        }
+        return 1;
+    }
 
-    // Check if Language HotKey is enabled
-    GetAppState().languageHotKeyEnabled.store(IsLanguageHotKeyEnabled());
+    initPhase.end();
 
-    // Check if Layout HotKey is enabled
-    GetAppState().layoutHotKeyEnabled.store(IsLayoutHotKeyEnabled());
+    ScopedStartupPhase installPhase(L"install global hook");
+    if (!InstallGlobalHook()) {
+        WriteLog(LogLevel::Error, L"Failed to install global hook.");
+        CleanupHookModule();
+        FreeLibrary(g_hDll);
+        if (g_hInstanceMutex) {
+            ReleaseMutex(g_hInstanceMutex.get());
+            g_hInstanceMutex.reset();
+        }
+        return 1;
+    }
+
+    // Update the shared memory values at startup
+    SetLanguageHotKeyEnabled(GetAppState().languageHotKeyEnabled.load());
+    SetLayoutHotKeyEnabled(GetAppState().layoutHotKeyEnabled.load());
+    PublishSharedState();
+    installPhase.end();
 
     // Register the window class
+    ScopedStartupPhase windowPhase(L"create message window");
     const wchar_t CLASS_NAME[] = L"TrayIconWindowClass";
     WNDCLASS wc = {};
     wc.lpfnWndProc = WindowProc;
@@ -404,6 +716,9 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
         std::wstringstream ss;
         ss << L"Failed to register window class. Error code: 0x" << std::hex << errorCode;
         WriteLog(LogLevel::Error, ss.str());
+        UninstallGlobalHook();
+        CleanupHookModule();
+        FreeLibrary(g_hDll);
         if (g_hInstanceMutex) {
             ReleaseMutex(g_hInstanceMutex.get());
             g_hInstanceMutex.reset();
@@ -429,6 +744,9 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
         std::wstringstream ss;
         ss << L"Failed to create message-only window. Error code: 0x" << std::hex << errorCode;
         WriteLog(LogLevel::Error, ss.str());
+        UninstallGlobalHook();
+        CleanupHookModule();
+        FreeLibrary(g_hDll);
         if (g_hInstanceMutex) {
             ReleaseMutex(g_hInstanceMutex.get());
             g_hInstanceMutex.reset();
@@ -437,98 +755,47 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
     }
 
     g_hwnd = hwnd;
+    windowPhase.end();
 
     // Ensure tray icon is cleaned up on any exit path
     struct TrayIconGuard {
         ~TrayIconGuard() { g_trayIcon.reset(); }
     } trayGuard;
 
-    // Initialize tray icon based on current configuration
-    ApplyConfig(hwnd);
-
-    MSG msg;
-    {
-        ConfigWatcher configWatcher(hwnd);
-
-        // Load the DLL
-        g_hDll = LoadLibrary(L"kbdlayoutmonhook.dll");
-        if (g_hDll == NULL) {
-            DWORD errorCode = GetLastError();
-            std::wstringstream ss;
-            ss << L"Failed to load kbdlayoutmonhook.dll. Error code: 0x" << std::hex << errorCode;
-            WriteLog(LogLevel::Error, ss.str());
-            if (g_hInstanceMutex) {
-                ReleaseMutex(g_hInstanceMutex.get());
-                g_hInstanceMutex.reset();
-            }
-            return 1;
+    // Later reloads only touch the subsystems whose keys changed
+    struct ConfigHandlersGuard {
+        std::vector<uint64_t> ids;
+        ~ConfigHandlersGuard() {
+            for (uint64_t id : ids)
+                g_config.unsubscribe(id);
         }
+    } configHandlers{SubscribeConfigHandlers(hwnd)};
 
-    InstallGlobalHook = (InstallGlobalHookFunc)GetProcAddress(g_hDll, "InstallGlobalHook");
-    UninstallGlobalHook = (UninstallGlobalHookFunc)GetProcAddress(g_hDll, "UninstallGlobalHook");
-    SetLanguageHotKeyEnabled = (SetLanguageHotKeyEnabledFunc)GetProcAddress(g_hDll, "SetLanguageHotKeyEnabled");
-    SetLayoutHotKeyEnabled = (SetLayoutHotKeyEnabledFunc)GetProcAddress(g_hDll, "SetLayoutHotKeyEnabled");
-    GetLanguageHotKeyEnabled = (GetLanguageHotKeyEnabledFunc)GetProcAddress(g_hDll, "GetLanguageHotKeyEnabled");
-    GetLayoutHotKeyEnabled = (GetLayoutHotKeyEnabledFunc)GetProcAddress(g_hDll, "GetLayoutHotKeyEnabled");
-    SetDebugLoggingEnabledPtr = (SetDebugLoggingEnabledFunc)GetProcAddress(g_hDll, "SetDebugLoggingEnabled");
-    InitHookModule = (InitHookModuleFunc)GetProcAddress(g_hDll, "InitHookModule");
-    CleanupHookModule = (CleanupHookModuleFunc)GetProcAddress(g_hDll, "CleanupHookModule");
-
-    if (!InstallGlobalHook || !UninstallGlobalHook || !SetLanguageHotKeyEnabled || !SetLayoutHotKeyEnabled ||
-            !GetLanguageHotKeyEnabled || !GetLayoutHotKeyEnabled || !SetDebugLoggingEnabledPtr ||
-            !InitHookModule || !CleanupHookModule) {
-            DWORD errorCode = GetLastError();
-            std::wstringstream ss;
-            ss << L"Failed to get function addresses from kbdlayoutmonhook.dll. Error code: 0x" << std::hex << errorCode;
-            WriteLog(LogLevel::Error, ss.str());
-            FreeLibrary(g_hDll);
-            if (g_hInstanceMutex) {
-                ReleaseMutex(g_hInstanceMutex.get());
-                g_hInstanceMutex.reset();
-            }
-            return 1;
-        }
+    // Watch for edits in the background once the tray exists; whatever
+    // changed before the watch began is picked up by a resync. Both only
+    // read files here: what a reload changes is applied on this thread.
+    auto watcher = g_startup->defer(L"start config watcher", [hwnd] {
+        g_configWatcher = std::make_unique<ConfigWatcher>(hwnd);
+    });
+    g_startup->defer(L"resync configuration", [] {
+        g_config.loadLayers({ConfigLayer::Machine, ConfigLayer::User});
+    }, {watcher});
 
-    // Initialize the hook module now that it's loaded
-        if (!InitHookModule()) {
-            WriteLog(LogLevel::Error, L"Failed to initialize hook module.");
-            CleanupHookModule();
-            FreeLibrary(g_hDll);
-            if (g_hInstanceMutex) {
-                ReleaseMutex(g_hInstanceMutex.get());
-                g_hInstanceMutex.reset();
-            }
-            return 1;
-        }
-
-    // Propagate current debug logging state to the DLL
-    if (SetDebugLoggingEnabledPtr)
-        SetDebugLoggingEnabledPtr(GetAppState().debugEnabled.load());
-
-        if (!InstallGlobalHook()) {
-            WriteLog(LogLevel::Error, L"Failed to install global hook.");
-            CleanupHookModule();
-            FreeLibrary(g_hDll);
-            if (g_hInstanceMutex) {
-                ReleaseMutex(g_hInstanceMutex.get());
-                g_hInstanceMutex.reset();
-            }
-            return 1;
-        }
+    // The tray icon and the rest wait until messages are being handled
+    PostMessage(hwnd, WM_STARTUP_DEFERRED, 0, 0);
 
-    // Update the shared memory values at startup
-    SetLanguageHotKeyEnabled(GetAppState().languageHotKeyEnabled.load());
-    SetLayoutHotKeyEnabled(GetAppState().layoutHotKeyEnabled.load());
-
-        while (GetMessage(&msg, NULL, 0, 0)) {
-            TranslateMessage(&msg);
-            DispatchMessage(&msg);
-        }
+    MSG msg;
+    while (GetMessage(&msg, NULL, 0, 0)) {
+        TranslateMessage(&msg);
+        DispatchMessage(&msg);
     }
 
+    g_startup->wait();
+    g_configWatcher.reset();
     UninstallGlobalHook();
     CleanupHookModule();
     FreeLibrary(g_hDll);
+    g_layoutEvents.stop();
     if (g_hInstanceMutex) {
         ReleaseMutex(g_hInstanceMutex.get());
         g_hInstanceMutex.reset();
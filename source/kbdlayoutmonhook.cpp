@@ -11,34 +11,45 @@
 #include <thread>
 #include <condition_variable>
 #include <queue>
-#include "configuration.h"
 #include "winreg_handle.h"
 #include "handle_guard.h"
+#include "log_level.h"
+#include "shared_state.h"
+#include "config_image.h"
+#include "layout_event_ring.h"
+#include "layout_pipeline.h"
+#include "latency_stats.h"
 
-std::atomic<bool> g_debugEnabled{false};
 HINSTANCE g_hInst = NULL;
 HHOOK g_hHook = NULL;
 
-#pragma data_seg(".shared")
-HKL g_lastHKL = NULL; // Declare g_lastHKL in the shared memory segment
-LONG g_refCount = 0;
-std::atomic<bool> g_languageHotKeyEnabled{false}; // Shared variable for Language HotKey status
-std::atomic<bool> g_layoutHotKeyEnabled{false}; // Shared variable for Layout HotKey status
-#pragma data_seg()
-#pragma comment(linker, "/SECTION:.shared,RWS")
+// State shared with the executable and every other process hosting the hook.
+SharedStatePage g_sharedState;
+// Effective configuration published by the executable, read in place so
+// hooked processes never open or parse the configuration file.
+SharedConfigImage g_configImage;
+std::atomic<uint32_t> g_configGeneration{0};
+// hook_mode=light: ShellProc only publishes events for the host to handle.
+std::atomic<bool> g_lightweightMode{false};
+LayoutEventRing g_eventRing;
+HandleGuard g_eventsReady;
+std::once_flag g_eventRingOnce;
+// Layout-switch latency histograms shared with the executable.
+LatencyStats g_latency;
 
-HandleGuard g_hMutex;
 HandleGuard g_logPipe;
 std::mutex g_pipeMutex;
 
 std::thread g_workerThread;
 std::mutex g_queueMutex;
 std::condition_variable g_queueCV;
-std::queue<std::pair<std::wstring, std::wstring>> g_taskQueue;
+struct LayoutTask {
+    LayoutNames names;
+    uint64_t sourceNs;
+};
+std::queue<LayoutTask> g_taskQueue;
 std::atomic<bool> g_workerRunning{false};
 
-enum class LogLevel { Info, Warn, Error };
-
 void IncrementRefCount();
 void DecrementRefCount();
 
@@ -67,103 +78,49 @@ static const wchar_t* LevelPrefix(LogLevel level) {
     }
 }
 
+// Whether the host would record an entry of @p level; checked before
+// building messages so the hot path formats nothing when logging is off.
+static bool LogEnabled(LogLevel level) {
+    return g_sharedState.read().logs(level);
+}
+
 static void WriteLog(LogLevel level, const std::wstring& message) {
+    // Skip the pipe round trip when the host would discard the entry anyway.
+    if (!LogEnabled(level))
+        return;
     std::wstring formatted = std::wstring(L"[") + LevelPrefix(level) + L"] " + message;
     PipeWrite(formatted);
 }
 
-
-// Function to get the KLID in the format "00000409"
-std::wstring GetKLID(HKL hkl) {
-    wchar_t klid[KL_NAMELENGTH];
-    if (GetKeyboardLayoutName(klid)) {
-        return std::wstring(klid);
+// Re-read the settings the hook uses when the host published a new image.
+static void RefreshHookConfig() {
+    if (!g_configImage.isOpen() && !g_configImage.openForRead())
+        return;
+    uint32_t generation = g_configImage.generation();
+    while (generation != g_configGeneration.load(std::memory_order_relaxed)) {
+        ConfigImageView view = g_configImage.current();
+        auto modeVal = view.get(L"hook_mode");
+        bool lightweight = modeVal && *modeVal == L"light";
+        // A publish while reading may have reused the slot; retry on the
+        // newer generation so the final state is never missed.
+        uint32_t after = g_configImage.generation();
+        if (after == generation) {
+            g_lightweightMode.store(lightweight);
+            g_configGeneration.store(generation, std::memory_order_relaxed);
+        }
+        generation = after;
     }
-    return L"Unknown";
 }
 
-// Function to get the locale ID in the format "0409"
-std::wstring GetLocaleID(HKL hkl) {
-    LANGID langID = LOWORD(hkl);
-    std::wstringstream ss;
-    ss << std::setw(4) << std::setfill(L'0') << std::hex << langID;
-    return ss.str();
-}
-
-// Function to set the default input method in the registry
-void SetDefaultInputMethodInRegistry(const std::wstring& localeID, const std::wstring& klid) {
-    if (!g_languageHotKeyEnabled.load() && !g_layoutHotKeyEnabled.load()) {
+// Persist a layout change unless both Windows hotkeys are disabled
+static void PersistLayout(const std::wstring& localeID, const std::wstring& klid,
+                          const LayoutTimeline& timeline) {
+    SharedStateSnapshot state = g_sharedState.read();
+    if (!state.languageHotKeyEnabled && !state.layoutHotKeyEnabled) {
         WriteLog(LogLevel::Warn, L"HotKeys are disabled. Skipping registry update.");
         return;
     }
-
-    // Update Keyboard Layout Preload
-    WinRegHandle hKey;
-    LONG result = RegOpenKeyEx(HKEY_CURRENT_USER, L"Keyboard Layout\\Preload", 0,
-                               KEY_SET_VALUE, hKey.receive());
-    if (result == ERROR_SUCCESS) {
-        result = RegSetValueEx(hKey.get(), L"1", 0, REG_SZ,
-                              reinterpret_cast<const BYTE*>(klid.c_str()),
-                              (DWORD)((klid.size() + 1) * sizeof(wchar_t)));
-        if (result == ERROR_SUCCESS) {
-            std::wstringstream ss;
-            ss << L"Set default input method in registry (Preload) to Locale ID: " << localeID << L", KLID: " << klid;
-            WriteLog(LogLevel::Info, ss.str());
-        } else {
-            std::wstringstream ss;
-            ss << L"Failed to set default input method in registry (Preload). Error code: " << result;
-            WriteLog(LogLevel::Error, ss.str());
-        }
-    } else {
-        std::wstringstream ss;
-        ss << L"Failed to open registry key (Preload). Error code: " << result;
-        WriteLog(LogLevel::Error, ss.str());
-    }
-
-    result = RegOpenKeyEx(HKEY_USERS, L".DEFAULT\\Keyboard Layout\\Preload", 0,
-                          KEY_SET_VALUE, hKey.receive());
-    if (result == ERROR_SUCCESS) {
-        result = RegSetValueEx(hKey.get(), L"1", 0, REG_SZ,
-                              reinterpret_cast<const BYTE*>(klid.c_str()),
-                              (DWORD)((klid.size() + 1) * sizeof(wchar_t)));
-        if (result == ERROR_SUCCESS) {
-            std::wstringstream ss;
-            ss << L"Set default input method in registry (DEFAULT Preload) to Locale ID: " << localeID << L", KLID: " << klid;
-            WriteLog(LogLevel::Info, ss.str());
-        } else {
-            std::wstringstream ss;
-            ss << L"Failed to set default input method in registry (DEFAULT Preload). Error code: " << result;
-            WriteLog(LogLevel::Error, ss.str());
-        }
-    } else {
-        std::wstringstream ss;
-        ss << L"Failed to open registry key (Preload). Error code: " << result;
-        WriteLog(LogLevel::Error, ss.str());
-    }
-
-    // Update Control Panel International User Profile
-    result = RegOpenKeyEx(HKEY_CURRENT_USER,
-                          L"Control Panel\\International\\User Profile", 0,
-                          KEY_SET_VALUE, hKey.receive());
-    if (result == ERROR_SUCCESS) {
-        std::wstring value = localeID + L":" + klid;
-        result = RegSetValueEx(hKey.get(), L"InputMethodOverride", 0, REG_SZ,
-                               reinterpret_cast<const BYTE*>(value.c_str()),
-                               (DWORD)((value.size() + 1) * sizeof(wchar_t)));
-        if (result == ERROR_SUCCESS) {
-            std::wstringstream ss;
-            ss << L"Set default input method in registry (InputMethodOverride) to " << value;
-            WriteLog(LogLevel::Info, ss.str());
-        } else {
-            std::wstringstream ss;
-            ss << L"Failed to set default input method in registry (InputMethodOverride). Error code: " << result;
-            WriteLog(LogLevel::Error, ss.str());
-        }
-    } else {
-        std::wstringstream ss;
-        ss << L"Failed to open registry key (User Profile). Error code: " << result;
-        WriteLog(LogLevel::Error, ss.str());
-    }
+    SetDefaultInputMethodInRegistry(localeID, klid, WriteLog, timeline);
 }
 
 void WorkerThread() {
@@ -176,7 +133,9 @@ void WorkerThread() {
         g_taskQueue.pop();
         lock.unlock();
 
-        SetDefaultInputMethodInRegistry(task.first, task.second);
+        LayoutTimeline timeline{&g_latency, task.sourceNs};
+        timeline.mark(LatencyStage::Dequeued);
+        PersistLayout(task.names.localeID, task.names.klid, timeline);
     }
 }
 
@@ -210,10 +169,7 @@ extern "C" __declspec(dllexport) BOOL InitHookModule() {
         std::lock_guard<std::mutex> lock(g_pipeMutex);
         g_logPipe.reset(CreateFileW(L"\\\\.\\pipe\\kbdlayoutmon_log", GENERIC_WRITE, 0, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL));
     }
-    g_hMutex.reset(CreateMutex(NULL, FALSE, L"Global\\KbdHookMutex"));
-    g_config.load();
-    auto debugVal = g_config.get(L"debug");
-    g_debugEnabled.store(debugVal && *debugVal == L"1");
+    RefreshHookConfig();
     StartWorkerThread();
     return TRUE;
 }
@@ -225,29 +181,60 @@ extern "C" __declspec(dllexport) void CleanupHookModule() {
     StopWorkerThread();
     std::lock_guard<std::mutex> lock(g_pipeMutex);
     g_logPipe.reset();
-    g_hMutex.reset();
+}
+
+// Hand a layout change to the host without creating a thread, pipe or
+// registry handle in this process.
+static void PublishLayoutEvent(uint64_t hkl, uint32_t sequence, uint64_t sourceNs) {
+    std::call_once(g_eventRingOnce, [] {
+        g_eventRing.open();
+        g_eventsReady.reset(OpenEventW(EVENT_MODIFY_STATE, FALSE, LayoutEventRing::kReadyEventName));
+    });
+    LayoutEvent event;
+    event.hkl = hkl;
+    event.timestampNs = sourceNs;
+    event.pid = GetCurrentProcessId();
+    event.sequence = sequence;
+    if (g_eventRing.push(event)) {
+        g_latency.recordSince(LatencyStage::Enqueued, sourceNs);
+        if (g_eventsReady)
+            SetEvent(g_eventsReady.get());
+    }
 }
 
 // Hook procedure to monitor system-wide messages
 LRESULT CALLBACK ShellProc(int nCode, WPARAM wParam, LPARAM lParam) {
     if (nCode == HSHELL_LANGUAGE) {
+        uint64_t sourceNs = LayoutEventClockNs();
+        RefreshHookConfig();
         HKL hkl = GetKeyboardLayout(0);
-        if (hkl != g_lastHKL) {
-            g_lastHKL = hkl;
-            std::wstring localeID = GetLocaleID(hkl);
-            std::wstring klid = GetKLID(hkl);
-            std::wstringstream ss;
-            ss << L"Keyboard layout changed. Locale ID: " << localeID << L", KLID: " << klid;
-            WriteLog(LogLevel::Info, ss.str());
+        uint64_t value = reinterpret_cast<uintptr_t>(hkl);
+        // Every hooked process sees HSHELL_LANGUAGE; only the one that wins
+        // the compare-exchange reports the transition.
+        uint32_t sequence = g_sharedState.claimLayoutChange(value);
+        if (sequence != 0) {
+            if (g_lightweightMode.load()) {
+                PublishLayoutEvent(value, sequence, sourceNs);
+                g_latency.recordSince(LatencyStage::HookBlocked, sourceNs);
+                return CallNextHookEx(g_hHook, nCode, wParam, lParam);
+            }
+            LayoutNames names = GetLayoutNames(value);
+            if (LogEnabled(LogLevel::Info)) {
+                std::wstringstream ss;
+                ss << L"Keyboard layout changed. Locale ID: " << names.localeID << L", KLID: " << names.klid;
+                WriteLog(LogLevel::Info, ss.str());
+            }
 
             if (!g_workerRunning.load())
                 StartWorkerThread();
 
             {
                 std::lock_guard<std::mutex> lock(g_queueMutex);
-                g_taskQueue.emplace(localeID, klid);
+                g_taskQueue.push({names, sourceNs});
             }
+            g_latency.recordSince(LatencyStage::Enqueued, sourceNs);
             g_queueCV.notify_one();
+            g_latency.recordSince(LatencyStage::HookBlocked, sourceNs);
         }
     }
     return CallNextHookEx(g_hHook, nCode, wParam, lParam);
@@ -258,8 +245,8 @@ LRESULT CALLBACK ShellProc(int nCode, WPARAM wParam, LPARAM lParam) {
  * @return TRUE if the hook was successfully installed.
  */
 extern "C" __declspec(dllexport) BOOL InstallGlobalHook() {
-    if (g_lastHKL == NULL) {
-        g_lastHKL = GetKeyboardLayout(0);
+    if (g_sharedState.lastHKL() == 0) {
+        g_sharedState.setLastHKL(reinterpret_cast<uintptr_t>(GetKeyboardLayout(0)));
     }
     WriteLog(LogLevel::Info, L"DLL loaded.");
 
@@ -297,52 +284,42 @@ extern "C" __declspec(dllexport) void UninstallGlobalHook() {
 
 // Increment reference count
 void IncrementRefCount() {
-    WaitForSingleObject(g_hMutex.get(), INFINITE);
-    g_refCount++;
+    LONG count = g_sharedState.incrementRefCount();
     std::wstringstream ss;
-    ss << L"Reference count incremented to " << g_refCount;
+    ss << L"Reference count incremented to " << count;
     WriteLog(LogLevel::Info, ss.str());
-    ReleaseMutex(g_hMutex.get());
 }
 
 // Decrement reference count and check if cleanup is needed
 void DecrementRefCount() {
-    WaitForSingleObject(g_hMutex.get(), INFINITE);
-    g_refCount--;
+    LONG count = g_sharedState.decrementRefCount();
     std::wstringstream ss;
-    ss << L"Reference count decremented to " << g_refCount;
+    ss << L"Reference count decremented to " << count;
     WriteLog(LogLevel::Info, ss.str());
-    ReleaseMutex(g_hMutex.get());
 }
 
 /**
  * @brief Query whether the Windows "Language" hotkey is enabled.
  */
 extern "C" __declspec(dllexport) bool GetLanguageHotKeyEnabled() {
-    return g_languageHotKeyEnabled.load();
+    return g_sharedState.languageHotKeyEnabled();
 }
 
 /**
  * @brief Query whether the Windows "Layout" hotkey is enabled.
  */
 extern "C" __declspec(dllexport) bool GetLayoutHotKeyEnabled() {
-    return g_layoutHotKeyEnabled.load();
+    return g_sharedState.layoutHotKeyEnabled();
 }
 
-/**
- * @brief Set the Language hotkey state shared with the executable.
- * @param enabled New enabled flag.
- */
-extern "C" __declspec(dllexport) void SetLanguageHotKeyEnabled(bool enabled) {
-    g_languageHotKeyEnabled.store(enabled);
-}
-
-/**
- * @brief Set the Layout hotkey state shared with the executable.
- * @param enabled New enabled flag.
- */
-extern "C" __declspec(dllexport) void SetLayoutHotKeyEnabled(bool enabled) {
-    g_layoutHotKeyEnabled.store(enabled);
+// The host's log pipe cannot be used under the loader lock, and without
+// the state page the hook could not tell whether logging is on anyway.
+// The hook keeps running on defaults: logging and both hotkeys off.
+static void ReportMappingFailure(const wchar_t* region) {
+    wchar_t message[160];
+    swprintf(message, 160, L"kbdlayoutmonhook: cannot map %ls (error %lu); using defaults.\n", region,
+             GetLastError());
+    OutputDebugStringW(message);
 }
 
 /**
@@ -354,8 +331,22 @@ BOOL APIENTRY DllMain(HINSTANCE hinstDLL, DWORD fdwReason, LPVOID lpReserved) {
         case DLL_PROCESS_ATTACH:
             g_hInst = hinstDLL;
             DisableThreadLibraryCalls(hinstDLL);
+            // Mapping a pagefile-backed section only touches kernel32 and is
+            // safe under the loader lock.
+            if (!g_sharedState.open())
+                ReportMappingFailure(L"shared state");
+            else if (!g_sharedState.isWritable())
+                OutputDebugStringW(L"kbdlayoutmonhook: shared state is read-only; layout changes here are not reported.\n");
+            if (!g_configImage.openForRead())
+                ReportMappingFailure(L"configuration image");
+            g_latency.open();
             break;
         case DLL_PROCESS_DETACH:
+            g_eventsReady.reset();
+            g_eventRing.close();
+            g_configImage.close();
+            g_latency.close();
+            g_sharedState.close();
             g_hInst = NULL;
             break;
     }
@@ -0,0 +1,178 @@
+#include "latency_stats.h"
+#include "layout_event_ring.h"
+
+#include <cmath>
+#include <cwchar>
+
+namespace {
+unsigned HighestBit(uint64_t value) {
+    unsigned bit = 0;
+    while (value >>= 1)
+        ++bit;
+    return bit;
+}
+
+void AppendDuration(std::wstring& out, uint64_t ns) {
+    wchar_t buf[32];
+    if (ns >= 1000000000ull)
+        std::swprintf(buf, 32, L"%.2fs", ns / 1e9);
+    else if (ns >= 1000000ull)
+        std::swprintf(buf, 32, L"%.2fms", ns / 1e6);
+    else if (ns >= 1000ull)
+        std::swprintf(buf, 32, L"%.1fus", ns / 1e3);
+    else
+        std::swprintf(buf, 32, L"%lluns", static_cast<unsigned long long>(ns));
+    out += buf;
+}
+} // namespace
+
+const wchar_t* LatencyStageName(LatencyStage stage) {
+    switch (stage) {
+    case LatencyStage::HookBlocked: return L"hook_blocked";
+    case LatencyStage::Enqueued: return L"enqueued";
+    case LatencyStage::Dequeued: return L"dequeued";
+    case LatencyStage::PreloadWritten: return L"preload_written";
+    case LatencyStage::DefaultPreloadWritten: return L"default_preload_written";
+    case LatencyStage::OverrideWritten: return L"override_written";
+    case LatencyStage::LogPersisted: return L"log_persisted";
+    default: return L"unknown";
+    }
+}
+
+size_t LatencyHistogram::BucketFor(uint64_t ns) {
+    if (ns < kSubBuckets)
+        return static_cast<size_t>(ns);
+    unsigned msb = HighestBit(ns);
+    size_t sub = static_cast<size_t>((ns >> (msb - kSubBucketBits)) & (kSubBuckets - 1));
+    return (msb - kSubBucketBits + 1) * kSubBuckets + sub;
+}
+
+uint64_t LatencyHistogram::BucketUpperBound(size_t index) {
+    if (index < kSubBuckets)
+        return index;
+    unsigned msb = static_cast<unsigned>(index / kSubBuckets) + kSubBucketBits - 1;
+    uint64_t sub = index % kSubBuckets;
+    uint64_t width = uint64_t{1} << (msb - kSubBucketBits);
+    uint64_t lower = (uint64_t{1} << msb) + sub * width;
+    return lower + (width - 1);
+}
+
+void LatencyHistogram::record(uint64_t ns) {
+    buckets[BucketFor(ns)].fetch_add(1, std::memory_order_relaxed);
+    sumNs.fetch_add(ns, std::memory_order_relaxed);
+    uint64_t prev = maxNs.load(std::memory_order_relaxed);
+    while (ns > prev && !maxNs.compare_exchange_weak(prev, ns, std::memory_order_relaxed)) {
+    }
+    // Counted last so a concurrent reader never sees more samples than
+    // bucket entries.
+    count.fetch_add(1, std::memory_order_release);
+}
+
+uint64_t LatencyHistogram::percentile(double quantile) const {
+    uint64_t total = count.load(std::memory_order_acquire);
+    if (total == 0)
+        return 0;
+    uint64_t rank = static_cast<uint64_t>(std::ceil(quantile * static_cast<double>(total)));
+    if (rank == 0)
+        rank = 1;
+    uint64_t seen = 0;
+    uint64_t max = maxNs.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < kBuckets; ++i) {
+        seen += buckets[i].load(std::memory_order_relaxed);
+        if (seen >= rank) {
+            uint64_t bound = BucketUpperBound(i);
+            return bound < max ? bound : max;
+        }
+    }
+    return max;
+}
+
+LatencySummary LatencyHistogram::summary() const {
+    LatencySummary s;
+    s.count = count.load(std::memory_order_acquire);
+    if (s.count == 0)
+        return s;
+    s.meanNs = sumNs.load(std::memory_order_relaxed) / s.count;
+    s.p50Ns = percentile(0.50);
+    s.p90Ns = percentile(0.90);
+    s.p99Ns = percentile(0.99);
+    s.p999Ns = percentile(0.999);
+    s.maxNs = maxNs.load(std::memory_order_relaxed);
+    return s;
+}
+
+void LatencyHistogram::reset() {
+    count.store(0, std::memory_order_relaxed);
+    sumNs.store(0, std::memory_order_relaxed);
+    maxNs.store(0, std::memory_order_relaxed);
+    for (auto& b : buckets)
+        b.store(0, std::memory_order_relaxed);
+}
+
+bool LatencyStats::open(const std::wstring& name) {
+    close();
+    if (!m_memory.open(name, sizeof(LatencyStatsBlock)))
+        return false;
+    auto* block = static_cast<LatencyStatsBlock*>(m_memory.data());
+    uint32_t expected = 0;
+    if (!block->magic.compare_exchange_strong(expected, kMagic) && expected != kMagic) {
+        m_memory.close();
+        return false;
+    }
+    m_block = block;
+    return true;
+}
+
+void LatencyStats::close() noexcept {
+    m_block = nullptr;
+    m_memory.close();
+}
+
+void LatencyStats::record(LatencyStage stage, uint64_t ns) {
+    if (m_block && stage < LatencyStage::Count)
+        m_block->stages[static_cast<size_t>(stage)].record(ns);
+}
+
+void LatencyStats::recordSince(LatencyStage stage, uint64_t sourceNs) {
+    uint64_t now = LayoutEventClockNs();
+    record(stage, now > sourceNs ? now - sourceNs : 0);
+}
+
+LatencySummary LatencyStats::summary(LatencyStage stage) const {
+    if (!m_block || stage >= LatencyStage::Count)
+        return {};
+    return m_block->stages[static_cast<size_t>(stage)].summary();
+}
+
+std::wstring LatencyStats::report() const {
+    std::wstring out;
+    for (uint32_t i = 0; i < static_cast<uint32_t>(LatencyStage::Count); ++i) {
+        auto stage = static_cast<LatencyStage>(i);
+        LatencySummary s = summary(stage);
+        out += LatencyStageName(stage);
+        out += L": n=" + std::to_wstring(s.count);
+        if (s.count) {
+            out += L" mean=";
+            AppendDuration(out, s.meanNs);
+            out += L" p50=";
+            AppendDuration(out, s.p50Ns);
+            out += L" p90=";
+            AppendDuration(out, s.p90Ns);
+            out += L" p99=";
+            AppendDuration(out, s.p99Ns);
+            out += L" p99.9=";
+            AppendDuration(out, s.p999Ns);
+            out += L" max=";
+            AppendDuration(out, s.maxNs);
+        }
+        out += L"\n";
+    }
+    return out;
+}
+
+void LatencyStats::reset() {
+    if (!m_block)
+        return;
+    for (auto& h : m_block->stages)
+        h.reset();
+}
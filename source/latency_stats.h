@@ -0,0 +1,131 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "shared_memory.h"
+
+/**
+ * @brief Points along a layout switch, from HSHELL_LANGUAGE reaching
+ *        ShellProc to the log entry hitting the file.
+ *
+ * Every stage except @c HookBlocked is measured from the source timestamp
+ * taken on entry to ShellProc; @c HookBlocked is how long ShellProc held
+ * the hooked application's thread.
+ */
+enum class LatencyStage : uint32_t {
+    HookBlocked,
+    Enqueued,
+    Dequeued,
+    PreloadWritten,
+    DefaultPreloadWritten,
+    OverrideWritten,
+    LogPersisted,
+    Count
+};
+
+/// Short name used in reports.
+const wchar_t* LatencyStageName(LatencyStage stage);
+
+/// Aggregates of one histogram, in nanoseconds.
+struct LatencySummary {
+    uint64_t count = 0;
+    uint64_t meanNs = 0;
+    uint64_t p50Ns = 0;
+    uint64_t p90Ns = 0;
+    uint64_t p99Ns = 0;
+    uint64_t p999Ns = 0;
+    uint64_t maxNs = 0;
+};
+
+/**
+ * @brief Lock-free log-linear latency histogram.
+ *
+ * Each power of two is split into 16 linear buckets, so a reported
+ * percentile is at most ~6% above the true value. All members are atomics,
+ * so the histogram may live in shared memory and be recorded into by
+ * several processes at once; a zero-filled histogram is empty.
+ */
+struct LatencyHistogram {
+    static constexpr unsigned kSubBucketBits = 4;
+    static constexpr size_t kSubBuckets = size_t{1} << kSubBucketBits;
+    static constexpr size_t kBuckets = (64 - kSubBucketBits + 1) * kSubBuckets;
+
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> sumNs;
+    std::atomic<uint64_t> maxNs;
+    std::atomic<uint64_t> buckets[kBuckets];
+
+    /// Add one sample.
+    void record(uint64_t ns);
+    /// Upper bound of the bucket holding the @p quantile (0..1) sample.
+    uint64_t percentile(double quantile) const;
+    /// Count, mean, common percentiles and max.
+    LatencySummary summary() const;
+    /// Zero every counter.
+    void reset();
+
+    /// Bucket index for a sample.
+    static size_t BucketFor(uint64_t ns);
+    /// Largest sample that falls into @p index.
+    static uint64_t BucketUpperBound(size_t index);
+};
+
+/// One histogram per stage, placed at the start of the shared region.
+struct LatencyStatsBlock {
+    std::atomic<uint32_t> magic;
+    LatencyHistogram stages[static_cast<size_t>(LatencyStage::Count)];
+};
+
+/**
+ * @brief Layout-switch latency histograms shared by the hook and the host.
+ *
+ * Hooked processes record how long ShellProc blocked and when events were
+ * queued; the executable records the remaining stages and can dump all of
+ * them on demand. Recording is a few relaxed atomic adds. Calls do nothing
+ * while the region is not open.
+ */
+class LatencyStats {
+public:
+    /// Name of the region used by the application.
+    static constexpr const wchar_t* kDefaultName = L"kbdlayoutmon_latency";
+    static constexpr uint32_t kMagic = 0x4B4C4C54; // "KLLT"
+
+    /// Map the region, creating it when needed.
+    bool open(const std::wstring& name = kDefaultName);
+    /// Unmap the region.
+    void close() noexcept;
+    /// True when mapped.
+    bool isOpen() const noexcept { return m_block != nullptr; }
+
+    /// Record a duration for @p stage.
+    void record(LatencyStage stage, uint64_t ns);
+    /// Record the time elapsed since @p sourceNs (LayoutEventClockNs()).
+    void recordSince(LatencyStage stage, uint64_t sourceNs);
+    /// Aggregates for @p stage.
+    LatencySummary summary(LatencyStage stage) const;
+    /// One line per stage with count, mean, p50/p90/p99/p99.9 and max.
+    std::wstring report() const;
+    /// Zero every histogram.
+    void reset();
+
+private:
+    SharedMemory m_memory;
+    LatencyStatsBlock* m_block = nullptr;
+};
+
+/**
+ * @brief Source timestamp of one layout event and where to record its
+ *        stage latencies.
+ */
+struct LayoutTimeline {
+    LatencyStats* stats = nullptr;
+    uint64_t sourceNs = 0;
+
+    /// Record that the event reached @p stage now.
+    void mark(LatencyStage stage) const {
+        if (stats && sourceNs)
+            stats->recordSince(stage, sourceNs);
+    }
+};
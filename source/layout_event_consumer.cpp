@@ -0,0 +1,90 @@
+#include "layout_event_consumer.h"
+
+#include <chrono>
+
+namespace {
+// Upper bound on the delay for producers that could not signal the host.
+constexpr unsigned kPollIntervalMs = 250;
+} // namespace
+
+LayoutEventConsumer::~LayoutEventConsumer() {
+    stop();
+}
+
+bool LayoutEventConsumer::start(Handler handler, const std::wstring& name) {
+    if (m_running.load() || !handler)
+        return false;
+    if (!m_ring.open(name))
+        return false;
+    m_handler = std::move(handler);
+#ifdef _WIN32
+    m_readyEvent.reset(CreateEventW(NULL, FALSE, FALSE, LayoutEventRing::kReadyEventName));
+    m_stopEvent.reset(CreateEventW(NULL, TRUE, FALSE, NULL));
+    if (!m_stopEvent) {
+        m_ring.close();
+        return false;
+    }
+#else
+    m_signaled = false;
+#endif
+    m_running = true;
+    m_thread = std::thread(&LayoutEventConsumer::run, this);
+    return true;
+}
+
+void LayoutEventConsumer::stop() {
+    if (!m_running.exchange(false))
+        return;
+#ifdef _WIN32
+    SetEvent(m_stopEvent.get());
+#else
+    notify();
+#endif
+    if (m_thread.joinable())
+        m_thread.join();
+    drain();
+    m_ring.close();
+#ifdef _WIN32
+    m_readyEvent.reset();
+    m_stopEvent.reset();
+#endif
+}
+
+void LayoutEventConsumer::notify() {
+#ifdef _WIN32
+    if (m_readyEvent)
+        SetEvent(m_readyEvent.get());
+#else
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_signaled = true;
+    }
+    m_cv.notify_one();
+#endif
+}
+
+size_t LayoutEventConsumer::drain() {
+    size_t handled = 0;
+    LayoutEvent event;
+    while (m_ring.pop(event)) {
+        m_handler(event);
+        ++handled;
+    }
+    return handled;
+}
+
+void LayoutEventConsumer::run() {
+    while (m_running.load()) {
+        drain();
+#ifdef _WIN32
+        HANDLE handles[2] = {m_stopEvent.get(), m_readyEvent.get()};
+        DWORD count = m_readyEvent ? 2 : 1;
+        WaitForMultipleObjects(count, handles, FALSE, kPollIntervalMs);
+#else
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cv.wait_for(lock, std::chrono::milliseconds(kPollIntervalMs),
+                      [this] { return m_signaled || !m_running.load(); });
+        m_signaled = false;
+#endif
+    }
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <thread>
+#include "layout_event_ring.h"
+
+#ifdef _WIN32
+#  include <windows.h>
+#  include "handle_guard.h"
+#else
+#  include <condition_variable>
+#  include <mutex>
+#endif
+
+/**
+ * @brief Host-side thread that drains the shared layout event ring.
+ *
+ * Lightweight hooks only push raw events; everything expensive (KLID
+ * resolution, registry writes, logging) happens in @p handler on this
+ * thread. On Windows producers wake it through a named event; it also
+ * polls periodically so producers that cannot open the event (e.g. lower
+ * integrity processes) are still served.
+ */
+class LayoutEventConsumer {
+public:
+    using Handler = std::function<void(const LayoutEvent&)>;
+
+    LayoutEventConsumer() = default;
+    /// Stops the thread after draining pending events.
+    ~LayoutEventConsumer();
+
+    LayoutEventConsumer(const LayoutEventConsumer&) = delete;
+    LayoutEventConsumer& operator=(const LayoutEventConsumer&) = delete;
+
+    /**
+     * @brief Map the ring and start the consumer thread.
+     * @return @c false if the ring could not be mapped or already running.
+     */
+    bool start(Handler handler, const std::wstring& name = LayoutEventRing::kDefaultName);
+    /// Drain remaining events and join the thread.
+    void stop();
+    /// Wake the thread; used by in-process producers.
+    void notify();
+    /// Handle every queued event on the calling thread.
+    size_t drain();
+    /// Events discarded by producers because the ring was full.
+    uint64_t dropped() const { return m_ring.dropped(); }
+
+private:
+    void run();
+
+    LayoutEventRing m_ring;
+    Handler m_handler;
+    std::thread m_thread;
+    std::atomic<bool> m_running{false};
+#ifdef _WIN32
+    HandleGuard m_readyEvent;
+    HandleGuard m_stopEvent;
+#else
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    bool m_signaled = false;
+#endif
+};
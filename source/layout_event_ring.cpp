@@ -0,0 +1,110 @@
+#include "layout_event_ring.h"
+
+#include <chrono>
+
+namespace {
+constexpr uint64_t kMask = LayoutEventRingBlock::kCapacity - 1;
+static_assert((LayoutEventRingBlock::kCapacity & kMask) == 0, "capacity must be a power of two");
+} // namespace
+
+uint64_t LayoutEventClockNs() {
+    // steady_clock is QueryPerformanceCounter on Windows and CLOCK_MONOTONIC
+    // elsewhere, both shared by every process on the machine.
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                     std::chrono::steady_clock::now().time_since_epoch())
+                                     .count());
+}
+
+bool LayoutEventRing::open(const std::wstring& name) {
+    close();
+    if (!m_memory.open(name, sizeof(LayoutEventRingBlock)))
+        return false;
+    auto* block = static_cast<LayoutEventRingBlock*>(m_memory.data());
+    uint32_t expected = 0;
+    if (!block->magic.compare_exchange_strong(expected, kMagic) && expected != kMagic) {
+        m_memory.close();
+        return false;
+    }
+    m_block = block;
+    return true;
+}
+
+void LayoutEventRing::close() noexcept {
+    m_block = nullptr;
+    m_memory.close();
+}
+
+bool LayoutEventRing::push(const LayoutEvent& event) {
+    if (tryPush(event))
+        return true;
+    if (m_block)
+        m_block->dropped.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+bool LayoutEventRing::tryPush(const LayoutEvent& event) {
+    if (!m_block)
+        return false;
+    uint64_t pos = m_block->enqueuePos.load(std::memory_order_relaxed);
+    LayoutEventCell* cell = nullptr;
+    for (;;) {
+        uint64_t index = pos & kMask;
+        cell = &m_block->cells[index];
+        uint64_t seq = cell->sequence.load(std::memory_order_acquire) + index;
+        int64_t diff = static_cast<int64_t>(seq - pos);
+        if (diff == 0) {
+            if (m_block->enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+        } else if (diff < 0) {
+            return false;
+        } else {
+            pos = m_block->enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+    cell->hkl.store(event.hkl, std::memory_order_relaxed);
+    cell->timestampNs.store(event.timestampNs, std::memory_order_relaxed);
+    cell->pid.store(event.pid, std::memory_order_relaxed);
+    cell->eventSequence.store(event.sequence, std::memory_order_relaxed);
+    cell->sequence.store(pos + 1 - (pos & kMask), std::memory_order_release);
+    return true;
+}
+
+bool LayoutEventRing::pop(LayoutEvent& event) {
+    if (!m_block)
+        return false;
+    uint64_t pos = m_block->dequeuePos.load(std::memory_order_relaxed);
+    LayoutEventCell* cell = nullptr;
+    for (;;) {
+        uint64_t index = pos & kMask;
+        cell = &m_block->cells[index];
+        uint64_t seq = cell->sequence.load(std::memory_order_acquire) + index;
+        int64_t diff = static_cast<int64_t>(seq - (pos + 1));
+        if (diff == 0) {
+            if (m_block->dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+        } else if (diff < 0) {
+            return false;
+        } else {
+            pos = m_block->dequeuePos.load(std::memory_order_relaxed);
+        }
+    }
+    event.hkl = cell->hkl.load(std::memory_order_relaxed);
+    event.timestampNs = cell->timestampNs.load(std::memory_order_relaxed);
+    event.pid = cell->pid.load(std::memory_order_relaxed);
+    event.sequence = cell->eventSequence.load(std::memory_order_relaxed);
+    cell->sequence.store(pos + LayoutEventRingBlock::kCapacity - (pos & kMask),
+                         std::memory_order_release);
+    return true;
+}
+
+uint64_t LayoutEventRing::dropped() const {
+    return m_block ? m_block->dropped.load(std::memory_order_relaxed) : 0;
+}
+
+size_t LayoutEventRing::depth() const {
+    if (!m_block)
+        return 0;
+    uint64_t dequeued = m_block->dequeuePos.load(std::memory_order_relaxed);
+    uint64_t enqueued = m_block->enqueuePos.load(std::memory_order_relaxed);
+    return enqueued > dequeued ? static_cast<size_t>(enqueued - dequeued) : 0;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "shared_memory.h"
+
+/**
+ * @brief Layout change reported by a hooked process.
+ */
+struct LayoutEvent {
+    uint64_t hkl = 0;          ///< Raw HKL value of the new layout.
+    uint64_t timestampNs = 0;  ///< LayoutEventClockNs() when the change was seen.
+    uint32_t pid = 0;          ///< Process that observed the change.
+    uint32_t sequence = 0;     ///< Transition number claimed in the state page.
+};
+
+/// Monotonic timestamp comparable across processes on the same machine.
+uint64_t LayoutEventClockNs();
+
+/// One ring slot. @c sequence is stored minus the slot index so that a
+/// zero-filled region is a valid empty ring.
+struct LayoutEventCell {
+    std::atomic<uint64_t> sequence;
+    std::atomic<uint64_t> hkl;
+    std::atomic<uint64_t> timestampNs;
+    std::atomic<uint32_t> pid;
+    std::atomic<uint32_t> eventSequence;
+};
+
+/// Ring layout placed at the start of the shared region.
+struct LayoutEventRingBlock {
+    static constexpr size_t kCapacity = 256;
+
+    std::atomic<uint32_t> magic;
+    std::atomic<uint64_t> enqueuePos;
+    std::atomic<uint64_t> dequeuePos;
+    std::atomic<uint64_t> dropped;
+    LayoutEventCell cells[kCapacity];
+};
+
+/**
+ * @brief Bounded lock-free queue of layout events in shared memory.
+ *
+ * Any number of hooked processes push; the executable pops. Pushing never
+ * blocks: when the host falls behind and the ring is full the event is
+ * counted in @c dropped() and discarded.
+ */
+class LayoutEventRing {
+public:
+    /// Name of the region used by the application.
+    static constexpr const wchar_t* kDefaultName = L"kbdlayoutmon_events";
+    /// Windows auto-reset event the host waits on; producers signal it
+    /// after a push.
+    static constexpr const wchar_t* kReadyEventName = L"Local\\kbdlayoutmon_events_ready";
+    static constexpr uint32_t kMagic = 0x4B4C4552; // "KLER"
+
+    /// Map the ring, creating it when needed.
+    bool open(const std::wstring& name = kDefaultName);
+    /// Unmap the ring.
+    void close() noexcept;
+    /// True when mapped.
+    bool isOpen() const noexcept { return m_block != nullptr; }
+
+    /// Append @p event; returns @c false if the ring is full or closed.
+    bool push(const LayoutEvent& event);
+    /// Like push() but a full ring is not counted as a drop, so callers
+    /// that can wait (e.g. trace replay) may retry.
+    bool tryPush(const LayoutEvent& event);
+    /// Remove the oldest event; returns @c false if the ring is empty.
+    bool pop(LayoutEvent& event);
+    /// Number of events discarded because the ring was full.
+    uint64_t dropped() const;
+    /// Events pushed but not yet popped; approximate while producers run.
+    size_t depth() const;
+
+private:
+    SharedMemory m_memory;
+    LayoutEventRingBlock* m_block = nullptr;
+};
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Hex formatting for locale IDs and KLIDs without streams or heap use.
+ *
+ * Digits come from a table lookup, so formatting has no data-dependent
+ * branches and can run at compile time.
+ */
+namespace layout_format {
+
+inline constexpr wchar_t kLowerDigits[] = L"0123456789abcdef";
+inline constexpr wchar_t kUpperDigits[] = L"0123456789ABCDEF";
+
+/**
+ * @brief Write the low @p Digits nibbles of @p value, most significant
+ *        first, followed by a terminator.
+ * @param out Buffer of at least @p Digits + 1 characters.
+ */
+template <size_t Digits, bool Upper = false>
+constexpr void FormatHex(uint32_t value, wchar_t* out) {
+    static_assert(Digits >= 1 && Digits <= 8, "at most 8 nibbles in 32 bits");
+    const wchar_t* digits = Upper ? kUpperDigits : kLowerDigits;
+    for (size_t i = 0; i < Digits; ++i)
+        out[i] = digits[(value >> (4 * (Digits - 1 - i))) & 0xF];
+    out[Digits] = L'\0';
+}
+
+/// Fixed-size, null-terminated hex string usable in constant expressions.
+template <size_t Digits>
+struct HexString {
+    wchar_t text[Digits + 1] = {};
+};
+
+/// Lowercase four-digit locale ID, e.g. "0409".
+constexpr HexString<4> LocaleHex(uint32_t langID) {
+    HexString<4> s;
+    FormatHex<4>(langID, s.text);
+    return s;
+}
+
+/// Uppercase eight-digit KLID as written by Windows, e.g. "0000040C".
+constexpr HexString<8> KLIDHex(uint32_t klid) {
+    HexString<8> s;
+    FormatHex<8, true>(klid, s.text);
+    return s;
+}
+
+static_assert(LocaleHex(0x0C0A).text[0] == L'0' && LocaleHex(0x0C0A).text[1] == L'c' &&
+              LocaleHex(0x0C0A).text[3] == L'a' && LocaleHex(0x0C0A).text[4] == L'\0');
+static_assert(KLIDHex(0x0001040C).text[3] == L'1' && KLIDHex(0x0001040C).text[7] == L'C');
+
+} // namespace layout_format
@@ -0,0 +1,189 @@
+#include "layout_pipeline.h"
+#include "layout_format.h"
+#include "winreg_handle.h"
+#include <cwchar>
+#include <sstream>
+
+namespace {
+// Find the KLID whose "Layout Id" matches the low 12 bits of a 0xFxxx
+// handle's high word, e.g. F002 -> 00010409 (United States-Dvorak).
+bool LookupLayoutId(uint32_t layoutId, uint32_t& klid) {
+    WinRegHandle root;
+    if (RegOpenKeyEx(HKEY_LOCAL_MACHINE, L"SYSTEM\\CurrentControlSet\\Control\\Keyboard Layouts", 0,
+                     KEY_READ, root.receive()) != ERROR_SUCCESS)
+        return false;
+    wchar_t name[KL_NAMELENGTH + 1];
+    for (DWORD i = 0;; ++i) {
+        DWORD nameLength = ARRAYSIZE(name);
+        if (RegEnumKeyEx(root.get(), i, name, &nameLength, nullptr, nullptr, nullptr, nullptr) != ERROR_SUCCESS)
+            return false;
+        WinRegHandle layout;
+        if (RegOpenKeyEx(root.get(), name, 0, KEY_READ, layout.receive()) != ERROR_SUCCESS)
+            continue;
+        wchar_t id[8] = {};
+        DWORD size = sizeof(id) - sizeof(wchar_t);
+        DWORD type = 0;
+        if (RegQueryValueEx(layout.get(), L"Layout Id", 0, &type, reinterpret_cast<BYTE*>(id), &size) ==
+                ERROR_SUCCESS &&
+            std::wcstoul(id, nullptr, 16) == layoutId) {
+            klid = static_cast<uint32_t>(std::wcstoul(name, nullptr, 16));
+            return true;
+        }
+    }
+}
+
+LayoutNameCache g_layoutNames;
+} // namespace
+
+LayoutNames ResolveLayoutNames(uint64_t hkl) {
+    uint32_t langID = static_cast<uint32_t>(hkl & 0xFFFF);
+    uint32_t device = static_cast<uint32_t>((hkl >> 16) & 0xFFFF);
+    uint32_t klid = langID;
+    if ((device & 0xF000) == 0xF000) {
+        if (!LookupLayoutId(device & 0x0FFF, klid))
+            klid = langID;
+    } else if ((device & 0xF000) == 0xE000) {
+        klid = static_cast<uint32_t>(hkl); // IME handles are their own KLID
+    } else if (device != 0) {
+        klid = device;
+    }
+
+    LayoutNames names;
+    layout_format::FormatHex<4>(langID, names.localeID);
+    layout_format::FormatHex<8, true>(klid, names.klid);
+    return names;
+}
+
+LayoutNames LayoutNameCache::get(uint64_t hkl, uint64_t signature) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (signature != m_signature) {
+        for (auto& e : m_entries)
+            e.used = false;
+        m_signature = signature;
+    }
+    for (const auto& e : m_entries) {
+        if (e.used && e.hkl == hkl)
+            return e.names;
+    }
+    ++m_misses;
+    Entry& slot = m_entries[m_next];
+    m_next = (m_next + 1) % kCapacity;
+    slot.hkl = hkl;
+    slot.names = m_resolver(hkl);
+    slot.used = true;
+    return slot.names;
+}
+
+void LayoutNameCache::clear() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto& e : m_entries)
+        e.used = false;
+}
+
+size_t LayoutNameCache::misses() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_misses;
+}
+
+uint64_t InstalledLayoutSignature() {
+    HKL layouts[64];
+    int count = GetKeyboardLayoutList(static_cast<int>(ARRAYSIZE(layouts)), layouts);
+    // FNV-1a over the handle list
+    uint64_t hash = 1469598103934665603ull ^ static_cast<uint64_t>(count);
+    for (int i = 0; i < count; ++i) {
+        hash ^= static_cast<uint64_t>(reinterpret_cast<uintptr_t>(layouts[i]));
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+LayoutNames GetLayoutNames(uint64_t hkl) {
+    return g_layoutNames.get(hkl, InstalledLayoutSignature());
+}
+
+std::wstring GetKLID(uint64_t hkl) {
+    return GetLayoutNames(hkl).klid;
+}
+
+std::wstring GetLocaleID(uint64_t hkl) {
+    return GetLayoutNames(hkl).localeID;
+}
+
+unsigned SetDefaultInputMethodInRegistry(const std::wstring& localeID, const std::wstring& klid,
+                                         LayoutLogSink log, const LayoutTimeline& timeline) {
+    unsigned written = 0;
+    // Update Keyboard Layout Preload
+    WinRegHandle hKey;
+    LONG result = RegOpenKeyEx(HKEY_CURRENT_USER, L"Keyboard Layout\\Preload", 0,
+                               KEY_SET_VALUE, hKey.receive());
+    if (result == ERROR_SUCCESS) {
+        result = RegSetValueEx(hKey.get(), L"1", 0, REG_SZ,
+                              reinterpret_cast<const BYTE*>(klid.c_str()),
+                              (DWORD)((klid.size() + 1) * sizeof(wchar_t)));
+        if (result == ERROR_SUCCESS) {
+            timeline.mark(LatencyStage::PreloadWritten);
+            written |= LayoutWritePreload;
+            std::wstringstream ss;
+            ss << L"Set default input method in registry (Preload) to Locale ID: " << localeID << L", KLID: " << klid;
+            log(LogLevel::Info, ss.str());
+        } else {
+            std::wstringstream ss;
+            ss << L"Failed to set default input method in registry (Preload). Error code: " << result;
+            log(LogLevel::Error, ss.str());
+        }
+    } else {
+        std::wstringstream ss;
+        ss << L"Failed to open registry key (Preload). Error code: " << result;
+        log(LogLevel::Error, ss.str());
+    }
+
+    result = RegOpenKeyEx(HKEY_USERS, L".DEFAULT\\Keyboard Layout\\Preload", 0,
+                          KEY_SET_VALUE, hKey.receive());
+    if (result == ERROR_SUCCESS) {
+        result = RegSetValueEx(hKey.get(), L"1", 0, REG_SZ,
+                              reinterpret_cast<const BYTE*>(klid.c_str()),
+                              (DWORD)((klid.size() + 1) * sizeof(wchar_t)));
+        if (result == ERROR_SUCCESS) {
+            timeline.mark(LatencyStage::DefaultPreloadWritten);
+            written |= LayoutWriteDefaultPreload;
+            std::wstringstream ss;
+            ss << L"Set default input method in registry (DEFAULT Preload) to Locale ID: " << localeID << L", KLID: " << klid;
+            log(LogLevel::Info, ss.str());
+        } else {
+            std::wstringstream ss;
+            ss << L"Failed to set default input method in registry (DEFAULT Preload). Error code: " << result;
+            log(LogLevel::Error, ss.str());
+        }
+    } else {
+        std::wstringstream ss;
+        ss << L"Failed to open registry key (Preload). Error code: " << result;
+        log(LogLevel::Error, ss.str());
+    }
+
+    // Update Control Panel International User Profile
+    result = RegOpenKeyEx(HKEY_CURRENT_USER,
+                          L"Control Panel\\International\\User Profile", 0,
+                          KEY_SET_VALUE, hKey.receive());
+    if (result == ERROR_SUCCESS) {
+        std::wstring value = localeID + L":" + klid;
+        result = RegSetValueEx(hKey.get(), L"InputMethodOverride", 0, REG_SZ,
+                               reinterpret_cast<const BYTE*>(value.c_str()),
+                               (DWORD)((value.size() + 1) * sizeof(wchar_t)));
+        if (result == ERROR_SUCCESS) {
+            timeline.mark(LatencyStage::OverrideWritten);
+            written |= LayoutWriteOverride;
+            std::wstringstream ss;
+            ss << L"Set default input method in registry (InputMethodOverride) to " << value;
+            log(LogLevel::Info, ss.str());
+        } else {
+            std::wstringstream ss;
+            ss << L"Failed to set default input method in registry (InputMethodOverride). Error code: " << result;
+            log(LogLevel::Error, ss.str());
+        }
+    } else {
+        std::wstringstream ss;
+        ss << L"Failed to open registry key (User Profile). Error code: " << result;
+        log(LogLevel::Error, ss.str());
+    }
+    return written;
+}
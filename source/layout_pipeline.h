@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include "latency_stats.h"
+#include "log_level.h"
+
+/**
+ * @brief Destination for diagnostics produced while handling a layout change.
+ *
+ * The hook forwards them over the log pipe, the executable writes them to
+ * its own log.
+ */
+using LayoutLogSink = void (*)(LogLevel level, const std::wstring& message);
+
+/**
+ * @brief Registry names of one keyboard layout, formatted in place.
+ */
+struct LayoutNames {
+    wchar_t localeID[5] = {}; ///< Language ID, e.g. "0409".
+    wchar_t klid[9] = {};     ///< Keyboard layout ID, e.g. "00010409".
+};
+
+/**
+ * @brief Compute the locale ID and KLID of @p hkl without caching.
+ *
+ * The KLID is derived from the handle itself: the high word is the layout
+ * for plain layouts, IME handles are their own KLID and 0xFxxx handles are
+ * matched against the "Layout Id" values of the installed layouts.
+ */
+LayoutNames ResolveLayoutNames(uint64_t hkl);
+
+/**
+ * @brief Small fixed-size HKL -> LayoutNames cache.
+ *
+ * Entries are filled on first sight and replaced round-robin. All entries
+ * are dropped when the caller reports a different installed-layout
+ * signature.
+ */
+class LayoutNameCache {
+public:
+    static constexpr size_t kCapacity = 16;
+    using Resolver = LayoutNames (*)(uint64_t hkl);
+
+    explicit LayoutNameCache(Resolver resolver = ResolveLayoutNames) : m_resolver(resolver) {}
+
+    /**
+     * @brief Names for @p hkl, resolving them on a miss.
+     * @param signature Current InstalledLayoutSignature().
+     */
+    LayoutNames get(uint64_t hkl, uint64_t signature);
+    /// Drop every entry.
+    void clear();
+    /// Number of lookups that had to resolve (primarily for tests).
+    size_t misses() const;
+
+private:
+    struct Entry {
+        uint64_t hkl = 0;
+        bool used = false;
+        LayoutNames names;
+    };
+
+    Resolver m_resolver;
+    mutable std::mutex m_mutex;
+    Entry m_entries[kCapacity];
+    size_t m_next = 0;
+    uint64_t m_signature = 0;
+    size_t m_misses = 0;
+};
+
+/// Hash of the installed keyboard layout list; changes when layouts are
+/// added or removed.
+uint64_t InstalledLayoutSignature();
+
+/**
+ * @brief Names for @p hkl from the process-wide cache.
+ *
+ * Does not allocate or format for layouts seen before.
+ */
+LayoutNames GetLayoutNames(uint64_t hkl);
+
+/**
+ * @brief Locale ID of a layout in the format "0409".
+ * @param hkl Raw HKL value.
+ */
+std::wstring GetLocaleID(uint64_t hkl);
+
+/**
+ * @brief KLID of a layout in the format "00000409".
+ * @param hkl Raw HKL value.
+ */
+std::wstring GetKLID(uint64_t hkl);
+
+/// Registry values written by SetDefaultInputMethodInRegistry().
+enum LayoutWrite : unsigned {
+    LayoutWritePreload = 1,        ///< HKCU Keyboard Layout\Preload
+    LayoutWriteDefaultPreload = 2, ///< HKU .DEFAULT Keyboard Layout\Preload
+    LayoutWriteOverride = 4        ///< HKCU User Profile InputMethodOverride
+};
+
+/**
+ * @brief Persist the default input method to the Preload and
+ *        InputMethodOverride registry values.
+ * @param localeID Locale ID as returned by GetLocaleID().
+ * @param klid     KLID as returned by GetKLID().
+ * @param log      Receives success and failure messages.
+ * @param timeline Marked after each successful registry write.
+ * @return LayoutWrite bits of the values that were written.
+ */
+unsigned SetDefaultInputMethodInRegistry(const std::wstring& localeID, const std::wstring& klid,
+                                     LayoutLogSink log, const LayoutTimeline& timeline = {});
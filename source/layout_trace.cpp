@@ -0,0 +1,121 @@
+#include "layout_trace.h"
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <thread>
+
+bool LayoutTraceWriter::open(const std::wstring& path) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_file.is_open())
+        m_file.close();
+    m_path.clear();
+    m_file.open(std::filesystem::path(path), std::ios::binary | std::ios::trunc);
+    if (!m_file.is_open())
+        return false;
+    LayoutTraceHeader header{kMagic, kVersion, static_cast<uint16_t>(sizeof(LayoutTraceRecord))};
+    m_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    m_file.flush();
+    if (!m_file) {
+        m_file.close();
+        return false;
+    }
+    m_path = path;
+    return true;
+}
+
+void LayoutTraceWriter::close() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_file.is_open())
+        m_file.close();
+    m_path.clear();
+}
+
+bool LayoutTraceWriter::isOpen() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_file.is_open();
+}
+
+bool LayoutTraceWriter::append(const LayoutTraceRecord& record) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_file.is_open())
+        return false;
+    m_file.write(reinterpret_cast<const char*>(&record), sizeof(record));
+    m_file.flush();
+    return static_cast<bool>(m_file);
+}
+
+std::wstring LayoutTraceWriter::path() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_path;
+}
+
+bool ReadLayoutTrace(const std::wstring& path, std::vector<LayoutTraceRecord>& records) {
+    std::ifstream file(std::filesystem::path(path), std::ios::binary);
+    if (!file.is_open())
+        return false;
+    LayoutTraceHeader header{};
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)))
+        return false;
+    if (header.magic != LayoutTraceWriter::kMagic || header.version != LayoutTraceWriter::kVersion ||
+        header.recordSize != sizeof(LayoutTraceRecord))
+        return false;
+    records.clear();
+    LayoutTraceRecord record;
+    // A trailing partial record (host killed mid-write) is ignored
+    while (file.read(reinterpret_cast<char*>(&record), sizeof(record)))
+        records.push_back(record);
+    return true;
+}
+
+bool ReplayLayoutTrace(const std::vector<LayoutTraceRecord>& records, LayoutEventConsumer::Handler handler,
+                       const LayoutReplayOptions& options, LayoutReplayResult& result) {
+    result = {};
+    SharedMemory::unlink(options.ringName);
+    LayoutEventRing ring;
+    if (!ring.open(options.ringName))
+        return false;
+    std::atomic<size_t> handled{0};
+    LayoutEventConsumer consumer;
+    bool started = consumer.start(
+        [&](const LayoutEvent& event) {
+            handler(event);
+            handled.fetch_add(1, std::memory_order_relaxed);
+        },
+        options.ringName);
+    if (!started) {
+        ring.close();
+        SharedMemory::unlink(options.ringName);
+        return false;
+    }
+
+    using clock = std::chrono::steady_clock;
+    double speed = options.speed > 0 ? options.speed : 1.0;
+    auto start = clock::now();
+    uint64_t firstNs = records.empty() ? 0 : records.front().timestampNs;
+    for (const auto& record : records) {
+        if (options.realtime && record.timestampNs > firstNs) {
+            auto offset = std::chrono::nanoseconds(
+                static_cast<int64_t>(static_cast<double>(record.timestampNs - firstNs) / speed));
+            std::this_thread::sleep_until(start + offset);
+        }
+        LayoutEvent event;
+        event.hkl = record.hkl;
+        event.pid = record.pid;
+        event.sequence = record.sequence;
+        event.timestampNs = LayoutEventClockNs();
+        while (!ring.tryPush(event)) {
+            consumer.notify();
+            std::this_thread::yield();
+        }
+        consumer.notify();
+    }
+    consumer.stop();
+    result.elapsedNs = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start).count());
+    result.events = handled.load();
+
+    ring.close();
+    SharedMemory::unlink(options.ringName);
+    return true;
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "layout_event_consumer.h"
+#include "layout_event_ring.h"
+
+/**
+ * @brief One layout event as handled by the host, 32 bytes on disk.
+ */
+struct LayoutTraceRecord {
+    uint64_t timestampNs = 0; ///< Source timestamp taken in ShellProc.
+    uint64_t hkl = 0;         ///< Raw HKL value.
+    uint32_t pid = 0;         ///< Hooked process that reported the change.
+    uint32_t sequence = 0;    ///< Transition number from the state page.
+    uint32_t klid = 0;        ///< KLID the host resolved.
+    uint16_t langId = 0;      ///< Locale ID the host resolved.
+    uint8_t writes = 0;       ///< LayoutWrite bits that succeeded.
+    uint8_t flags = 0;        ///< LayoutTraceRecord::kSkipped when not persisted.
+
+    /// Registry update skipped because both hotkeys were disabled.
+    static constexpr uint8_t kSkipped = 1;
+};
+
+static_assert(sizeof(LayoutTraceRecord) == 32, "trace records are written verbatim");
+
+/// File header preceding the records.
+struct LayoutTraceHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t recordSize;
+};
+
+/**
+ * @brief Append-only binary trace of handled layout events.
+ *
+ * Records are flushed as they are appended so a trace survives a crash of
+ * the host. Safe to call from several threads.
+ */
+class LayoutTraceWriter {
+public:
+    static constexpr uint32_t kMagic = 0x4B4C5452; // "KLTR"
+    static constexpr uint16_t kVersion = 1;
+
+    /// Create or truncate @p path and write the header.
+    bool open(const std::wstring& path);
+    /// Flush and close the file.
+    void close();
+    /// True while a trace file is open.
+    bool isOpen() const;
+    /// Append one record; returns @c false when closed or on write errors.
+    bool append(const LayoutTraceRecord& record);
+    /// Path of the open trace, empty when closed.
+    std::wstring path() const;
+
+private:
+    mutable std::mutex m_mutex;
+    std::ofstream m_file;
+    std::wstring m_path;
+};
+
+/**
+ * @brief Load every complete record of a trace file.
+ * @return @c false when the file is missing or not a trace.
+ */
+bool ReadLayoutTrace(const std::wstring& path, std::vector<LayoutTraceRecord>& records);
+
+/// Pacing and transport used by ReplayLayoutTrace().
+struct LayoutReplayOptions {
+    /// Reproduce the recorded gaps between events instead of pushing as
+    /// fast as the consumer drains.
+    bool realtime = false;
+    /// Divides recorded gaps in realtime mode (2.0 replays twice as fast).
+    double speed = 1.0;
+    /// Ring the events travel through.
+    std::wstring ringName = L"kbdlayoutmon_replay";
+};
+
+/// Outcome of ReplayLayoutTrace().
+struct LayoutReplayResult {
+    size_t events = 0;      ///< Events handed to the handler.
+    uint64_t elapsedNs = 0; ///< Wall time from first push to drained ring.
+};
+
+/**
+ * @brief Feed @p records through a LayoutEventRing and LayoutEventConsumer
+ *        into @p handler, exactly as hooks in light mode do.
+ *
+ * Each event carries a fresh source timestamp so latency measured by the
+ * handler covers the replayed pipeline. The producer waits instead of
+ * dropping when the ring is full.
+ */
+bool ReplayLayoutTrace(const std::vector<LayoutTraceRecord>& records, LayoutEventConsumer::Handler handler,
+                       const LayoutReplayOptions& options, LayoutReplayResult& result);
@@ -33,10 +33,9 @@ std::atomic<LogLevel> g_logLevel{LogLevel::Info};
 
 namespace {
 std::wstring GetLogPath() {
-    auto val = g_config.get(L"log_path");
-    if (val && !val->empty()) {
-        return *val;
-    }
+    ConfigSnapshotPtr config = g_config.snapshot();
+    if (!config->settings().logPath.empty())
+        return config->settings().logPath;
 
     wchar_t logPath[MAX_PATH] = {0};
 #ifdef _WIN32
@@ -149,14 +148,9 @@ void WriteLog(LogLevel level, const wchar_t* message) {
     // In UNIT_TEST ensure rotation semantics are honored prior to writing
 #ifdef _WIN32
     // Determine max size and backups from configuration
-    unsigned long long maxBytes = 10ULL * 1024ULL * 1024ULL;
-    if (auto val = g_config.get(L"max_log_size_mb")) {
-        try { maxBytes = static_cast<unsigned long long>(std::stoul(*val)) * 1024ULL * 1024ULL; } catch(...) { }
-    }
-    size_t maxBackups = 5;
-    if (auto b = g_config.get(L"max_log_backups")) {
-        try { maxBackups = std::stoul(*b); } catch(...) { }
-    }
+    ConfigSnapshotPtr config = g_config.snapshot();
+    unsigned long long maxBytes = static_cast<unsigned long long>(config->settings().maxLogSizeMb) * 1024ULL * 1024ULL;
+    size_t maxBackups = config->settings().maxLogBackups;
 
     WIN32_FILE_ATTRIBUTE_DATA fad;
     bool exists = GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &fad) != 0;
@@ -226,14 +220,9 @@ void WriteLog(LogLevel level, const wchar_t* message) {
 #else
     {
         namespace fs = std::filesystem;
-        unsigned long long maxBytes = 10ULL * 1024ULL * 1024ULL;
-        if (auto val = g_config.get(L"max_log_size_mb")) {
-            try { maxBytes = static_cast<unsigned long long>(std::stoul(*val)) * 1024ULL * 1024ULL; } catch(...) { }
-        }
-        size_t maxBackups = 5;
-        if (auto b = g_config.get(L"max_log_backups")) {
-            try { maxBackups = std::stoul(*b); } catch(...) { }
-        }
+        ConfigSnapshotPtr config = g_config.snapshot();
+        unsigned long long maxBytes = static_cast<unsigned long long>(config->settings().maxLogSizeMb) * 1024ULL * 1024ULL;
+        size_t maxBackups = config->settings().maxLogBackups;
         try {
             if (fs::exists(path) && fs::file_size(path) > maxBytes) {
                 for (size_t i = maxBackups; i > 0; --i) {
@@ -294,13 +283,9 @@ void WriteLog(const std::wstring& message) {
 
 
 Log::Log(size_t maxQueueSize, bool startThreads) : m_maxQueueSize(maxQueueSize) {
-    if (auto val = g_config.get(L"max_queue_size")) {
-        try {
-            m_maxQueueSize = std::stoul(*val);
-        } catch (...) {
-            // Ignore parse errors and keep provided default
-        }
-    }
+    ConfigSnapshotPtr config = g_config.snapshot();
+    if (config->settings().has(ConfigKey::MaxQueueSize))
+        m_maxQueueSize = config->settings().maxQueueSize;
     m_running = true;
     if (startThreads) {
 #ifdef _WIN32
@@ -337,6 +322,10 @@ void Log::shutdown() {
 }
 
 void Log::write(LogLevel level, const std::wstring& message) {
+    write(level, message, 0);
+}
+
+void Log::write(LogLevel level, const std::wstring& message, uint64_t originNs) {
     if (!GetAppState().debugEnabled.load())
         return;
     if (level < g_logLevel.load())
@@ -345,8 +334,9 @@ void Log::write(LogLevel level, const std::wstring& message) {
         std::lock_guard<std::mutex> lock(m_mutex);
         if (m_queue.size() >= m_maxQueueSize) {
             m_queue.pop();
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
         }
-        m_queue.push({level, message});
+        m_queue.push({level, message, originNs});
     }
     m_cv.notify_one();
 }
@@ -355,11 +345,16 @@ void Log::write(const std::wstring& message) {
     write(LogLevel::Info, message);
 }
 
+void Log::setPersistedCallback(PersistedCallback callback) {
+    m_onPersisted.store(callback);
+}
+
 void Log::setMaxQueueSize(size_t maxSize) {
     std::lock_guard<std::mutex> lock(m_mutex);
     m_maxQueueSize = maxSize ? maxSize : 1; // avoid zero
     while (m_queue.size() > m_maxQueueSize) {
         m_queue.pop();
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
     }
 }
 
@@ -372,7 +367,7 @@ std::wstring Log::peekOldest() const {
     std::lock_guard<std::mutex> lock(m_mutex);
     if (m_queue.empty())
         return std::wstring{};
-    return m_queue.front().second;
+    return m_queue.front().message;
 }
 
 void Log::process() {
@@ -406,8 +401,14 @@ void Log::process() {
             auto entry = std::move(m_queue.front());
             m_queue.pop();
             lock.unlock();
-            LogLevel level = entry.first;
-            std::wstring msg = std::move(entry.second);
+            LogLevel level = entry.level;
+            std::wstring msg = std::move(entry.message);
+            auto persisted = [this, &entry] {
+                if (!entry.originNs)
+                    return;
+                if (auto cb = m_onPersisted.load())
+                    cb(entry.originNs);
+            };
 
             bool suppress = false;
             if (m_suppress > 0) {
@@ -438,29 +439,15 @@ void Log::process() {
 #ifdef UNIT_TEST
                 // In unit tests, forward to WriteLog to reuse BOM, sharing and rotation logic.
                 WriteLog(level, msg.c_str());
+                persisted();
                 lock.lock();
 #else
             if (m_file.is_open()) {
                 // Check log file size
-                size_t maxMb = 10;
-                auto val = g_config.get(L"max_log_size_mb");
-                if (val) {
-                    try {
-                        maxMb = std::stoul(*val);
-                    } catch (...) {
-                        maxMb = 10;
-                    }
-                }
-                unsigned long long maxBytes = static_cast<unsigned long long>(maxMb) * 1024 * 1024ULL;
-
-                size_t maxBackups = 5;
-                if (auto backups = g_config.get(L"max_log_backups")) {
-                    try {
-                        maxBackups = std::stoul(*backups);
-                    } catch (...) {
-                        maxBackups = 5;
-                    }
-                }
+                ConfigSnapshotPtr config = g_config.snapshot();
+                unsigned long long maxBytes =
+                    static_cast<unsigned long long>(config->settings().maxLogSizeMb) * 1024 * 1024ULL;
+                size_t maxBackups = config->settings().maxLogBackups;
 
 #ifdef _WIN32
                 WIN32_FILE_ATTRIBUTE_DATA fad;
@@ -553,6 +540,7 @@ void Log::process() {
                 swprintf(ts, 32, L"%04d-%02d-%02d %02d:%02d:%02d", tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec);
 #endif
                 m_file << ts << L" [" << LevelPrefix(level) << L"] " << msg << std::endl;
+                persisted();
             } else {
 #ifdef _WIN32
                 OutputDebugString(L"Failed to write to log file.");
@@ -8,15 +8,8 @@
 #include <fstream>
 #include <atomic>
 #include <utility>
-
-/**
- * @brief Severity levels for log messages.
- */
-enum class LogLevel {
-    Info,
-    Warn,
-    Error
-};
+#include <cstdint>
+#include "log_level.h"
 
 #ifdef _WIN32
 #  include <windows.h>
@@ -58,12 +51,33 @@ public:
     void write(LogLevel level, const std::wstring& message);
     void write(const std::wstring& message);
 
+    /**
+     * @brief Queue a message that belongs to a timed event.
+     *
+     * Identical to write(LogLevel, const std::wstring&) except that
+     * @p originNs is handed to the persisted callback once the entry has
+     * been written.
+     *
+     * @param originNs Source timestamp of the event (LayoutEventClockNs()),
+     *        or 0 when the entry is not timed.
+     */
+    void write(LogLevel level, const std::wstring& message, uint64_t originNs);
+
+    /// Invoked on the writer thread after a timed entry reached the file.
+    using PersistedCallback = void (*)(uint64_t originNs);
+
+    /// Install or clear (nullptr) the persisted callback.
+    void setPersistedCallback(PersistedCallback callback);
+
     /// Adjust the maximum number of queued messages.
     void setMaxQueueSize(size_t maxSize);
 
     /// Obtain the number of messages currently queued (primarily for tests).
     size_t queueSize() const;
 
+    /// Number of messages discarded because the queue was full.
+    uint64_t dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
     /// Peek at the oldest queued message (primarily for tests).
     std::wstring peekOldest() const;
 
@@ -76,6 +90,12 @@ private:
     /// Listener thread that accepts messages via a named pipe.
     void pipeListener();
 
+    struct Entry {
+        LogLevel level;
+        std::wstring message;
+        uint64_t originNs;
+    };
+
     std::thread m_thread;      ///< Log writer thread.
 #ifdef _WIN32
     std::thread m_pipeThread; ///< Named pipe listener thread.
@@ -83,7 +103,9 @@ private:
 #endif
     mutable std::mutex m_mutex;
     std::condition_variable m_cv;
-    std::queue<std::pair<LogLevel, std::wstring>> m_queue;
+    std::queue<Entry> m_queue;
+    std::atomic<PersistedCallback> m_onPersisted{nullptr};
+    std::atomic<uint64_t> m_dropped{0};
     std::wofstream m_file;
     bool m_running = false;
     size_t m_maxQueueSize = 1000;
@@ -0,0 +1,13 @@
+#pragma once
+
+/**
+ * @brief Severity levels for log messages.
+ *
+ * Kept separate from log.h so the hook DLL and shared-memory state can use
+ * the enumeration without pulling in the log writer.
+ */
+enum class LogLevel {
+    Info,
+    Warn,
+    Error
+};
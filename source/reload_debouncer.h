@@ -0,0 +1,55 @@
+#pragma once
+
+#include <chrono>
+
+/**
+ * @brief Merges bursts of file change notifications into one reload.
+ *
+ * Every touch() pushes the reload back to @c delay after the latest
+ * change, but never beyond kMaxDelayFactor times @c delay after the first
+ * change of the burst, so a file rewritten continuously is still reloaded.
+ * The reload always happens after the last touch(), so the state read is
+ * at least as new as every change that was reported.
+ */
+class ReloadDebouncer {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /// Upper bound on a burst's delay, in multiples of the debounce window.
+    static constexpr int kMaxDelayFactor = 10;
+
+    /// Record a change observed at @p now.
+    void touch(Clock::time_point now, std::chrono::milliseconds delay) {
+        if (!m_pending) {
+            m_pending = true;
+            m_deadline = now + delay * kMaxDelayFactor;
+        }
+        m_due = now + delay < m_deadline ? now + delay : m_deadline;
+    }
+
+    /// True while a reload is scheduled.
+    bool pending() const noexcept { return m_pending; }
+
+    /// Milliseconds until the reload is due, 0 when it is, -1 when none is scheduled.
+    long long timeoutMs(Clock::time_point now) const {
+        if (!m_pending)
+            return -1;
+        if (now >= m_due)
+            return 0;
+        // Round up so a wait never wakes just before the deadline
+        return (std::chrono::duration_cast<std::chrono::microseconds>(m_due - now).count() + 999) / 1000;
+    }
+
+    /// True once when the scheduled reload is due; clears it.
+    bool take(Clock::time_point now) {
+        if (!m_pending || now < m_due)
+            return false;
+        m_pending = false;
+        return true;
+    }
+
+private:
+    bool m_pending = false;
+    Clock::time_point m_due{};
+    Clock::time_point m_deadline{};
+};
@@ -0,0 +1,161 @@
+#include "shared_memory.h"
+
+#include <utility>
+
+#ifdef _WIN32
+#  include <sddl.h>
+#else
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <fcntl.h>
+#  include <unistd.h>
+#  include <cerrno>
+#endif
+
+namespace {
+#ifdef _WIN32
+std::wstring PlatformName(const std::wstring& name) {
+    // Session-local so every process on the same desktop sees one region.
+    return L"Local\\" + name;
+}
+
+// The hook runs inside low-integrity and AppContainer processes, which the
+// creator's default DACL shuts out: everyone may read, only the creating
+// user and SYSTEM may write, and the medium label stops writes from below.
+constexpr wchar_t kRegionSecurity[] = L"D:(A;;GA;;;SY)(A;;GA;;;OW)(A;;GR;;;WD)(A;;GR;;;AC)S:(ML;;NW;;;ME)";
+#else
+std::string PlatformName(const std::wstring& name) {
+    std::string result = "/";
+    for (wchar_t c : name)
+        result.push_back(c < 0x80 ? static_cast<char>(c) : '_');
+    return result;
+}
+#endif
+} // namespace
+
+SharedMemory::~SharedMemory() {
+    close();
+}
+
+SharedMemory::SharedMemory(SharedMemory&& other) noexcept
+    : m_data(std::exchange(other.m_data, nullptr)),
+      m_size(std::exchange(other.m_size, 0)),
+      m_created(std::exchange(other.m_created, false))
+#ifdef _WIN32
+      , m_mapping(std::move(other.m_mapping))
+#endif
+{
+}
+
+SharedMemory& SharedMemory::operator=(SharedMemory&& other) noexcept {
+    if (this != &other) {
+        close();
+        m_data = std::exchange(other.m_data, nullptr);
+        m_size = std::exchange(other.m_size, 0);
+        m_created = std::exchange(other.m_created, false);
+#ifdef _WIN32
+        m_mapping = std::move(other.m_mapping);
+#endif
+    }
+    return *this;
+}
+
+bool SharedMemory::open(const std::wstring& name, size_t size, Access access) {
+    close();
+    if (name.empty() || size == 0)
+        return false;
+
+#ifdef _WIN32
+    std::wstring fullName = PlatformName(name);
+    if (access == Access::ReadOnly) {
+        m_mapping.reset(OpenFileMappingW(FILE_MAP_READ, FALSE, fullName.c_str()));
+        if (!m_mapping)
+            return false;
+        m_created = false;
+    } else {
+        ULARGE_INTEGER li{};
+        li.QuadPart = size;
+        SECURITY_ATTRIBUTES attributes{static_cast<DWORD>(sizeof(attributes)), NULL, FALSE};
+        PSECURITY_DESCRIPTOR descriptor = NULL;
+        if (ConvertStringSecurityDescriptorToSecurityDescriptorW(kRegionSecurity, SDDL_REVISION_1, &descriptor, NULL))
+            attributes.lpSecurityDescriptor = descriptor;
+        m_mapping.reset(CreateFileMappingW(INVALID_HANDLE_VALUE, &attributes, PAGE_READWRITE,
+                                           li.HighPart, li.LowPart, fullName.c_str()));
+        DWORD error = GetLastError();
+        if (descriptor)
+            LocalFree(descriptor);
+        if (!m_mapping)
+            return false;
+        m_created = error != ERROR_ALREADY_EXISTS;
+    }
+    DWORD mapAccess = access == Access::ReadOnly ? FILE_MAP_READ : FILE_MAP_ALL_ACCESS;
+    m_data = MapViewOfFile(m_mapping.get(), mapAccess, 0, 0, size);
+    if (!m_data) {
+        m_mapping.reset();
+        m_created = false;
+        return false;
+    }
+#else
+    std::string fullName = PlatformName(name);
+    int fd = -1;
+    if (access == Access::ReadOnly) {
+        fd = shm_open(fullName.c_str(), O_RDONLY, 0);
+        m_created = false;
+    } else {
+        fd = shm_open(fullName.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+        m_created = fd >= 0;
+        if (fd < 0 && errno == EEXIST)
+            fd = shm_open(fullName.c_str(), O_RDWR, 0);
+    }
+    if (fd < 0)
+        return false;
+
+    struct stat st{};
+    if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        return false;
+    }
+    if (static_cast<size_t>(st.st_size) < size) {
+        // The creator may not have sized the object yet; growing it is
+        // idempotent and zero-fills the new range.
+        if (access == Access::ReadOnly || ftruncate(fd, static_cast<off_t>(size)) != 0) {
+            ::close(fd);
+            return false;
+        }
+    }
+    int prot = access == Access::ReadOnly ? PROT_READ : PROT_READ | PROT_WRITE;
+    void* addr = mmap(nullptr, size, prot, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+        m_created = false;
+        return false;
+    }
+    m_data = addr;
+#endif
+    m_size = size;
+    return true;
+}
+
+void SharedMemory::close() noexcept {
+    if (m_data) {
+#ifdef _WIN32
+        UnmapViewOfFile(m_data);
+#else
+        munmap(m_data, m_size);
+#endif
+    }
+#ifdef _WIN32
+    m_mapping.reset();
+#endif
+    m_data = nullptr;
+    m_size = 0;
+    m_created = false;
+}
+
+void SharedMemory::unlink(const std::wstring& name) {
+#ifdef _WIN32
+    (void)name;
+#else
+    shm_unlink(PlatformName(name).c_str());
+#endif
+}
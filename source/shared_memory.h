@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#ifdef _WIN32
+#  include <windows.h>
+#  include "handle_guard.h"
+#endif
+
+/**
+ * @brief RAII wrapper for a named memory region shared between processes.
+ *
+ * Backed by CreateFileMappingW/MapViewOfFile on Windows and by
+ * shm_open/mmap on POSIX systems. A freshly created region is zero-filled,
+ * so structures placed in it should treat all-zero as a valid initial state.
+ * On Windows any process in the session, sandboxed ones included, may map
+ * it read-only; only the creating user may map it read-write.
+ */
+class SharedMemory {
+public:
+    /// Requested access to the mapped view.
+    enum class Access {
+        ReadWrite,
+        ReadOnly
+    };
+
+    /// Construct without mapping anything.
+    SharedMemory() noexcept = default;
+    /// Unmap the view and release the underlying handle.
+    ~SharedMemory();
+
+    SharedMemory(const SharedMemory&) = delete;
+    SharedMemory& operator=(const SharedMemory&) = delete;
+
+    /// Move constructor transfers ownership of the mapping.
+    SharedMemory(SharedMemory&& other) noexcept;
+    /// Move assignment transfers ownership of the mapping.
+    SharedMemory& operator=(SharedMemory&& other) noexcept;
+
+    /**
+     * @brief Create or attach to the region called @p name.
+     *
+     * Read-write callers create the region when it does not exist yet.
+     * Read-only callers only attach to a region created elsewhere.
+     *
+     * @param name   Portable region name without platform prefix.
+     * @param size   Size of the region in bytes.
+     * @param access Desired view access.
+     * @return @c true when the view was mapped.
+     */
+    bool open(const std::wstring& name, size_t size, Access access = Access::ReadWrite);
+
+    /// Unmap the view. Safe to call when nothing is mapped.
+    void close() noexcept;
+
+    /**
+     * @brief Remove the name of a region so later opens create a new one.
+     *
+     * Only meaningful on POSIX; on Windows the region disappears with its
+     * last handle.
+     */
+    static void unlink(const std::wstring& name);
+
+    /// Address of the mapped view or @c nullptr.
+    void* data() const noexcept { return m_data; }
+    /// Size of the mapped view in bytes.
+    size_t size() const noexcept { return m_size; }
+    /// True when this instance created the region rather than attaching.
+    bool created() const noexcept { return m_created; }
+    /// True if a view is mapped.
+    explicit operator bool() const noexcept { return m_data != nullptr; }
+
+private:
+    void* m_data = nullptr;
+    size_t m_size = 0;
+    bool m_created = false;
+#ifdef _WIN32
+    HandleGuard m_mapping;
+#endif
+};
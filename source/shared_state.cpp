@@ -0,0 +1,241 @@
+#include "shared_state.h"
+
+#include <thread>
+
+namespace {
+constexpr uint32_t kFlagLanguage = 1u << 0;
+constexpr uint32_t kFlagLayout = 1u << 1;
+constexpr uint32_t kFlagDebug = 1u << 2;
+
+// HKL values are 32-bit handles sign-extended on 64-bit Windows, so the low
+// half identifies the layout and the full value can be rebuilt from it.
+constexpr uint64_t PackLayout(uint32_t sequence, uint64_t hkl) {
+    return (static_cast<uint64_t>(sequence) << 32) | static_cast<uint32_t>(hkl);
+}
+
+constexpr uint32_t LayoutSequence(uint64_t packed) {
+    return static_cast<uint32_t>(packed >> 32);
+}
+
+constexpr uint64_t LayoutHKL(uint64_t packed) {
+    return static_cast<uint64_t>(static_cast<int64_t>(static_cast<int32_t>(static_cast<uint32_t>(packed))));
+}
+
+uint32_t ToFlags(const SharedStateSnapshot& s) {
+    return (s.languageHotKeyEnabled ? kFlagLanguage : 0) |
+           (s.layoutHotKeyEnabled ? kFlagLayout : 0) |
+           (s.debugEnabled ? kFlagDebug : 0);
+}
+
+// A whole snapshot in one word, so readers on any thread can keep the last
+// consistent one without a lock: generation, log level, flags, valid bit
+constexpr uint64_t kSnapshotValid = 1u;
+
+uint64_t PackSnapshot(const SharedStateSnapshot& s) {
+    return (static_cast<uint64_t>(s.configGeneration) << 32) |
+           (static_cast<uint64_t>(static_cast<uint8_t>(s.logLevel)) << 16) |
+           (static_cast<uint64_t>(ToFlags(s) & 0xFFu) << 8) | kSnapshotValid;
+}
+
+SharedStateSnapshot UnpackSnapshot(uint64_t packed) {
+    SharedStateSnapshot state;
+    uint32_t flags = static_cast<uint32_t>(packed >> 8) & 0xFFu;
+    state.languageHotKeyEnabled = (flags & kFlagLanguage) != 0;
+    state.layoutHotKeyEnabled = (flags & kFlagLayout) != 0;
+    state.debugEnabled = (flags & kFlagDebug) != 0;
+    state.logLevel = static_cast<LogLevel>(static_cast<uint8_t>(packed >> 16));
+    state.configGeneration = static_cast<uint32_t>(packed >> 32);
+    return state;
+}
+} // namespace
+
+bool SharedStatePage::attach(const std::wstring& name, SharedMemory::Access access) {
+    close();
+    if (!m_memory.open(name, sizeof(SharedStateBlock), access))
+        return false;
+
+    // The region starts zero-filled, which is a valid state for every
+    // member, so only the layout tag needs to be established.
+    auto* block = static_cast<SharedStateBlock*>(m_memory.data());
+    uint32_t expected = block->magic.load(std::memory_order_acquire);
+    if (expected == 0 && access == SharedMemory::Access::ReadWrite)
+        block->magic.compare_exchange_strong(expected, kMagic);
+    if (expected != 0 && expected != kMagic) {
+        m_memory.close();
+        return false;
+    }
+    m_block = block;
+    m_writable = access == SharedMemory::Access::ReadWrite;
+    return true;
+}
+
+bool SharedStatePage::openForPublish(const std::wstring& name) {
+    if (!attach(name, SharedMemory::Access::ReadWrite))
+        return false;
+    // Fields a dead publisher left half written are replaced by the
+    // executable's first publish
+    uint32_t seq = m_block->sequence.load(std::memory_order_acquire);
+    if (seq & 1u)
+        m_block->sequence.compare_exchange_strong(seq, seq + 1, std::memory_order_release);
+    m_publisher = true;
+    return true;
+}
+
+bool SharedStatePage::open(const std::wstring& name) {
+    return attach(name, SharedMemory::Access::ReadWrite) || attach(name, SharedMemory::Access::ReadOnly);
+}
+
+void SharedStatePage::close() noexcept {
+    m_block = nullptr;
+    m_lastRead.store(0, std::memory_order_relaxed);
+    m_writable = false;
+    m_publisher = false;
+    m_memory.close();
+}
+
+uint32_t SharedStatePage::beginWrite() {
+    // Threads of the executable serialize on the sequence counter itself
+    for (;;) {
+        uint32_t seq = m_block->sequence.load(std::memory_order_relaxed);
+        if ((seq & 1u) == 0 &&
+            m_block->sequence.compare_exchange_weak(seq, seq + 1, std::memory_order_acquire,
+                                                    std::memory_order_relaxed)) {
+            std::atomic_thread_fence(std::memory_order_release);
+            return seq;
+        }
+        std::this_thread::yield();
+    }
+}
+
+void SharedStatePage::endWrite(uint32_t seq) {
+    m_block->sequence.store(seq + 2, std::memory_order_release);
+}
+
+SharedStateSnapshot SharedStatePage::load() const {
+    SharedStateSnapshot state;
+    uint32_t flags = m_block->flags.load(std::memory_order_relaxed);
+    state.languageHotKeyEnabled = (flags & kFlagLanguage) != 0;
+    state.layoutHotKeyEnabled = (flags & kFlagLayout) != 0;
+    state.debugEnabled = (flags & kFlagDebug) != 0;
+    state.logLevel = static_cast<LogLevel>(m_block->logLevel.load(std::memory_order_relaxed));
+    state.configGeneration = m_block->configGeneration.load(std::memory_order_relaxed);
+    return state;
+}
+
+void SharedStatePage::store(const SharedStateSnapshot& state) {
+    m_block->flags.store(ToFlags(state), std::memory_order_relaxed);
+    m_block->logLevel.store(static_cast<uint32_t>(state.logLevel), std::memory_order_relaxed);
+    m_block->configGeneration.store(state.configGeneration, std::memory_order_relaxed);
+}
+
+SharedStateSnapshot SharedStatePage::read() const {
+    if (!m_block)
+        return {};
+    for (int attempt = 0; attempt < kMaxReadAttempts; ++attempt) {
+        uint32_t before = m_block->sequence.load(std::memory_order_acquire);
+        if (before & 1u) {
+            std::this_thread::yield();
+            continue;
+        }
+        SharedStateSnapshot state = load();
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (m_block->sequence.load(std::memory_order_relaxed) == before) {
+            m_lastRead.store(PackSnapshot(state), std::memory_order_relaxed);
+            return state;
+        }
+    }
+    // The executable is preempted mid-write, stalled or dead; hooked
+    // processes must not spin on it, and what they last saw is the best
+    // guess until it finishes
+    uint64_t last = m_lastRead.load(std::memory_order_relaxed);
+    return last ? UnpackSnapshot(last) : SharedStateSnapshot{};
+}
+
+void SharedStatePage::publish(const SharedStateSnapshot& state) {
+    update([&](SharedStateSnapshot& s) { s = state; });
+}
+
+void SharedStatePage::setLanguageHotKeyEnabled(bool enabled) {
+    update([&](SharedStateSnapshot& s) { s.languageHotKeyEnabled = enabled; });
+}
+
+void SharedStatePage::setLayoutHotKeyEnabled(bool enabled) {
+    update([&](SharedStateSnapshot& s) { s.layoutHotKeyEnabled = enabled; });
+}
+
+void SharedStatePage::setDebugEnabled(bool enabled) {
+    update([&](SharedStateSnapshot& s) { s.debugEnabled = enabled; });
+}
+
+void SharedStatePage::setLogLevel(LogLevel level) {
+    update([&](SharedStateSnapshot& s) { s.logLevel = level; });
+}
+
+uint32_t SharedStatePage::bumpConfigGeneration() {
+    uint32_t generation = 0;
+    update([&](SharedStateSnapshot& s) { generation = ++s.configGeneration; });
+    return generation;
+}
+
+bool SharedStatePage::languageHotKeyEnabled() const {
+    return m_block && (m_block->flags.load(std::memory_order_acquire) & kFlagLanguage) != 0;
+}
+
+bool SharedStatePage::layoutHotKeyEnabled() const {
+    return m_block && (m_block->flags.load(std::memory_order_acquire) & kFlagLayout) != 0;
+}
+
+bool SharedStatePage::debugEnabled() const {
+    return m_block && (m_block->flags.load(std::memory_order_acquire) & kFlagDebug) != 0;
+}
+
+int32_t SharedStatePage::incrementRefCount() {
+    if (!m_writable)
+        return 0;
+    return m_block->refCount.fetch_add(1, std::memory_order_acq_rel) + 1;
+}
+
+int32_t SharedStatePage::decrementRefCount() {
+    if (!m_writable)
+        return 0;
+    return m_block->refCount.fetch_sub(1, std::memory_order_acq_rel) - 1;
+}
+
+int32_t SharedStatePage::refCount() const {
+    return m_block ? m_block->refCount.load(std::memory_order_acquire) : 0;
+}
+
+uint64_t SharedStatePage::lastHKL() const {
+    return m_block ? LayoutHKL(m_block->layout.load(std::memory_order_acquire)) : 0;
+}
+
+void SharedStatePage::setLastHKL(uint64_t hkl) {
+    if (!m_writable)
+        return;
+    uint64_t current = m_block->layout.load(std::memory_order_relaxed);
+    while (!m_block->layout.compare_exchange_weak(current, PackLayout(LayoutSequence(current), hkl),
+                                                  std::memory_order_acq_rel,
+                                                  std::memory_order_relaxed)) {
+    }
+}
+
+uint32_t SharedStatePage::claimLayoutChange(uint64_t hkl) {
+    if (!m_writable)
+        return 0;
+    uint64_t current = m_block->layout.load(std::memory_order_acquire);
+    for (;;) {
+        if (static_cast<uint32_t>(current) == static_cast<uint32_t>(hkl))
+            return 0;
+        uint32_t sequence = LayoutSequence(current) + 1;
+        if (sequence == 0)
+            sequence = 1;
+        if (m_block->layout.compare_exchange_weak(current, PackLayout(sequence, hkl),
+                                                  std::memory_order_acq_rel,
+                                                  std::memory_order_acquire))
+            return sequence;
+    }
+}
+
+uint32_t SharedStatePage::layoutSequence() const {
+    return m_block ? LayoutSequence(m_block->layout.load(std::memory_order_acquire)) : 0;
+}
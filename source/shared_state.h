@@ -0,0 +1,184 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include "log_level.h"
+#include "shared_memory.h"
+
+/**
+ * @brief Values the executable publishes for every process hosting the hook.
+ */
+struct SharedStateSnapshot {
+    bool languageHotKeyEnabled = false;
+    bool layoutHotKeyEnabled = false;
+    bool debugEnabled = false;
+    LogLevel logLevel = LogLevel::Info;
+    uint32_t configGeneration = 0;
+
+    /// Whether the host records an entry of @p level; hooks check this
+    /// before sending anything down the log pipe.
+    bool logs(LogLevel level) const { return debugEnabled && level >= logLevel; }
+};
+
+/**
+ * @brief Layout of the shared state page.
+ *
+ * Every member is a lock-free atomic so the block is valid across process
+ * boundaries, and an all-zero page is the initial state. Multi-field
+ * snapshots are protected by a sequence lock: the executable makes
+ * @c sequence odd while it updates and readers retry when it changed
+ * underneath them.
+ */
+struct SharedStateBlock {
+    std::atomic<uint32_t> magic;
+    std::atomic<uint32_t> sequence;
+    std::atomic<uint32_t> flags;
+    std::atomic<uint32_t> logLevel;
+    std::atomic<uint32_t> configGeneration;
+    std::atomic<int32_t> refCount;
+    /// Event sequence in the high half, low 32 bits of the current HKL in
+    /// the low half, so one compare-exchange claims a transition.
+    std::atomic<uint64_t> layout;
+};
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free &&
+              std::atomic<uint64_t>::is_always_lock_free,
+              "Shared state requires address-free atomics");
+
+/**
+ * @brief Versioned state page shared by the executable and the hook DLL.
+ *
+ * Replaces the former `.shared` data section and the named mutex that
+ * guarded the reference count. All operations are lock-free; accessors
+ * return defaults and mutators do nothing while the page is not open.
+ *
+ * Only the executable publishes the sequence-locked fields, so a hooked
+ * process that dies can never leave them half written. Hooked processes
+ * only update the reference count and layout, each a single atomic.
+ */
+class SharedStatePage {
+public:
+    /// Name of the region used by the application.
+    static constexpr const wchar_t* kDefaultName = L"kbdlayoutmon_state";
+    /// Identifies the block layout; bump when SharedStateBlock changes.
+    static constexpr uint32_t kMagic = 0x4B4C5302; // "KLS" v2
+    /// Attempts read() makes before giving up on a write in progress.
+    static constexpr int kMaxReadAttempts = 100;
+
+    /**
+     * @brief Map the page as the executable, its only publisher.
+     *
+     * Creates the page when necessary. A write left unfinished by an
+     * executable that died is completed; the single-instance mutex rules
+     * out another live publisher.
+     *
+     * @param name Region name; tests pass unique names.
+     * @return @c false if the region cannot be mapped or has another layout.
+     */
+    bool openForPublish(const std::wstring& name = kDefaultName);
+    /**
+     * @brief Map the page from a hooked process.
+     *
+     * The view is read-write when the process may write to it, so the
+     * reference count and layout claims work, and read-only otherwise.
+     * Published fields cannot be changed through it either way.
+     *
+     * @return @c false if the region cannot be mapped or has another layout.
+     */
+    bool open(const std::wstring& name = kDefaultName);
+    /// Unmap the page.
+    void close() noexcept;
+    /// True when the page is mapped.
+    bool isOpen() const noexcept { return m_block != nullptr; }
+    /// True when the view may change the reference count and layout.
+    bool isWritable() const noexcept { return m_writable; }
+
+    /**
+     * @brief Obtain a consistent copy of all published fields.
+     *
+     * When a write stays in progress for kMaxReadAttempts attempts, returns
+     * the last consistent copy this view read, so a publisher that was only
+     * preempted does not flip the hotkeys off. Defaults, which disable
+     * logging and both hotkeys, are returned only before any read succeeded.
+     */
+    SharedStateSnapshot read() const;
+    /// Replace all published fields in one sequence-locked write.
+    void publish(const SharedStateSnapshot& state);
+
+    /**
+     * @brief Atomically modify the published fields.
+     *
+     * Does nothing unless the page was opened with openForPublish().
+     *
+     * @param fn Callable receiving a @c SharedStateSnapshot& to edit.
+     */
+    template <typename Fn>
+    void update(Fn&& fn) {
+        if (!m_block || !m_publisher)
+            return;
+        uint32_t seq = beginWrite();
+        SharedStateSnapshot state = load();
+        fn(state);
+        store(state);
+        endWrite(seq);
+    }
+
+    /// Set the shared Language hotkey flag.
+    void setLanguageHotKeyEnabled(bool enabled);
+    /// Set the shared Layout hotkey flag.
+    void setLayoutHotKeyEnabled(bool enabled);
+    /// Set the shared debug logging flag.
+    void setDebugEnabled(bool enabled);
+    /// Set the minimum severity hooked processes should forward.
+    void setLogLevel(LogLevel level);
+    /// Increment the configuration generation and return the new value,
+    /// or 0 when this view cannot publish.
+    uint32_t bumpConfigGeneration();
+
+    /// Read the Language hotkey flag without a full snapshot.
+    bool languageHotKeyEnabled() const;
+    /// Read the Layout hotkey flag without a full snapshot.
+    bool layoutHotKeyEnabled() const;
+    /// Read the debug flag without a full snapshot.
+    bool debugEnabled() const;
+
+    /// Increment the hook reference count and return the new value.
+    int32_t incrementRefCount();
+    /// Decrement the hook reference count and return the new value.
+    int32_t decrementRefCount();
+    /// Current hook reference count.
+    int32_t refCount() const;
+
+    /// Last keyboard layout seen by any hooked process.
+    uint64_t lastHKL() const;
+    /// Seed the current layout without counting it as a transition.
+    void setLastHKL(uint64_t hkl);
+
+    /**
+     * @brief Claim the transition to @p hkl for the calling process.
+     *
+     * Exactly one of any number of concurrent callers reporting the same
+     * change wins; the others, and callers reporting the current layout,
+     * get 0.
+     *
+     * @return The transition's event sequence (starting at 1) when claimed.
+     */
+    uint32_t claimLayoutChange(uint64_t hkl);
+    /// Sequence of the most recently claimed transition.
+    uint32_t layoutSequence() const;
+
+private:
+    bool attach(const std::wstring& name, SharedMemory::Access access);
+    uint32_t beginWrite();
+    void endWrite(uint32_t seq);
+    SharedStateSnapshot load() const;
+    void store(const SharedStateSnapshot& state);
+
+    SharedMemory m_memory;
+    SharedStateBlock* m_block = nullptr;
+    /// Last snapshot read() saw consistent, packed with a valid bit; 0 when none.
+    mutable std::atomic<uint64_t> m_lastRead{0};
+    bool m_writable = false;
+    bool m_publisher = false;
+};
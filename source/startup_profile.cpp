@@ -0,0 +1,94 @@
+#include "startup_profile.h"
+
+#include <cwchar>
+
+namespace {
+// Phases currently open on this thread, for nesting
+thread_local unsigned t_depth = 0;
+
+void AppendMilliseconds(std::wstring& out, uint64_t ns) {
+    wchar_t buf[32];
+    std::swprintf(buf, 32, L"%10.3f", ns / 1e6);
+    out += buf;
+}
+} // namespace
+
+StartupProfile::StartupProfile() : m_start(Clock::now()) {}
+
+uint64_t StartupProfile::sinceStart(Clock::time_point when) const {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(when - m_start).count());
+}
+
+size_t StartupProfile::begin(const wchar_t* name) {
+    if (finished())
+        return kNotRecorded;
+    uint64_t now = sinceStart(Clock::now());
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_phases.size() == kMaxPhases)
+        return kNotRecorded;
+    StartupPhase phase;
+    phase.name = name;
+    phase.startNs = now;
+    phase.depth = t_depth++;
+    m_phases.push_back(phase);
+    return m_phases.size() - 1;
+}
+
+void StartupProfile::end(size_t index) {
+    uint64_t now = sinceStart(Clock::now());
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (index >= m_phases.size() || !m_phases[index].open)
+        return;
+    if (t_depth > 0)
+        --t_depth;
+    StartupPhase& phase = m_phases[index];
+    phase.durationNs = now - phase.startNs;
+    phase.open = false;
+}
+
+void StartupProfile::finish() {
+    uint64_t now = sinceStart(Clock::now());
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_finished.load(std::memory_order_relaxed))
+        return;
+    m_totalNs = now;
+    m_finished.store(true, std::memory_order_release);
+}
+
+std::vector<StartupPhase> StartupProfile::phases() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_phases;
+}
+
+uint64_t StartupProfile::totalNs() const {
+    if (finished()) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_totalNs;
+    }
+    return sinceStart(Clock::now());
+}
+
+std::wstring StartupProfile::report() const {
+    std::vector<StartupPhase> all = phases();
+    std::wstring out = L" start(ms)  time(ms)  phase\n";
+    for (const StartupPhase& phase : all) {
+        AppendMilliseconds(out, phase.startNs);
+        if (phase.open)
+            out += L"   running";
+        else
+            AppendMilliseconds(out, phase.durationNs);
+        out += L"  ";
+        out.append(2 * phase.depth, L' ');
+        out += phase.name;
+        out += L"\n";
+    }
+    out += L"total";
+    AppendMilliseconds(out, totalNs());
+    out += L" ms\n";
+    return out;
+}
+
+StartupProfile& GetStartupProfile() {
+    static StartupProfile profile;
+    return profile;
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/// One timed phase, in nanoseconds since the profile started.
+struct StartupPhase {
+    const wchar_t* name = L"";
+    uint64_t startNs = 0;
+    uint64_t durationNs = 0;
+    unsigned depth = 0;  ///< Phases open on the same thread when it began
+    bool open = true;    ///< Not ended yet
+};
+
+/**
+ * @brief Timeline of the phases that make up startup.
+ *
+ * Phases are timed with a monotonic clock relative to construction and
+ * may be recorded from any thread, each ended on the thread that began it;
+ * a phase begun while another is open on the same thread is reported
+ * nested under it. After finish() nothing more
+ * is recorded, so code shared with later reloads can stay instrumented at
+ * the cost of one atomic load.
+ */
+class StartupProfile {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr size_t kNotRecorded = static_cast<size_t>(-1);
+    /// Phases kept at most; later ones are not recorded.
+    static constexpr size_t kMaxPhases = 256;
+
+    StartupProfile();
+
+    /**
+     * @brief Start timing @p name, which must outlive the profile.
+     * @return Index for end(), or kNotRecorded after finish() or once
+     *         kMaxPhases phases were recorded.
+     */
+    size_t begin(const wchar_t* name);
+    /// Stop timing the phase returned by begin().
+    void end(size_t index);
+    /// Stop recording; the timeline keeps its current phases.
+    void finish();
+    /// True once finish() was called.
+    bool finished() const noexcept { return m_finished.load(std::memory_order_acquire); }
+
+    /// Copy of every phase in the order they began.
+    std::vector<StartupPhase> phases() const;
+    /// Time from construction to finish(), or to now while still recording.
+    uint64_t totalNs() const;
+
+    /**
+     * @brief Table of the phases, one per line.
+     *
+     * Each line holds the start offset and duration in milliseconds and
+     * the phase name, indented by nesting depth.
+     */
+    std::wstring report() const;
+
+private:
+    uint64_t sinceStart(Clock::time_point when) const;
+
+    const Clock::time_point m_start;
+    std::atomic<bool> m_finished{false};
+    mutable std::mutex m_mutex;
+    std::vector<StartupPhase> m_phases;
+    uint64_t m_totalNs = 0;
+};
+
+/// Profile of this process's startup.
+StartupProfile& GetStartupProfile();
+
+/**
+ * @brief Times the enclosing scope as one startup phase.
+ *
+ * Call end() to stop before the scope closes, e.g. when the next phase
+ * follows in the same block.
+ */
+class ScopedStartupPhase {
+public:
+    explicit ScopedStartupPhase(const wchar_t* name, StartupProfile& profile = GetStartupProfile())
+        : m_profile(profile), m_index(profile.begin(name)) {}
+    ~ScopedStartupPhase() { end(); }
+
+    ScopedStartupPhase(const ScopedStartupPhase&) = delete;
+    ScopedStartupPhase& operator=(const ScopedStartupPhase&) = delete;
+
+    void end() {
+        if (m_index != StartupProfile::kNotRecorded) {
+            m_profile.end(m_index);
+            m_index = StartupProfile::kNotRecorded;
+        }
+    }
+
+private:
+    StartupProfile& m_profile;
+    size_t m_index;
+};
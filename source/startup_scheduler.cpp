@@ -0,0 +1,144 @@
+#include "startup_scheduler.h"
+
+#include <exception>
+#include <string>
+#include <system_error>
+#include <utility>
+
+#include "config_parser.h"
+#include "log.h"
+
+StartupScheduler::StartupScheduler(StartupProfile& profile) : m_profile(profile) {}
+
+StartupScheduler::~StartupScheduler() {
+    wait();
+}
+
+StartupScheduler::TaskId StartupScheduler::add(const wchar_t* name, Task work, std::initializer_list<TaskId> after) {
+    return addTask(name, std::move(work), after, false);
+}
+
+StartupScheduler::TaskId StartupScheduler::defer(const wchar_t* name, Task work, std::initializer_list<TaskId> after) {
+    return addTask(name, std::move(work), after, true);
+}
+
+StartupScheduler::TaskId StartupScheduler::addTask(const wchar_t* name, Task work,
+                                                   std::initializer_list<TaskId> after, bool deferred) {
+    for (TaskId dependency : after) {
+        if (dependency >= m_tasks.size() || (m_tasks[dependency].deferred && !deferred))
+            return kInvalidTask;
+    }
+    TaskId id = m_tasks.size();
+    Entry entry(name, std::move(work), deferred);
+    for (TaskId dependency : after) {
+        // Critical dependencies of a deferred task are done by runDeferred()
+        if (m_tasks[dependency].deferred == deferred) {
+            m_tasks[dependency].dependents.push_back(id);
+            ++entry.pending;
+        }
+    }
+    m_tasks.push_back(std::move(entry));
+    return id;
+}
+
+void StartupScheduler::prepare(bool deferred) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_ready.clear();
+    m_remaining = 0;
+    for (TaskId id = 0; id < m_tasks.size(); ++id) {
+        if (m_tasks[id].deferred != deferred)
+            continue;
+        ++m_remaining;
+        if (m_tasks[id].pending == 0)
+            m_ready.push_back(id);
+    }
+}
+
+void StartupScheduler::runTask(Entry& task) {
+    // A failed task must still be counted, or run() and wait() never return
+    try {
+        if (task.work)
+            task.work();
+    } catch (const std::exception& e) {
+        WriteLog(LogLevel::Error, std::wstring(L"Startup task failed: ") + task.name + L": " + Utf8ToWide(e.what()));
+    } catch (...) {
+        WriteLog(LogLevel::Error, std::wstring(L"Startup task failed: ") + task.name);
+    }
+}
+
+void StartupScheduler::workLoop() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;) {
+        m_changed.wait(lock, [&] { return !m_ready.empty() || m_remaining == 0; });
+        if (m_remaining == 0)
+            return;
+        TaskId id = m_ready.front();
+        m_ready.pop_front();
+        Entry& task = m_tasks[id];
+        lock.unlock();
+        {
+            ScopedStartupPhase phase(task.name, m_profile);
+            runTask(task);
+        }
+        lock.lock();
+        for (TaskId dependent : task.dependents) {
+            if (--m_tasks[dependent].pending == 0)
+                m_ready.push_back(dependent);
+        }
+        if (--m_remaining == 0 && m_done) {
+            Task done = std::move(m_done);
+            m_done = nullptr;
+            lock.unlock();
+            done();
+            lock.lock();
+        }
+        m_changed.notify_all();
+    }
+}
+
+void StartupScheduler::run(size_t threads) {
+    prepare(false);
+    std::vector<std::thread> helpers;
+    for (size_t i = 1; i < threads; ++i) {
+        try {
+            helpers.emplace_back(&StartupScheduler::workLoop, this);
+        } catch (const std::system_error&) {
+            break; // Fewer threads only means less overlap
+        }
+    }
+    workLoop();
+    for (std::thread& helper : helpers)
+        helper.join();
+}
+
+void StartupScheduler::runDeferred(size_t threads, Task done) {
+    prepare(true);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_remaining != 0) {
+            m_done = std::move(done);
+            done = nullptr;
+        }
+    }
+    if (done) {
+        done();
+        return;
+    }
+    for (size_t i = 0; i < threads; ++i) {
+        try {
+            m_workers.emplace_back(&StartupScheduler::workLoop, this);
+        } catch (const std::system_error&) {
+            break;
+        }
+    }
+    if (m_workers.empty())
+        workLoop(); // No thread to spare: finish the work here instead
+}
+
+void StartupScheduler::wait() {
+    for (std::thread& worker : m_workers) {
+        if (worker.joinable())
+            worker.join();
+    }
+    m_workers.clear();
+}
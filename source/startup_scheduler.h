@@ -0,0 +1,97 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <initializer_list>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "startup_profile.h"
+
+/**
+ * @brief Runs startup tasks concurrently in dependency order.
+ *
+ * Critical tasks are what the application needs before it is usable and
+ * run in run(); deferred tasks run in the background from runDeferred()
+ * once it is. A task starts as soon as every task it depends on has
+ * finished, on whichever pool thread is free, and is timed as a startup
+ * phase under its name. Dependencies must be added first, so there are no
+ * cycles, and a critical task cannot depend on a deferred one. Tasks are
+ * added before run() and from one thread only. A task that throws is
+ * logged and counts as finished, so its dependents still run.
+ */
+class StartupScheduler {
+public:
+    using TaskId = size_t;
+    using Task = std::function<void()>;
+
+    static constexpr TaskId kInvalidTask = static_cast<TaskId>(-1);
+
+    explicit StartupScheduler(StartupProfile& profile = GetStartupProfile());
+    /// Waits for deferred tasks still running.
+    ~StartupScheduler();
+
+    StartupScheduler(const StartupScheduler&) = delete;
+    StartupScheduler& operator=(const StartupScheduler&) = delete;
+
+    /**
+     * @brief Add a critical task; @p name must outlive the scheduler.
+     * @return Id to depend on, or kInvalidTask when a dependency is
+     *         unknown or deferred.
+     */
+    TaskId add(const wchar_t* name, Task work, std::initializer_list<TaskId> after = {});
+    /// Add a deferred task, which may depend on tasks of either kind.
+    TaskId defer(const wchar_t* name, Task work, std::initializer_list<TaskId> after = {});
+
+    /**
+     * @brief Run every critical task and return once all have finished.
+     *
+     * Up to @p threads threads work through the tasks, the calling thread
+     * included.
+     */
+    void run(size_t threads);
+
+    /**
+     * @brief Start the deferred tasks on @p threads background threads.
+     *
+     * Call after run(). Returns at once; @p done runs on the thread that
+     * finishes the last task, or here when there is none.
+     */
+    void runDeferred(size_t threads, Task done = nullptr);
+
+    /// Block until every deferred task has finished.
+    void wait();
+
+private:
+    struct Entry {
+        Entry(const wchar_t* name, Task work, bool deferred)
+            : name(name), work(std::move(work)), deferred(deferred) {}
+
+        const wchar_t* name = nullptr;
+        Task work;
+        bool deferred = false;
+        size_t pending = 0; ///< Unfinished dependencies of the same kind
+        std::vector<TaskId> dependents;
+    };
+
+    TaskId addTask(const wchar_t* name, Task work, std::initializer_list<TaskId> after, bool deferred);
+    // Queue the tasks of one kind with nothing left to wait for
+    void prepare(bool deferred);
+    // Run one task, logging what it throws
+    void runTask(Entry& task);
+    // Run ready tasks until every queued one has finished
+    void workLoop();
+
+    StartupProfile& m_profile;
+    std::vector<Entry> m_tasks;
+    std::mutex m_mutex;
+    std::condition_variable m_changed;
+    std::deque<TaskId> m_ready;
+    size_t m_remaining = 0; ///< Tasks of the running kind not finished yet
+    Task m_done;
+    std::vector<std::thread> m_workers; ///< Deferred pool, joined by wait()
+};
@@ -5,9 +5,11 @@
 #include "constants.h"
 #include "log.h"
 #include "utils.h"
+#include "file_watch_service.h"
 #ifdef _WIN32
 #  include <shlwapi.h>
 #endif
+#include <chrono>
 #include "app_state.h"
 
 #ifdef UNIT_TEST
@@ -22,48 +24,57 @@
 extern Configuration g_config;
 #endif
 
-// Command-line overrides populated by kbdlayoutmon.cpp
-extern std::wstring g_cliIconPath;
-extern std::wstring g_cliTrayTooltip;
-
 BOOL (WINAPI *pShell_NotifyIcon)(DWORD, PNOTIFYICONDATA) = ::Shell_NotifyIcon;
 
-TrayIcon::TrayIcon(HWND hwnd) {
-    if (!GetAppState().trayIconEnabled.load()) return;
+// Editors save in bursts; wait for the icon file to settle before reloading
+constexpr std::chrono::milliseconds kIconReloadDebounce(200);
 
-    ZeroMemory(&nid_, sizeof(nid_));
-    nid_.cbSize = sizeof(NOTIFYICONDATA);
-    nid_.hWnd = hwnd;
-    nid_.uID = 1;
-    nid_.uFlags = NIF_ICON | NIF_MESSAGE | NIF_TIP;
-    nid_.uCallbackMessage = WM_TRAYICON;
-    // Determine icon path, preferring command-line override when present
-    std::wstring iconPath = g_cliIconPath;
-    if (iconPath.empty()) {
-        auto iconVal = g_config.get(L"icon_path");
-        if (iconVal && !iconVal->empty())
-            iconPath = *iconVal;
-    }
+// Load the icon at iconPath, falling back to the embedded one. fromFile
+// tells whether the caller owns the result; shared resource icons are
+// never destroyed.
+static HICON LoadTrayIcon(const std::wstring& iconPath, bool& fromFile) {
+    HICON hIcon = nullptr;
     if (!iconPath.empty()) {
 #ifdef UNIT_TEST
         auto loadImage = pLoadImageW;
 #else
         auto loadImage = LoadImageW;
 #endif
-        nid_.hIcon = reinterpret_cast<HICON>(
+        hIcon = reinterpret_cast<HICON>(
             loadImage(nullptr, iconPath.c_str(), IMAGE_ICON, 0, 0, LR_LOADFROMFILE));
     }
-    if (!nid_.hIcon) {
-        nid_.hIcon = LoadIcon(g_hInst, MAKEINTRESOURCE(IDI_MYAPP));
+    fromFile = hIcon != nullptr;
+    if (!hIcon) {
+        hIcon = LoadIcon(g_hInst, MAKEINTRESOURCE(IDI_MYAPP));
     }
+    return hIcon;
+}
 
-    // Set tray tooltip from override/config or use default name
-    std::wstring tip = g_cliTrayTooltip;
-    if (tip.empty()) {
-        auto tipVal = g_config.get(L"tray_tooltip");
-        if (tipVal && !tipVal->empty())
-            tip = *tipVal;
-    }
+static void DestroyTrayIcon(HICON hIcon) {
+    if (!hIcon) return;
+#ifdef UNIT_TEST
+    pDestroyIcon(hIcon);
+#else
+    DestroyIcon(hIcon);
+#endif
+}
+
+TrayIcon::TrayIcon(HWND hwnd) {
+    if (!GetAppState().trayIconEnabled.load()) return;
+
+    ZeroMemory(&nid_, sizeof(nid_));
+    nid_.cbSize = sizeof(NOTIFYICONDATA);
+    nid_.hWnd = hwnd;
+    nid_.uID = 1;
+    nid_.uFlags = NIF_ICON | NIF_MESSAGE | NIF_TIP;
+    nid_.uCallbackMessage = WM_TRAYICON;
+    // Command-line overrides are already merged into the configuration
+    ConfigSnapshotPtr config = g_config.snapshot();
+    const std::wstring& iconPath = config->settings().iconPath;
+    nid_.hIcon = LoadTrayIcon(iconPath, ownsIcon_);
+
+    // Set tray tooltip from config or use default name
+    const std::wstring& tip = config->settings().trayTooltip;
     if (!tip.empty()) {
         wcscpy_s(nid_.szTip, ARRAYSIZE(nid_.szTip), tip.c_str());
     } else {
@@ -71,43 +82,64 @@ TrayIcon::TrayIcon(HWND hwnd) {
     }
     pShell_NotifyIcon(NIM_ADD, &nid_);
     added_ = true;
+    WatchIcon(iconPath);
 }
 
 TrayIcon::~TrayIcon() {
+    WatchIcon(L"");
     if (added_) {
         pShell_NotifyIcon(NIM_DELETE, &nid_);
+        if (ownsIcon_)
+            DestroyTrayIcon(nid_.hIcon);
     }
 }
 
+HICON TrayIcon::SwapIcon(const std::wstring& iconPath) {
+    HICON previous = ownsIcon_ ? nid_.hIcon : nullptr;
+    nid_.hIcon = LoadTrayIcon(iconPath, ownsIcon_);
+    return previous != nid_.hIcon ? previous : nullptr;
+}
+
 void TrayIcon::Update(const std::wstring& iconPath, const std::wstring& tooltip) {
     if (!added_) return;
 
-    // Prefer CLI overrides over provided parameters
-    std::wstring finalIcon = g_cliIconPath.empty() ? iconPath : g_cliIconPath;
-    std::wstring finalTip = g_cliTrayTooltip.empty() ? tooltip : g_cliTrayTooltip;
+    HICON previous = SwapIcon(iconPath);
+    WatchIcon(iconPath);
 
-    HICON hIcon = nullptr;
-    if (!finalIcon.empty()) {
-#ifdef UNIT_TEST
-        auto loadImage = pLoadImageW;
-#else
-        auto loadImage = LoadImageW;
-#endif
-        hIcon = reinterpret_cast<HICON>(
-            loadImage(nullptr, finalIcon.c_str(), IMAGE_ICON, 0, 0, LR_LOADFROMFILE));
-    }
-    if (!hIcon) {
-        hIcon = LoadIcon(g_hInst, MAKEINTRESOURCE(IDI_MYAPP));
-    }
-    nid_.hIcon = hIcon;
-
-    if (!finalTip.empty()) {
-        wcscpy_s(nid_.szTip, ARRAYSIZE(nid_.szTip), finalTip.c_str());
+    if (!tooltip.empty()) {
+        wcscpy_s(nid_.szTip, ARRAYSIZE(nid_.szTip), tooltip.c_str());
     } else {
         wcscpy_s(nid_.szTip, ARRAYSIZE(nid_.szTip), L"kbdlayoutmon");
     }
 
     pShell_NotifyIcon(NIM_MODIFY, &nid_);
+    DestroyTrayIcon(previous);
+}
+
+void TrayIcon::ReloadIcon() {
+    if (!added_ || iconPath_.empty()) return;
+
+    HICON previous = SwapIcon(iconPath_);
+    pShell_NotifyIcon(NIM_MODIFY, &nid_);
+    DestroyTrayIcon(previous);
+}
+
+void TrayIcon::WatchIcon(const std::wstring& iconPath) {
+    if (iconPath == iconPath_) return;
+
+    FileWatchService& watcher = GetFileWatchService();
+    if (iconWatch_) {
+        watcher.unwatch(iconWatch_);
+        iconWatch_ = 0;
+    }
+    iconPath_ = iconPath;
+    if (iconPath_.empty()) return;
+
+    // The service thread must not touch the tray; the window thread reloads
+    HWND hwnd = nid_.hWnd;
+    iconWatch_ = watcher.watch(iconPath_, [hwnd](const std::wstring&) {
+        PostMessage(hwnd, WM_TRAY_ICON_CHANGED, 0, 0);
+    }, kIconReloadDebounce);
 }
 
 #ifndef UNIT_TEST
@@ -134,9 +166,10 @@ void ShowTrayMenu(HWND hwnd) {
     InsertMenu(hMenu, 6, MF_BYPOSITION | MF_STRING, ID_TRAY_OPEN_LOG, L"Open Log File");
     InsertMenu(hMenu, 7, MF_BYPOSITION | MF_STRING, ID_TRAY_OPEN_CONFIG, L"Open Config File");
     InsertMenu(hMenu, 8, MF_BYPOSITION | MF_STRING | (state.debugEnabled.load() ? MF_CHECKED : 0), ID_TRAY_TOGGLE_DEBUG, L"Debug Logging");
-    InsertMenu(hMenu, 9, MF_BYPOSITION | MF_SEPARATOR, 0, NULL);
-    InsertMenu(hMenu, 10, MF_BYPOSITION | MF_STRING, ID_TRAY_RESTART, L"Restart");
-    InsertMenu(hMenu, 11, MF_BYPOSITION | MF_STRING, ID_TRAY_EXIT, L"Quit");
+    InsertMenu(hMenu, 9, MF_BYPOSITION | MF_STRING, ID_TRAY_LATENCY_REPORT, L"Log Latency Report");
+    InsertMenu(hMenu, 10, MF_BYPOSITION | MF_SEPARATOR, 0, NULL);
+    InsertMenu(hMenu, 11, MF_BYPOSITION | MF_STRING, ID_TRAY_RESTART, L"Restart");
+    InsertMenu(hMenu, 12, MF_BYPOSITION | MF_STRING, ID_TRAY_EXIT, L"Quit");
 
     SetForegroundWindow(hwnd);
     TrackPopupMenu(hMenu, TPM_BOTTOMALIGN | TPM_LEFTALIGN, pt.x, pt.y, 0, hwnd, NULL);
@@ -144,7 +177,8 @@ void ShowTrayMenu(HWND hwnd) {
 }
 
 // Function pointers declared in main module
-extern void (*SetDebugLoggingEnabledPtr)(bool);
+void PublishSharedState();
+void LogLatencyReport();
 extern HMODULE g_hDll; // used for restart? not required, ignore
 
 void HandleTrayCommand(HWND hwnd, WPARAM wParam) {
@@ -171,9 +205,10 @@ void HandleTrayCommand(HWND hwnd, WPARAM wParam) {
         case ID_TRAY_OPEN_LOG:
         {
             wchar_t logPath[MAX_PATH] = {0};
-            auto val = g_config.get(L"log_path");
-            if (val && !val->empty()) {
-                lstrcpynW(logPath, val->c_str(), MAX_PATH);
+            ConfigSnapshotPtr config = g_config.snapshot();
+            const std::wstring& configured = config->settings().logPath;
+            if (!configured.empty()) {
+                lstrcpynW(logPath, configured.c_str(), MAX_PATH);
             } else if (g_hInst) {
                 GetModuleFileName(g_hInst, logPath, MAX_PATH);
                 PathRemoveFileSpec(logPath);
@@ -209,6 +244,10 @@ void HandleTrayCommand(HWND hwnd, WPARAM wParam) {
                     SetDebugLoggingEnabled(true);
                 WriteLog(LogLevel::Info, L"Debug logging enabled.");
             }
+            PublishSharedState();
+            break;
+        case ID_TRAY_LATENCY_REPORT:
+            LogLatencyReport();
             break;
         case ID_TRAY_RESTART:
             ShellExecute(NULL, L"open", L"cmd.exe", L"/C taskkill /IM kbdlayoutmon.exe /F && start kbdlayoutmon.exe", NULL, SW_HIDE);
@@ -1,5 +1,6 @@
 #pragma once
 #include <windows.h>
+#include <cstdint>
 #include <string>
 
 #include "app_state.h"
@@ -10,6 +11,7 @@ extern HINSTANCE g_hInst;
 // Message and menu identifiers
 constexpr UINT WM_TRAYICON = WM_USER + 1;
 constexpr UINT WM_UPDATE_TRAY_MENU = WM_USER + 2;
+constexpr UINT WM_TRAY_ICON_CHANGED = WM_USER + 4; ///< Icon file was edited
 
 enum TrayMenuId {
     ID_TRAY_EXIT = 1001,
@@ -21,7 +23,8 @@ enum TrayMenuId {
     ID_TRAY_RESTART = 1007,
     ID_TRAY_OPEN_LOG = 1008,
     ID_TRAY_TOGGLE_DEBUG = 1009,
-    ID_TRAY_OPEN_CONFIG = 1010
+    ID_TRAY_OPEN_CONFIG = 1010,
+    ID_TRAY_LATENCY_REPORT = 1011
 };
 
 class TrayIcon {
@@ -35,9 +38,23 @@ public:
     // Reload the tray icon and tooltip based on provided values.
     void Update(const std::wstring& iconPath, const std::wstring& tooltip);
 
+    // Reload the icon from its file, keeping the tooltip. Called on the
+    // window thread once WM_TRAY_ICON_CHANGED arrives.
+    void ReloadIcon();
+
 private:
+    // Watch the icon file so edits post WM_TRAY_ICON_CHANGED to the window
+    void WatchIcon(const std::wstring& iconPath);
+
+    // Point nid_ at the icon for @p iconPath. Returns the icon it replaced
+    // when that one was loaded from a file, to destroy after NIM_MODIFY.
+    HICON SwapIcon(const std::wstring& iconPath);
+
     NOTIFYICONDATA nid_{};
     bool added_ = false;
+    bool ownsIcon_ = false; // nid_.hIcon came from LoadImageW, not the resources
+    std::wstring iconPath_;
+    uint64_t iconWatch_ = 0;
 };
 
 extern BOOL (WINAPI *pShell_NotifyIcon)(DWORD, PNOTIFYICONDATA);
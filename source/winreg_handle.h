@@ -1,6 +1,10 @@
 #pragma once
 
+#ifdef UNIT_TEST
+#include "../tests/windows_stub.h"
+#else
 #include <windows.h>
+#endif
 
 /**
  * @brief RAII wrapper for Windows registry handles.
@@ -0,0 +1,411 @@
+// Compare benchmark results written by the benchjson reporter against a
+// stored baseline.
+//
+//   bench_compare <baseline.json> <current.json> [--alpha <p>]
+//                 [--threshold <pct>] [--thresholds <file>] [--gate <tag>]...
+//
+// Every benchmark present in both files is checked with a one-sided
+// Mann-Whitney U test (are the current samples stochastically larger than
+// the baseline samples?) and the ratio of the sample medians. A benchmark
+// regresses when p < alpha and its median slowed down by more than its
+// threshold. Regressions in gated benchmarks (tags [log], [config] and
+// [layout] unless --gate is given) make the exit status 1; others are only
+// reported. A gated benchmark without a baseline entry fails as well, so
+// new benchmarks cannot go unchecked until the baseline is re-recorded.
+// The thresholds file holds `substring = percent` lines matched
+// against "test case/benchmark name"; the last matching line wins.
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+constexpr int kSchema = 1;
+
+// Just enough JSON for the reporter's output
+struct JsonValue {
+    enum Type { Null, Bool, Number, String, Array, Object } type = Null;
+    bool boolean = false;
+    double number = 0.0;
+    std::string text;
+    std::vector<JsonValue> items;
+    std::vector<std::pair<std::string, JsonValue>> members;
+
+    const JsonValue* find(const std::string& key) const {
+        for (const auto& m : members)
+            if (m.first == key)
+                return &m.second;
+        return nullptr;
+    }
+};
+
+class JsonParser {
+public:
+    explicit JsonParser(const std::string& text) : m_text(text) {}
+
+    bool parse(JsonValue& value) {
+        if (!parseValue(value))
+            return false;
+        skipSpace();
+        return m_pos == m_text.size();
+    }
+
+private:
+    void skipSpace() {
+        while (m_pos < m_text.size() && std::isspace(static_cast<unsigned char>(m_text[m_pos])))
+            ++m_pos;
+    }
+
+    bool consume(char c) {
+        skipSpace();
+        if (m_pos < m_text.size() && m_text[m_pos] == c) {
+            ++m_pos;
+            return true;
+        }
+        return false;
+    }
+
+    bool literal(const char* word) {
+        size_t len = std::char_traits<char>::length(word);
+        if (m_text.compare(m_pos, len, word) != 0)
+            return false;
+        m_pos += len;
+        return true;
+    }
+
+    bool parseString(std::string& out) {
+        if (!consume('"'))
+            return false;
+        while (m_pos < m_text.size()) {
+            char c = m_text[m_pos++];
+            if (c == '"')
+                return true;
+            if (c != '\\') {
+                out += c;
+                continue;
+            }
+            if (m_pos >= m_text.size())
+                return false;
+            char e = m_text[m_pos++];
+            switch (e) {
+            case 'n': out += '\n'; break;
+            case 't': out += '\t'; break;
+            case 'r': out += '\r'; break;
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'u':
+                if (m_pos + 4 > m_text.size())
+                    return false;
+                // Names are ASCII; keep the code unit's low byte
+                out += static_cast<char>(std::strtoul(m_text.substr(m_pos, 4).c_str(), nullptr, 16));
+                m_pos += 4;
+                break;
+            default: out += e; break;
+            }
+        }
+        return false;
+    }
+
+    bool parseValue(JsonValue& value) {
+        skipSpace();
+        if (m_pos >= m_text.size())
+            return false;
+        char c = m_text[m_pos];
+        if (c == '{') {
+            ++m_pos;
+            value.type = JsonValue::Object;
+            if (consume('}'))
+                return true;
+            do {
+                std::string key;
+                JsonValue member;
+                if (!parseString(key) || !consume(':') || !parseValue(member))
+                    return false;
+                value.members.emplace_back(std::move(key), std::move(member));
+            } while (consume(','));
+            return consume('}');
+        }
+        if (c == '[') {
+            ++m_pos;
+            value.type = JsonValue::Array;
+            if (consume(']'))
+                return true;
+            do {
+                JsonValue item;
+                if (!parseValue(item))
+                    return false;
+                value.items.push_back(std::move(item));
+            } while (consume(','));
+            return consume(']');
+        }
+        if (c == '"') {
+            value.type = JsonValue::String;
+            return parseString(value.text);
+        }
+        if (literal("true") || literal("false")) {
+            value.type = JsonValue::Bool;
+            value.boolean = c == 't';
+            return true;
+        }
+        if (literal("null"))
+            return true;
+        // Covers nan/inf too, which %g can print for degenerate samples
+        const char* begin = m_text.c_str() + m_pos;
+        char* end = nullptr;
+        value.number = std::strtod(begin, &end);
+        if (end == begin)
+            return false;
+        value.type = JsonValue::Number;
+        m_pos += static_cast<size_t>(end - begin);
+        return true;
+    }
+
+    const std::string& m_text;
+    size_t m_pos = 0;
+};
+
+struct Benchmark {
+    std::string tags;
+    std::vector<double> samples;
+};
+
+using BenchmarkSet = std::map<std::string, Benchmark>;
+
+bool LoadResults(const std::string& path, BenchmarkSet& out) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        std::cerr << "cannot open " << path << std::endl;
+        return false;
+    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    std::string text = buffer.str();
+    JsonValue root;
+    if (!JsonParser(text).parse(root) || root.type != JsonValue::Object) {
+        std::cerr << path << ": not a benchmark result file" << std::endl;
+        return false;
+    }
+    const JsonValue* schema = root.find("schema");
+    if (!schema || schema->type != JsonValue::Number || static_cast<int>(schema->number) != kSchema) {
+        std::cerr << path << ": unsupported schema (expected " << kSchema << ")" << std::endl;
+        return false;
+    }
+    const JsonValue* benchmarks = root.find("benchmarks");
+    if (!benchmarks || benchmarks->type != JsonValue::Array) {
+        std::cerr << path << ": missing benchmarks" << std::endl;
+        return false;
+    }
+    for (const auto& item : benchmarks->items) {
+        const JsonValue* testCase = item.find("test_case");
+        const JsonValue* name = item.find("name");
+        const JsonValue* samples = item.find("samples_ns");
+        if (!testCase || !name || !samples || samples->type != JsonValue::Array)
+            continue;
+        Benchmark bench;
+        if (const JsonValue* tags = item.find("tags"))
+            bench.tags = tags->text;
+        for (const auto& s : samples->items)
+            if (s.type == JsonValue::Number && std::isfinite(s.number))
+                bench.samples.push_back(s.number);
+        out[testCase->text + "/" + name->text] = std::move(bench);
+    }
+    return true;
+}
+
+double Median(std::vector<double> values) {
+    if (values.empty())
+        return 0.0;
+    std::sort(values.begin(), values.end());
+    size_t mid = values.size() / 2;
+    return values.size() % 2 ? values[mid] : (values[mid - 1] + values[mid]) / 2.0;
+}
+
+/**
+ * @brief One-sided Mann-Whitney U test.
+ * @return p-value for "@p current tends to be larger than @p baseline",
+ *         using the normal approximation with tie and continuity
+ *         correction (adequate for the 10+ samples a benchmark produces).
+ */
+double MannWhitneyGreater(const std::vector<double>& baseline, const std::vector<double>& current) {
+    size_t n1 = current.size();
+    size_t n2 = baseline.size();
+    if (n1 == 0 || n2 == 0)
+        return 1.0;
+    std::vector<std::pair<double, bool>> all; // value, from current
+    all.reserve(n1 + n2);
+    for (double v : current)
+        all.emplace_back(v, true);
+    for (double v : baseline)
+        all.emplace_back(v, false);
+    std::sort(all.begin(), all.end(),
+              [](const auto& a, const auto& b) { return a.first < b.first; });
+
+    double rankSum = 0.0;
+    double tieTerm = 0.0;
+    for (size_t i = 0; i < all.size();) {
+        size_t j = i;
+        while (j < all.size() && all[j].first == all[i].first)
+            ++j;
+        double rank = (static_cast<double>(i + 1) + static_cast<double>(j)) / 2.0;
+        for (size_t k = i; k < j; ++k)
+            if (all[k].second)
+                rankSum += rank;
+        double t = static_cast<double>(j - i);
+        tieTerm += t * t * t - t;
+        i = j;
+    }
+
+    double a = static_cast<double>(n1);
+    double b = static_cast<double>(n2);
+    double n = a + b;
+    double u = rankSum - a * (a + 1.0) / 2.0;
+    double mean = a * b / 2.0;
+    double variance = a * b / 12.0 * ((n + 1.0) - tieTerm / (n * (n - 1.0)));
+    if (variance <= 0.0)
+        return u > mean ? 0.0 : 1.0;
+    double z = (u - mean - 0.5) / std::sqrt(variance);
+    return 0.5 * std::erfc(z / std::sqrt(2.0));
+}
+
+// `substring = percent` lines; '#' and ';' start comments like the config file
+bool LoadThresholds(const std::string& path, std::vector<std::pair<std::string, double>>& out) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "cannot open " << path << std::endl;
+        return false;
+    }
+    auto trim = [](std::string s) {
+        size_t b = s.find_first_not_of(" \t\r");
+        size_t e = s.find_last_not_of(" \t\r");
+        return b == std::string::npos ? std::string() : s.substr(b, e - b + 1);
+    };
+    std::string line;
+    for (int number = 1; std::getline(file, line); ++number) {
+        line = trim(line);
+        if (line.empty() || line[0] == '#' || line[0] == ';')
+            continue;
+        size_t eq = line.rfind('=');
+        char* end = nullptr;
+        double pct = eq == std::string::npos ? 0.0 : std::strtod(line.c_str() + eq + 1, &end);
+        if (eq == std::string::npos || end == line.c_str() + eq + 1 || pct < 0.0) {
+            std::cerr << path << ":" << number << ": expected 'name = percent'" << std::endl;
+            return false;
+        }
+        out.emplace_back(trim(line.substr(0, eq)), pct);
+    }
+    return true;
+}
+
+int Usage() {
+    std::cerr << "usage: bench_compare <baseline.json> <current.json> [--alpha <p>]\n"
+                 "                     [--threshold <pct>] [--thresholds <file>] [--gate <tag>]..."
+              << std::endl;
+    return 2;
+}
+
+std::string Format(const char* fmt, double value) {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), fmt, value);
+    return buf;
+}
+
+std::string FormatNs(double ns) {
+    if (ns >= 1e9)
+        return Format("%.2f s", ns / 1e9);
+    if (ns >= 1e6)
+        return Format("%.2f ms", ns / 1e6);
+    if (ns >= 1e3)
+        return Format("%.2f us", ns / 1e3);
+    return Format("%.1f ns", ns);
+}
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::vector<std::string> positional;
+    double alpha = 0.01;
+    double defaultThreshold = 10.0;
+    std::vector<std::pair<std::string, double>> thresholds;
+    std::vector<std::string> gates;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--alpha" && hasValue) {
+            alpha = std::atof(argv[++i]);
+        } else if (arg == "--threshold" && hasValue) {
+            defaultThreshold = std::atof(argv[++i]);
+        } else if (arg == "--thresholds" && hasValue) {
+            if (!LoadThresholds(argv[++i], thresholds))
+                return 2;
+        } else if (arg == "--gate" && hasValue) {
+            gates.push_back(argv[++i]);
+        } else if (arg.rfind("--", 0) == 0) {
+            return Usage();
+        } else {
+            positional.push_back(arg);
+        }
+    }
+    if (positional.size() != 2 || alpha <= 0.0 || alpha >= 1.0)
+        return Usage();
+    if (gates.empty())
+        gates = {"[log]", "[config]", "[layout]"};
+
+    BenchmarkSet baseline;
+    BenchmarkSet current;
+    if (!LoadResults(positional[0], baseline) || !LoadResults(positional[1], current))
+        return 2;
+
+    size_t regressions = 0;
+    size_t gatedRegressions = 0;
+    size_t unrecorded = 0;
+    std::printf("%-10s %-64s %12s %12s %9s %9s\n", "status", "benchmark", "baseline", "current", "change",
+                "p");
+    for (const auto& [key, bench] : current) {
+        bool gated = std::any_of(gates.begin(), gates.end(),
+                                 [&](const std::string& tag) { return bench.tags.find(tag) != std::string::npos; });
+        auto it = baseline.find(key);
+        if (it == baseline.end()) {
+            std::printf("%-10s %s\n", gated ? "UNRECORDED" : "new", key.c_str());
+            if (gated)
+                ++unrecorded;
+            continue;
+        }
+        double threshold = defaultThreshold;
+        for (const auto& [pattern, pct] : thresholds)
+            if (key.find(pattern) != std::string::npos)
+                threshold = pct;
+
+        double before = Median(it->second.samples);
+        double after = Median(bench.samples);
+        double change = before > 0.0 ? (after / before - 1.0) * 100.0 : 0.0;
+        double p = MannWhitneyGreater(it->second.samples, bench.samples);
+        const char* status = "ok";
+        if (p < alpha && change > threshold) {
+            ++regressions;
+            status = gated ? "REGRESSED" : "slower";
+            if (gated)
+                ++gatedRegressions;
+        } else if (MannWhitneyGreater(bench.samples, it->second.samples) < alpha && change < -threshold) {
+            status = "faster";
+        }
+        std::printf("%-10s %-64.64s %12s %12s %8.1f%% %9.2g\n", status, key.c_str(), FormatNs(before).c_str(),
+                    FormatNs(after).c_str(), change, p);
+    }
+    for (const auto& entry : baseline)
+        if (!current.count(entry.first))
+            std::printf("%-10s %s\n", "missing", entry.first.c_str());
+
+    std::printf("\n%zu benchmark(s) slower than their threshold (alpha %.3g), %zu gated\n", regressions, alpha,
+                gatedRegressions);
+    if (unrecorded)
+        std::printf("%zu gated benchmark(s) have no baseline; record one with scripts/bench_baseline.sh --update\n",
+                    unrecorded);
+    return gatedRegressions || unrecorded ? 1 : 0;
+}
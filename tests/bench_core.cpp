@@ -0,0 +1,398 @@
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include "windows_stub.h"
+#include "../source/app_state.h"
+#include "../source/config_parser.h"
+#include "../source/configuration.h"
+#include "../source/layout_event_ring.h"
+#include "../source/layout_pipeline.h"
+#include "../source/log.h"
+#include "../source/shared_memory.h"
+#include "../source/utils.h"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#ifndef _WIN32
+#include <unistd.h>
+#include "memory_registry.h"
+#endif
+
+namespace {
+namespace fs = std::filesystem;
+
+std::vector<std::wstring> MakeConfigLines(size_t count) {
+    static const wchar_t* kSamples[] = {
+        L"DEBUG=1",
+        L"  tray_icon = 0  ",
+        L"# comment line",
+        L"; another comment",
+        L"LOG_PATH=$HOME/kbdlayoutmon.log",
+        L"max_log_size_mb=10",
+        L"",
+        L"temp_hotkey_timeout=10000",
+    };
+    std::vector<std::wstring> lines;
+    lines.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        if (i % 8 == 7)
+            lines.push_back(L"custom_key_" + std::to_wstring(i) + L"=value " + std::to_wstring(i));
+        else
+            lines.push_back(kSamples[i % 8]);
+    }
+    return lines;
+}
+
+std::wstring JoinLines(const std::vector<std::wstring>& lines) {
+    std::wstring text;
+    for (const auto& line : lines)
+        text += line + L"\n";
+    return text;
+}
+
+void SetEnv(const char* name, const char* value) {
+#ifdef _WIN32
+    _putenv_s(name, value);
+#else
+    setenv(name, value, 1);
+#endif
+}
+
+// Directory removed when the benchmark case ends
+struct ScratchDir {
+    fs::path path;
+    explicit ScratchDir(const char* name) : path(fs::temp_directory_path() / name) {
+        fs::remove_all(path);
+        fs::create_directories(path);
+    }
+    ~ScratchDir() {
+        std::error_code ec;
+        fs::remove_all(path, ec);
+    }
+};
+
+// Restores logging globals touched by a benchmark
+struct LogSettings {
+    bool debug = GetAppState().debugEnabled.load();
+    LogLevel level = g_logLevel.load();
+    LogSettings() {
+        GetAppState().debugEnabled.store(true);
+        g_logLevel.store(LogLevel::Info);
+    }
+    ~LogSettings() {
+        GetAppState().debugEnabled.store(debug);
+        g_logLevel.store(level);
+    }
+};
+} // namespace
+
+TEST_CASE("Config parsing", "[benchmark][config]") {
+    auto small = MakeConfigLines(16);
+    auto large = MakeConfigLines(100000);
+    std::wstring smallText = JoinLines(small);
+    std::wstring largeText = JoinLines(large);
+    SetEnv("HOME", "/home/bench");
+
+    BENCHMARK("ParseConfigLines 16 lines") {
+        return ParseConfigLines(small);
+    };
+
+    BENCHMARK("ParseConfigLines 100k lines") {
+        return ParseConfigLines(large);
+    };
+
+    BENCHMARK_ADVANCED("ParseConfigStream 16 lines")(Catch::Benchmark::Chronometer meter) {
+        std::vector<std::wistringstream> streams(static_cast<size_t>(meter.runs()));
+        for (auto& s : streams)
+            s.str(smallText);
+        meter.measure([&](int i) { return ParseConfigStream(streams[static_cast<size_t>(i)]); });
+    };
+
+    BENCHMARK_ADVANCED("ParseConfigStream 100k lines")(Catch::Benchmark::Chronometer meter) {
+        std::vector<std::wistringstream> streams(static_cast<size_t>(meter.runs()));
+        for (auto& s : streams)
+            s.str(largeText);
+        meter.measure([&](int i) { return ParseConfigStream(streams[static_cast<size_t>(i)]); });
+    };
+}
+
+TEST_CASE("Config file load", "[benchmark][config]") {
+    ScratchDir dir("immon_bench_config");
+    fs::path path = dir.path / "kbdlayoutmon.config";
+    {
+        std::ofstream out(path, std::ios::binary);
+        out << "\xEF\xBB\xBF";
+        for (const auto& line : MakeConfigLines(100000)) {
+            std::string narrow(line.begin(), line.end());
+            out << narrow << "\r\n";
+        }
+    }
+    SetEnv("HOME", "/home/bench");
+
+    BENCHMARK("ReadConfigFile+ParseConfigText 100k-line file") {
+        std::wstring text;
+        ReadConfigFile(path.wstring(), text);
+        return ParseConfigText(text);
+    };
+
+    std::wstring text;
+    ReadConfigFile(path.wstring(), text);
+    BENCHMARK("ParseConfigText 100k lines") {
+        return ParseConfigText(text);
+    };
+
+    BENCHMARK("Configuration::load 100k-line file") {
+        Configuration config;
+        config.setBinaryCache(false);
+        config.load(path.wstring());
+        return config.snapshot();
+    };
+
+    // Reloads of an unchanged file: hashed content, then stat only
+    Configuration config;
+    config.load(path.wstring());
+    BENCHMARK("Configuration::load unchanged content") {
+        fs::last_write_time(path, fs::file_time_type::clock::now());
+        config.load();
+    };
+    fs::last_write_time(path, fs::file_time_type::clock::now() - std::chrono::hours(1));
+    config.load();
+    BENCHMARK("Configuration::load unchanged stamp") {
+        config.load();
+    };
+}
+
+TEST_CASE("Configuration cold start", "[benchmark][config]") {
+    ScratchDir dir("immon_bench_startup");
+    auto environment = EnvironmentSnapshot::Capture();
+    for (size_t count : {size_t(16), size_t(100000)}) {
+        fs::path path = dir.path / ("kbdlayoutmon_" + std::to_string(count) + ".config");
+        {
+            std::ofstream out(path, std::ios::binary);
+            for (const auto& line : MakeConfigLines(count)) {
+                std::string narrow(line.begin(), line.end());
+                out << narrow << "\r\n";
+            }
+        }
+        // A first process parses the text and leaves the cache behind
+        auto coldLoad = [&](bool cache) {
+            Configuration config;
+            config.setEnvironment(environment);
+            config.setBinaryCache(cache);
+            config.load(path.wstring());
+            return config.snapshot();
+        };
+        coldLoad(true);
+
+        BENCHMARK("cold load " + std::to_string(count) + " lines from text") {
+            return coldLoad(false);
+        };
+        BENCHMARK("cold load " + std::to_string(count) + " lines from binary cache") {
+            return coldLoad(true);
+        };
+    }
+}
+
+TEST_CASE("Configuration::get under reader contention", "[benchmark][config]") {
+    Configuration config;
+    for (int i = 0; i < 64; ++i)
+        config.set(L"key_" + std::to_wstring(i), L"value_" + std::to_wstring(i));
+    constexpr int kLookups = 10000;
+
+    BENCHMARK("get single reader") {
+        return config.get(L"key_42");
+    };
+
+    BENCHMARK("snapshot find single reader") {
+        return config.snapshot()->find(L"key_42") != nullptr;
+    };
+
+    config.set(L"max_log_size_mb", L"10");
+    BENCHMARK("get known key by name") {
+        return config.get(L"max_log_size_mb");
+    };
+
+    BENCHMARK("get known key by ConfigKey") {
+        return config.get(ConfigKey::MaxLogSizeMb);
+    };
+
+    for (int readers : {2, 4, 8}) {
+        BENCHMARK("get " + std::to_string(readers) + " readers x " + std::to_string(kLookups)) {
+            std::atomic<size_t> found{0};
+            std::vector<std::thread> threads;
+            for (int t = 0; t < readers; ++t) {
+                threads.emplace_back([&, t] {
+                    size_t local = 0;
+                    for (int i = 0; i < kLookups; ++i)
+                        local += config.get(L"key_" + std::to_wstring((i + t) % 64)).has_value();
+                    found.fetch_add(local);
+                });
+            }
+            for (auto& th : threads)
+                th.join();
+            return found.load();
+        };
+    }
+}
+
+TEST_CASE("Log::write with concurrent producers", "[benchmark][log]") {
+    LogSettings settings;
+    ScratchDir dir("immon_bench_log");
+    g_config.set(L"log_path", (dir.path / "bench.log").wstring());
+    g_config.set(L"max_log_size_mb", L"64");
+    constexpr int kMessages = 200;
+
+    for (int producers : {1, 2, 4, 8, 16}) {
+        // Caller-side cost: producers only enqueue; the writer drains afterwards
+        BENCHMARK_ADVANCED("enqueue " + std::to_string(producers) + " producers x " +
+                           std::to_string(kMessages))(Catch::Benchmark::Chronometer meter) {
+            Log log(1u << 20, false);
+            meter.measure([&] {
+                std::vector<std::thread> threads;
+                for (int p = 0; p < producers; ++p) {
+                    threads.emplace_back([&] {
+                        for (int i = 0; i < kMessages; ++i)
+                            log.write(LogLevel::Info, L"benchmark message");
+                    });
+                }
+                for (auto& th : threads)
+                    th.join();
+            });
+        };
+
+        // Throughput: every message is written before the measurement ends
+        BENCHMARK("write+flush " + std::to_string(producers) + " producers x " + std::to_string(kMessages)) {
+            Log log(1u << 20);
+            std::vector<std::thread> threads;
+            for (int p = 0; p < producers; ++p) {
+                threads.emplace_back([&] {
+                    for (int i = 0; i < kMessages; ++i)
+                        log.write(LogLevel::Info, L"benchmark message");
+                });
+            }
+            for (auto& th : threads)
+                th.join();
+            log.shutdown();
+        };
+    }
+    g_config.set(L"max_log_size_mb", L"10");
+}
+
+TEST_CASE("Log rotation cost by backup count", "[benchmark][log]") {
+    LogSettings settings;
+    ScratchDir dir("immon_bench_rotate");
+    g_config.set(L"max_log_size_mb", L"1");
+
+    for (int backups : {0, 1, 4, 16}) {
+        BENCHMARK_ADVANCED("rotate with " + std::to_string(backups) + " backups")(Catch::Benchmark::Chronometer meter) {
+            // One directory per run: an oversized (sparse) log plus a full
+            // set of backups, so every measured write rotates.
+            std::vector<std::wstring> paths;
+            for (int run = 0; run < meter.runs(); ++run) {
+                fs::path runDir = dir.path / (std::to_string(backups) + "_" + std::to_string(run));
+                fs::create_directories(runDir);
+                fs::path log = runDir / "rotate.log";
+                { std::ofstream(log).put('x'); }
+                fs::resize_file(log, 2 * 1024 * 1024);
+                for (int b = 1; b <= backups; ++b)
+                    std::ofstream(log.string() + "." + std::to_string(b)) << "backup";
+                paths.push_back(log.wstring());
+            }
+            g_config.set(L"max_log_backups", std::to_wstring(backups));
+            meter.measure([&](int run) {
+                g_config.set(L"log_path", paths[static_cast<size_t>(run)]);
+                WriteLog(LogLevel::Info, L"rotate");
+            });
+            for (const auto& p : paths)
+                fs::remove_all(fs::path(p).parent_path());
+        };
+    }
+    g_config.set(L"max_log_size_mb", L"10");
+    g_config.set(L"max_log_backups", L"5");
+}
+
+TEST_CASE("Environment expansion", "[benchmark][utils]") {
+    SetEnv("IMMON_BENCH_DIR", "/var/tmp/kbdlayoutmon");
+    SetEnv("IMMON_BENCH_NAME", "layout");
+
+    BENCHMARK("ExpandEnvVars no references") {
+        return ExpandEnvVars(L"C:\\Program Files\\kbdlayoutmon\\kbdlayoutmon.log");
+    };
+    BENCHMARK("ExpandEnvVars %VAR%") {
+        return ExpandEnvVars(L"%IMMON_BENCH_DIR%\\kbdlayoutmon.log");
+    };
+    BENCHMARK("ExpandEnvVars mixed x4") {
+        return ExpandEnvVars(L"$IMMON_BENCH_DIR/${IMMON_BENCH_NAME}/%IMMON_BENCH_NAME%-$IMMON_BENCH_NAME.log");
+    };
+
+    auto environment = EnvironmentSnapshot::Capture();
+    BENCHMARK("ExpandEnvVars mixed x4 from snapshot") {
+        return ExpandEnvVars(L"$IMMON_BENCH_DIR/${IMMON_BENCH_NAME}/%IMMON_BENCH_NAME%-$IMMON_BENCH_NAME.log",
+                             environment.get());
+    };
+}
+
+TEST_CASE("Command line quoting", "[benchmark][utils]") {
+    std::wstring plain = L"C:\\Program Files\\kbdlayoutmon\\kbdlayoutmon.exe";
+    std::wstring awkward = L"C:\\dir with \"quotes\"\\trailing\\\\";
+    std::wstring longPath;
+    for (int i = 0; i < 32; ++i)
+        longPath += L"C:\\segment " + std::to_wstring(i) + L"\\";
+
+    BENCHMARK("QuotePath plain") {
+        return QuotePath(plain);
+    };
+    BENCHMARK("QuotePath quotes and trailing backslashes") {
+        return QuotePath(awkward);
+    };
+    BENCHMARK("QuotePath 32 segments") {
+        return QuotePath(longPath);
+    };
+}
+
+TEST_CASE("Layout pipeline", "[benchmark][layout]") {
+    static const uint64_t kLayouts[] = {0x04090409, 0x040C040C, 0x04070407, 0xF0020409};
+    BENCHMARK("GetLayoutNames cached") {
+        return GetLayoutNames(kLayouts[1]);
+    };
+
+    BENCHMARK("ResolveLayoutNames uncached") {
+        return ResolveLayoutNames(kLayouts[3]);
+    };
+
+#ifndef _WIN32
+    std::wstring ringName = L"immon_bench_ring_" + std::to_wstring(getpid());
+    LayoutEventRing ring;
+    REQUIRE(ring.open(ringName));
+    BENCHMARK("LayoutEventRing push+pop") {
+        LayoutEvent event;
+        event.hkl = kLayouts[0];
+        event.timestampNs = LayoutEventClockNs();
+        ring.push(event);
+        ring.pop(event);
+        return event.hkl;
+    };
+    ring.close();
+    SharedMemory::unlink(ringName);
+
+    // Full event handling minus the log: resolve, then the three registry
+    // writes against the in-memory registry
+    auto ignore = [](LogLevel, const std::wstring&) {};
+    MemoryRegistry& registry = MemoryRegistry::instance();
+    registry.clear();
+    registry.install();
+    BENCHMARK_ADVANCED("resolve+persist")(Catch::Benchmark::Chronometer meter) {
+        meter.measure([&](int i) {
+            LayoutNames names = GetLayoutNames(kLayouts[static_cast<size_t>(i) % 4]);
+            return SetDefaultInputMethodInRegistry(names.localeID, names.klid, ignore);
+        });
+    };
+    registry.uninstall();
+    registry.clear();
+#endif
+}
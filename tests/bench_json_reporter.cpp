@@ -0,0 +1,98 @@
+// Catch2 reporter that writes benchmark results as JSON for charting and
+// baseline comparison. Select it with `--reporter benchjson` (optionally
+// `--reporter benchjson::out=results.json`).
+//
+// {
+//   "schema": 1,
+//   "executable": "bench_core",
+//   "benchmarks": [
+//     { "test_case": "...", "tags": "[benchmark][log]", "name": "...", "iterations": 1, "mean_ns": 1.0,
+//       "mean_low_ns": 1.0, "mean_high_ns": 1.0, "stddev_ns": 1.0,
+//       "outlier_variance": 0.0, "samples_ns": [ ... ] }
+//   ]
+// }
+#include <catch2/reporters/catch_reporter_registrars.hpp>
+#include <catch2/reporters/catch_reporter_streaming_base.hpp>
+#include <cstdio>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace {
+std::string JsonString(const std::string& text) {
+    std::string out = "\"";
+    for (char c : text) {
+        switch (c) {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\t': out += "\\t"; break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                char buf[8];
+                std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+                out += buf;
+            } else {
+                out += c;
+            }
+        }
+    }
+    return out + "\"";
+}
+
+std::string JsonNumber(double value) {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%.6g", value);
+    return buf;
+}
+
+class BenchJsonReporter : public Catch::StreamingReporterBase {
+public:
+    BenchJsonReporter(Catch::ReporterConfig&& config) : StreamingReporterBase(CATCH_MOVE(config)) {
+        m_preferences.shouldReportAllAssertions = false;
+    }
+
+    static std::string getDescription() { return "Benchmark results as JSON"; }
+
+    void testRunStarting(Catch::TestRunInfo const& info) override {
+        StreamingReporterBase::testRunStarting(info);
+        m_stream << "{\n  \"schema\": 1,\n  \"executable\": " << JsonString(std::string(info.name))
+                 << ",\n  \"benchmarks\": [";
+    }
+
+    void benchmarkEnded(Catch::BenchmarkStats<> const& stats) override {
+        m_stream << (m_count++ ? ",\n" : "\n") << "    {\"test_case\": "
+                 << JsonString(currentTestCaseInfo ? currentTestCaseInfo->name : std::string())
+                 << ", \"tags\": " << JsonString(currentTestCaseInfo ? currentTestCaseInfo->tagsAsString() : std::string())
+                 << ", \"name\": " << JsonString(stats.info.name)
+                 << ", \"iterations\": " << stats.info.iterations
+                 << ", \"mean_ns\": " << JsonNumber(stats.mean.point.count())
+                 << ", \"mean_low_ns\": " << JsonNumber(stats.mean.lower_bound.count())
+                 << ", \"mean_high_ns\": " << JsonNumber(stats.mean.upper_bound.count())
+                 << ", \"stddev_ns\": " << JsonNumber(stats.standardDeviation.point.count())
+                 << ", \"outlier_variance\": " << JsonNumber(stats.outlierVariance) << ", \"samples_ns\": [";
+        for (size_t i = 0; i < stats.samples.size(); ++i)
+            m_stream << (i ? ", " : "") << JsonNumber(stats.samples[i].count());
+        m_stream << "]}";
+    }
+
+    void benchmarkFailed(Catch::StringRef error) override {
+        m_failures.push_back(std::string(error));
+    }
+
+    void testRunEnded(Catch::TestRunStats const& stats) override {
+        StreamingReporterBase::testRunEnded(stats);
+        m_stream << "\n  ],\n  \"failures\": [";
+        for (size_t i = 0; i < m_failures.size(); ++i)
+            m_stream << (i ? ", " : "") << JsonString(m_failures[i]);
+        m_stream << "]\n}\n";
+        m_stream.flush();
+    }
+
+private:
+    size_t m_count = 0;
+    std::vector<std::string> m_failures;
+};
+} // namespace
+
+CATCH_REGISTER_REPORTER("benchjson", BenchJsonReporter)
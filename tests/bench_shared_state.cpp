@@ -0,0 +1,37 @@
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include "../source/shared_memory.h"
+#include "../source/shared_state.h"
+#include <mutex>
+
+TEST_CASE("Shared state page snapshot and counter cost", "[benchmark]") {
+    const std::wstring name = L"immon_bench_state";
+    SharedMemory::unlink(name);
+    SharedStatePage page;
+    REQUIRE(page.openForPublish(name));
+
+    BENCHMARK("seqlock snapshot read") {
+        return page.read();
+    };
+
+    BENCHMARK("seqlock publish") {
+        page.setDebugEnabled(true);
+    };
+
+    BENCHMARK("interlocked reference count") {
+        page.incrementRefCount();
+        return page.decrementRefCount();
+    };
+
+    // Baseline matching the former mutex-guarded reference count.
+    std::mutex mutex;
+    long refCount = 0;
+    BENCHMARK("mutex reference count") {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++refCount;
+        return --refCount;
+    };
+
+    page.close();
+    SharedMemory::unlink(name);
+}
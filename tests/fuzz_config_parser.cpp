@@ -0,0 +1,125 @@
+// Fuzz target for the configuration file decoder and parser.
+//
+// Built with clang and -DIMMON_FUZZ=ON this is a libFuzzer target:
+//   fuzz_config_parser corpus_dir/
+// Otherwise a small driver replays the given files, or feeds pseudo-random
+// inputs assembled from configuration-shaped fragments:
+//   fuzz_config_parser [--iterations <n>] [--seed <n>] [file...]
+//
+// Besides crashes and sanitizer reports, every input is checked for the
+// parser's invariants: text and line parsing agree, keys are lower case and
+// known keys only ever hold normalized values.
+#include "../source/config_parser.h"
+#include "../source/config_schema.h"
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cwctype>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+void Check(bool condition, const char* what) {
+    if (!condition) {
+        std::fprintf(stderr, "invariant violated: %s\n", what);
+        std::abort();
+    }
+}
+} // namespace
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    std::wstring text;
+    DecodeConfigBytes(data, size, text);
+    ConfigMap parsed = ParseConfigText(text);
+
+    std::vector<std::wstring> lines;
+    for (size_t start = 0;;) {
+        size_t end = text.find(L'\n', start);
+        lines.push_back(text.substr(start, end == std::wstring::npos ? std::wstring::npos : end - start));
+        if (end == std::wstring::npos)
+            break;
+        start = end + 1;
+    }
+    Check(ParseConfigLines(lines) == parsed, "text and line parsing differ");
+
+    for (const auto& [key, value] : parsed) {
+        for (wchar_t c : key)
+            Check(static_cast<wchar_t>(std::towlower(c)) == c, "key not lower case");
+        if (const ConfigKeyInfo* info = FindConfigKey(key)) {
+            std::wstring normalized;
+            Check(NormalizeConfigValue(*info, value, normalized) && normalized == value,
+                  "known key holds a non-normalized value");
+        }
+    }
+    BuildConfigSettings(parsed);
+    return 0;
+}
+
+#ifndef IMMON_LIBFUZZER
+namespace {
+std::string RandomInput(std::mt19937& rng) {
+    static const char* kFragments[] = {
+        "debug", "DEBUG", "tray_icon", "max_log_size_mb", "max_queue_size", "log_level", "hook_mode",
+        "log_path", "custom_key", "=", "==", " ", "\t", "\r\n", "\n", "#", ";", "\"", "'", "1", "0",
+        "true", "off", "Warn", "LIGHT", "4294967296", "-1", "10000", "%HOME%", "$HOME", "${HOME}", "${",
+        "%", "$", "\xEF\xBB\xBF", "\xFF\xFE", "\xFE\xFF", "\xC3\xA9", "\xF0\x9F\x98\x80", "\xED\xA0\x80",
+        "\xC0\xAF", "\x80", "\xFF", "\0",
+    };
+    std::uniform_int_distribution<size_t> pick(0, std::size(kFragments) - 1);
+    std::uniform_int_distribution<int> count(0, 64);
+    std::uniform_int_distribution<int> byte(0, 255);
+    std::string input;
+    int n = count(rng);
+    for (int i = 0; i < n; ++i) {
+        if (byte(rng) < 16) {
+            input.push_back(static_cast<char>(byte(rng)));
+            continue;
+        }
+        // The empty fragment stands for an embedded NUL
+        const char* fragment = kFragments[pick(rng)];
+        input.append(fragment, fragment[0] ? std::strlen(fragment) : 1);
+    }
+    return input;
+}
+} // namespace
+
+int main(int argc, char* argv[]) {
+    unsigned long iterations = 10000;
+    unsigned long seed = 1;
+    std::vector<const char*> files;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--iterations") == 0 && i + 1 < argc)
+            iterations = std::strtoul(argv[++i], nullptr, 10);
+        else if (std::strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+            seed = std::strtoul(argv[++i], nullptr, 10);
+        else
+            files.push_back(argv[i]);
+    }
+
+    if (!files.empty()) {
+        for (const char* path : files) {
+            std::ifstream file(path, std::ios::binary);
+            if (!file) {
+                std::fprintf(stderr, "cannot open %s\n", path);
+                return 2;
+            }
+            std::string bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+            LLVMFuzzerTestOneInput(reinterpret_cast<const uint8_t*>(bytes.data()), bytes.size());
+        }
+        std::printf("%zu file(s) passed\n", files.size());
+        return 0;
+    }
+
+    std::mt19937 rng(static_cast<std::mt19937::result_type>(seed));
+    for (unsigned long i = 0; i < iterations; ++i) {
+        std::string input = RandomInput(rng);
+        LLVMFuzzerTestOneInput(reinterpret_cast<const uint8_t*>(input.data()), input.size());
+    }
+    std::printf("%lu random input(s) passed (seed %lu)\n", iterations, seed);
+    return 0;
+}
+#endif
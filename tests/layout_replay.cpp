@@ -0,0 +1,177 @@
+// Replay a recorded layout trace through the host pipeline on Linux.
+//
+//   layout_replay <trace> [--realtime] [--speed <x>] [--log <path>]
+//   layout_replay --generate <count> <trace>
+//
+// Events travel through a LayoutEventRing into a LayoutEventConsumer, are
+// resolved, persisted into MemoryRegistry and logged through Log, exactly
+// as HandleLayoutEvent does for light-mode hooks. The replay prints
+// throughput, per-stage latency and any divergence from the recorded
+// KLIDs or registry writes.
+#include "windows_stub.h"
+#include "memory_registry.h"
+#include "../source/app_state.h"
+#include "../source/configuration.h"
+#include "../source/latency_stats.h"
+#include "../source/layout_pipeline.h"
+#include "../source/layout_trace.h"
+#include "../source/log.h"
+#include <atomic>
+#include <cstdlib>
+#include <cwchar>
+#include <filesystem>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+Log* g_replayLog = nullptr;
+
+void ReplayLogSink(LogLevel level, const std::wstring& message) {
+    g_replayLog->write(level, message);
+}
+
+LatencyStats* g_replayLatency = nullptr;
+void RecordPersisted(uint64_t originNs) {
+    g_replayLatency->recordSince(LatencyStage::LogPersisted, originNs);
+}
+
+std::wstring Widen(const char* text) {
+    std::wstring out;
+    for (; *text; ++text)
+        out.push_back(static_cast<unsigned char>(*text));
+    return out;
+}
+
+int Usage() {
+    std::wcerr << L"usage: layout_replay <trace> [--realtime] [--speed <x>] [--log <path>]\n"
+                  L"       layout_replay --generate <count> <trace>"
+               << std::endl;
+    return 2;
+}
+
+// Synthetic trace cycling through a few common layouts, 1 ms apart
+int Generate(size_t count, const std::wstring& path) {
+    static const uint64_t kLayouts[] = {0x04090409, 0x040C040C, 0x04070407, 0xF0020409, 0x08040804};
+    LayoutTraceWriter writer;
+    if (!writer.open(path)) {
+        std::wcerr << L"cannot create " << path << std::endl;
+        return 1;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        LayoutTraceRecord record;
+        record.timestampNs = static_cast<uint64_t>(i) * 1000000ull;
+        record.hkl = kLayouts[i % (sizeof(kLayouts) / sizeof(kLayouts[0]))];
+        record.pid = 1000 + static_cast<uint32_t>(i % 7);
+        record.sequence = static_cast<uint32_t>(i + 1);
+        LayoutNames names = ResolveLayoutNames(record.hkl);
+        record.klid = static_cast<uint32_t>(std::wcstoul(names.klid, nullptr, 16));
+        record.langId = static_cast<uint16_t>(std::wcstoul(names.localeID, nullptr, 16));
+        record.writes = LayoutWritePreload | LayoutWriteDefaultPreload | LayoutWriteOverride;
+        writer.append(record);
+    }
+    std::wcout << L"wrote " << count << L" events to " << path << std::endl;
+    return 0;
+}
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 2)
+        return Usage();
+    std::string first = argv[1];
+    if (first == "--generate") {
+        if (argc != 4)
+            return Usage();
+        return Generate(std::strtoull(argv[2], nullptr, 10), Widen(argv[3]));
+    }
+
+    std::wstring tracePath = Widen(argv[1]);
+    LayoutReplayOptions options;
+    std::wstring logPath = (std::filesystem::temp_directory_path() / "layout_replay.log").wstring();
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--realtime") {
+            options.realtime = true;
+        } else if (arg == "--speed" && i + 1 < argc) {
+            options.speed = std::strtod(argv[++i], nullptr);
+        } else if (arg == "--log" && i + 1 < argc) {
+            logPath = Widen(argv[++i]);
+        } else {
+            return Usage();
+        }
+    }
+
+    std::vector<LayoutTraceRecord> records;
+    if (!ReadLayoutTrace(tracePath, records)) {
+        std::wcerr << L"cannot read trace " << tracePath << std::endl;
+        return 1;
+    }
+
+    GetAppState().debugEnabled.store(true);
+    g_logLevel.store(LogLevel::Info);
+    g_config.set(L"log_path", logPath);
+
+    MemoryRegistry& registry = MemoryRegistry::instance();
+    registry.clear();
+    registry.install();
+
+    std::wstring latencyName = L"kbdlayoutmon_replay_latency";
+    SharedMemory::unlink(latencyName);
+    LatencyStats latency;
+    latency.open(latencyName);
+    g_replayLatency = &latency;
+
+    Log log;
+    g_replayLog = &log;
+    log.setPersistedCallback(RecordPersisted);
+
+    // The consumer is a single thread and the ring is FIFO, so the n-th
+    // handled event is records[n].
+    size_t index = 0;
+    size_t klidMismatches = 0;
+    size_t writeMismatches = 0;
+    auto handler = [&](const LayoutEvent& event) {
+        const LayoutTraceRecord& recorded = records[index++];
+        LayoutTimeline timeline{&latency, event.timestampNs};
+        timeline.mark(LatencyStage::Dequeued);
+        LayoutNames names = GetLayoutNames(event.hkl);
+        std::wstringstream ss;
+        ss << L"Keyboard layout changed. Locale ID: " << names.localeID << L", KLID: " << names.klid
+           << L" (event " << event.sequence << L", pid " << event.pid << L")";
+        log.write(LogLevel::Info, ss.str(), event.timestampNs);
+        if (static_cast<uint32_t>(std::wcstoul(names.klid, nullptr, 16)) != recorded.klid)
+            ++klidMismatches;
+        unsigned writes = 0;
+        if (!(recorded.flags & LayoutTraceRecord::kSkipped))
+            writes = SetDefaultInputMethodInRegistry(names.localeID, names.klid, ReplayLogSink, timeline);
+        if (writes != recorded.writes)
+            ++writeMismatches;
+    };
+
+    LayoutReplayResult result;
+    bool ok = ReplayLayoutTrace(records, handler, options, result);
+    log.shutdown();
+    registry.uninstall();
+    if (!ok) {
+        std::wcerr << L"replay failed to map the event ring" << std::endl;
+        return 1;
+    }
+
+    double seconds = static_cast<double>(result.elapsedNs) / 1e9;
+    std::wcout << L"events: " << result.events << L"\n"
+               << L"elapsed: " << seconds << L" s\n"
+               << L"throughput: " << (seconds > 0 ? static_cast<double>(result.events) / seconds : 0.0)
+               << L" events/s\n"
+               << L"klid mismatches: " << klidMismatches << L"\n"
+               << L"registry write mismatches: " << writeMismatches << L"\n"
+               << L"registry writes: " << registry.writes() << L"\n";
+    if (auto value = registry.value(HKEY_CURRENT_USER, L"Control Panel\\International\\User Profile",
+                                    L"InputMethodOverride"))
+        std::wcout << L"final InputMethodOverride: " << *value << L"\n";
+    std::wcout << latency.report() << std::flush;
+
+    latency.close();
+    SharedMemory::unlink(latencyName);
+    return (klidMismatches || writeMismatches) ? 3 : 0;
+}
@@ -0,0 +1,79 @@
+#include "memory_registry.h"
+#include <algorithm>
+
+namespace {
+// Handles below this value are the predefined roots (HKEY_CURRENT_USER, ...)
+constexpr uintptr_t kFirstHandle = 0x1000;
+}
+
+MemoryRegistry& MemoryRegistry::instance() {
+    static MemoryRegistry registry;
+    return registry;
+}
+
+void MemoryRegistry::install() {
+    pRegOpenKeyEx = &MemoryRegistry::Open;
+    pRegSetValueEx = &MemoryRegistry::Set;
+}
+
+void MemoryRegistry::uninstall() {
+    pRegOpenKeyEx = nullptr;
+    pRegSetValueEx = nullptr;
+}
+
+void MemoryRegistry::clear() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_keys.clear();
+    m_values.clear();
+    m_writes = 0;
+}
+
+std::wstring MemoryRegistry::pathOf(HKEY key) const {
+    auto raw = reinterpret_cast<uintptr_t>(key);
+    if (raw >= kFirstHandle && raw - kFirstHandle < m_keys.size())
+        return m_keys[raw - kFirstHandle];
+    return L"root" + std::to_wstring(raw);
+}
+
+std::optional<std::wstring> MemoryRegistry::value(HKEY root, const std::wstring& subKey,
+                                                  const std::wstring& name) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_values.find(pathOf(root) + L"\\" + subKey + L"\\" + name);
+    if (it == m_values.end())
+        return std::nullopt;
+    return it->second;
+}
+
+uint64_t MemoryRegistry::writes() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_writes;
+}
+
+LONG MemoryRegistry::Open(HKEY root, LPCWSTR subKey, DWORD, DWORD, HKEY* result) {
+    MemoryRegistry& self = instance();
+    std::lock_guard<std::mutex> lock(self.m_mutex);
+    std::wstring path = self.pathOf(root);
+    if (subKey && *subKey)
+        path += std::wstring(L"\\") + subKey;
+    auto it = std::find(self.m_keys.begin(), self.m_keys.end(), path);
+    size_t index = static_cast<size_t>(it - self.m_keys.begin());
+    if (it == self.m_keys.end())
+        self.m_keys.push_back(path);
+    if (result)
+        *result = reinterpret_cast<HKEY>(kFirstHandle + index);
+    return ERROR_SUCCESS;
+}
+
+LONG MemoryRegistry::Set(HKEY key, LPCWSTR name, DWORD, DWORD, const BYTE* data, DWORD size) {
+    MemoryRegistry& self = instance();
+    std::lock_guard<std::mutex> lock(self.m_mutex);
+    std::wstring text;
+    if (data && size >= sizeof(wchar_t)) {
+        text.assign(reinterpret_cast<const wchar_t*>(data), size / sizeof(wchar_t));
+        while (!text.empty() && text.back() == L'\0')
+            text.pop_back();
+    }
+    self.m_values[self.pathOf(key) + L"\\" + (name ? name : L"")] = text;
+    ++self.m_writes;
+    return ERROR_SUCCESS;
+}
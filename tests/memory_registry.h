@@ -0,0 +1,47 @@
+#pragma once
+
+#include "windows_stub.h"
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+/**
+ * @brief In-memory stand-in for the registry on non-Windows builds.
+ *
+ * Once installed, RegOpenKeyEx and RegSetValueEx from windows_stub.h store
+ * string values in a map instead of returning canned results, so replayed
+ * or simulated layout changes can be checked for the values they leave
+ * behind. Keys are opened implicitly; handles are reused per path so long
+ * runs do not grow the handle table.
+ */
+class MemoryRegistry {
+public:
+    /// Process-wide instance the stub hooks forward to.
+    static MemoryRegistry& instance();
+
+    /// Route the registry stubs to this instance.
+    void install();
+    /// Restore the canned stub behaviour.
+    void uninstall();
+    /// Drop every stored value and reset the counters.
+    void clear();
+
+    /// Value stored under @p root\\@p subKey, if any.
+    std::optional<std::wstring> value(HKEY root, const std::wstring& subKey, const std::wstring& name) const;
+    /// Number of successful RegSetValueEx calls since the last clear().
+    uint64_t writes() const;
+
+private:
+    static LONG Open(HKEY root, LPCWSTR subKey, DWORD options, DWORD sam, HKEY* result);
+    static LONG Set(HKEY key, LPCWSTR name, DWORD reserved, DWORD type, const BYTE* data, DWORD size);
+
+    std::wstring pathOf(HKEY key) const;
+
+    mutable std::mutex m_mutex;
+    std::vector<std::wstring> m_keys;              ///< Handle index -> path
+    std::map<std::wstring, std::wstring> m_values; ///< "path\\name" -> data
+    uint64_t m_writes = 0;
+};
@@ -0,0 +1,381 @@
+// Long-running load generator for the logging, configuration and layout
+// pipelines. Runs headless on Linux against the test stubs.
+//
+//   soak_tests [--duration <s>] [--producers <n>] [--log-rate <lines/s>]
+//              [--config-rate <rewrites/s>] [--layout-rate <changes/s>]
+//              [--sample-ms <ms>] [--csv <path>]
+//
+// Rates are per producer. Every sample records throughput, queue depths,
+// drop counts, RSS and open descriptors; the run fails (exit code 1) when a
+// gauge or a drop rate keeps growing after warm-up, or when work is lost.
+#include "windows_stub.h"
+#include "memory_registry.h"
+#include "../source/app_state.h"
+#include "../source/config_watcher.h"
+#include "../source/configuration.h"
+#include "../source/latency_stats.h"
+#include "../source/layout_event_consumer.h"
+#include "../source/layout_event_ring.h"
+#include "../source/layout_pipeline.h"
+#include "../source/log.h"
+#include "../source/shared_state.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+extern void (*g_testApplyConfig)(HWND);
+
+namespace {
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+struct SoakOptions {
+    double durationSec = 60;
+    unsigned producers = 4;
+    double logRate = 2000;
+    double configRate = 2;
+    double layoutRate = 200;
+    unsigned sampleMs = 250;
+    std::string csvPath;
+};
+
+struct Sample {
+    double seconds = 0;
+    uint64_t logLines = 0;
+    uint64_t logDropped = 0;
+    size_t logQueue = 0;
+    uint64_t configReloads = 0;
+    uint64_t layoutProduced = 0;
+    uint64_t layoutHandled = 0;
+    uint64_t layoutDropped = 0;
+    size_t ringDepth = 0;
+    uint64_t rssKb = 0;
+    size_t fds = 0;
+};
+
+std::atomic<uint64_t> g_logLines{0};
+std::atomic<uint64_t> g_configReloads{0};
+std::atomic<uint64_t> g_layoutProduced{0};
+std::atomic<uint64_t> g_layoutHandled{0};
+Log* g_soakLog = nullptr;
+LatencyStats* g_soakLatency = nullptr;
+
+void CountReload(HWND) { g_configReloads.fetch_add(1, std::memory_order_relaxed); }
+
+void SoakLogSink(LogLevel level, const std::wstring& message) { g_soakLog->write(level, message); }
+
+void RecordPersisted(uint64_t originNs) {
+    g_soakLatency->recordSince(LatencyStage::LogPersisted, originNs);
+}
+
+uint64_t ResidentKb() {
+    std::ifstream statm("/proc/self/statm");
+    uint64_t pages = 0, resident = 0;
+    statm >> pages >> resident;
+    return resident * static_cast<uint64_t>(sysconf(_SC_PAGESIZE)) / 1024;
+}
+
+size_t OpenDescriptors() {
+    std::error_code ec;
+    size_t count = 0;
+    for (fs::directory_iterator it("/proc/self/fd", ec), end; !ec && it != end; it.increment(ec))
+        ++count;
+    return count;
+}
+
+// Run @p emit so that it has been called rate * elapsed times, checking
+// roughly every millisecond until @p stop is set.
+template <typename Emit>
+void Paced(double rate, const std::atomic<bool>& stop, Emit emit) {
+    if (rate <= 0)
+        return;
+    auto start = Clock::now();
+    uint64_t done = 0;
+    while (!stop.load(std::memory_order_relaxed)) {
+        double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+        auto due = static_cast<uint64_t>(elapsed * rate);
+        for (; done < due && !stop.load(std::memory_order_relaxed); ++done)
+            emit(done);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+void WriteConfig(const fs::path& cfg, const fs::path& logPath, unsigned producer, uint64_t generation) {
+    fs::path tmp = cfg;
+    tmp += ".tmp" + std::to_string(producer);
+    {
+        std::wofstream f(tmp);
+        f << L"log_path=" << logPath.wstring() << L"\n";
+        f << L"max_log_size_mb=1\n";
+        f << L"max_log_backups=2\n";
+        f << L"soak_generation=" << generation << L"\n";
+        f << L"soak_producer=" << producer << L"\n";
+    }
+    std::error_code ec;
+    fs::rename(tmp, cfg, ec);
+}
+
+double Median(std::vector<double> values) {
+    if (values.empty())
+        return 0;
+    std::sort(values.begin(), values.end());
+    return values[values.size() / 2];
+}
+
+/**
+ * Detect a series that keeps climbing: after warm-up the samples are split
+ * into thirds, and growth is reported when each third's median exceeds the
+ * previous one and the last third sits above the first third's peak by more
+ * than @p slack.
+ */
+bool GrowsWithoutBound(const std::vector<double>& series, double slack) {
+    size_t warmup = series.size() / 4;
+    size_t n = series.size() - warmup;
+    if (n < 9)
+        return false;
+    size_t third = n / 3;
+    auto begin = series.begin() + static_cast<std::ptrdiff_t>(warmup);
+    std::vector<double> a(begin, begin + static_cast<std::ptrdiff_t>(third));
+    std::vector<double> b(begin + static_cast<std::ptrdiff_t>(third), begin + static_cast<std::ptrdiff_t>(2 * third));
+    std::vector<double> c(begin + static_cast<std::ptrdiff_t>(2 * third), series.end());
+    double peakA = *std::max_element(a.begin(), a.end());
+    return Median(b) > Median(a) && Median(c) > Median(b) && Median(c) > peakA + slack;
+}
+
+template <typename Field>
+std::vector<double> Series(const std::vector<Sample>& samples, Field field) {
+    std::vector<double> out;
+    for (const auto& s : samples)
+        out.push_back(static_cast<double>(field(s)));
+    return out;
+}
+
+template <typename Field>
+std::vector<double> Rates(const std::vector<Sample>& samples, Field field) {
+    std::vector<double> out;
+    for (size_t i = 1; i < samples.size(); ++i)
+        out.push_back(static_cast<double>(field(samples[i]) - field(samples[i - 1])));
+    return out;
+}
+
+int Usage() {
+    std::cerr << "usage: soak_tests [--duration <s>] [--producers <n>] [--log-rate <n>] [--config-rate <n>]\n"
+                 "                  [--layout-rate <n>] [--sample-ms <ms>] [--csv <path>]"
+              << std::endl;
+    return 2;
+}
+} // namespace
+
+int main(int argc, char** argv) {
+    SoakOptions options;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc)
+            return Usage();
+        const char* value = argv[++i];
+        if (arg == "--duration")
+            options.durationSec = std::strtod(value, nullptr);
+        else if (arg == "--producers")
+            options.producers = static_cast<unsigned>(std::strtoul(value, nullptr, 10));
+        else if (arg == "--log-rate")
+            options.logRate = std::strtod(value, nullptr);
+        else if (arg == "--config-rate")
+            options.configRate = std::strtod(value, nullptr);
+        else if (arg == "--layout-rate")
+            options.layoutRate = std::strtod(value, nullptr);
+        else if (arg == "--sample-ms")
+            options.sampleMs = static_cast<unsigned>(std::strtoul(value, nullptr, 10));
+        else if (arg == "--csv")
+            options.csvPath = value;
+        else
+            return Usage();
+    }
+    if (options.producers == 0 || options.sampleMs == 0)
+        return Usage();
+
+    std::wstring suffix = L"_" + std::to_wstring(static_cast<unsigned long>(getpid()));
+    fs::path dir = fs::temp_directory_path() / ("immon_soak_" + std::to_string(getpid()));
+    fs::create_directories(dir);
+    fs::path cfg = dir / "kbdlayoutmon.config";
+    // Logs live in their own directory so the watcher, which reacts to
+    // every file in the config directory, only sees config rewrites.
+    fs::create_directories(dir / "logs");
+    fs::path logPath = dir / "logs" / "soak.log";
+    WriteConfig(cfg, logPath, 0, 0);
+
+    GetAppState().debugEnabled.store(true);
+    g_logLevel.store(LogLevel::Info);
+    g_config.load(cfg.wstring());
+
+    MemoryRegistry& registry = MemoryRegistry::instance();
+    registry.clear();
+    registry.install();
+
+    SharedStatePage state;
+    LatencyStats latency;
+    LayoutEventRing ring;
+    std::wstring stateName = L"immon_soak_state" + suffix;
+    std::wstring latencyName = L"immon_soak_latency" + suffix;
+    std::wstring ringName = L"immon_soak_events" + suffix;
+    for (const auto& name : {stateName, latencyName, ringName})
+        SharedMemory::unlink(name);
+    if (!state.open(stateName) || !latency.open(latencyName) || !ring.open(ringName)) {
+        std::cerr << "failed to map shared memory" << std::endl;
+        return 1;
+    }
+    g_soakLatency = &latency;
+
+    Log log;
+    g_soakLog = &log;
+    log.setPersistedCallback(RecordPersisted);
+
+    g_testApplyConfig = CountReload;
+    auto watcher = std::make_unique<ConfigWatcher>(nullptr);
+
+    LayoutEventConsumer consumer;
+    consumer.start(
+        [&](const LayoutEvent& event) {
+            LayoutTimeline timeline{&latency, event.timestampNs};
+            timeline.mark(LatencyStage::Dequeued);
+            LayoutNames names = GetLayoutNames(event.hkl);
+            std::wstringstream ss;
+            ss << L"Keyboard layout changed. Locale ID: " << names.localeID << L", KLID: " << names.klid;
+            log.write(LogLevel::Info, ss.str(), event.timestampNs);
+            SetDefaultInputMethodInRegistry(names.localeID, names.klid, SoakLogSink, timeline);
+            g_layoutHandled.fetch_add(1, std::memory_order_relaxed);
+        },
+        ringName);
+
+    static const uint64_t kLayouts[] = {0x04090409, 0x040C040C, 0x04070407, 0x08040804};
+    std::atomic<bool> stop{false};
+    std::vector<std::thread> producers;
+    for (unsigned p = 0; p < options.producers; ++p) {
+        producers.emplace_back([&, p] {
+            Paced(options.logRate, stop, [&](uint64_t n) {
+                log.write(LogLevel::Info, L"soak producer " + std::to_wstring(p) + L" line " + std::to_wstring(n));
+                g_logLines.fetch_add(1, std::memory_order_relaxed);
+            });
+        });
+        producers.emplace_back([&, p] {
+            Paced(options.configRate, stop, [&](uint64_t n) { WriteConfig(cfg, logPath, p, n); });
+        });
+        producers.emplace_back([&, p] {
+            Paced(options.layoutRate, stop, [&](uint64_t n) {
+                uint64_t hkl = kLayouts[(n + p) % (sizeof(kLayouts) / sizeof(kLayouts[0]))];
+                uint64_t sourceNs = LayoutEventClockNs();
+                uint32_t sequence = state.claimLayoutChange(hkl);
+                if (sequence == 0)
+                    return;
+                LayoutEvent event;
+                event.hkl = hkl;
+                event.timestampNs = sourceNs;
+                event.pid = p;
+                event.sequence = sequence;
+                g_layoutProduced.fetch_add(1, std::memory_order_relaxed);
+                if (ring.push(event)) {
+                    latency.recordSince(LatencyStage::Enqueued, sourceNs);
+                    consumer.notify();
+                }
+            });
+        });
+    }
+
+    std::vector<Sample> samples;
+    auto start = Clock::now();
+    auto deadline = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(options.durationSec));
+    auto next = start;
+    for (;;) {
+        next += std::chrono::milliseconds(options.sampleMs);
+        std::this_thread::sleep_until(next);
+        Sample s;
+        s.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        s.logLines = g_logLines.load();
+        s.logDropped = log.dropped();
+        s.logQueue = log.queueSize();
+        s.configReloads = g_configReloads.load();
+        s.layoutProduced = g_layoutProduced.load();
+        s.layoutHandled = g_layoutHandled.load();
+        s.layoutDropped = ring.dropped();
+        s.ringDepth = ring.depth();
+        s.rssKb = ResidentKb();
+        s.fds = OpenDescriptors();
+        samples.push_back(s);
+        if (next >= deadline)
+            break;
+    }
+
+    stop.store(true);
+    for (auto& t : producers)
+        t.join();
+    consumer.stop();
+    watcher.reset();
+    g_testApplyConfig = nullptr;
+    log.shutdown();
+    registry.uninstall();
+
+    if (!options.csvPath.empty()) {
+        std::ofstream csv(options.csvPath);
+        csv << "seconds,log_lines,log_dropped,log_queue,config_reloads,layout_produced,layout_handled,"
+               "layout_dropped,ring_depth,rss_kb,fds\n";
+        for (const auto& s : samples)
+            csv << s.seconds << ',' << s.logLines << ',' << s.logDropped << ',' << s.logQueue << ','
+                << s.configReloads << ',' << s.layoutProduced << ',' << s.layoutHandled << ',' << s.layoutDropped
+                << ',' << s.ringDepth << ',' << s.rssKb << ',' << s.fds << '\n';
+    }
+
+    const Sample& last = samples.back();
+    double seconds = last.seconds > 0 ? last.seconds : 1;
+    std::cout << "duration: " << last.seconds << " s, producers: " << options.producers << "\n"
+              << "log lines: " << last.logLines << " (" << last.logLines / seconds << "/s), dropped "
+              << log.dropped() << "\n"
+              << "config reloads: " << last.configReloads << "\n"
+              << "layout events: " << g_layoutProduced.load() << " produced, " << g_layoutHandled.load()
+              << " handled, " << ring.dropped() << " dropped\n"
+              << "rss: " << samples.front().rssKb << " -> " << last.rssKb << " KiB, fds: " << samples.front().fds
+              << " -> " << last.fds << "\n";
+    std::wcout << latency.report() << std::flush;
+
+    std::vector<std::string> failures;
+    auto check = [&](const char* name, const std::vector<double>& series, double slack) {
+        if (GrowsWithoutBound(series, slack))
+            failures.push_back(std::string(name) + " grows without bound");
+    };
+    check("log queue depth", Series(samples, [](const Sample& s) { return s.logQueue; }), 64);
+    check("layout ring depth", Series(samples, [](const Sample& s) { return s.ringDepth; }), 16);
+    check("rss", Series(samples, [](const Sample& s) { return s.rssKb; }), 4096);
+    check("open descriptors", Series(samples, [](const Sample& s) { return s.fds; }), 4);
+    check("log drop rate", Rates(samples, [](const Sample& s) { return s.logDropped; }), 100);
+    check("layout drop rate", Rates(samples, [](const Sample& s) { return s.layoutDropped; }), 10);
+
+    if (g_layoutHandled.load() + ring.dropped() != g_layoutProduced.load())
+        failures.push_back("layout events lost between ring and consumer");
+    if (options.logRate > 0 && last.logLines == 0)
+        failures.push_back("no log lines were produced");
+    if (options.configRate > 0 && options.durationSec >= 1 && last.configReloads == 0)
+        failures.push_back("configuration was never reloaded");
+    if (options.layoutRate > 0 && g_layoutHandled.load() == 0)
+        failures.push_back("no layout events were handled");
+
+    state.close();
+    latency.close();
+    ring.close();
+    for (const auto& name : {stateName, latencyName, ringName})
+        SharedMemory::unlink(name);
+    std::error_code ec;
+    fs::remove_all(dir, ec);
+
+    for (const auto& f : failures)
+        std::cerr << "FAIL: " << f << std::endl;
+    if (failures.empty())
+        std::cout << "PASS" << std::endl;
+    return failures.empty() ? 0 : 1;
+}
@@ -1,6 +1,8 @@
 #include <string>
 #include <atomic>
 #include <cwchar>
+#include <cstdlib>
+#include <filesystem>
 #include <iostream>
 #include "windows_stub.h"
 #include "../source/app_state.h"
@@ -12,17 +14,25 @@
 
 // CLI helpers used by some tests
 bool g_cliMode = false;
-std::wstring g_cliIconPath;
-std::wstring g_cliTrayTooltip;
 
 // Registry test controls
 LONG g_RegOpenKeyExResult = ERROR_SUCCESS;
 bool g_RegOpenKeyExFailOnSetValue = false;
 LONG g_RegSetValueExResult = ERROR_SUCCESS;
+LONG (*pRegOpenKeyEx)(HKEY, LPCWSTR, DWORD, DWORD, HKEY*) = nullptr;
+LONG (*pRegSetValueEx)(HKEY, LPCWSTR, DWORD, DWORD, const BYTE*, DWORD) = nullptr;
 
 // Sleep tracking for tests that simulate waits
 int g_sleepCalls = 0;
 
+#ifndef _WIN32
+// Keep configuration caches written by tests out of the user's cache directory
+static const bool g_testCacheHome = [] {
+    std::string dir = (std::filesystem::temp_directory_path() / "immon_test_cache").string();
+    return setenv("XDG_CACHE_HOME", dir.c_str(), 1) == 0;
+}();
+#endif
+
 // Global instance handle used by tray/icon/log code
 HINSTANCE g_hInst = nullptr;
 
@@ -141,8 +151,10 @@ DWORD (*pWaitForMultipleObjects)(DWORD, const HANDLE*, BOOL, DWORD) = [](DWORD,
 DWORD (*pWaitForSingleObject)(HANDLE, DWORD) = [](HANDLE, DWORD) -> DWORD { return WAIT_OBJECT_0; };
 DWORD (*pGetModuleFileNameW)(HINSTANCE, wchar_t*, DWORD) = [](HINSTANCE, wchar_t* buffer, DWORD) -> DWORD { if(buffer) buffer[0]=L'\0'; return 0; };
 HANDLE (*pLoadImageW)(HINSTANCE, LPCWSTR, UINT, int, int, UINT) = [](HINSTANCE, LPCWSTR, UINT, int, int, UINT){ return reinterpret_cast<HANDLE>(1); };
+BOOL (*pDestroyIcon)(HICON) = [](HICON) -> BOOL { return TRUE; };
 UINT (*pSetTimer)(HWND, UINT, UINT, TIMERPROC) = [](HWND, UINT, UINT, TIMERPROC) -> UINT { return 1; };
 BOOL (*pKillTimer)(HWND, UINT) = [](HWND, UINT) -> BOOL { return TRUE; };
+BOOL (*pPostMessage)(HWND, UINT, WPARAM, LPARAM) = [](HWND, UINT, WPARAM, LPARAM) -> BOOL { return TRUE; };
 // Minimal defaults for other test-only globals
 int applyCalls = 0;
 std::atomic<bool> g_stopRequested{false};
@@ -150,7 +162,3 @@ std::atomic<bool> g_stopRequested{false};
 int waitCalls = 0;
 DWORD lastBytes = 0;
 
-// ApplyConfig stub needed by config_watcher_posix.cpp on non-Windows
-#ifndef _WIN32
-void ApplyConfig(HWND) { ++applyCalls; }
-#endif
@@ -0,0 +1,122 @@
+#include <catch2/catch_test_macros.hpp>
+#include "../source/config_cache.h"
+#include "../source/config_image.h"
+#include "../source/shared_memory.h"
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <string>
+#include "unique_name.h"
+
+TEST_CASE("Config image round-trips settings", "[config_image]") {
+    ConfigMap settings{
+        {L"debug", L"1"},
+        {L"log_path", L"C:\\logs\\kbdlayoutmon.log"},
+        {L"tray_tooltip", L""},
+        {L"max_log_size_mb", L"10"}};
+    std::vector<unsigned char> image = SerializeConfigImage(settings, 7);
+
+    ConfigImageView view;
+    REQUIRE(view.attach(image.data(), image.size()));
+    REQUIRE(view.generation() == 7);
+    REQUIRE(view.size() == settings.size());
+    REQUIRE(view.get(L"debug") == std::wstring_view(L"1"));
+    REQUIRE(view.get(L"log_path") == std::wstring_view(L"C:\\logs\\kbdlayoutmon.log"));
+    REQUIRE(view.get(L"tray_tooltip") == std::wstring_view(L""));
+    REQUIRE_FALSE(view.get(L"missing").has_value());
+    REQUIRE(view.toMap() == settings);
+}
+
+TEST_CASE("Config image rejects truncated buffers", "[config_image]") {
+    std::vector<unsigned char> image = SerializeConfigImage({{L"debug", L"1"}}, 1);
+    ConfigImageView view;
+    REQUIRE_FALSE(view.attach(image.data(), image.size() - 1));
+    REQUIRE_FALSE(view.valid());
+    REQUIRE_FALSE(view.get(L"debug").has_value());
+
+    image[0] ^= 0xFF;
+    REQUIRE_FALSE(view.attach(image.data(), image.size()));
+}
+
+TEST_CASE("Shared config image reaches readers without reopening", "[config_image]") {
+    std::wstring name = UniqueName(L"immon_test_config");
+    SharedMemory::unlink(name);
+
+    SharedConfigImage host;
+    REQUIRE(host.openForPublish(name));
+    SharedConfigImage hook;
+    REQUIRE(hook.openForRead(name));
+    REQUIRE(hook.generation() == 0);
+    REQUIRE_FALSE(hook.current().valid());
+
+    uint32_t first = host.publish({{L"debug", L"0"}});
+    REQUIRE(first != 0);
+    REQUIRE(hook.generation() == first);
+    REQUIRE(hook.current().get(L"debug") == std::wstring_view(L"0"));
+
+    uint32_t second = host.publish({{L"debug", L"1"}, {L"log_level", L"WARN"}});
+    REQUIRE(second != first);
+    ConfigImageView view = hook.current();
+    REQUIRE(view.generation() == second);
+    REQUIRE(view.get(L"debug") == std::wstring_view(L"1"));
+    REQUIRE(view.get(L"log_level") == std::wstring_view(L"WARN"));
+
+    REQUIRE(hook.publish({{L"debug", L"0"}}) == 0);
+
+    host.close();
+    hook.close();
+    SharedMemory::unlink(name);
+}
+
+TEST_CASE("Shared config image refuses oversized settings", "[config_image]") {
+    std::wstring name = UniqueName(L"immon_test_config_big");
+    SharedMemory::unlink(name);
+
+    SharedConfigImage host;
+    REQUIRE(host.openForPublish(name));
+    REQUIRE(host.publish({{L"a", L"1"}}) == 1);
+    std::wstring huge(SharedConfigImage::kSlotSize, L'x');
+    REQUIRE(host.publish({{L"a", huge}}) == 0);
+    REQUIRE(host.current().get(L"a") == std::wstring_view(L"1"));
+
+    host.close();
+    SharedMemory::unlink(name);
+}
+
+TEST_CASE("Config cache round-trips and rejects stale or damaged files", "[config_image]") {
+    namespace fs = std::filesystem;
+    fs::path dir = fs::temp_directory_path() / "immon_config_cache";
+    fs::create_directories(dir);
+    std::wstring path = ConfigCachePath((dir / "kbdlayoutmon.config").wstring());
+
+    ConfigMap settings{{L"debug", L"1"}, {L"log_path", L"/tmp/caf\u00e9.log"}, {L"odd", L"x"}};
+    std::vector<std::wstring> diagnostics;
+    for (int i = 0; i < 12; ++i)
+        diagnostics.push_back(L"line " + std::to_wstring(i + 1) + L": unknown key");
+    ConfigCacheKey key{1, 2, 3, ConfigSchemaHash()};
+    REQUIRE(WriteConfigCache(path, key, settings, diagnostics));
+
+    ConfigMap loaded;
+    std::vector<std::wstring> loadedDiagnostics;
+    REQUIRE(ReadConfigCache(path, key, loaded, loadedDiagnostics));
+    REQUIRE(loaded == settings);
+    REQUIRE(loadedDiagnostics == diagnostics); // in order past nine entries
+
+    for (ConfigCacheKey other : {ConfigCacheKey{9, 2, 3, key.schemaHash}, ConfigCacheKey{1, 9, 3, key.schemaHash},
+                                 ConfigCacheKey{1, 2, 9, key.schemaHash}, ConfigCacheKey{1, 2, 3, 9}})
+        REQUIRE_FALSE(ReadConfigCache(path, other, loaded, loadedDiagnostics));
+
+    // Flip a byte in the settings image, then cut the file short
+    {
+        std::fstream f(fs::path(path), std::ios::in | std::ios::out | std::ios::binary);
+        f.seekp(sizeof(ConfigCacheHeader) + 30);
+        f.put('\x7f');
+    }
+    REQUIRE_FALSE(ReadConfigCache(path, key, loaded, loadedDiagnostics));
+    REQUIRE(WriteConfigCache(path, key, settings, diagnostics));
+    fs::resize_file(path, fs::file_size(path) - 4);
+    REQUIRE_FALSE(ReadConfigCache(path, key, loaded, loadedDiagnostics));
+
+    fs::remove(path);
+    fs::remove_all(dir);
+}
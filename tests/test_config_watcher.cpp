@@ -3,100 +3,82 @@
 #include <future>
 #include <chrono>
 #include <filesystem>
-#include <cstring>
+#include <fstream>
 #include <atomic>
 #include "../source/app_state.h"
+#include "../source/configuration.h"
 
-#define _WIN32
 #include "windows_stub.h"
-
-#define private public
 #include "../source/config_watcher.h"
-#undef private
 
 // Delegated globals and stubs are provided in tests/stubs.cpp
-extern HINSTANCE g_hInst;
 extern int applyCalls;
-extern int g_sleepCalls;
-extern HANDLE (*pCreateEventW)(void*, BOOL, BOOL, LPCWSTR);
-extern BOOL (*pSetEvent)(HANDLE);
-extern HANDLE (*pCreateFileW)(LPCWSTR, DWORD, DWORD, void*, DWORD, DWORD, HANDLE);
-extern DWORD (*pWaitForSingleObject)(HANDLE, DWORD);
-extern BOOL (*pReadDirectoryChangesW)(HANDLE, void* buffer, DWORD, BOOL, DWORD, DWORD* bytesReturned, OVERLAPPED*, void*);
-extern BOOL (*pCancelIoEx)(HANDLE, OVERLAPPED*);
-extern BOOL (*pGetOverlappedResult)(HANDLE, OVERLAPPED*, DWORD* bytes, BOOL);
-extern DWORD (*pWaitForMultipleObjects)(DWORD, const HANDLE*, BOOL, DWORD);
-extern DWORD (*pGetModuleFileNameW)(HINSTANCE, wchar_t* buffer, DWORD);
-extern int waitCalls;
-extern DWORD lastBytes;
-static HANDLE g_stopHandle = nullptr;
-static bool stopSignaled = false;
+extern void (*g_testApplyConfig)(HWND);
+
+namespace {
+std::atomic<int> reloads{0};
+void RecordApply(HWND) {
+    ++reloads;
+    ++applyCalls;
+}
+
+std::filesystem::path WriteWatchedConfig(const wchar_t* value) {
+    namespace fs = std::filesystem;
+    fs::path dir = fs::temp_directory_path() / "immon_cfgwatch_win";
+    fs::create_directories(dir);
+    fs::path cfg = dir / "kbdlayoutmon.config";
+    std::wofstream f(cfg);
+    f << L"reload_debounce_ms=0\n";
+    f << L"key=" << value << L"\n";
+    return cfg;
+}
+} // namespace
 
 TEST_CASE("Renaming config file triggers reload", "[config_watcher]") {
+    namespace fs = std::filesystem;
+    fs::path cfg = WriteWatchedConfig(L"value");
+    g_config.load(cfg.wstring());
+
     applyCalls = 0;
-    g_sleepCalls = 0;
+    reloads = 0;
+    g_testApplyConfig = RecordApply;
     {
         ConfigWatcher watcher(nullptr);
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
-        std::filesystem::rename("kbdlayoutmon.config", "kbdlayoutmon.config.tmp");
-        std::filesystem::rename("kbdlayoutmon.config.tmp", "kbdlayoutmon.config");
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        fs::path tmp = cfg.parent_path() / "kbdlayoutmon.config.tmp";
+        WriteWatchedConfig(L"updated");
+        fs::rename(cfg, tmp);
+        fs::rename(tmp, cfg);
+        for (int i = 0; i < 100 && reloads == 0; ++i)
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
     }
+    g_testApplyConfig = nullptr;
+
     REQUIRE(applyCalls >= 1);
+    REQUIRE(g_config.get(L"key").value_or(L"") == L"updated");
 }
 
-TEST_CASE("Watcher exits when stop event set and directory cannot be opened", "[config_watcher]") {
-    auto origCreateFileW = pCreateFileW;
-    pCreateFileW = [](LPCWSTR, DWORD, DWORD, void*, DWORD, DWORD, HANDLE) -> HANDLE { return nullptr; };
+TEST_CASE("Watcher stops promptly while a reload is pending", "[config_watcher]") {
+    namespace fs = std::filesystem;
+    fs::path cfg = WriteWatchedConfig(L"value");
+    g_config.load(cfg.wstring());
+    g_config.set(L"reload_debounce_ms", L"10000");
 
-    stopSignaled = false;
-    waitCalls = 0;
-    g_sleepCalls = 0;
-    std::chrono::steady_clock::time_point start;
+    auto* watcher = new ConfigWatcher(nullptr);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
     {
-        ConfigWatcher watcher(nullptr);
-        g_stopHandle = watcher.m_stopEvent.get();
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
-        SetEvent(g_stopHandle);
-        start = std::chrono::steady_clock::now();
+        std::wofstream f(cfg, std::ios::app);
+        f << L"other=1\n";
     }
-    auto elapsed = std::chrono::steady_clock::now() - start;
-    pCreateFileW = origCreateFileW;
-    g_stopHandle = nullptr;
-    stopSignaled = false;
-    REQUIRE(elapsed < std::chrono::milliseconds(200));
-    REQUIRE(g_sleepCalls >= 1);
-}
-
-TEST_CASE("Watcher thread stops promptly when signaled", "[config_watcher]") {
-    stopSignaled = false;
-    waitCalls = 0;
-
-    auto origWaitForMultipleObjects = pWaitForMultipleObjects;
-    pWaitForMultipleObjects = [](DWORD, const HANDLE*, BOOL, DWORD) -> DWORD {
-        while (!stopSignaled) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(1));
-        }
-        return WAIT_OBJECT_0 + 1;
-    };
-
-    ConfigWatcher* watcher = new ConfigWatcher(nullptr);
-    g_stopHandle = watcher->m_stopEvent.get();
-    std::this_thread::sleep_for(std::chrono::milliseconds(10));
-    SetEvent(g_stopHandle);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
 
     auto start = std::chrono::steady_clock::now();
     auto dtor = std::async(std::launch::async, [watcher]() { delete watcher; });
     bool finished = dtor.wait_for(std::chrono::milliseconds(200)) == std::future_status::ready;
     auto elapsed = std::chrono::steady_clock::now() - start;
-    if (finished) {
+    if (finished)
         dtor.get();
-    }
-    pWaitForMultipleObjects = origWaitForMultipleObjects;
-    g_stopHandle = nullptr;
-    stopSignaled = false;
 
     REQUIRE(finished);
     REQUIRE(elapsed < std::chrono::milliseconds(200));
 }
-
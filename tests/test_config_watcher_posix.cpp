@@ -4,9 +4,12 @@
 #include <fstream>
 #include <thread>
 #include <chrono>
+#include <memory>
 
-#include "../source/config_watcher_posix.h"
+#include "../source/config_watcher.h"
 #include "../source/configuration.h"
+#include "../source/file_watch_service.h"
+#include "../source/reload_debouncer.h"
 #include "../source/app_state.h"
 #include "../source/log.h"
 
@@ -31,9 +34,11 @@ TEST_CASE("ConfigWatcher reloads on file changes", "[config_watcher][posix]") {
     fs::path cfg = dir / "kbdlayoutmon.config";
     fs::path logPath = dir / "watch.log";
 
+    // Reload on every event; debouncing has its own test
     {
         std::wofstream f(cfg);
         f << L"log_path=" << logPath.wstring() << L"\n";
+        f << L"reload_debounce_ms=0\n";
         f << L"key=value\n";
     }
 
@@ -49,6 +54,7 @@ TEST_CASE("ConfigWatcher reloads on file changes", "[config_watcher][posix]") {
         {
             std::wofstream f(cfg);
             f << L"log_path=" << logPath.wstring() << L"\n";
+            f << L"reload_debounce_ms=0\n";
             f << L"key=updated\n";
         }
         std::this_thread::sleep_for(100ms);
@@ -58,11 +64,11 @@ TEST_CASE("ConfigWatcher reloads on file changes", "[config_watcher][posix]") {
         fs::rename(tmp, cfg);
         std::this_thread::sleep_for(200ms);
 
-        // Trigger a final write but do not wait so the watcher thread sees the
-        // event after destruction and can exit promptly.
+        // A final write racing with destruction must not hold it up
         {
             std::wofstream f(cfg);
             f << L"log_path=" << logPath.wstring() << L"\n";
+            f << L"reload_debounce_ms=0\n";
             f << L"key=final\n";
         }
     }
@@ -86,4 +92,185 @@ TEST_CASE("ConfigWatcher reloads on file changes", "[config_watcher][posix]") {
     GetAppState().debugEnabled.store(prevDebug);
     g_logLevel.store(prevLevel);
 }
+
+TEST_CASE("ConfigWatcher ignores other files in the directory", "[config_watcher][posix]") {
+    using namespace std::chrono_literals;
+    namespace fs = std::filesystem;
+
+    fs::path dir = fs::temp_directory_path() / "immon_cfgwatch_filter";
+    fs::create_directories(dir);
+    fs::path cfg = dir / "kbdlayoutmon.config";
+    {
+        std::ofstream f(cfg);
+        f << "reload_debounce_ms=0\nkey=value\n";
+    }
+    g_config.load(cfg.wstring());
+
+    applyCalls = 0;
+    g_testApplyConfig = RecordApply;
+    {
+        ConfigWatcher watcher(nullptr);
+        std::this_thread::sleep_for(100ms);
+
+        // A log rotating next to the config file
+        for (int i = 0; i < 3; ++i) {
+            std::ofstream(dir / "kbdlayoutmon.log") << "line " << i << "\n";
+            fs::rename(dir / "kbdlayoutmon.log", dir / ("kbdlayoutmon.log." + std::to_string(i)));
+        }
+        std::this_thread::sleep_for(200ms);
+        REQUIRE(applyCalls == 0);
+
+        {
+            std::ofstream f(cfg);
+            f << "reload_debounce_ms=0\nkey=updated\n";
+        }
+        for (int i = 0; i < 40 && applyCalls == 0; ++i)
+            std::this_thread::sleep_for(10ms);
+        REQUIRE(applyCalls >= 1);
+        REQUIRE(g_config.get(L"key") == L"updated");
+    }
+    g_testApplyConfig = nullptr;
+
+    fs::remove_all(dir);
+}
+
+TEST_CASE("ConfigWatcher shuts down promptly", "[config_watcher][posix]") {
+    using namespace std::chrono_literals;
+    namespace fs = std::filesystem;
+    using Clock = std::chrono::steady_clock;
+
+    fs::path dir = fs::temp_directory_path() / "immon_cfgwatch_stop";
+    fs::create_directories(dir);
+    fs::path cfg = dir / "kbdlayoutmon.config";
+    {
+        std::ofstream f(cfg);
+        f << "reload_debounce_ms=5000\nkey=value\n";
+    }
+    g_config.load(cfg.wstring());
+
+    auto destroyAfter = [&](auto&& action) {
+        auto watcher = std::make_unique<ConfigWatcher>(nullptr);
+        action();
+        auto start = Clock::now();
+        watcher.reset();
+        return Clock::now() - start;
+    };
+
+    // Idle, with no event to wake the thread other than the stop signal
+    auto idle = destroyAfter([] { std::this_thread::sleep_for(50ms); });
+    // Right after construction
+    auto immediate = destroyAfter([] {});
+    // With a reload scheduled seconds away
+    auto pending = destroyAfter([&] {
+        std::this_thread::sleep_for(50ms);
+        std::ofstream(cfg) << "reload_debounce_ms=5000\nkey=changed\n";
+        std::this_thread::sleep_for(50ms);
+    });
+
+    INFO("idle " << std::chrono::duration_cast<std::chrono::microseconds>(idle).count() << " us, immediate "
+                 << std::chrono::duration_cast<std::chrono::microseconds>(immediate).count() << " us, pending "
+                 << std::chrono::duration_cast<std::chrono::microseconds>(pending).count() << " us");
+    REQUIRE(idle < 100ms);
+    REQUIRE(immediate < 100ms);
+    REQUIRE(pending < 100ms);
+
+    fs::remove_all(dir);
+}
+
+TEST_CASE("ReloadDebouncer waits for a burst to settle", "[config_watcher]") {
+    using namespace std::chrono_literals;
+    ReloadDebouncer debounce;
+    auto t0 = ReloadDebouncer::Clock::now();
+    REQUIRE(debounce.timeoutMs(t0) == -1);
+    REQUIRE_FALSE(debounce.take(t0));
+
+    debounce.touch(t0, 100ms);
+    debounce.touch(t0 + 60ms, 100ms);
+    REQUIRE(debounce.timeoutMs(t0 + 60ms) == 100);
+    REQUIRE_FALSE(debounce.take(t0 + 150ms));
+    REQUIRE(debounce.take(t0 + 160ms));
+    REQUIRE_FALSE(debounce.pending());
+
+    // Continuous changes still reload after ten windows
+    for (int i = 0; i < 20; ++i)
+        debounce.touch(t0 + i * 90ms, 100ms);
+    REQUIRE(debounce.timeoutMs(t0 + 999ms) == 1);
+    REQUIRE(debounce.take(t0 + 1000ms));
+
+    debounce.touch(t0, 0ms);
+    REQUIRE(debounce.take(t0));
+}
+
+TEST_CASE("ConfigWatcher merges rapid writes and applies the final state", "[config_watcher][posix]") {
+    using namespace std::chrono_literals;
+    namespace fs = std::filesystem;
+
+    fs::path dir = fs::temp_directory_path() / "immon_cfgwatch_burst";
+    fs::create_directories(dir);
+    fs::path cfg = dir / "kbdlayoutmon.config";
+    {
+        std::ofstream f(cfg);
+        f << "reload_debounce_ms=100\nkey=initial\n";
+    }
+    g_config.load(cfg.wstring());
+
+    applyCalls = 0;
+    g_testApplyConfig = RecordApply;
+    {
+        ConfigWatcher watcher(nullptr);
+        std::this_thread::sleep_for(100ms);
+
+        // Atomic saves: write a temporary file, then rename it over the config
+        for (int i = 0; i < 50; ++i) {
+            fs::path tmp = dir / "kbdlayoutmon.config.tmp";
+            {
+                std::ofstream f(tmp);
+                f << "reload_debounce_ms=100\nkey=" << i << "\n";
+            }
+            fs::rename(tmp, cfg);
+            std::this_thread::sleep_for(1ms);
+        }
+        for (int i = 0; i < 200 && g_config.get(L"key") != L"49"; ++i)
+            std::this_thread::sleep_for(10ms);
+        // Let any reload still scheduled run before counting
+        std::this_thread::sleep_for(300ms);
+
+        REQUIRE(g_config.get(L"key") == L"49");
+        REQUIRE(applyCalls >= 1);
+        REQUIRE(applyCalls <= 3);
+    }
+    g_testApplyConfig = nullptr;
+
+    fs::remove_all(dir);
+}
+TEST_CASE("ConfigWatcher skips a machine file whose directory is missing", "[config_watcher][posix]") {
+    namespace fs = std::filesystem;
+    fs::path dir = fs::temp_directory_path() / "immon_cfgwatch_machine";
+    fs::remove_all(dir);
+    fs::create_directories(dir / "user");
+    fs::path cfg = dir / "user" / "kbdlayoutmon.config";
+    std::ofstream(cfg) << "key=value\n";
+    g_config.load(cfg.wstring());
+    FileWatchService& service = GetFileWatchService();
+    size_t idle = service.directoryCount();
+
+    // A normal install: no machine directory, so only the user file is watched
+    g_config.loadLayer(ConfigLayer::Machine, (dir / "missing" / "kbdlayoutmon.config").wstring());
+    {
+        ConfigWatcher watcher(nullptr);
+        REQUIRE(service.directoryCount() == idle + 1);
+    }
+
+    // Once the directory exists, a machine file created there is watched
+    fs::create_directories(dir / "machine");
+    g_config.loadLayer(ConfigLayer::Machine, (dir / "machine" / "kbdlayoutmon.config").wstring());
+    {
+        ConfigWatcher watcher(nullptr);
+        REQUIRE(service.directoryCount() == idle + 2);
+    }
+    REQUIRE(service.directoryCount() == idle);
+
+    g_config.loadLayer(ConfigLayer::Machine, (dir / "missing" / "kbdlayoutmon.config").wstring());
+    fs::remove_all(dir);
+}
 #endif
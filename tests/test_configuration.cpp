@@ -1,11 +1,15 @@
 #include <catch2/catch_test_macros.hpp>
+#include "../source/config_cache.h"
 #include "../source/config_parser.h"
+#include "../source/config_schema.h"
 #include "../source/configuration.h"
 #include <string>
 #include <vector>
 #include <fstream>
+#include <sstream>
 #include <filesystem>
 #include <thread>
+#include <atomic>
 #include <optional>
 #include <limits>
 #include <cstdlib>
@@ -140,6 +144,53 @@ TEST_CASE("Environment variables are expanded", "[config]") {
 #endif
 }
 
+TEST_CASE("Environment expansion is Unicode-correct and can use a snapshot", "[config]") {
+    const std::wstring value = L"caf\u00e9 \u65e5\u672c \U0001F600";
+    REQUIRE(Utf8ToWide(WideToUtf8(value)) == value);
+    REQUIRE(WideToUtf8(L"\u00e9") == "\xc3\xa9");
+    REQUIRE(Utf8ToWide("\xff") == L"\u00ff"); // invalid UTF-8 falls back to Latin-1
+
+    EnvironmentSnapshot environment({{L"IMMON_SNAP_DIR", value}, {L"IMMON_SNAP_NAME", L"log"}});
+    REQUIRE(ExpandEnvVars(L"%IMMON_SNAP_DIR%/%IMMON_SNAP_NAME%.txt", &environment) == value + L"/log.txt");
+#ifdef _WIN32
+    REQUIRE(ExpandEnvVars(L"%immon_snap_name%", &environment) == L"log");
+    REQUIRE(ExpandEnvVars(L"100%%IMMON_SNAP_NAME%", &environment) == L"100%log");
+    REQUIRE(ExpandEnvVars(L"%IMMON_SNAP_MISSING%", &environment) == L"%IMMON_SNAP_MISSING%");
+#else
+    REQUIRE(ExpandEnvVars(L"$IMMON_SNAP_NAME-${IMMON_SNAP_DIR}", &environment) == L"log-" + value);
+    REQUIRE(ExpandEnvVars(L"[$IMMON_SNAP_MISSING]", &environment) == L"[]");
+    REQUIRE(ExpandEnvVars(L"${IMMON_SNAP_NAME", &environment) == L"${IMMON_SNAP_NAME");
+
+    // Values are decoded from UTF-8 rather than widened byte by byte
+    setenv("IMMON_TEST_UTF8", WideToUtf8(value).c_str(), 1);
+    REQUIRE(ExpandEnvVars(L"$IMMON_TEST_UTF8|%IMMON_TEST_UTF8%") == value + L"|" + value);
+
+    // A snapshot keeps reloads stable while the process environment changes
+    namespace fs = std::filesystem;
+    fs::path cfg = fs::temp_directory_path() / "immon_env_snapshot.config";
+    {
+        std::ofstream f(cfg);
+        f << "log_path=$IMMON_TEST_UTF8/app.log\n";
+    }
+    Configuration config;
+    config.setEnvironment(EnvironmentSnapshot::Capture());
+    config.load(cfg.wstring());
+    setenv("IMMON_TEST_UTF8", "changed", 1);
+    {
+        std::ofstream f(cfg);
+        f << "log_path=$IMMON_TEST_UTF8/app.log\n\n";
+    }
+    config.load();
+    REQUIRE(config.get(ConfigKey::LogPath).value() == value + L"/app.log");
+    config.setEnvironment(nullptr);
+    config.load();
+    REQUIRE(config.get(ConfigKey::LogPath).value() == L"changed/app.log");
+    unsetenv("IMMON_TEST_UTF8");
+    fs::remove(cfg);
+    fs::remove(ConfigCachePath(cfg.wstring()));
+#endif
+}
+
 TEST_CASE("Reload custom config file", "[config]") {
     namespace fs = std::filesystem;
     fs::path dir = fs::temp_directory_path() / "immon_test";
@@ -168,8 +219,7 @@ TEST_CASE("Reload custom config file", "[config]") {
         REQUIRE(updated[L"debug"] == L"1");
     }
 
-    fs::remove(cfg);
-    fs::remove(dir);
+    fs::remove_all(dir);
 }
 
 TEST_CASE("Configuration loads default path and handles missing files", "[configuration]") {
@@ -195,10 +245,10 @@ TEST_CASE("Configuration loads default path and handles missing files", "[config
     SECTION("nonexistent file does not modify state") {
         cfg.load();
         REQUIRE(cfg.getLastPath().empty());
-        REQUIRE(cfg.snapshot().empty());
+        REQUIRE(cfg.snapshot()->empty());
         cfg.load((dir / L"missing.config").wstring());
         REQUIRE(cfg.getLastPath().empty());
-        REQUIRE(cfg.snapshot().empty());
+        REQUIRE(cfg.snapshot()->empty());
     }
 
     fs::current_path(old);
@@ -226,7 +276,449 @@ TEST_CASE("snapshot returns a consistent copy", "[configuration]") {
     cfg.set(L"a", L"1");
     auto snap = cfg.snapshot();
     cfg.set(L"a", L"2");
-    REQUIRE(snap[L"a"] == L"1");
+    REQUIRE(snap->get(L"a") == std::optional<std::wstring_view>(L"1"));
     auto snap2 = cfg.snapshot();
-    REQUIRE(snap2[L"a"] == L"2");
+    REQUIRE(snap2->get(L"a") == std::optional<std::wstring_view>(L"2"));
+}
+
+TEST_CASE("snapshot views outlive later changes and instances stay separate", "[configuration]") {
+    Configuration first;
+    Configuration second;
+    first.set(L"name", L"first");
+    second.set(L"name", L"second");
+
+    // Alternate lookups on one thread; each instance must answer for itself
+    for (int i = 0; i < 10; ++i) {
+        REQUIRE(first.get(L"name") == std::optional<std::wstring>(L"first"));
+        REQUIRE(second.get(L"name") == std::optional<std::wstring>(L"second"));
+    }
+
+    auto snap = first.snapshot();
+    std::wstring_view view = *snap->get(L"name");
+    std::atomic<bool> done{false};
+    std::thread writer([&]() {
+        for (int i = 0; i < 500; ++i)
+            first.set(L"name", L"value " + std::to_wstring(i));
+        done = true;
+    });
+    while (!done) {
+        REQUIRE(view == L"first");
+        auto current = first.get(L"name");
+        REQUIRE(current.has_value());
+    }
+    writer.join();
+    REQUIRE(view == L"first");
+    REQUIRE(first.get(L"name") == std::optional<std::wstring>(L"value 499"));
+    REQUIRE_FALSE(snap->find(L"missing"));
+}
+
+TEST_CASE("Known keys are parsed once into typed settings", "[config]") {
+    ConfigSettings defaults = BuildConfigSettings({});
+    REQUIRE(defaults.present == 0);
+    REQUIRE_FALSE(defaults.debug);
+    REQUIRE(defaults.trayIcon);
+    REQUIRE(defaults.tempHotkeyTimeout == 10000);
+    REQUIRE(defaults.maxLogSizeMb == 10);
+    REQUIRE(defaults.maxLogBackups == 5);
+    REQUIRE(defaults.maxQueueSize == 1000);
+    REQUIRE(defaults.logLevel == LogLevel::Info);
+    REQUIRE(defaults.hookMode == HookMode::Full);
+
+    ConfigSettings typed = BuildConfigSettings({{L"debug", L"yes"},
+                                                {L"tray_icon", L"off"},
+                                                {L"log_level", L"WARN"},
+                                                {L"max_queue_size", L"2000"},
+                                                {L"max_log_backups", L"99999"},
+                                                {L"hook_mode", L"Light"},
+                                                {L"log_path", L"/var/log/immon.log"},
+                                                {L"custom", L"ignored"}});
+    REQUIRE(typed.debug);
+    REQUIRE_FALSE(typed.trayIcon);
+    REQUIRE(typed.logLevel == LogLevel::Warn);
+    REQUIRE(typed.maxQueueSize == 2000);
+    REQUIRE(typed.maxLogBackups == 5); // out of range -> default
+    REQUIRE(typed.has(ConfigKey::MaxLogBackups));
+    REQUIRE_FALSE(typed.has(ConfigKey::Startup));
+    REQUIRE(typed.hookMode == HookMode::Light);
+    REQUIRE(typed.logPath == L"/var/log/immon.log");
+
+    Configuration cfg;
+    cfg.set(L"max_log_size_mb", L"3");
+    REQUIRE(cfg.snapshot()->settings().maxLogSizeMb == 3);
+}
+
+TEST_CASE("Snapshot lookups index known keys and hash the rest", "[configuration]") {
+    static_assert(FindConfigKey(L"max_log_size_mb") == &GetConfigKeyInfo(ConfigKey::MaxLogSizeMb));
+    static_assert(FindConfigKey(L"max_log_size") == nullptr);
+    static_assert(FindConfigKey(L"") == nullptr);
+
+    ConfigMap values = {{L"debug", L"1"}, {L"hook_mode", L"light"}};
+    for (int i = 0; i < 100; ++i)
+        values.emplace(L"custom_" + std::to_wstring(i), std::to_wstring(i));
+    ConfigSnapshot snapshot(values);
+
+    for (const auto& [key, value] : values) {
+        const std::wstring* found = snapshot.find(key);
+        REQUIRE(found);
+        REQUIRE(*found == value);
+    }
+    REQUIRE(snapshot.find(ConfigKey::Debug) == snapshot.find(L"debug"));
+    REQUIRE(snapshot.get(ConfigKey::HookMode).value() == L"light");
+    REQUIRE(snapshot.find(ConfigKey::LogPath) == nullptr);
+    REQUIRE(snapshot.find(L"log_path") == nullptr);
+    REQUIRE(snapshot.find(L"custom_100") == nullptr);
+    REQUIRE(snapshot.find(L"Debug") == nullptr);
+
+    ConfigSnapshot known(ConfigMap{{L"tray_icon", L"0"}});
+    REQUIRE(known.get(ConfigKey::TrayIcon).value() == L"0");
+    REQUIRE(known.find(L"custom") == nullptr);
+    REQUIRE(ConfigSnapshot().find(L"custom") == nullptr);
+
+    Configuration cfg;
+    cfg.set(L"icon_path", L"a.ico");
+    REQUIRE(cfg.get(ConfigKey::IconPath).value() == L"a.ico");
+    REQUIRE_FALSE(cfg.get(ConfigKey::TrayTooltip));
+}
+
+TEST_CASE("Unknown keys and invalid values are reported with normalized results", "[config]") {
+    std::vector<std::wstring> lines = {
+        L"DEBUG=true",
+        L"LOG_LEVEL=Error",
+        L"HOOK_MODE=turbo",
+        L"MAX_LOG_SIZE_MB=12abc",
+        L"TYPO_KEY=1",
+    };
+    std::vector<std::wstring> diagnostics;
+    auto settings = ParseConfigLines(lines, &diagnostics);
+    REQUIRE(settings[L"debug"] == L"1");
+    REQUIRE(settings[L"log_level"] == L"error");
+    REQUIRE(settings[L"hook_mode"] == L"full");
+    REQUIRE(settings[L"max_log_size_mb"] == L"10");
+    REQUIRE(settings[L"typo_key"] == L"1");
+    REQUIRE(diagnostics.size() == 3);
+    REQUIRE(diagnostics[0].find(L"line 3") == 0);
+    REQUIRE(diagnostics[0].find(L"hook_mode") != std::wstring::npos);
+    REQUIRE(diagnostics[1].find(L"line 4") == 0);
+    REQUIRE(diagnostics[2] == L"line 5: unknown key 'typo_key'");
+
+    for (const ConfigKeyInfo& info : kConfigKeys) {
+        REQUIRE(FindConfigKey(info.name) == &info);
+        std::wstring normalized;
+        REQUIRE(NormalizeConfigValue(info, info.defaultValue, normalized));
+        REQUIRE(normalized == info.defaultValue);
+    }
+    REQUIRE(FindConfigKey(L"nope") == nullptr);
+}
+
+TEST_CASE("Config text is decoded from UTF-8 and UTF-16 with or without a BOM", "[config]") {
+    // "name=café\r\ndebug=1\n" plus a character outside the BMP
+    const std::wstring expected = L"café \U0001F600";
+    const std::string utf8 = "NAME=caf\xc3\xa9 \xf0\x9f\x98\x80\r\nDEBUG=1\n";
+
+    std::wstring text;
+    DecodeConfigBytes(utf8.data(), utf8.size(), text);
+    REQUIRE(ParseConfigText(text)[L"name"] == expected);
+
+    std::string bom8 = "\xEF\xBB\xBF" + utf8;
+    DecodeConfigBytes(bom8.data(), bom8.size(), text);
+    auto settings = ParseConfigText(text);
+    REQUIRE(settings[L"name"] == expected);
+    REQUIRE(settings[L"debug"] == L"1");
+
+    // Re-encode the same text as UTF-16 in both byte orders
+    std::u16string units = u"NAME=café \U0001F600\r\nDEBUG=1\n";
+    for (bool bigEndian : {false, true}) {
+        std::string bytes = bigEndian ? "\xFE\xFF" : "\xFF\xFE";
+        for (char16_t u : units) {
+            char hi = static_cast<char>(u >> 8), lo = static_cast<char>(u & 0xFF);
+            bytes += bigEndian ? hi : lo;
+            bytes += bigEndian ? lo : hi;
+        }
+        DecodeConfigBytes(bytes.data(), bytes.size(), text);
+        settings = ParseConfigText(text);
+        REQUIRE(settings[L"name"] == expected);
+        REQUIRE(settings[L"debug"] == L"1");
+    }
+
+    // Invalid UTF-8 bytes fall back to Latin-1 instead of truncating
+    std::string latin1 = "NAME=caf\xe9\nDEBUG=1";
+    DecodeConfigBytes(latin1.data(), latin1.size(), text);
+    settings = ParseConfigText(text);
+    REQUIRE(settings[L"name"] == L"café");
+    REQUIRE(settings[L"debug"] == L"1");
+}
+
+TEST_CASE("Text, line and stream parsing agree", "[config]") {
+    std::vector<std::wstring> lines = {
+        L"  DEBUG = 1  ", L"# comment", L"KEY=value # comment", L"FOO=\"bar #baz\" # another",
+        L"BAZ='qux ;quux' ; comment", L"JUSTKEY", L"=orphan", L"MAX_QUEUE_SIZE = nope", L"EMPTY=", L"dup=1",
+        L"DUP=2", L"QUOTE=\"", L"\tTRAY_ICON\t=\t1\t\r"};
+    std::wstring text;
+    for (const auto& line : lines)
+        text += line + L"\n";
+    auto fromLines = ParseConfigLines(lines);
+    REQUIRE(ParseConfigText(text) == fromLines);
+    std::wistringstream stream(text);
+    REQUIRE(ParseConfigStream(stream) == fromLines);
+    REQUIRE(fromLines[L"dup"] == L"2");
+    REQUIRE(fromLines[L"quote"] == L"\"");
+    REQUIRE(fromLines[L"empty"].empty());
+    REQUIRE(fromLines.count(L"justkey") == 0);
+}
+
+TEST_CASE("Reloads notify only the subscribers whose keys changed", "[configuration]") {
+    namespace fs = std::filesystem;
+    fs::path dir = fs::temp_directory_path() / "immon_notify";
+    fs::create_directories(dir);
+    fs::path cfg = dir / "kbdlayoutmon.config";
+    auto write = [&](const char* text) {
+        std::ofstream out(cfg, std::ios::binary);
+        out << text;
+    };
+
+    Configuration config;
+    write("LOG_LEVEL=info\nTRAY_ICON=1\nTRAY_TOOLTIP=hello\n");
+    config.load(cfg.wstring());
+
+    std::vector<ConfigDiff> level, tray, all;
+    config.subscribe(L"log_level", [&](const ConfigDiff& diff) { level.push_back(diff); });
+    uint64_t trayId = config.subscribePrefix(L"tray_", [&](const ConfigDiff& diff) { tray.push_back(diff); });
+    config.subscribePrefix(L"", [&](const ConfigDiff& diff) { all.push_back(diff); });
+
+    // Identical content: nothing is published or delivered
+    ConfigSnapshotPtr before = config.snapshot();
+    write("log_level = INFO\r\ntray_icon=yes\ntray_tooltip=hello\n");
+    config.load();
+    REQUIRE(config.snapshot() == before);
+    REQUIRE(all.empty());
+
+    write("LOG_LEVEL=warn\nTRAY_ICON=1\nTRAY_TOOLTIP=hello\n");
+    config.load();
+    REQUIRE(level.size() == 1);
+    REQUIRE(tray.empty());
+    REQUIRE(all.size() == 1);
+    REQUIRE(level[0].before() == before);
+    REQUIRE(level[0].after() == config.snapshot());
+    REQUIRE(level[0].changes().size() == 1);
+    REQUIRE(level[0].changes()[0].key == L"log_level");
+    REQUIRE(*level[0].changes()[0].before == L"info");
+    REQUIRE(*level[0].changes()[0].after == L"warn");
+    REQUIRE(level[0].contains(ConfigKey::LogLevel));
+    REQUIRE(level[0].after()->settings().logLevel == LogLevel::Warn);
+
+    // Removing and adding keys; prefix subscribers see only their keys
+    write("LOG_LEVEL=warn\nTRAY_ICON=0\nDEBUG=1\n");
+    config.load();
+    REQUIRE(level.size() == 1);
+    REQUIRE(tray.size() == 1);
+    REQUIRE(tray[0].changes().size() == 2);
+    REQUIRE(tray[0].changes()[0].key == L"tray_icon");
+    REQUIRE(tray[0].changes()[1].key == L"tray_tooltip");
+    REQUIRE(tray[0].changes()[1].after == nullptr);
+    REQUIRE_FALSE(tray[0].contains(L"debug"));
+    REQUIRE(all.size() == 2);
+    REQUIRE(all[1].changes().size() == 3);
+    REQUIRE(all[1].changes()[0].key == L"debug");
+    REQUIRE(all[1].changes()[0].before == nullptr);
+
+    config.unsubscribe(trayId);
+    config.set(L"tray_icon", L"1");
+    config.set(L"tray_icon", L"1");
+    REQUIRE(tray.size() == 1);
+    REQUIRE(all.size() == 3);
+
+    fs::remove_all(dir);
+}
+
+TEST_CASE("Listeners run in publish order and may change the configuration", "[configuration]") {
+    Configuration config;
+    std::vector<std::wstring> seen;
+    config.subscribe(L"a", [&](const ConfigDiff& diff) {
+        seen.push_back(L"a=" + *diff.changes()[0].after);
+        // Published while this listener runs; delivered after it returns
+        config.set(L"b", *diff.changes()[0].after);
+        seen.push_back(L"a done");
+    });
+    config.subscribe(L"b", [&](const ConfigDiff& diff) { seen.push_back(L"b=" + *diff.changes()[0].after); });
+
+    config.set(L"a", L"1");
+    REQUIRE(seen == std::vector<std::wstring>{L"a=1", L"a done", L"b=1"});
+    REQUIRE(config.get(L"b") == L"1");
+}
+
+TEST_CASE("Config file hash and stamp only skip unchanged content", "[configuration]") {
+    namespace fs = std::filesystem;
+    // XXH64 reference values
+    REQUIRE(HashConfigBytes("", 0) == 0xEF46DB3751D8E999ull);
+    REQUIRE(HashConfigBytes("abc", 3) == 0x44BC2CF5AD770999ull);
+    std::string longer;
+    for (int i = 0; i < 3; ++i)
+        longer += "Nobody inspects the spammish repetition";
+    REQUIRE(HashConfigBytes(longer.data(), longer.size()) == 0x03672E8D89443A6Full);
+
+    fs::path dir = fs::temp_directory_path() / "immon_stamp";
+    fs::create_directories(dir);
+    fs::path cfg = dir / "kbdlayoutmon.config";
+    auto write = [&](const char* text) {
+        std::ofstream out(cfg, std::ios::binary);
+        out << text;
+    };
+
+    Configuration config;
+    write("DEBUG=0\n");
+    config.load(cfg.wstring());
+    auto written = fs::last_write_time(cfg);
+
+    // Same size and modification time but new content is still picked up
+    write("DEBUG=1\n");
+    fs::last_write_time(cfg, written);
+    config.load();
+    REQUIRE(config.get(L"debug") == L"1");
+
+    // Once the file has settled, an unchanged stamp skips the read entirely
+    auto old = fs::file_time_type::clock::now() - std::chrono::hours(1);
+    fs::last_write_time(cfg, old);
+    config.load();
+    write("DEBUG=0\n");
+    fs::last_write_time(cfg, old);
+    config.load();
+    REQUIRE(config.get(L"debug") == L"1");
+
+    // set() diverges from the file, so the next load reads it again
+    config.set(L"other", L"1");
+    config.load();
+    REQUIRE(config.get(L"debug") == L"0");
+    REQUIRE_FALSE(config.get(L"other"));
+
+    fs::remove_all(dir);
+}
+
+TEST_CASE("Loads reuse the binary cache only while it matches", "[configuration]") {
+    namespace fs = std::filesystem;
+    fs::path dir = fs::temp_directory_path() / "immon_cache_load";
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    fs::path cfg = dir / "kbdlayoutmon.config";
+    std::wstring cachePath = ConfigCachePath(cfg.wstring());
+    // Caches are per user, never beside a file that may sit in a shared directory
+    REQUIRE_FALSE(cachePath.empty());
+    REQUIRE(fs::path(cachePath).parent_path() == fs::path(ConfigCacheDirectory()));
+    REQUIRE(ConfigCachePath((dir / "other" / "kbdlayoutmon.config").wstring()) != cachePath);
+    {
+        std::ofstream out(cfg, std::ios::binary);
+        out << "DEBUG=1\nTYPO=1\n";
+    }
+    auto environment = EnvironmentSnapshot::Capture();
+
+    Configuration first;
+    first.setEnvironment(environment);
+    first.load(cfg.wstring());
+    REQUIRE(fs::exists(cachePath));
+
+    // Swap in a cache with different settings for the same key: a fresh
+    // instance takes them without parsing
+    std::string bytes;
+    REQUIRE(ReadConfigBytes(cfg.wstring(), bytes));
+    ConfigCacheKey key{HashConfigBytes(bytes.data(), bytes.size()), bytes.size(), environment->hash(),
+                       ConfigSchemaHash()};
+    ConfigMap parsed;
+    std::vector<std::wstring> diagnostics;
+    REQUIRE(ReadConfigCache(cachePath, key, parsed, diagnostics));
+    REQUIRE(parsed == first.snapshot()->values());
+    REQUIRE(diagnostics.size() == 1);
+    REQUIRE(WriteConfigCache(cachePath, key, {{L"debug", L"0"}}, {}));
+
+    Configuration second;
+    second.setEnvironment(environment);
+    second.load(cfg.wstring());
+    REQUIRE(second.get(ConfigKey::Debug) == L"0");
+
+    // Without the cache, or once the file changes, the text is parsed again
+    Configuration uncached;
+    uncached.setBinaryCache(false);
+    uncached.setEnvironment(environment);
+    uncached.load(cfg.wstring());
+    REQUIRE(uncached.get(ConfigKey::Debug) == L"1");
+    {
+        std::ofstream out(cfg, std::ios::binary);
+        out << "DEBUG=yes\n";
+    }
+    second.load();
+    REQUIRE(second.get(ConfigKey::Debug) == L"1");
+    REQUIRE_FALSE(second.get(L"typo"));
+    REQUIRE_FALSE(ReadConfigCache(cachePath, key, parsed, diagnostics));
+
+    // The machine-wide file is never cached
+    fs::remove(cachePath);
+    Configuration machine;
+    machine.setEnvironment(environment);
+    machine.loadLayer(ConfigLayer::Machine, cfg.wstring());
+    REQUIRE(machine.get(ConfigKey::Debug) == L"1");
+    REQUIRE_FALSE(fs::exists(cachePath));
+
+    fs::remove_all(dir);
+}
+
+TEST_CASE("Configuration layers merge by precedence and reload independently", "[configuration]") {
+    namespace fs = std::filesystem;
+    fs::path dir = fs::temp_directory_path() / "immon_layers";
+    fs::create_directories(dir);
+    fs::path machine = dir / "machine.config";
+    fs::path user = dir / "user.config";
+    auto write = [](const fs::path& path, const char* text) {
+        std::ofstream out(path, std::ios::binary);
+        out << text;
+    };
+
+    Configuration config;
+    write(machine, "LOG_LEVEL=warn\nICON_PATH=machine.ico\nTRAY_TOOLTIP=machine\n");
+    write(user, "ICON_PATH=user.ico\n");
+    config.loadLayer(ConfigLayer::Machine, machine.wstring());
+    config.load(user.wstring());
+    REQUIRE(config.get(L"log_level") == L"warn");
+    REQUIRE(config.get(L"icon_path") == L"user.ico");
+    REQUIRE(config.get(L"tray_tooltip") == L"machine");
+    REQUIRE(config.getLayerPath(ConfigLayer::Machine) == machine.wstring());
+    REQUIRE(config.getLastPath() == user.wstring());
+
+    config.set(L"icon_path", L"cli.ico", ConfigLayer::CommandLine);
+    REQUIRE(config.snapshot()->settings().iconPath == L"cli.ico");
+
+    // Reloading the user file keeps the override and leaves the machine
+    // layer as it was last read
+    std::atomic<int> notified{0};
+    uint64_t id = config.subscribePrefix(L"", [&](const ConfigDiff&) { ++notified; });
+    write(machine, "LOG_LEVEL=error\n");
+    write(user, "ICON_PATH=other.ico\nDEBUG=1\n");
+    config.load();
+    REQUIRE(config.get(L"icon_path") == L"cli.ico");
+    REQUIRE(config.get(L"debug") == L"1");
+    REQUIRE(config.get(L"log_level") == L"warn");
+    REQUIRE(config.layerValues(ConfigLayer::User).at(L"icon_path") == L"other.ico");
+    REQUIRE(notified == 1);
+
+    // A change hidden by a higher layer publishes nothing
+    config.set(L"icon_path", L"hidden.ico", ConfigLayer::Machine);
+    REQUIRE(notified == 1);
+    config.unsubscribe(id);
+
+    config.clearLayer(ConfigLayer::CommandLine);
+    REQUIRE(config.get(L"icon_path") == L"other.ico");
+
+    // The machine file is optional; without it the layer is empty and keys
+    // fall back to their schema defaults
+    fs::remove(machine);
+    config.loadLayer(ConfigLayer::Machine);
+    REQUIRE(config.layerValues(ConfigLayer::Machine).empty());
+    REQUIRE_FALSE(config.get(L"log_level"));
+    REQUIRE_FALSE(config.get(L"tray_tooltip"));
+    REQUIRE(config.snapshot()->settings().trayTooltip.empty());
+
+    // It is still the file to watch, and is read once it appears
+    REQUIRE(config.getLayerPath(ConfigLayer::Machine) == machine.wstring());
+    write(machine, "TRAY_TOOLTIP=created later\n");
+    config.loadLayer(ConfigLayer::Machine);
+    REQUIRE(config.get(L"tray_tooltip") == L"created later");
+
+    fs::remove_all(dir);
 }
@@ -0,0 +1,348 @@
+#include <catch2/catch_test_macros.hpp>
+#ifndef _WIN32
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <thread>
+
+#include "../source/app_state.h"
+#include "../source/configuration.h"
+#include "../source/file_watch_service.h"
+#include "../source/log.h"
+#include "windows_stub.h"
+
+namespace {
+// Backend fed by the test instead of the filesystem
+class ScriptedBackend : public FileWatchBackend {
+public:
+    bool addDirectory(const std::wstring&) override { return true; }
+    void removeDirectory(const std::wstring&) override {}
+
+    WaitResult wait(long long timeoutMs, std::vector<FileWatchChange>& changes) override {
+        std::unique_lock<std::mutex> lock(mutex);
+        auto ready = [&] { return stopped || !queued.empty(); };
+        if (timeoutMs < 0)
+            cv.wait(lock, ready);
+        else if (!cv.wait_for(lock, std::chrono::milliseconds(timeoutMs), ready))
+            return WaitResult::Timeout;
+        if (stopped)
+            return WaitResult::Stopped;
+        changes.insert(changes.end(), queued.begin(), queued.end());
+        queued.clear();
+        return WaitResult::Changes;
+    }
+
+    void stop() override {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopped = true;
+        cv.notify_all();
+    }
+
+    bool caseInsensitive() const override { return false; }
+
+    void push(FileWatchChange change) {
+        std::lock_guard<std::mutex> lock(mutex);
+        queued.push_back(std::move(change));
+        cv.notify_all();
+    }
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::vector<FileWatchChange> queued;
+    bool stopped = false;
+};
+
+// Scripted Win32 calls for driving the ReadDirectoryChangesW backend
+struct PostedRead {
+    void* buffer;
+    DWORD size;
+    OVERLAPPED* ov;
+};
+std::vector<PostedRead> posted;
+bool failRead = false;
+DWORD waitResult = WAIT_TIMEOUT;
+DWORD lastTimeout = 0;
+DWORD completedBytes = 0;
+int createdEvents = 0;
+int openedDirectories = 0;
+
+struct ScriptedWin32 {
+    ScriptedWin32()
+        : createEvent(pCreateEventW), createFile(pCreateFileW), readChanges(pReadDirectoryChangesW),
+          waitMultiple(pWaitForMultipleObjects), overlappedResult(pGetOverlappedResult) {
+        posted.clear();
+        failRead = false;
+        waitResult = WAIT_TIMEOUT;
+        completedBytes = 0;
+        createdEvents = 0;
+        openedDirectories = 0;
+        pCreateEventW = [](void*, BOOL, BOOL, LPCWSTR) -> HANDLE {
+            return reinterpret_cast<HANDLE>(static_cast<uintptr_t>(0x100 + ++createdEvents));
+        };
+        pCreateFileW = [](LPCWSTR, DWORD, DWORD, void*, DWORD, DWORD, HANDLE) -> HANDLE {
+            ++openedDirectories;
+            return reinterpret_cast<HANDLE>(0x10);
+        };
+        pReadDirectoryChangesW = [](HANDLE, void* buffer, DWORD size, BOOL, DWORD, DWORD*, OVERLAPPED* ov,
+                                    void*) -> BOOL {
+            if (failRead)
+                return FALSE;
+            posted.push_back({buffer, size, ov});
+            return TRUE;
+        };
+        pWaitForMultipleObjects = [](DWORD, const HANDLE*, BOOL, DWORD timeout) -> DWORD {
+            lastTimeout = timeout;
+            return waitResult;
+        };
+        pGetOverlappedResult = [](HANDLE, OVERLAPPED*, DWORD* bytes, BOOL) -> BOOL {
+            *bytes = completedBytes;
+            return TRUE;
+        };
+    }
+    ~ScriptedWin32() {
+        pCreateEventW = createEvent;
+        pCreateFileW = createFile;
+        pReadDirectoryChangesW = readChanges;
+        pWaitForMultipleObjects = waitMultiple;
+        pGetOverlappedResult = overlappedResult;
+    }
+
+    decltype(pCreateEventW) createEvent;
+    decltype(pCreateFileW) createFile;
+    decltype(pReadDirectoryChangesW) readChanges;
+    decltype(pWaitForMultipleObjects) waitMultiple;
+    decltype(pGetOverlappedResult) overlappedResult;
+};
+
+// Append one FILE_NOTIFY_INFORMATION record, linking it from the previous one
+DWORD AppendRecord(void* buffer, DWORD offset, DWORD previous, DWORD action, const std::wstring& name) {
+    auto* base = static_cast<BYTE*>(buffer);
+    if (offset > 0)
+        reinterpret_cast<FILE_NOTIFY_INFORMATION*>(base + previous)->NextEntryOffset = offset - previous;
+    auto* info = reinterpret_cast<FILE_NOTIFY_INFORMATION*>(base + offset);
+    info->NextEntryOffset = 0;
+    info->Action = action;
+    info->FileNameLength = static_cast<DWORD>(name.size() * sizeof(WCHAR));
+    std::memcpy(info->FileName, name.data(), info->FileNameLength);
+    DWORD size = static_cast<DWORD>(offsetof(FILE_NOTIFY_INFORMATION, FileName) + info->FileNameLength);
+    return offset + ((size + 3) & ~3u);
+}
+
+template <typename Predicate>
+bool WaitFor(Predicate done) {
+    for (int i = 0; i < 200 && !done(); ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    return done();
+}
+} // namespace
+
+TEST_CASE("FileWatchService dispatches changes per watched path", "[file_watch][posix]") {
+    using namespace std::chrono_literals;
+    namespace fs = std::filesystem;
+
+    fs::path root = fs::temp_directory_path() / "immon_file_watch";
+    fs::remove_all(root);
+    fs::create_directories(root / "a");
+    fs::create_directories(root / "b");
+    fs::path first = root / "a" / "first.conf";
+    fs::path second = root / "b" / "second.conf";
+    fs::path sibling = root / "a" / "sibling.conf";
+
+    FileWatchService service;
+    std::atomic<int> firstCalls{0};
+    std::atomic<int> secondCalls{0};
+    std::atomic<int> siblingCalls{0};
+    uint64_t firstId = service.watch(first.wstring(), [&](const std::wstring& path) {
+        CHECK(path == first.wstring());
+        ++firstCalls;
+    });
+    uint64_t secondId = service.watch(second.wstring(), [&](const std::wstring&) { ++secondCalls; });
+    REQUIRE(firstId != 0);
+    REQUIRE(secondId != 0);
+    REQUIRE(service.directoryCount() == 2);
+
+    // Watches in the same directory share its backend watch
+    uint64_t siblingId = service.watch(sibling.wstring(), [&](const std::wstring&) { ++siblingCalls; });
+    REQUIRE(service.directoryCount() == 2);
+
+    std::ofstream(second) << "x=1\n";
+    REQUIRE(WaitFor([&] { return secondCalls.load() == 1; }));
+    std::this_thread::sleep_for(50ms);
+    CHECK(firstCalls == 0);
+    CHECK(siblingCalls == 0);
+
+    std::ofstream(first) << "x=1\n";
+    REQUIRE(WaitFor([&] { return firstCalls.load() == 1; }));
+    CHECK(siblingCalls == 0);
+
+    service.unwatch(secondId);
+    REQUIRE(service.directoryCount() == 1);
+    std::ofstream(second) << "x=2\n";
+    std::this_thread::sleep_for(50ms);
+    CHECK(secondCalls == 1);
+
+    service.unwatch(firstId);
+    service.unwatch(siblingId);
+    CHECK(service.directoryCount() == 0);
+    fs::remove_all(root);
+}
+
+TEST_CASE("FileWatchService debounces and fans out overflows", "[file_watch]") {
+    using namespace std::chrono_literals;
+    auto owned = std::make_unique<ScriptedBackend>();
+    ScriptedBackend& backend = *owned;
+    FileWatchService service(std::move(owned));
+
+    std::atomic<int> configCalls{0};
+    std::atomic<int> otherCalls{0};
+    std::wstring dir = std::filesystem::absolute("watch_dir").lexically_normal().wstring();
+    uint64_t configId = service.watch(L"watch_dir/app.config", [&](const std::wstring&) { ++configCalls; }, 50ms);
+    service.watch(L"other_dir/app.config", [&](const std::wstring&) { ++otherCalls; });
+
+    // A burst collapses into one callback once it settles
+    for (int i = 0; i < 5; ++i)
+        backend.push({dir, L"app.config", false});
+    backend.push({dir, L"app.log", false});
+    REQUIRE(WaitFor([&] { return configCalls.load() == 1; }));
+    std::this_thread::sleep_for(100ms);
+    CHECK(configCalls == 1);
+    CHECK(otherCalls == 0);
+
+    // A lost-event overflow may have hidden a change to any file
+    service.setDebounce(configId, 0ms);
+    backend.push({std::wstring(), std::wstring(), true});
+    REQUIRE(WaitFor([&] { return configCalls.load() == 2 && otherCalls.load() == 1; }));
+}
+
+TEST_CASE("ReadDirectoryChangesW backend reposts before parsing a batch", "[file_watch]") {
+    ScriptedWin32 win32;
+    auto backend = CreateDirectoryChangesBackend();
+    REQUIRE(backend);
+    REQUIRE(backend->addDirectory(L"C:\\cfg"));
+    std::vector<FileWatchChange> changes;
+
+    // The first wait opens the directory and posts a read
+    REQUIRE(backend->wait(25, changes) == FileWatchBackend::WaitResult::Timeout);
+    CHECK(lastTimeout == 25);
+    CHECK(changes.empty());
+    REQUIRE(posted.size() == 1);
+    CHECK(posted[0].size == 64 * 1024);
+    CHECK(reinterpret_cast<uintptr_t>(posted[0].buffer) % alignof(DWORD) == 0);
+
+    DWORD end = AppendRecord(posted[0].buffer, 0, 0, FILE_ACTION_MODIFIED, L"KbdLayoutMon.config");
+    completedBytes = AppendRecord(posted[0].buffer, end, 0, FILE_ACTION_ADDED, L"trace.log");
+    waitResult = WAIT_OBJECT_0 + 2;
+    changes.clear();
+    REQUIRE(backend->wait(-1, changes) == FileWatchBackend::WaitResult::Changes);
+
+    // The next read went to the other buffer before this batch was parsed
+    REQUIRE(posted.size() == 2);
+    CHECK(posted[1].buffer != posted[0].buffer);
+    CHECK(posted[1].ov == posted[0].ov);
+    REQUIRE(changes.size() == 2);
+    CHECK(changes[0].directory == L"C:\\cfg");
+    CHECK(changes[0].name == L"KbdLayoutMon.config");
+    CHECK_FALSE(changes[0].overflow);
+    CHECK(changes[1].name == L"trace.log");
+    CHECK(backend->caseInsensitive());
+
+    // Then back to the first one
+    completedBytes = AppendRecord(posted[1].buffer, 0, 0, FILE_ACTION_MODIFIED, L"kbdlayoutmon.config");
+    changes.clear();
+    REQUIRE(backend->wait(-1, changes) == FileWatchBackend::WaitResult::Changes);
+    REQUIRE(posted.size() == 3);
+    CHECK(posted[2].buffer == posted[0].buffer);
+    REQUIRE(changes.size() == 1);
+
+    waitResult = WAIT_OBJECT_0;
+    CHECK(backend->wait(-1, changes) == FileWatchBackend::WaitResult::Stopped);
+}
+
+TEST_CASE("ReadDirectoryChangesW backend resyncs after overflow and failure", "[file_watch]") {
+    ScriptedWin32 win32;
+    auto backend = CreateDirectoryChangesBackend();
+    REQUIRE(backend->addDirectory(L"C:\\cfg"));
+    std::vector<FileWatchChange> changes;
+    REQUIRE(backend->wait(-1, changes) == FileWatchBackend::WaitResult::Timeout);
+    REQUIRE(openedDirectories == 1);
+
+    // An empty completion means the kernel buffer overflowed
+    completedBytes = 0;
+    waitResult = WAIT_OBJECT_0 + 2;
+    changes.clear();
+    REQUIRE(backend->wait(-1, changes) == FileWatchBackend::WaitResult::Changes);
+    REQUIRE(changes.size() == 1);
+    CHECK(changes[0].overflow);
+    CHECK(changes[0].directory == L"C:\\cfg");
+    CHECK(posted.size() == 2);
+
+    // A read that cannot be reposted drops the handle and retries later,
+    // waking up for the retry even with nothing else pending
+    failRead = true;
+    completedBytes = AppendRecord(posted[1].buffer, 0, 0, FILE_ACTION_MODIFIED, L"kbdlayoutmon.config");
+    changes.clear();
+    backend->wait(-1, changes);
+    CHECK(changes.empty());
+    waitResult = WAIT_TIMEOUT;
+    REQUIRE(backend->wait(-1, changes) == FileWatchBackend::WaitResult::Timeout);
+    CHECK(lastTimeout <= 50);
+
+    failRead = false;
+    std::this_thread::sleep_for(std::chrono::milliseconds(60));
+    REQUIRE(backend->wait(-1, changes) == FileWatchBackend::WaitResult::Changes);
+    CHECK(openedDirectories == 2);
+    REQUIRE(changes.size() == 1);
+    CHECK(changes[0].overflow);
+}
+
+TEST_CASE("ReadDirectoryChangesW backend logs a lost watch once", "[file_watch]") {
+    namespace fs = std::filesystem;
+    bool prevDebug = GetAppState().debugEnabled.load();
+    auto prevLevel = g_logLevel.load();
+    GetAppState().debugEnabled.store(true);
+    g_logLevel.store(LogLevel::Info);
+    fs::path dir = fs::temp_directory_path() / "immon_watch_retry_log";
+    fs::create_directories(dir);
+    fs::path logPath = dir / "watch.log";
+    g_config.set(L"log_path", logPath.wstring());
+
+    ScriptedWin32 win32;
+    failRead = true;
+    auto backend = CreateDirectoryChangesBackend();
+    REQUIRE(backend->addDirectory(L"C:\\cfg"));
+    std::vector<FileWatchChange> changes;
+    // Every retry fails until the directory can be read again
+    for (int i = 0; i < 3; ++i) {
+        backend->wait(-1, changes);
+        std::this_thread::sleep_for(std::chrono::milliseconds(50 << i) + std::chrono::milliseconds(10));
+    }
+    CHECK(openedDirectories >= 3);
+    failRead = false;
+    std::this_thread::sleep_for(std::chrono::milliseconds(410));
+    REQUIRE(backend->wait(-1, changes) == FileWatchBackend::WaitResult::Changes);
+    REQUIRE(changes.size() == 1);
+    CHECK(changes[0].overflow);
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    size_t failures = 0;
+    size_t recoveries = 0;
+    std::wifstream logFile(logPath);
+    for (std::wstring line; std::getline(logFile, line);) {
+        if (line.find(L"retrying in the background") != std::wstring::npos)
+            ++failures;
+        if (line.find(L"Watching directory again") != std::wstring::npos)
+            ++recoveries;
+    }
+    CHECK(failures == 1);
+    CHECK(recoveries == 1);
+
+    g_config.set(L"log_path", L"");
+    fs::remove_all(dir);
+    GetAppState().debugEnabled.store(prevDebug);
+    g_logLevel.store(prevLevel);
+}
+
+#endif // !_WIN32
@@ -0,0 +1,159 @@
+#include <catch2/catch_test_macros.hpp>
+#include "windows_stub.h"
+#include "../source/latency_stats.h"
+#include "../source/layout_event_ring.h"
+#include "../source/layout_pipeline.h"
+#include "../source/log.h"
+#include "../source/configuration.h"
+#include "../source/app_state.h"
+#include "../source/shared_memory.h"
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "unique_name.h"
+
+namespace {
+std::unique_ptr<LatencyHistogram> MakeHistogram() {
+    auto h = std::make_unique<LatencyHistogram>();
+    h->reset();
+    return h;
+}
+
+void IgnoreLog(LogLevel, const std::wstring&) {}
+
+std::atomic<int> g_persisted{0};
+std::atomic<uint64_t> g_lastOrigin{0};
+void CountPersisted(uint64_t originNs) {
+    g_lastOrigin.store(originNs);
+    g_persisted.fetch_add(1);
+}
+}
+
+TEST_CASE("Latency buckets cover every value within their bounds", "[latency]") {
+    REQUIRE(LatencyHistogram::BucketFor(0) == 0);
+    REQUIRE(LatencyHistogram::BucketFor(15) == 15);
+    REQUIRE(LatencyHistogram::BucketFor(~uint64_t{0}) == LatencyHistogram::kBuckets - 1);
+    REQUIRE(LatencyHistogram::BucketUpperBound(LatencyHistogram::kBuckets - 1) == ~uint64_t{0});
+
+    std::vector<uint64_t> samples = {16, 17, 31, 32, 33, 1000, 1023, 1024, 123456789, 1ull << 40};
+    for (uint64_t v : samples) {
+        size_t index = LatencyHistogram::BucketFor(v);
+        REQUIRE(v <= LatencyHistogram::BucketUpperBound(index));
+        REQUIRE(v > LatencyHistogram::BucketUpperBound(index - 1));
+        // Relative width of a bucket is at most 1/16
+        REQUIRE(LatencyHistogram::BucketUpperBound(index) - v <= v / 16);
+    }
+}
+
+TEST_CASE("Latency percentiles track a known distribution", "[latency]") {
+    auto h = MakeHistogram();
+    REQUIRE(h->percentile(0.5) == 0);
+    REQUIRE(h->summary().count == 0);
+
+    for (uint64_t v = 1; v <= 10000; ++v)
+        h->record(v * 1000);
+
+    LatencySummary s = h->summary();
+    REQUIRE(s.count == 10000);
+    REQUIRE(s.maxNs == 10000000);
+    REQUIRE(s.meanNs == 5000500);
+    auto near = [](uint64_t actual, uint64_t expected) {
+        return actual >= expected && actual <= expected + expected / 16;
+    };
+    REQUIRE(near(s.p50Ns, 5000000));
+    REQUIRE(near(s.p90Ns, 9000000));
+    REQUIRE(near(s.p99Ns, 9900000));
+    REQUIRE(s.p999Ns <= s.maxNs);
+    REQUIRE(h->percentile(1.0) == s.maxNs);
+
+    h->reset();
+    REQUIRE(h->summary().count == 0);
+}
+
+TEST_CASE("Latency histogram loses no samples under contention", "[latency]") {
+    auto h = MakeHistogram();
+    constexpr int kThreads = 8;
+    constexpr uint64_t kPerThread = 20000;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t) {
+        threads.emplace_back([&h, t] {
+            for (uint64_t i = 0; i < kPerThread; ++i)
+                h->record((i % 100) * 10 + static_cast<uint64_t>(t));
+        });
+    }
+    for (auto& th : threads)
+        th.join();
+
+    REQUIRE(h->count.load() == kThreads * kPerThread);
+    uint64_t total = 0;
+    for (const auto& b : h->buckets)
+        total += b.load();
+    REQUIRE(total == kThreads * kPerThread);
+    REQUIRE(h->maxNs.load() == 990 + kThreads - 1);
+}
+
+TEST_CASE("Latency stats are shared between views and timelines", "[latency]") {
+    std::wstring name = UniqueName(L"immon_test_latency");
+    SharedMemory::unlink(name);
+
+    LatencyStats hook;
+    LatencyStats host;
+    REQUIRE(hook.open(name));
+    REQUIRE(host.open(name));
+
+    hook.record(LatencyStage::HookBlocked, 2000);
+    hook.record(LatencyStage::HookBlocked, 4000);
+    REQUIRE(host.summary(LatencyStage::HookBlocked).count == 2);
+    REQUIRE(host.summary(LatencyStage::HookBlocked).maxNs == 4000);
+
+    // Registry writes succeed in the stubs, so every write stage is marked
+    LayoutTimeline timeline{&host, LayoutEventClockNs()};
+    SetDefaultInputMethodInRegistry(L"0409", L"00000409", IgnoreLog, timeline);
+    REQUIRE(hook.summary(LatencyStage::PreloadWritten).count == 1);
+    REQUIRE(hook.summary(LatencyStage::DefaultPreloadWritten).count == 1);
+    REQUIRE(hook.summary(LatencyStage::OverrideWritten).count == 1);
+    REQUIRE(hook.summary(LatencyStage::Dequeued).count == 0);
+
+    std::wstring report = host.report();
+    REQUIRE(report.find(L"hook_blocked: n=2 ") != std::wstring::npos);
+    REQUIRE(report.find(L"log_persisted: n=0\n") != std::wstring::npos);
+
+    host.reset();
+    REQUIRE(hook.summary(LatencyStage::HookBlocked).count == 0);
+
+    // A closed instance ignores records
+    LatencyStats closed;
+    closed.record(LatencyStage::Enqueued, 1);
+    LayoutTimeline{&closed, 1}.mark(LatencyStage::Enqueued);
+    REQUIRE(closed.summary(LatencyStage::Enqueued).count == 0);
+
+    hook.close();
+    host.close();
+    SharedMemory::unlink(name);
+}
+
+TEST_CASE("Log reports timed entries once they are written", "[latency][log]") {
+    GetAppState().debugEnabled.store(true);
+    g_logLevel.store(LogLevel::Info);
+    using namespace std::chrono_literals;
+    namespace fs = std::filesystem;
+    fs::path dir = fs::temp_directory_path() / "immon_latency_log_test";
+    fs::create_directories(dir);
+    g_config.set(L"log_path", (dir / "latency.log").wstring());
+
+    g_persisted.store(0);
+    Log log;
+    log.setPersistedCallback(CountPersisted);
+    log.write(LogLevel::Info, L"untimed");
+    log.write(LogLevel::Info, L"timed", 1234);
+    log.shutdown();
+
+    REQUIRE(g_persisted.load() == 1);
+    REQUIRE(g_lastOrigin.load() == 1234);
+
+    fs::remove_all(dir);
+}
@@ -0,0 +1,186 @@
+#include <catch2/catch_test_macros.hpp>
+#include "windows_stub.h"
+#include "../source/layout_event_consumer.h"
+#include "../source/layout_event_ring.h"
+#include "../source/layout_pipeline.h"
+#include "../source/shared_memory.h"
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include "unique_name.h"
+
+namespace {
+LayoutEvent MakeEvent(uint64_t hkl, uint32_t pid = 1) {
+    LayoutEvent event;
+    event.hkl = hkl;
+    event.timestampNs = LayoutEventClockNs();
+    event.pid = pid;
+    return event;
+}
+
+std::vector<std::pair<LogLevel, std::wstring>> g_pipelineLog;
+void CaptureLog(LogLevel level, const std::wstring& message) {
+    g_pipelineLog.emplace_back(level, message);
+}
+}
+
+TEST_CASE("Layout event ring is FIFO across views and wraps around", "[layout_events]") {
+    std::wstring name = UniqueName(L"immon_test_ring");
+    SharedMemory::unlink(name);
+
+    LayoutEventRing producer;
+    LayoutEventRing consumer;
+    REQUIRE(producer.open(name));
+    REQUIRE(consumer.open(name));
+
+    LayoutEvent out;
+    REQUIRE_FALSE(consumer.pop(out));
+    // Several laps so every slot's biased sequence is exercised.
+    for (uint64_t i = 1; i <= LayoutEventRingBlock::kCapacity * 3; ++i) {
+        REQUIRE(producer.push(MakeEvent(i, 42)));
+        REQUIRE(consumer.pop(out));
+        REQUIRE(out.hkl == i);
+        REQUIRE(out.pid == 42);
+    }
+    REQUIRE_FALSE(consumer.pop(out));
+
+    producer.close();
+    consumer.close();
+    SharedMemory::unlink(name);
+}
+
+TEST_CASE("Layout event ring drops and counts events when full", "[layout_events]") {
+    std::wstring name = UniqueName(L"immon_test_ring_full");
+    SharedMemory::unlink(name);
+
+    LayoutEventRing ring;
+    REQUIRE(ring.open(name));
+    for (uint64_t i = 0; i < LayoutEventRingBlock::kCapacity; ++i)
+        REQUIRE(ring.push(MakeEvent(i)));
+    REQUIRE_FALSE(ring.push(MakeEvent(999)));
+    REQUIRE(ring.dropped() == 1);
+
+    LayoutEvent out;
+    REQUIRE(ring.pop(out));
+    REQUIRE(out.hkl == 0);
+    REQUIRE(ring.push(MakeEvent(1000)));
+
+    ring.close();
+    SharedMemory::unlink(name);
+}
+
+TEST_CASE("Layout event consumer handles every event from concurrent producers", "[layout_events]") {
+    std::wstring name = UniqueName(L"immon_test_consumer");
+    SharedMemory::unlink(name);
+
+    std::mutex mutex;
+    std::set<uint64_t> seen;
+    LayoutEventConsumer consumer;
+    REQUIRE(consumer.start([&](const LayoutEvent& event) {
+        std::lock_guard<std::mutex> lock(mutex);
+        seen.insert(event.hkl);
+    }, name));
+
+    const int producers = 4;
+    const int perProducer = 2000;
+    std::atomic<int> pushed{0};
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++p) {
+        threads.emplace_back([&, p]() {
+            LayoutEventRing ring;
+            if (!ring.open(name))
+                return;
+            for (int i = 0; i < perProducer; ++i) {
+                uint64_t hkl = static_cast<uint64_t>(p) * perProducer + i + 1;
+                while (!ring.push(MakeEvent(hkl, static_cast<uint32_t>(p))))
+                    std::this_thread::yield();
+                ++pushed;
+                consumer.notify();
+            }
+        });
+    }
+    for (auto& t : threads)
+        t.join();
+    REQUIRE(pushed == producers * perProducer);
+
+    consumer.stop();
+    REQUIRE(seen.size() == static_cast<size_t>(producers * perProducer));
+    SharedMemory::unlink(name);
+}
+
+TEST_CASE("Layout pipeline formats locale IDs and reports registry results", "[layout_events]") {
+    REQUIRE(GetLocaleID(0x04090409) == L"0409");
+    REQUIRE(GetLocaleID(0xF0020C0A) == L"0c0a");
+
+    g_pipelineLog.clear();
+    g_RegOpenKeyExFailOnSetValue = false;
+    g_RegSetValueExResult = ERROR_SUCCESS;
+    SetDefaultInputMethodInRegistry(L"0409", L"00000409", CaptureLog);
+    REQUIRE(g_pipelineLog.size() == 3);
+    for (const auto& entry : g_pipelineLog)
+        REQUIRE(entry.first == LogLevel::Info);
+    REQUIRE(g_pipelineLog.back().second.find(L"0409:00000409") != std::wstring::npos);
+
+    g_pipelineLog.clear();
+    g_RegSetValueExResult = 5;
+    SetDefaultInputMethodInRegistry(L"0409", L"00000409", CaptureLog);
+    g_RegSetValueExResult = ERROR_SUCCESS;
+    REQUIRE(g_pipelineLog.size() == 3);
+    for (const auto& entry : g_pipelineLog)
+        REQUIRE(entry.first == LogLevel::Error);
+}
+
+TEST_CASE("Layout names are derived from the handle, not the calling thread", "[layout_events]") {
+    LayoutNames plain = ResolveLayoutNames(0x04090409);
+    REQUIRE(std::wstring(plain.localeID) == L"0409");
+    REQUIRE(std::wstring(plain.klid) == L"00000409");
+
+    // UK layout with US English language
+    LayoutNames mixed = ResolveLayoutNames(0x08090409);
+    REQUIRE(std::wstring(mixed.localeID) == L"0409");
+    REQUIRE(std::wstring(mixed.klid) == L"00000809");
+
+    LayoutNames ime = ResolveLayoutNames(0xFFFFFFFFE0010411ull);
+    REQUIRE(std::wstring(ime.localeID) == L"0411");
+    REQUIRE(std::wstring(ime.klid) == L"E0010411");
+
+    // Unknown layout id falls back to the language's base layout
+    LayoutNames variant = ResolveLayoutNames(0xFFFFFFFFF0020C0Aull);
+    REQUIRE(std::wstring(variant.localeID) == L"0c0a");
+    REQUIRE(std::wstring(variant.klid) == L"00000C0A");
+
+    REQUIRE(GetKLID(0x040C040C) == L"0000040C");
+}
+
+namespace {
+int g_resolveCalls = 0;
+LayoutNames CountingResolver(uint64_t hkl) {
+    ++g_resolveCalls;
+    return ResolveLayoutNames(hkl);
+}
+}
+
+TEST_CASE("Layout name cache resolves once and invalidates on layout list changes", "[layout_events]") {
+    g_resolveCalls = 0;
+    LayoutNameCache cache(CountingResolver);
+    for (int i = 0; i < 5; ++i) {
+        REQUIRE(std::wstring(cache.get(0x04090409, 1).klid) == L"00000409");
+        REQUIRE(std::wstring(cache.get(0x04070407, 1).klid) == L"00000407");
+    }
+    REQUIRE(g_resolveCalls == 2);
+    REQUIRE(cache.misses() == 2);
+
+    // A different installed-layout signature drops every entry.
+    cache.get(0x04090409, 2);
+    REQUIRE(g_resolveCalls == 3);
+
+    // Round-robin replacement keeps at most kCapacity entries.
+    for (uint64_t i = 0; i < LayoutNameCache::kCapacity + 1; ++i)
+        cache.get(0x04000400 + i, 2);
+    cache.get(0x04000400 + LayoutNameCache::kCapacity, 2);
+    REQUIRE(g_resolveCalls == 3 + static_cast<int>(LayoutNameCache::kCapacity) + 1);
+}
@@ -0,0 +1,125 @@
+#include <catch2/catch_test_macros.hpp>
+#include "windows_stub.h"
+#include "../source/layout_trace.h"
+#include "../source/layout_pipeline.h"
+#include "../source/shared_memory.h"
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "unique_name.h"
+#ifndef _WIN32
+#include "memory_registry.h"
+#endif
+
+namespace {
+std::vector<LayoutTraceRecord> MakeTrace(size_t count, uint64_t gapNs) {
+    std::vector<LayoutTraceRecord> records;
+    for (size_t i = 0; i < count; ++i) {
+        LayoutTraceRecord record;
+        record.timestampNs = 1000 + i * gapNs;
+        record.hkl = (i % 2) ? 0x040C040C : 0x04090409;
+        record.pid = 7;
+        record.sequence = static_cast<uint32_t>(i + 1);
+        records.push_back(record);
+    }
+    return records;
+}
+
+void IgnoreLog(LogLevel, const std::wstring&) {}
+}
+
+TEST_CASE("Layout trace round-trips records and ignores a torn tail", "[layout_trace]") {
+    namespace fs = std::filesystem;
+    fs::path path = fs::temp_directory_path() / "immon_layout_trace.bin";
+
+    LayoutTraceWriter writer;
+    REQUIRE(writer.open(path.wstring()));
+    REQUIRE(writer.path() == path.wstring());
+    auto records = MakeTrace(10, 500);
+    records[3].flags = LayoutTraceRecord::kSkipped;
+    records[4].writes = LayoutWritePreload | LayoutWriteOverride;
+    for (const auto& r : records)
+        REQUIRE(writer.append(r));
+    writer.close();
+    REQUIRE_FALSE(writer.isOpen());
+    REQUIRE_FALSE(writer.append(records[0]));
+
+    {
+        std::ofstream torn(path, std::ios::binary | std::ios::app);
+        torn.write("\x01\x02\x03", 3);
+    }
+
+    std::vector<LayoutTraceRecord> loaded;
+    REQUIRE(ReadLayoutTrace(path.wstring(), loaded));
+    REQUIRE(loaded.size() == records.size());
+    for (size_t i = 0; i < records.size(); ++i) {
+        REQUIRE(loaded[i].timestampNs == records[i].timestampNs);
+        REQUIRE(loaded[i].hkl == records[i].hkl);
+        REQUIRE(loaded[i].sequence == records[i].sequence);
+        REQUIRE(loaded[i].flags == records[i].flags);
+        REQUIRE(loaded[i].writes == records[i].writes);
+    }
+
+    {
+        std::ofstream bogus(path, std::ios::binary | std::ios::trunc);
+        bogus << "not a trace";
+    }
+    REQUIRE_FALSE(ReadLayoutTrace(path.wstring(), loaded));
+    REQUIRE_FALSE(ReadLayoutTrace((fs::temp_directory_path() / "immon_missing.bin").wstring(), loaded));
+    fs::remove(path);
+}
+
+TEST_CASE("Layout trace replay delivers every event in order without drops", "[layout_trace]") {
+    // More events than the ring holds so the producer has to wait
+    auto records = MakeTrace(LayoutEventRingBlock::kCapacity * 4, 1000);
+    LayoutReplayOptions options;
+    options.ringName = UniqueName(L"immon_test_replay");
+
+    std::vector<uint32_t> sequences;
+    LayoutReplayResult result;
+    REQUIRE(ReplayLayoutTrace(records, [&](const LayoutEvent& e) { sequences.push_back(e.sequence); }, options,
+                              result));
+    REQUIRE(result.events == records.size());
+    REQUIRE(sequences.size() == records.size());
+    for (size_t i = 0; i < sequences.size(); ++i)
+        REQUIRE(sequences[i] == records[i].sequence);
+}
+
+TEST_CASE("Layout trace replay honours recorded spacing in realtime mode", "[layout_trace]") {
+    // 5 events 20 ms apart, replayed at double speed: at least ~40 ms
+    auto records = MakeTrace(5, 20000000);
+    LayoutReplayOptions options;
+    options.ringName = UniqueName(L"immon_test_replay_rt");
+    options.realtime = true;
+    options.speed = 2.0;
+    LayoutReplayResult result;
+    REQUIRE(ReplayLayoutTrace(records, [](const LayoutEvent&) {}, options, result));
+    REQUIRE(result.events == 5);
+    REQUIRE(result.elapsedNs >= 40000000ull);
+}
+
+#ifndef _WIN32
+TEST_CASE("Memory registry keeps the values the pipeline writes", "[layout_trace]") {
+    MemoryRegistry& registry = MemoryRegistry::instance();
+    registry.clear();
+    registry.install();
+
+    unsigned writes = SetDefaultInputMethodInRegistry(L"040c", L"0000040C", IgnoreLog);
+    REQUIRE(writes == (LayoutWritePreload | LayoutWriteDefaultPreload | LayoutWriteOverride));
+    REQUIRE(registry.writes() == 3);
+    REQUIRE(registry.value(HKEY_CURRENT_USER, L"Keyboard Layout\\Preload", L"1") == std::wstring(L"0000040C"));
+    REQUIRE(registry.value(HKEY_USERS, L".DEFAULT\\Keyboard Layout\\Preload", L"1") ==
+            std::wstring(L"0000040C"));
+    REQUIRE(registry.value(HKEY_CURRENT_USER, L"Control Panel\\International\\User Profile",
+                           L"InputMethodOverride") == std::wstring(L"040c:0000040C"));
+
+    SetDefaultInputMethodInRegistry(L"0409", L"00000409", IgnoreLog);
+    REQUIRE(registry.writes() == 6);
+    REQUIRE(registry.value(HKEY_CURRENT_USER, L"Keyboard Layout\\Preload", L"1") == std::wstring(L"00000409"));
+
+    registry.uninstall();
+    registry.clear();
+    REQUIRE_FALSE(registry.value(HKEY_CURRENT_USER, L"Keyboard Layout\\Preload", L"1").has_value());
+}
+#endif
@@ -0,0 +1,334 @@
+#include <catch2/catch_test_macros.hpp>
+#include "../source/shared_memory.h"
+#include "../source/shared_state.h"
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include "unique_name.h"
+
+TEST_CASE("SharedMemory views of one name alias the same bytes", "[shared_state]") {
+    std::wstring name = UniqueName(L"immon_test_shm");
+    SharedMemory::unlink(name);
+
+    SharedMemory first;
+    REQUIRE(first.open(name, 4096));
+    REQUIRE(first.created());
+    SharedMemory second;
+    REQUIRE(second.open(name, 4096));
+    REQUIRE_FALSE(second.created());
+
+    static_cast<unsigned char*>(first.data())[17] = 0xAB;
+    REQUIRE(static_cast<unsigned char*>(second.data())[17] == 0xAB);
+
+    SharedMemory reader;
+    REQUIRE(reader.open(name, 4096, SharedMemory::Access::ReadOnly));
+    REQUIRE(static_cast<const unsigned char*>(reader.data())[17] == 0xAB);
+
+    first.close();
+    second.close();
+    reader.close();
+    SharedMemory::unlink(name);
+}
+
+TEST_CASE("SharedStatePage publishes to every attached view", "[shared_state]") {
+    std::wstring name = UniqueName(L"immon_test_state");
+    SharedMemory::unlink(name);
+
+    SharedStatePage host;
+    SharedStatePage hook;
+    REQUIRE(host.openForPublish(name));
+    REQUIRE(hook.open(name));
+
+    SharedStateSnapshot initial = hook.read();
+    REQUIRE_FALSE(initial.debugEnabled);
+    REQUIRE(initial.logLevel == LogLevel::Info);
+    REQUIRE(initial.configGeneration == 0);
+
+    host.setLanguageHotKeyEnabled(true);
+    host.setDebugEnabled(true);
+    host.setLogLevel(LogLevel::Warn);
+    REQUIRE(host.bumpConfigGeneration() == 1);
+
+    SharedStateSnapshot seen = hook.read();
+    REQUIRE(seen.languageHotKeyEnabled);
+    REQUIRE_FALSE(seen.layoutHotKeyEnabled);
+    REQUIRE(seen.debugEnabled);
+    REQUIRE(seen.logLevel == LogLevel::Warn);
+    REQUIRE(seen.configGeneration == 1);
+    REQUIRE(hook.languageHotKeyEnabled());
+
+    hook.setLastHKL(0x04090409);
+    REQUIRE(host.lastHKL() == 0x04090409);
+
+    // Only the executable publishes
+    hook.setLayoutHotKeyEnabled(true);
+    REQUIRE(hook.bumpConfigGeneration() == 0);
+    REQUIRE_FALSE(host.read().layoutHotKeyEnabled);
+    REQUIRE(host.read().configGeneration == 1);
+
+    host.close();
+    hook.close();
+    SharedMemory::unlink(name);
+}
+
+// Hooks have no setter of their own: whether they log follows what the
+// executable publishes on the page.
+TEST_CASE("Hook logging follows the debug state the host publishes", "[shared_state]") {
+    std::wstring name = UniqueName(L"immon_test_state_log");
+    SharedMemory::unlink(name);
+
+    SharedStatePage host;
+    SharedStatePage hook;
+    REQUIRE(host.openForPublish(name));
+    REQUIRE(hook.open(name));
+
+    REQUIRE_FALSE(hook.read().logs(LogLevel::Error));
+
+    host.update([](SharedStateSnapshot& s) {
+        s.debugEnabled = true;
+        s.logLevel = LogLevel::Warn;
+    });
+    SharedStateSnapshot on = hook.read();
+    REQUIRE_FALSE(on.logs(LogLevel::Info));
+    REQUIRE(on.logs(LogLevel::Warn));
+    REQUIRE(on.logs(LogLevel::Error));
+
+    host.update([](SharedStateSnapshot& s) { s.debugEnabled = false; });
+    SharedStateSnapshot off = hook.read();
+    REQUIRE(off.logLevel == LogLevel::Warn);
+    REQUIRE_FALSE(off.logs(LogLevel::Error));
+
+    host.close();
+    hook.close();
+    SharedMemory::unlink(name);
+}
+
+TEST_CASE("SharedStatePage reference count is exact under contention", "[shared_state]") {
+    std::wstring name = UniqueName(L"immon_test_refcount");
+    SharedMemory::unlink(name);
+
+    SharedStatePage page;
+    REQUIRE(page.open(name));
+    const int threads = 8;
+    const int iterations = 10000;
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&name, iterations]() {
+            SharedStatePage view;
+            if (!view.open(name))
+                return;
+            for (int i = 0; i < iterations; ++i) {
+                view.incrementRefCount();
+                view.decrementRefCount();
+                view.incrementRefCount();
+            }
+        });
+    }
+    for (auto& w : workers)
+        w.join();
+    REQUIRE(page.refCount() == threads * iterations);
+
+    page.close();
+    SharedMemory::unlink(name);
+}
+
+TEST_CASE("SharedStatePage readers never observe torn snapshots", "[shared_state]") {
+    std::wstring name = UniqueName(L"immon_test_seqlock");
+    SharedMemory::unlink(name);
+
+    SharedStatePage writer;
+    SharedStatePage reader;
+    REQUIRE(writer.openForPublish(name));
+    REQUIRE(reader.open(name));
+
+    // Every published snapshot keeps all flags equal to the generation's
+    // parity, so a mix of two writes is detectable.
+    std::atomic<bool> done{false};
+    std::thread producer([&]() {
+        for (uint32_t gen = 1; gen <= 20000; ++gen) {
+            bool odd = (gen & 1u) != 0;
+            SharedStateSnapshot s;
+            s.languageHotKeyEnabled = odd;
+            s.layoutHotKeyEnabled = odd;
+            s.debugEnabled = odd;
+            s.logLevel = odd ? LogLevel::Error : LogLevel::Info;
+            s.configGeneration = gen;
+            writer.publish(s);
+        }
+        done = true;
+    });
+
+    size_t torn = 0;
+    while (!done) {
+        SharedStateSnapshot s = reader.read();
+        bool odd = (s.configGeneration & 1u) != 0;
+        if (s.languageHotKeyEnabled != odd || s.layoutHotKeyEnabled != odd ||
+            s.debugEnabled != odd || (s.logLevel == LogLevel::Error) != odd)
+            ++torn;
+    }
+    producer.join();
+    REQUIRE(torn == 0);
+    REQUIRE(reader.read().configGeneration == 20000);
+
+    writer.close();
+    reader.close();
+    SharedMemory::unlink(name);
+}
+
+TEST_CASE("SharedStatePage survives a publisher that died mid-write", "[shared_state]") {
+    std::wstring name = UniqueName(L"immon_test_deadwriter");
+    SharedMemory::unlink(name);
+
+    SharedStatePage host;
+    REQUIRE(host.openForPublish(name));
+    host.setDebugEnabled(true);
+
+    // Leave a write unfinished, as an executable killed inside one would
+    SharedMemory raw;
+    REQUIRE(raw.open(name, sizeof(SharedStateBlock)));
+    auto* block = static_cast<SharedStateBlock*>(raw.data());
+    block->sequence.fetch_add(1);
+    host.close();
+
+    SharedStatePage hook;
+    REQUIRE(hook.open(name));
+    SharedStateSnapshot stale = hook.read();
+    REQUIRE_FALSE(stale.debugEnabled); // logging off instead of spinning
+    REQUIRE_FALSE(stale.languageHotKeyEnabled);
+    REQUIRE(hook.claimLayoutChange(0x04090409) != 0); // single atomics still work
+
+    SharedStatePage restarted;
+    REQUIRE(restarted.openForPublish(name));
+    REQUIRE((block->sequence.load() & 1u) == 0);
+    restarted.setLanguageHotKeyEnabled(true);
+    REQUIRE(hook.read().languageHotKeyEnabled);
+    REQUIRE(hook.read().debugEnabled);
+
+    restarted.close();
+    hook.close();
+    raw.close();
+    SharedMemory::unlink(name);
+}
+
+TEST_CASE("SharedStatePage keeps the last snapshot while a live writer is mid-write", "[shared_state]") {
+    std::wstring name = UniqueName(L"immon_test_slowwriter");
+    SharedMemory::unlink(name);
+
+    SharedStatePage host;
+    REQUIRE(host.openForPublish(name));
+    SharedStateSnapshot published;
+    published.languageHotKeyEnabled = true;
+    published.layoutHotKeyEnabled = true;
+    published.logLevel = LogLevel::Warn;
+    published.configGeneration = 7;
+    host.publish(published);
+
+    SharedStatePage hook;
+    REQUIRE(hook.open(name));
+    REQUIRE(hook.read().configGeneration == 7);
+    SharedStatePage fresh;
+    REQUIRE(fresh.open(name));
+
+    // The executable is preempted inside update(), holding the sequence odd
+    std::atomic<bool> writing{false};
+    std::atomic<bool> release{false};
+    std::thread writer([&] {
+        host.update([&](SharedStateSnapshot& s) {
+            writing = true;
+            while (!release)
+                std::this_thread::yield();
+            s.layoutHotKeyEnabled = false;
+            s.configGeneration = 8;
+        });
+    });
+    while (!writing)
+        std::this_thread::yield();
+
+    SharedStateSnapshot during = hook.read();
+    REQUIRE(during.languageHotKeyEnabled);
+    REQUIRE(during.layoutHotKeyEnabled);
+    REQUIRE(during.logLevel == LogLevel::Warn);
+    REQUIRE(during.configGeneration == 7);
+    // A view that never read a consistent snapshot falls back to defaults
+    REQUIRE_FALSE(fresh.read().languageHotKeyEnabled);
+
+    release = true;
+    writer.join();
+    SharedStateSnapshot after = hook.read();
+    REQUIRE(after.configGeneration == 8);
+    REQUIRE_FALSE(after.layoutHotKeyEnabled);
+    REQUIRE(after.languageHotKeyEnabled);
+
+    fresh.close();
+    hook.close();
+    host.close();
+    SharedMemory::unlink(name);
+}
+
+TEST_CASE("SharedStatePage ignores calls while closed", "[shared_state]") {
+    SharedStatePage page;
+    REQUIRE_FALSE(page.isOpen());
+    page.setDebugEnabled(true);
+    REQUIRE(page.incrementRefCount() == 0);
+    REQUIRE_FALSE(page.read().debugEnabled);
+}
+
+TEST_CASE("SharedStatePage claims each layout transition exactly once", "[shared_state]") {
+    std::wstring name = UniqueName(L"immon_test_claim");
+    SharedMemory::unlink(name);
+
+    SharedStatePage seed;
+    REQUIRE(seed.open(name));
+    seed.setLastHKL(0x04090409);
+    REQUIRE(seed.claimLayoutChange(0x04090409) == 0);
+
+    // Each step is reported by every "process" at once, like HSHELL_LANGUAGE
+    // reaching all hooked processes. Layouts alternate so every step is a
+    // real transition.
+    const int threads = 8;
+    const uint32_t steps = 2000;
+    const uint64_t layouts[] = {0x04070407, 0x04090409, 0x04110411};
+    std::atomic<uint32_t> arrived{0};
+    std::atomic<uint32_t> claims[steps] = {};
+    std::atomic<uint32_t> badSequence{0};
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&]() {
+            SharedStatePage view;
+            if (!view.open(name))
+                return;
+            for (uint32_t step = 0; step < steps; ++step) {
+                // Spin barrier: wait for every worker to finish the previous step.
+                arrived.fetch_add(1);
+                while (arrived.load() < (step + 1) * threads)
+                    std::this_thread::yield();
+                uint32_t sequence = view.claimLayoutChange(layouts[step % 3]);
+                if (sequence != 0) {
+                    claims[step].fetch_add(1);
+                    if (sequence != step + 1)
+                        badSequence.fetch_add(1);
+                }
+            }
+        });
+    }
+    for (auto& w : workers)
+        w.join();
+
+    size_t wrong = 0;
+    for (uint32_t step = 0; step < steps; ++step)
+        if (claims[step].load() != 1)
+            ++wrong;
+    REQUIRE(wrong == 0);
+    REQUIRE(badSequence == 0);
+    REQUIRE(seed.layoutSequence() == steps);
+    REQUIRE(seed.lastHKL() == layouts[(steps - 1) % 3]);
+
+    // 64-bit HKLs are sign-extended 32-bit handles and survive the packing.
+    const uint64_t extended = 0xFFFFFFFFF0020C0Aull;
+    REQUIRE(seed.claimLayoutChange(extended) == steps + 1);
+    REQUIRE(seed.lastHKL() == extended);
+
+    seed.close();
+    SharedMemory::unlink(name);
+}
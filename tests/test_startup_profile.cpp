@@ -0,0 +1,56 @@
+#include <catch2/catch_test_macros.hpp>
+#include "../source/startup_profile.h"
+#include <string>
+#include <thread>
+
+TEST_CASE("Startup phases nest and stop recording after finish", "[startup_profile]") {
+    StartupProfile profile;
+    {
+        ScopedStartupPhase outer(L"load configuration", profile);
+        ScopedStartupPhase inner(L"parse text", profile);
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    ScopedStartupPhase next(L"create tray icon", profile);
+    next.end();
+    next.end(); // ending twice is harmless
+
+    std::thread([&] { ScopedStartupPhase worker(L"worker", profile); }).join();
+    ScopedStartupPhase running(L"still running", profile);
+
+    auto phases = profile.phases();
+    REQUIRE(phases.size() == 5);
+    REQUIRE(std::wstring(phases[0].name) == L"load configuration");
+    REQUIRE(phases[0].depth == 0);
+    REQUIRE(phases[1].depth == 1);
+    REQUIRE(phases[1].durationNs >= 2000000);
+    REQUIRE(phases[0].durationNs >= phases[1].durationNs);
+    REQUIRE(phases[1].startNs >= phases[0].startNs);
+    REQUIRE(phases[2].depth == 0);
+    REQUIRE(phases[2].startNs >= phases[0].startNs + phases[0].durationNs);
+    REQUIRE(phases[3].depth == 0); // other threads nest separately
+    REQUIRE(phases[4].open);
+
+    std::wstring report = profile.report();
+    REQUIRE(report.find(L"  load configuration\n") != std::wstring::npos);
+    REQUIRE(report.find(L"    parse text\n") != std::wstring::npos);
+    REQUIRE(report.find(L"   running  still running\n") != std::wstring::npos);
+
+    profile.finish();
+    running.end();
+    uint64_t total = profile.totalNs();
+    ScopedStartupPhase late(L"reload", profile);
+    late.end();
+    REQUIRE(profile.phases().size() == 5);
+    REQUIRE_FALSE(profile.phases()[4].open);
+    REQUIRE(profile.totalNs() == total);
+    REQUIRE(total >= phases[1].durationNs);
+    REQUIRE(profile.report().find(L"total") != std::wstring::npos);
+}
+
+TEST_CASE("Startup profile keeps a bounded number of phases", "[startup_profile]") {
+    StartupProfile profile;
+    for (size_t i = 0; i < StartupProfile::kMaxPhases + 10; ++i)
+        ScopedStartupPhase phase(L"repeat", profile);
+    REQUIRE(profile.phases().size() == StartupProfile::kMaxPhases);
+    REQUIRE(profile.begin(L"extra") == StartupProfile::kNotRecorded);
+}
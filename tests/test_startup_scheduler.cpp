@@ -0,0 +1,124 @@
+#include <catch2/catch_test_macros.hpp>
+#include "../source/startup_scheduler.h"
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+// Record the order tasks finish in
+struct Order {
+    std::mutex mutex;
+    std::vector<std::wstring> names;
+    StartupScheduler::Task record(const wchar_t* name) {
+        return [this, name] {
+            std::lock_guard<std::mutex> lock(mutex);
+            names.push_back(name);
+        };
+    }
+    size_t position(const wchar_t* name) {
+        for (size_t i = 0; i < names.size(); ++i) {
+            if (names[i] == name)
+                return i;
+        }
+        return names.size();
+    }
+};
+} // namespace
+
+TEST_CASE("Independent startup tasks overlap and dependents wait", "[startup_scheduler]") {
+    StartupProfile profile;
+    StartupScheduler scheduler(profile);
+    Order order;
+    std::atomic<int> started{0};
+    std::atomic<bool> overlapped{false};
+    // Each waits for the other to start, which only happens on two threads
+    auto meet = [&](const wchar_t* name) {
+        return [&, name] {
+            ++started;
+            for (int i = 0; i < 1000 && started < 2; ++i)
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            if (started == 2)
+                overlapped = true;
+            order.record(name)();
+        };
+    };
+    auto config = scheduler.add(L"load configuration", meet(L"config"));
+    auto dll = scheduler.add(L"load hook DLL", meet(L"dll"));
+    auto apply = scheduler.add(L"apply configuration", order.record(L"apply"), {config, dll});
+    scheduler.add(L"install global hook", order.record(L"hook"), {apply});
+
+    REQUIRE(scheduler.add(L"unknown", nullptr, {42}) == StartupScheduler::kInvalidTask);
+    auto later = scheduler.defer(L"deferred", nullptr);
+    REQUIRE(scheduler.add(L"waits for deferred", nullptr, {later}) == StartupScheduler::kInvalidTask);
+
+    scheduler.run(3);
+
+    REQUIRE(overlapped);
+    REQUIRE(order.names.size() == 4);
+    REQUIRE(order.position(L"apply") == 2);
+    REQUIRE(order.position(L"hook") == 3);
+
+    auto phases = profile.phases();
+    REQUIRE(phases.size() == 4);
+    for (const StartupPhase& phase : phases)
+        REQUIRE_FALSE(phase.open);
+}
+
+TEST_CASE("Deferred startup tasks run in the background after run()", "[startup_scheduler]") {
+    StartupProfile profile;
+    StartupScheduler scheduler(profile);
+    Order order;
+    auto window = scheduler.add(L"create message window", order.record(L"window"));
+    auto watcher = scheduler.defer(L"start config watcher", order.record(L"watcher"), {window});
+    scheduler.defer(L"resync configuration", order.record(L"resync"), {watcher});
+    scheduler.defer(L"warm caches", order.record(L"warm"));
+
+    scheduler.run(1);
+    REQUIRE(order.names.size() == 1);
+
+    std::atomic<int> doneCalls{0};
+    std::atomic<size_t> finishedBeforeDone{0};
+    scheduler.runDeferred(2, [&] {
+        std::lock_guard<std::mutex> lock(order.mutex);
+        finishedBeforeDone = order.names.size();
+        ++doneCalls;
+    });
+    scheduler.wait();
+
+    REQUIRE(doneCalls == 1);
+    REQUIRE(finishedBeforeDone == 4);
+    REQUIRE(order.position(L"watcher") < order.position(L"resync"));
+    REQUIRE(profile.phases().size() == 4);
+
+    // Nothing deferred: the callback runs straight away
+    StartupScheduler empty(profile);
+    bool called = false;
+    empty.run(2);
+    empty.runDeferred(2, [&] { called = true; });
+    REQUIRE(called);
+}
+
+TEST_CASE("A startup task that throws still counts as finished", "[startup_scheduler]") {
+    StartupProfile profile;
+    StartupScheduler scheduler(profile);
+    Order order;
+    auto broken = scheduler.add(L"broken", [] { throw std::runtime_error("no hook DLL"); });
+    scheduler.add(L"after broken", order.record(L"after"), {broken});
+    auto later = scheduler.defer(L"broken later", [] { throw 42; });
+    scheduler.defer(L"after broken later", order.record(L"later"), {later});
+
+    scheduler.run(2);
+    REQUIRE(order.names.size() == 1);
+
+    std::atomic<bool> done{false};
+    scheduler.runDeferred(1, [&] { done = true; });
+    scheduler.wait();
+    REQUIRE(done);
+    REQUIRE(order.names.size() == 2);
+    for (const StartupPhase& phase : profile.phases())
+        REQUIRE_FALSE(phase.open);
+}
@@ -11,8 +11,6 @@
 // Globals expected by tray_icon and kbdlayoutmon
 extern HINSTANCE g_hInst;
 std::unique_ptr<TrayIcon> g_trayIcon;
-extern std::wstring g_cliIconPath;
-extern std::wstring g_cliTrayTooltip;
 extern HANDLE (*pLoadImageW)(HINSTANCE, LPCWSTR, UINT, int, int, UINT);
 
 // Track icon handles via mock Shell_NotifyIcon
@@ -77,8 +75,7 @@ TEST_CASE("CLI overrides applied to new tray icons") {
     g_loadedPath3.clear();
     g_lastTip3.clear();
     g_trayIcon.reset();
-    g_cliIconPath.clear();
-    g_cliTrayTooltip.clear();
+    g_config.clearLayer(ConfigLayer::CommandLine);
     pShell_NotifyIcon = FakeShellNotifyIcon3;
     pLoadImageW = DummyLoadImage3;
 
@@ -86,17 +83,15 @@ TEST_CASE("CLI overrides applied to new tray icons") {
     std::vector<std::wstring> argv = {L"app", L"--icon-path", L"cli.ico", L"--tray-tooltip", L"CliTip"};
     for (size_t i = 1; i < argv.size(); ++i) {
         if (argv[i] == L"--icon-path" && i + 1 < argv.size()) {
-            g_config.set(L"icon_path", argv[i + 1]);
-            g_cliIconPath = argv[i + 1];
+            g_config.set(L"icon_path", argv[i + 1], ConfigLayer::CommandLine);
             ++i;
         } else if (argv[i] == L"--tray-tooltip" && i + 1 < argv.size()) {
-            g_config.set(L"tray_tooltip", argv[i + 1]);
-            g_cliTrayTooltip = argv[i + 1];
+            g_config.set(L"tray_tooltip", argv[i + 1], ConfigLayer::CommandLine);
             ++i;
         }
     }
 
-    // Simulate config reload dropping entries but overrides persist
+    // The config file clearing these does not affect the overrides
     g_config.set(L"icon_path", L"");
     g_config.set(L"tray_tooltip", L"");
 
@@ -105,6 +100,5 @@ TEST_CASE("CLI overrides applied to new tray icons") {
     REQUIRE(g_lastTip3 == L"CliTip");
 
     g_trayIcon.reset();
-    g_cliIconPath.clear();
-    g_cliTrayTooltip.clear();
+    g_config.clearLayer(ConfigLayer::CommandLine);
 }
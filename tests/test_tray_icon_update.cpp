@@ -3,9 +3,14 @@
 #include "../source/configuration.h"
 #include "../source/app_state.h"
 #include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
 #include <memory>
 #include <set>
 #include <string>
+#include <thread>
+#include <vector>
 
 // Globals provided elsewhere
 extern HINSTANCE g_hInst;
@@ -70,3 +75,116 @@ TEST_CASE("ApplyConfig updates tray icon on config change") {
 
     g_trayIcon.reset();
 }
+
+// Hand out a fresh handle per file and fail for "missing.ico"
+static uintptr_t g_nextIcon = 0x100;
+static HANDLE CountingLoadImage(HINSTANCE, LPCWSTR path, UINT, int, int, UINT) {
+    if (path && std::wstring(path) == L"missing.ico")
+        return nullptr;
+    return reinterpret_cast<HANDLE>(g_nextIcon++);
+}
+
+static std::vector<HICON> g_destroyedIcons;
+static bool g_destroyedAfterModify = true;
+static BOOL RecordDestroyIcon(HICON icon) {
+    g_destroyedIcons.push_back(icon);
+    g_destroyedAfterModify = g_destroyedAfterModify && (g_lastMsg == NIM_MODIFY || g_lastMsg == NIM_DELETE);
+    return TRUE;
+}
+extern BOOL (*pDestroyIcon)(HICON);
+
+TEST_CASE("Replacing the tray icon destroys only icons loaded from files") {
+    g_lastMsg = 0;
+    g_nextIcon = 0x100;
+    g_destroyedIcons.clear();
+    g_destroyedAfterModify = true;
+    pShell_NotifyIcon = FakeShellNotifyIcon2;
+    pLoadImageW = CountingLoadImage;
+    pDestroyIcon = RecordDestroyIcon;
+
+    g_config.set(L"icon_path", L"first.ico");
+    g_config.set(L"tray_tooltip", L"Tip");
+    {
+        TrayIcon tray(reinterpret_cast<HWND>(1));
+        REQUIRE(g_destroyedIcons.empty());
+
+        tray.Update(L"second.ico", L"Tip");
+        REQUIRE(g_destroyedIcons == std::vector<HICON>{reinterpret_cast<HICON>(0x100)});
+
+        tray.ReloadIcon();
+        REQUIRE(g_destroyedIcons.size() == 2);
+        REQUIRE(g_destroyedIcons.back() == reinterpret_cast<HICON>(0x101));
+
+        // The resource fallback is shared and never destroyed
+        tray.Update(L"missing.ico", L"Tip");
+        REQUIRE(g_destroyedIcons.size() == 3);
+        tray.Update(L"third.ico", L"Tip");
+        REQUIRE(g_destroyedIcons.size() == 3);
+    }
+    // The last file icon goes with the tray
+    REQUIRE(g_destroyedIcons.size() == 4);
+    REQUIRE(g_destroyedIcons.back() == reinterpret_cast<HICON>(0x103));
+    REQUIRE(g_destroyedAfterModify);
+
+    pDestroyIcon = [](HICON) -> BOOL { return TRUE; };
+    pLoadImageW = DummyLoadImage2;
+    g_config.set(L"icon_path", L"");
+}
+
+#ifndef _WIN32
+// Record icon change notifications posted by the watch thread
+static std::atomic<int> g_iconChangedPosts{0};
+static BOOL RecordPostMessage(HWND, UINT msg, WPARAM, LPARAM) {
+    if (msg == WM_TRAY_ICON_CHANGED)
+        ++g_iconChangedPosts;
+    return TRUE;
+}
+extern BOOL (*pPostMessage)(HWND, UINT, WPARAM, LPARAM);
+
+TEST_CASE("Editing the icon file posts a reload to the window thread") {
+    namespace fs = std::filesystem;
+    fs::path dir = fs::temp_directory_path() / "kbdlayoutmon_tray_icon_watch";
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    fs::path icon = dir / "tray.ico";
+    std::ofstream(icon) << "v1";
+
+    g_iconChangedPosts = 0;
+    g_loadedPath.clear();
+    g_lastMsg = 0;
+    pShell_NotifyIcon = FakeShellNotifyIcon2;
+    pLoadImageW = DummyLoadImage2;
+    pPostMessage = RecordPostMessage;
+
+    g_config.set(L"icon_path", icon.wstring());
+    g_config.set(L"tray_tooltip", L"Tip");
+    {
+        TrayIcon tray(reinterpret_cast<HWND>(1));
+        g_loadedPath.clear();
+
+        std::ofstream(icon) << "v2";
+        for (int i = 0; i < 200 && g_iconChangedPosts == 0; ++i)
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        REQUIRE(g_iconChangedPosts > 0);
+        // Only the window thread reloads the icon
+        REQUIRE(g_loadedPath.empty());
+
+        tray.ReloadIcon();
+        REQUIRE(g_loadedPath == icon.wstring());
+        REQUIRE(g_lastMsg == NIM_MODIFY);
+        REQUIRE(g_lastTip == L"Tip");
+
+        // Switching icons stops watching the old file
+        tray.Update(L"", L"Tip");
+        std::this_thread::sleep_for(std::chrono::milliseconds(300));
+        g_iconChangedPosts = 0;
+        std::ofstream(icon) << "v3";
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        REQUIRE(g_iconChangedPosts == 0);
+    }
+
+    pPostMessage = [](HWND, UINT, WPARAM, LPARAM) -> BOOL { return TRUE; };
+    g_config.set(L"icon_path", L"");
+    fs::remove_all(dir);
+}
+#endif
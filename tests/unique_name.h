@@ -0,0 +1,23 @@
+#pragma once
+
+#include <string>
+#ifndef _WIN32
+#include <unistd.h>
+#else
+#include <windows.h>
+#endif
+
+/**
+ * @brief Name for a shared section owned by this test process.
+ *
+ * Appends the process id to @p base so concurrent test runs never attach
+ * to each other's sections.
+ */
+inline std::wstring UniqueName(const wchar_t* base) {
+#ifdef _WIN32
+    unsigned long pid = GetCurrentProcessId();
+#else
+    unsigned long pid = static_cast<unsigned long>(getpid());
+#endif
+    return std::wstring(base) + L"_" + std::to_wstring(pid);
+}
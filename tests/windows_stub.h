@@ -128,6 +128,9 @@ struct FILE_NOTIFY_INFORMATION {
 #define HWND_MESSAGE ((HWND)-3)
 #define HKEY_CURRENT_USER ((HKEY)1)
 #define HKEY_USERS ((HKEY)2)
+#define HKEY_LOCAL_MACHINE ((HKEY)3)
+#define ERROR_NO_MORE_ITEMS 259L
+#define ERROR_NOTIFY_ENUM_DIR 1022L
 #define LOWORD(l) ((LANGID)((uintptr_t)(l) & 0xFFFF))
 #define UNREFERENCED_PARAMETER(x) (void)(x)
 #define DLL_PROCESS_ATTACH 1
@@ -157,6 +160,7 @@ extern "C" {
     extern DWORD (*pWaitForMultipleObjects)(DWORD, const HANDLE*, BOOL, DWORD);
     extern DWORD (*pGetModuleFileNameW)(HINSTANCE, wchar_t*, DWORD);
     extern HANDLE (*pLoadImageW)(HINSTANCE, LPCWSTR, UINT, int, int, UINT);
+    extern BOOL (*pDestroyIcon)(HICON);
 
     ATOM RegisterClass(const WNDCLASS*);
     HWND CreateWindowEx(DWORD, LPCWSTR, LPCWSTR, DWORD, int, int, int, int, HWND, HANDLE, HINSTANCE, LPVOID);
@@ -205,6 +209,7 @@ inline BOOL GetOverlappedResult(HANDLE a, OVERLAPPED* b, DWORD* c, BOOL d) { ret
 inline DWORD WaitForMultipleObjects(DWORD a, const HANDLE* b, BOOL c, DWORD d) { return pWaitForMultipleObjects(a,b,c,d); }
 inline DWORD GetModuleFileNameW(HINSTANCE inst, wchar_t* buffer, DWORD size) { return pGetModuleFileNameW(inst, buffer, size); }
 inline HANDLE LoadImageW(HINSTANCE a, LPCWSTR b, UINT c, int d, int e, UINT f) { return pLoadImageW(a,b,c,d,e,f); }
+inline BOOL DestroyIcon(HICON icon) { return pDestroyIcon(icon); }
 inline void CloseHandle(HANDLE h) { 
     // Avoid closing our simulated in-process handles (2 and 3) which are not real
     if (h == reinterpret_cast<HANDLE>(2) || h == reinterpret_cast<HANDLE>(3))
@@ -228,15 +233,26 @@ inline BOOL ConnectNamedPipe(HANDLE a, void* b) { return pConnectNamedPipe(a,b);
 inline BOOL DisconnectNamedPipe(HANDLE a) { return pDisconnectNamedPipe(a); }
 extern LONG g_RegOpenKeyExResult;
 extern bool g_RegOpenKeyExFailOnSetValue;
-inline LONG RegOpenKeyEx(HKEY, LPCWSTR, DWORD, DWORD samDesired, HKEY*) {
+// Optional overrides (e.g. MemoryRegistry); null keeps the canned results
+extern LONG (*pRegOpenKeyEx)(HKEY, LPCWSTR, DWORD, DWORD, HKEY*);
+extern LONG (*pRegSetValueEx)(HKEY, LPCWSTR, DWORD, DWORD, const BYTE*, DWORD);
+inline LONG RegOpenKeyEx(HKEY root, LPCWSTR subKey, DWORD options, DWORD samDesired, HKEY* result) {
+    if (pRegOpenKeyEx)
+        return pRegOpenKeyEx(root, subKey, options, samDesired, result);
     if (g_RegOpenKeyExFailOnSetValue && (samDesired & KEY_SET_VALUE)) {
         return g_RegOpenKeyExResult;
     }
     return ERROR_SUCCESS;
 }
 extern LONG g_RegSetValueExResult;
-inline LONG RegSetValueEx(HKEY, LPCWSTR, DWORD, DWORD, const BYTE*, DWORD) { return g_RegSetValueExResult; }
-inline LONG RegSetValueExW(HKEY, LPCWSTR, DWORD, DWORD, const BYTE*, DWORD) { return g_RegSetValueExResult; }
+inline LONG RegSetValueEx(HKEY key, LPCWSTR name, DWORD reserved, DWORD type, const BYTE* data, DWORD size) {
+    if (pRegSetValueEx)
+        return pRegSetValueEx(key, name, reserved, type, data, size);
+    return g_RegSetValueExResult;
+}
+inline LONG RegSetValueExW(HKEY key, LPCWSTR name, DWORD reserved, DWORD type, const BYTE* data, DWORD size) {
+    return RegSetValueEx(key, name, reserved, type, data, size);
+}
 inline LONG RegQueryValueEx(HKEY, LPCWSTR valueName, DWORD, DWORD*, BYTE* data, DWORD* len) {
     if (valueName && data && len && *len >= sizeof(wchar_t) * 2) {
         auto wdata = reinterpret_cast<wchar_t*>(data);
@@ -253,6 +269,8 @@ inline LONG RegQueryValueEx(HKEY, LPCWSTR valueName, DWORD, DWORD*, BYTE* data,
 inline LONG RegDeleteValue(HKEY, LPCWSTR) { return ERROR_SUCCESS; }
 inline LONG RegCloseKey(HKEY) { return ERROR_SUCCESS; }
 inline HKL GetKeyboardLayout(DWORD) { return nullptr; }
+inline int GetKeyboardLayoutList(int, HKL*) { return 0; }
+inline LONG RegEnumKeyEx(HKEY, DWORD, LPWSTR, DWORD*, DWORD*, LPWSTR, DWORD*, void*) { return ERROR_NO_MORE_ITEMS; }
 inline BOOL GetKeyboardLayoutName(wchar_t*) { return TRUE; }
 inline HHOOK SetWindowsHookEx(int, HOOKPROC, HINSTANCE, DWORD) { return (HHOOK)1; }
 inline LRESULT CallNextHookEx(HHOOK, int, WPARAM, LPARAM) { return 0; }
@@ -267,6 +285,8 @@ extern UINT (*pSetTimer)(HWND, UINT, UINT, TIMERPROC);
 extern BOOL (*pKillTimer)(HWND, UINT);
 inline UINT SetTimer(HWND a, UINT b, UINT c, TIMERPROC d) { return pSetTimer(a, b, c, d); }
 inline BOOL KillTimer(HWND a, UINT b) { return pKillTimer(a, b); }
+extern BOOL (*pPostMessage)(HWND, UINT, WPARAM, LPARAM);
+inline BOOL PostMessage(HWND a, UINT b, WPARAM c, LPARAM d) { return pPostMessage(a, b, c, d); }
 inline int lstrlen(const wchar_t* s) { return wcslen(s); }
 extern int g_sleepCalls;
 inline void Sleep(DWORD) { ++g_sleepCalls; }
@@ -287,6 +307,7 @@ extern "C" {
     extern DWORD (*pWaitForSingleObject)(HANDLE, DWORD);
     extern DWORD (*pGetModuleFileNameW)(HINSTANCE, wchar_t*, DWORD);
     extern HANDLE (*pLoadImageW)(HINSTANCE, LPCWSTR, UINT, int, int, UINT);
+    extern BOOL (*pDestroyIcon)(HICON);
     extern UINT (*pSetTimer)(HWND, UINT, UINT, TIMERPROC);
     extern BOOL (*pKillTimer)(HWND, UINT);
     extern BOOL (WINAPI *pShell_NotifyIcon)(DWORD, PNOTIFYICONDATA);